@@ -0,0 +1,122 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+// Harness minimo de micro-benchmarks, no estilo do Google Benchmark mas sem
+// dependencias. Cada benchmark recebe um BenchState; o que vem antes do laco
+// "while (state.keepRunning())" e' preparacao e nao entra na medicao.
+//
+//   static void BM_algo(BenchState& state) {
+//       std::vector<char> dados(state.param());
+//       while (state.keepRunning()) processa(dados);
+//       state.setBytesProcessed(dados.size());
+//   }
+//   MicroBench::add("algo", BM_algo, { 1024, 4096 });
+//
+// Alocacoes sao contadas via MicroBench::allocations(), que o executavel
+// incrementa no seu operator new.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class BenchState {
+public:
+    BenchState(long long param, double minSeconds)
+        : value(param), minTime(minSeconds), iterations(0), started(false),
+          bytesPerIteration(0), itemsPerIteration(0), itemName("itens"), allocStart(0), allocEnd(0), seconds(0.0) {}
+
+    long long param() const { return value; }
+
+    bool keepRunning();
+
+    void setBytesProcessed(long long bytes) { bytesPerIteration = bytes; }
+    void setItemsProcessed(long long items, const char* name) { itemsPerIteration = items; itemName = name; }
+
+    long long getIterations() const { return iterations; }
+    double getSeconds() const { return seconds; }
+    double allocationsPerIteration() const { return iterations ? (double)(allocEnd - allocStart) / iterations : 0.0; }
+    long long getBytes() const { return bytesPerIteration; }
+    long long getItems() const { return itemsPerIteration; }
+    const char* getItemName() const { return itemName; }
+
+private:
+    long long value;
+    double minTime;
+    long long iterations;
+    bool started;
+    long long bytesPerIteration, itemsPerIteration;
+    const char* itemName;
+    long long allocStart, allocEnd;
+    double seconds;
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+class MicroBench {
+public:
+    typedef std::function<void(BenchState&)> Function;
+
+    static std::atomic<long long>& allocations() {
+        static std::atomic<long long> count(0);
+        return count;
+    }
+
+    static void add(const std::string& name, Function fn, const std::vector<long long>& params) {
+        Entry e = { name, fn, params };
+        registry().push_back(e);
+    }
+
+    // Roda os benchmarks cujo nome contem filter; imprime uma linha por parametro
+    static void run(const std::string& filter, double minSeconds) {
+        printf("%-34s %12s %10s %14s %16s %10s\n", "benchmark", "tempo/iter", "iteracoes", "MB/s", "itens/s", "allocs/iter");
+        for (const Entry& e : registry()) {
+            if (!filter.empty() && e.name.find(filter) == std::string::npos) continue;
+            for (long long p : e.params) {
+                BenchState state(p, minSeconds);
+                e.fn(state);
+
+                double perIter = state.getIterations() ? state.getSeconds() / state.getIterations() : 0.0;
+                std::string name = e.name + "/" + std::to_string(p);
+                char mbs[32] = "-", items[48] = "-";
+                if (state.getBytes() > 0 && perIter > 0)
+                    snprintf(mbs, sizeof(mbs), "%.1f", state.getBytes() / perIter / (1024.0 * 1024.0));
+                if (state.getItems() > 0 && perIter > 0)
+                    snprintf(items, sizeof(items), "%.3g %s", state.getItems() / perIter, state.getItemName());
+                printf("%-34s %9.3f us %10lld %14s %16s %10.1f\n", name.c_str(), perIter * 1e6,
+                       state.getIterations(), mbs, items, state.allocationsPerIteration());
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        Function fn;
+        std::vector<long long> params;
+    };
+
+    static std::vector<Entry>& registry() {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+};
+
+// Roda no minimo 3 iteracoes e ate' completar minTime segundos
+inline bool BenchState::keepRunning() {
+    auto now = std::chrono::high_resolution_clock::now();
+    if (!started) {
+        started = true;
+        allocStart = MicroBench::allocations().load();
+        start = now;
+        return true;
+    }
+    iterations++;
+    seconds = std::chrono::duration<double>(now - start).count();
+    if (iterations < 3 || seconds < minTime) return true;
+    allocEnd = MicroBench::allocations().load();
+    return false;
+}
+
+#endif
@@ -0,0 +1,451 @@
+// Micro-benchmarks dos kernels de CPU: Bmp::load, Bmp::convertBGRtoRGB,
+// Terrain::buildBlockMesh (parte de CPU do generateBlockMesh), createSphere,
+// createIcosphere, MeshBuilder::optimize, ImageOps (luminancia, HLS,
+// histograma; luminancia tambem so' com SSE2 e sem SIMD), os filtros em
+// frequencia de Fft2D (heightmap e imagem), FilterPipeline (cadeia fundida
+// contra um filtro por passada), NoiseSource (fBm, ridged e warped; fBm
+// tambem escalar), Erosion (gotas e termica, esta tambem escalar) e
+// HorizonBake (varredura de horizontes e so' a sombra do sol) e
+// SoftRasterizer (um quadro do terreno em wireframe via Terrain::rasterize).
+// Nao precisa de contexto OpenGL.
+//
+// Uso: micro_benchmarks [filtro] [--min-time segundos]
+//
+// Compilar com ../Comum/{bmp,Fft,FilterPipeline,GLState,ImageOps,MeshBuilder,Profiler,ShaderCache,ShaderReflection,SoftRasterizer,ThreadPool}.cpp,
+// ../Manipulacao_de_terrenos/{Erosion,HorizonBake,Terrain,HeightMap,NoiseSource,png}.cpp,
+// ../Camera_3D/ConsoleApplication1/ConsoleApplication1/Sphere.cpp e linkar GLEW/OpenGL
+// (Terrain.cpp referencia funcoes GL mesmo que o benchmark nao as chame).
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "MicroBench.h"
+#include "../Comum/Bmp.h"
+#include "../Comum/Fft.h"
+#include "../Comum/FilterPipeline.h"
+#include "../Comum/ImageOps.h"
+#include "../Comum/MeshBuilder.h"
+#include "../Comum/SoftRasterizer.h"
+#include "../Manipulacao_de_terrenos/Erosion.h"
+#include "../Manipulacao_de_terrenos/HeightMap.h"
+#include "../Manipulacao_de_terrenos/HorizonBake.h"
+#include "../Manipulacao_de_terrenos/NoiseSource.h"
+#include "../Manipulacao_de_terrenos/Terrain.h"
+#include "../Camera_3D/ConsoleApplication1/ConsoleApplication1/Sphere.h"
+
+// Conta todas as alocacoes do processo para o relatorio "allocs/iter". As
+// formas [] e com tamanho tambem sao substituidas: nao depende de a
+// biblioteca repassar para as basicas. O g++ ve o free() de memoria vinda de
+// operator new e avisa (-Wmismatched-new-delete), aqui e' de proposito
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static void* countedAlloc(size_t size) {
+    MicroBench::allocations()++;
+    void* p = malloc(size ? size : 1);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) {
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size) {
+    return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+// Imagem 24 bits de lado n com conteudo deterministico, gravada em disco uma unica vez
+static std::string benchBmpPath(int n) {
+    std::string path = "microbench_" + std::to_string(n) + ".bmp";
+    FILE* fp = NULL;
+    fopen_s(&fp, path.c_str(), "rb");
+    if (fp != NULL) {
+        fclose(fp);
+        return path;
+    }
+
+    int lineSize = (3 * n + 3) / 4 * 4;
+    std::vector<unsigned char> pixels((size_t)lineSize * n);
+    for (size_t i = 0; i < pixels.size(); i++) pixels[i] = (unsigned char)(i * 2654435761u >> 24);
+    Bmp::save(path.c_str(), n, n, pixels.data());
+    return path;
+}
+
+static void BM_BmpLoad(BenchState& state) {
+    int n = (int)state.param();
+    std::string path = benchBmpPath(n);
+    while (state.keepRunning()) {
+        Bmp bmp(path.c_str());
+        if (bmp.getImage() == NULL) abort();
+    }
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+static void BM_ConvertBGRtoRGB(BenchState& state) {
+    int n = (int)state.param();
+    Bmp bmp(benchBmpPath(n).c_str());
+    while (state.keepRunning()) {
+        bmp.convertBGRtoRGB();
+    }
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// Luminancia da imagem de lado n com o caminho SIMD dado (restaurado no fim)
+static void luminanceBench(BenchState& state, ImageOps::Simd simd) {
+    int n = (int)state.param();
+    Bmp bmp(benchBmpPath(n).c_str());
+    std::vector<unsigned char> gray((size_t)n * n);
+    ImageOps::Simd previous = ImageOps::getSimd();
+    ImageOps::setSimd(simd);
+    while (state.keepRunning()) {
+        ImageOps::luminance(bmp.getImage(), n, n, gray.data());
+    }
+    ImageOps::setSimd(previous);
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+static void BM_Luminance(BenchState& state) {
+    luminanceBench(state, ImageOps::SIMD_AVX2);
+}
+
+static void BM_LuminanceSse2(BenchState& state) {
+    luminanceBench(state, ImageOps::SIMD_SSE2);
+}
+
+static void BM_LuminanceScalar(BenchState& state) {
+    luminanceBench(state, ImageOps::SIMD_NONE);
+}
+
+// Ida e volta RGB -> HLS -> RGB
+static void BM_HlsRoundTrip(BenchState& state) {
+    int n = (int)state.param();
+    Bmp bmp(benchBmpPath(n).c_str());
+    std::vector<float> h((size_t)n * n), l((size_t)n * n), s((size_t)n * n);
+    std::vector<unsigned char> back((size_t)ImageOps::stride(n) * n);
+    while (state.keepRunning()) {
+        ImageOps::rgbToHls(bmp.getImage(), n, n, h.data(), l.data(), s.data());
+        ImageOps::hlsToRgb(h.data(), l.data(), s.data(), n, n, back.data());
+    }
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+static void BM_Histogram(BenchState& state) {
+    int n = (int)state.param();
+    Bmp bmp(benchBmpPath(n).c_str());
+    ImageOps::Histogram histogram;
+    while (state.keepRunning()) {
+        ImageOps::histogram(bmp.getImage(), n, n, histogram);
+    }
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// Passa-baixa gaussiano num heightmap fractal n x n (ida, mascara e volta).
+// 1000 = 2^3 5^3 usa as raizes 2 e 5; 1025 = 5^2 41 cai no Bluestein
+static void BM_FftFilterHeightMap(BenchState& state) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    Fft2D fft(n, n);
+    FrequencyFilter filter(FrequencyFilter::GAUSSIAN, false, 30.0f);
+    while (state.keepRunning()) {
+        fft.filter(map.getData(), filter);
+    }
+    state.setBytesProcessed((long long)n * n * sizeof(float));
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// Passa-alta ideal de raio 30 nos 3 canais, como no notebook
+static void BM_FftFilterImage(BenchState& state) {
+    int n = (int)state.param();
+    Bmp bmp(benchBmpPath(n).c_str());
+    std::vector<unsigned char> image(bmp.getImage(), bmp.getImage() + (size_t)ImageOps::stride(n) * n);
+    Fft2D fft(n, n);
+    FrequencyFilter filter(FrequencyFilter::IDEAL, true, 30.0f);
+    while (state.keepRunning()) {
+        fft.filterImage(image.data(), filter);
+    }
+    state.setBytesProcessed((long long)n * n * 3);
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// Mediana 3x3 + gaussiano + Sobel + unsharp num heightmap n x n, fundidos por
+// ladrilho, ou um FilterPipeline por filtro, com a imagem inteira indo e
+// voltando da memoria entre eles
+static void filterChainBench(BenchState& state, bool fused) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    std::vector<float> out((size_t)n * n), temp((size_t)n * n);
+
+    FilterPipeline chain;
+    chain.median(1).gaussian(1.5f).sobel().unsharp(1.0f, 0.5f);
+    FilterPipeline single[4];
+    single[0].median(1);
+    single[1].gaussian(1.5f);
+    single[2].sobel();
+    single[3].unsharp(1.0f, 0.5f);
+
+    while (state.keepRunning()) {
+        if (fused) {
+            chain.run(map.getData(), out.data(), n, n);
+        }
+        else {
+            single[0].run(map.getData(), out.data(), n, n);
+            single[1].run(out.data(), temp.data(), n, n);
+            single[2].run(temp.data(), out.data(), n, n);
+            single[3].run(out.data(), temp.data(), n, n);
+        }
+    }
+    state.setBytesProcessed((long long)n * n * sizeof(float));
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+static void BM_FilterChain(BenchState& state) {
+    filterChainBench(state, true);
+}
+
+static void BM_FilterSeparate(BenchState& state) {
+    filterChainBench(state, false);
+}
+
+// Parametro: tamanho do bloco em LOD 1 sobre um heightmap fractal de 1024^2
+static void BM_BuildBlockMesh(BenchState& state) {
+    int blockSize = (int)state.param();
+    HeightMap map;
+    map.generateFractal(1024, 1024, 42u);
+    Terrain terrain(map, 0);
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    while (state.keepRunning()) {
+        terrain.buildBlockMesh(1, 0, 0, blockSize, blockSize, vertices, indices);
+    }
+    state.setBytesProcessed((long long)(vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int)));
+    state.setItemsProcessed((long long)vertices.size() / 5, "vert");
+}
+
+// Parametro: sectorCount, com stackCount = sectorCount / 2 (mesma proporcao de 36x18)
+static void BM_CreateSphere(BenchState& state) {
+    unsigned int sectors = (unsigned int)state.param();
+    size_t vertexCount = 0;
+    while (state.keepRunning()) {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        createSphere(vertices, indices, 1.0f, sectors, sectors / 2);
+        vertexCount = vertices.size() / 6;
+    }
+    state.setItemsProcessed((long long)vertexCount, "vert");
+}
+
+static void BM_CreateIcosphere(BenchState& state) {
+    unsigned int subdivisions = (unsigned int)state.param();
+    size_t vertexCount = 0;
+    while (state.keepRunning()) {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        createIcosphere(vertices, indices, 1.0f, subdivisions);
+        vertexCount = vertices.size() / 6;
+    }
+    state.setItemsProcessed((long long)vertexCount, "vert");
+}
+
+static void BM_MeshOptimize(BenchState& state) {
+    unsigned int sectors = (unsigned int)state.param();
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    createSphere(vertices, indices, 1.0f, sectors, sectors / 2);
+    while (state.keepRunning()) {
+        MeshBuilder mesh(6);
+        mesh.addMesh(vertices, indices);
+        mesh.optimize();
+    }
+    state.setItemsProcessed((long long)(indices.size() / 3), "tri");
+}
+
+// Mapa n x n de 6 oitavas: SSE2 em ladrilhos no ThreadPool, ou sample() um a um
+static void noiseBench(BenchState& state, NoiseSource::Type type, bool scalar) {
+    int n = (int)state.param();
+    NoiseSource noise(NoiseSource::Settings(type, 42u));
+    std::vector<float> out((size_t)n * n);
+    while (state.keepRunning()) {
+        if (scalar) {
+            for (int y = 0; y < n; y++)
+                for (int x = 0; x < n; x++) out[(size_t)y * n + x] = noise.sample((float)x, (float)y);
+        }
+        else {
+            noise.generate(0, 0, n, n, out.data());
+        }
+    }
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+static void BM_NoiseFbm(BenchState& state) {
+    noiseBench(state, NoiseSource::FBM, false);
+}
+
+static void BM_NoiseFbmScalar(BenchState& state) {
+    noiseBench(state, NoiseSource::FBM, true);
+}
+
+static void BM_NoiseRidged(BenchState& state) {
+    noiseBench(state, NoiseSource::RIDGED, false);
+}
+
+static void BM_NoiseWarped(BenchState& state) {
+    noiseBench(state, NoiseSource::WARPED, false);
+}
+
+// Uma gota por amostra de um mapa fractal n x n (o mapa vai sendo erodido
+// entre as iteracoes, como numa simulacao longa)
+static void BM_ErosionHydraulic(BenchState& state) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    Erosion erosion(map);
+    while (state.keepRunning()) {
+        erosion.hydraulic(n * n);
+    }
+    state.setItemsProcessed((long long)n * n, "gotas");
+}
+
+// 16 iteracoes de erosao termica (4 trocas de halo) num mapa n x n
+static void thermalBench(BenchState& state, bool simd) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    Erosion::Settings settings;
+    settings.simd = simd;
+    Erosion erosion(map, settings);
+    while (state.keepRunning()) {
+        erosion.thermal(16);
+    }
+    state.setItemsProcessed((long long)n * n * 16, "px");
+}
+
+static void BM_ErosionThermal(BenchState& state) {
+    thermalBench(state, true);
+}
+
+static void BM_ErosionThermalScalar(BenchState& state) {
+    thermalBench(state, false);
+}
+
+// 16 azimutes, ceu visivel e sombra de um mapa fractal n x n
+static void BM_HorizonBake(BenchState& state) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    HorizonBake bake;
+    while (state.keepRunning()) {
+        bake.bake(map);
+    }
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// So' a sombra de um sol que se move, sem refazer os horizontes
+static void BM_HorizonBakeSetSun(BenchState& state) {
+    int n = (int)state.param();
+    HeightMap map;
+    map.generateFractal(n, n, 42u);
+    HorizonBake bake;
+    bake.bake(map);
+    float azimuth = 0.0f;
+    while (state.keepRunning()) {
+        azimuth += 0.01f;
+        bake.setSun(azimuth, 0.35f);
+    }
+    state.setItemsProcessed((long long)n * n, "px");
+}
+
+// Parametro: largura da imagem (4:3); terreno fractal de 256^2 visto da
+// posicao inicial do demo, ja' com o descarte e o LOD por bloco
+static void BM_SoftRasterTerrain(BenchState& state) {
+    int w = (int)state.param(), h = w * 3 / 4;
+    HeightMap map;
+    map.generateFractal(256, 256, 42u);
+    Terrain terrain(map, 0);
+    SoftRasterizer raster(w, h);
+    glm::vec3 cameraPosition(128, 60, 256);
+    glm::mat4 mvp = glm::perspective(glm::radians(45.0f), (float)w / h, 1.0f, 1000.0f) *
+                    glm::lookAt(cameraPosition, glm::vec3(128, 0, 128), glm::vec3(0, 1, 0));
+    while (state.keepRunning()) {
+        raster.clear(0.0f, 0.0f, 0.0f);
+        terrain.rasterize(raster, mvp, cameraPosition);
+        raster.finish();
+    }
+    state.setItemsProcessed(raster.getStats().triangles, "tri");
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--min-time" && i + 1 < argc) minTime = atof(argv[++i]);
+        else filter = arg;
+    }
+
+    Bmp::setVerbose(false);
+
+    MicroBench::add("Bmp::load", BM_BmpLoad, { 256, 512, 1024, 2048, 4096 });
+    MicroBench::add("Bmp::convertBGRtoRGB", BM_ConvertBGRtoRGB, { 256, 512, 1024, 2048, 4096 });
+    MicroBench::add("Terrain::buildBlockMesh", BM_BuildBlockMesh, { 32, 64, 128, 256, 512 });
+    MicroBench::add("createSphere", BM_CreateSphere, { 36, 72, 144, 288, 576 });
+    MicroBench::add("createIcosphere", BM_CreateIcosphere, { 2, 3, 4, 5, 6 });
+    MicroBench::add("MeshBuilder::optimize", BM_MeshOptimize, { 36, 72, 144, 288, 576 });
+    MicroBench::add("ImageOps::luminance", BM_Luminance, { 256, 1024, 4096 });
+    MicroBench::add("ImageOps::luminance (SSE2)", BM_LuminanceSse2, { 256, 1024, 4096 });
+    MicroBench::add("ImageOps::luminance (escalar)", BM_LuminanceScalar, { 256, 1024, 4096 });
+    MicroBench::add("ImageOps::rgbToHls+hlsToRgb", BM_HlsRoundTrip, { 256, 1024, 4096 });
+    MicroBench::add("ImageOps::histogram", BM_Histogram, { 256, 1024, 4096 });
+    MicroBench::add("Fft2D::filter (heightmap)", BM_FftFilterHeightMap, { 256, 1000, 1024, 1025, 2048 });
+    MicroBench::add("Fft2D::filterImage", BM_FftFilterImage, { 256, 1024 });
+    MicroBench::add("FilterPipeline::run (cadeia)", BM_FilterChain, { 512, 2048, 4096 });
+    MicroBench::add("FilterPipeline::run (um filtro por passada)", BM_FilterSeparate, { 512, 2048, 4096 });
+    MicroBench::add("NoiseSource::generate (fbm)", BM_NoiseFbm, { 256, 1024 });
+    MicroBench::add("NoiseSource::sample (fbm, escalar)", BM_NoiseFbmScalar, { 256, 1024 });
+    MicroBench::add("NoiseSource::generate (ridged)", BM_NoiseRidged, { 256, 1024 });
+    MicroBench::add("NoiseSource::generate (warped)", BM_NoiseWarped, { 256, 1024 });
+    MicroBench::add("Erosion::hydraulic", BM_ErosionHydraulic, { 256, 1024 });
+    MicroBench::add("Erosion::thermal", BM_ErosionThermal, { 256, 1024, 4096 });
+    MicroBench::add("Erosion::thermal (escalar)", BM_ErosionThermalScalar, { 256, 1024, 4096 });
+    MicroBench::add("HorizonBake::bake", BM_HorizonBake, { 256, 1024 });
+    MicroBench::add("HorizonBake::setSun", BM_HorizonBakeSetSun, { 256, 1024 });
+    MicroBench::add("SoftRasterizer (terreno)", BM_SoftRasterTerrain, { 400, 800, 1600 });
+
+    MicroBench::run(filter, minTime);
+    return 0;
+}
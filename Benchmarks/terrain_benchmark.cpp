@@ -0,0 +1,300 @@
+// Benchmark de renderizacao do Terrain.
+//
+// Para cada cenario gera um heightmap fractal sintetico (ou carrega os arquivos
+// passados com --map), faz um voo de camera roteirizado e deterministico sobre
+// o terreno e reporta em JSON: tempo de geracao de malha, bytes enviados a GPU,
+// draw calls, triangulos submetidos e os percentis p50/p95/p99 do tempo de quadro.
+// Com --stream R cada tamanho tambem roda com alturas procedurais geradas so'
+// nos blocos a menos de R da camera (Terrain com NoiseSource), sem heightmap.
+// --no-culling desliga o descarte por frustum e por oclusao do Terrain.
+// --tess P troca as malhas da CPU pela tesselacao na GPU (segmentos de ~P
+// pixels); os triangulos entao sao os gerados pela GPU, lidos um quadro depois.
+//
+// Uso: terrain_benchmark [--sizes 256,512,...] [--frames N] [--map arquivo]... [--stream R] [--no-culling]
+//                        [--tess P] [--out arquivo.json]
+//
+// Compilar com ../Manipulacao_de_terrenos/{Terrain,HeightMap,NoiseSource,png}.cpp,
+// ../Comum/{bmp,FrameCapture,GLState,Headless,Profiler,ShaderCache,ShaderReflection,SoftRasterizer,ThreadPool}.cpp e GLEW/GLFW (ou -DHEADLESS_EGL -lEGL).
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../Comum/GLState.h"
+#include "../Comum/Headless.h"
+#include "../Comum/ShaderCache.h"
+#include "../Manipulacao_de_terrenos/Terrain.h"
+
+#define SCREEN_X 800
+#define SCREEN_Y 600
+
+// mesmos shaders do demo de terreno
+const char* vertexShaderSource = R"(
+#version 400 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoord;
+uniform mat4 mvp;
+out vec2 TexCoord;
+void main() {
+    TexCoord = aTexCoord;
+    gl_Position = mvp * vec4(aPos, 1.0);
+})";
+
+const char* fragmentShaderSource = R"(
+#version 400 core
+in vec2 TexCoord;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(TexCoord, 1.0, 1.0);
+})";
+
+struct Scenario {
+    std::string name;
+    HeightMap map;
+};
+
+struct Result {
+    std::string name;
+    int width, height, frames;
+    double setupMs;          // carga/geracao do heightmap
+    double streamMs;         // geracao das alturas dos blocos no streaming, somada em todos os quadros
+    double meshMs;           // geracao de malha (CPU + upload) somada em todos os quadros
+    long long uploadBytes;
+    double drawCalls;        // media por quadro
+    double triangles;        // media por quadro
+    double blocksCulled;     // media por quadro, fora do frustum
+    double blocksOccluded;   // media por quadro, atras do relevo
+    double p50, p95, p99, mean;
+};
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t i = (size_t)std::ceil(p * values.size());
+    return values[i == 0 ? 0 : i - 1];
+}
+
+// Voo roteirizado: atravessa o mapa na diagonal a baixa altitude, com uma
+// leve ondulacao lateral, olhando sempre para frente
+static void cameraPath(float t, int width, int height, glm::vec3& eye, glm::vec3& target) {
+    float u = 0.1f + 0.8f * t;
+    float wobble = 0.1f * std::sin(t * 6.2831853f * 2.0f);
+    eye = glm::vec3(width * (u + wobble * 0.5f), 40.0f, height * (u - wobble * 0.5f));
+    target = eye + glm::vec3(width * 0.05f, -15.0f, height * 0.05f);
+}
+
+static Result runScenario(const std::string& name, Terrain& terrain, int frames, double setupMs, bool culling) {
+    Result r;
+    r.name = name;
+    r.width = terrain.getWidth();
+    r.height = terrain.getHeight();
+    r.frames = frames;
+    r.setupMs = setupMs;
+    r.streamMs = 0.0;
+    r.meshMs = 0.0;
+    r.uploadBytes = 0;
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_X / SCREEN_Y, 1.0f, 1000.0f);
+
+    long long drawCalls = 0, triangles = 0, culled = 0, occluded = 0;
+    terrain.setCulling(culling);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frames);
+
+    for (int f = 0; f < frames; f++) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        glm::vec3 eye, target;
+        cameraPath(frames > 1 ? (float)f / (frames - 1) : 0.0f, r.width, r.height, eye, target);
+        glm::mat4 mvp = projection * glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        terrain.render(mvp, eye);
+        // espera a GPU para o tempo de quadro incluir o trabalho submetido
+        glFinish();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        frameTimes.push_back(elapsed.count());
+
+        const Terrain::Stats& stats = terrain.getStats();
+        r.meshMs += stats.meshTimeMs;
+        r.streamMs += stats.generateMs;
+        r.uploadBytes += stats.uploadBytes;
+        drawCalls += stats.drawCalls;
+        triangles += stats.triangles;
+        culled += stats.blocksCulled;
+        occluded += stats.blocksOccluded;
+    }
+
+    double sum = 0.0;
+    for (double t : frameTimes) sum += t;
+    r.mean = frames > 0 ? sum / frames : 0.0;
+    r.drawCalls = frames > 0 ? (double)drawCalls / frames : 0.0;
+    r.triangles = frames > 0 ? (double)triangles / frames : 0.0;
+    r.blocksCulled = frames > 0 ? (double)culled / frames : 0.0;
+    r.blocksOccluded = frames > 0 ? (double)occluded / frames : 0.0;
+    r.p50 = percentile(frameTimes, 0.50);
+    r.p95 = percentile(frameTimes, 0.95);
+    r.p99 = percentile(frameTimes, 0.99);
+    return r;
+}
+
+// Entre aspas e escapado: nomes de --map sao caminhos (barras invertidas no Windows)
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out += code;
+        }
+        else {
+            out += (char)c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string toJSON(const std::vector<Result>& results, const char* renderer) {
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\n  \"renderer\": " << jsonString(renderer ? renderer : "") << ",\n  \"scenarios\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    {\n"
+            << "      \"name\": " << jsonString(r.name) << ",\n"
+            << "      \"width\": " << r.width << ",\n"
+            << "      \"height\": " << r.height << ",\n"
+            << "      \"frames\": " << r.frames << ",\n"
+            << "      \"heightmap_ms\": " << r.setupMs << ",\n"
+            << "      \"stream_generation_ms\": " << r.streamMs << ",\n"
+            << "      \"mesh_generation_ms\": " << r.meshMs << ",\n"
+            << "      \"upload_bytes\": " << r.uploadBytes << ",\n"
+            << "      \"draw_calls_per_frame\": " << r.drawCalls << ",\n"
+            << "      \"triangles_per_frame\": " << r.triangles << ",\n"
+            << "      \"blocks_culled_per_frame\": " << r.blocksCulled << ",\n"
+            << "      \"blocks_occluded_per_frame\": " << r.blocksOccluded << ",\n"
+            << "      \"frame_ms\": { \"mean\": " << r.mean << ", \"p50\": " << r.p50
+            << ", \"p95\": " << r.p95 << ", \"p99\": " << r.p99 << " }\n"
+            << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = { 256, 512, 1024, 2048, 4096, 8192 };
+    std::vector<std::string> maps;
+    std::string outPath;
+    int frames = 120;
+    float streamRadius = 0.0f;
+    bool culling = true;
+    float tessPixels = 0.0f;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        }
+        else if (arg == "--map" && i + 1 < argc) {
+            maps.push_back(argv[++i]);
+        }
+        else if (arg == "--stream" && i + 1 < argc) {
+            streamRadius = (float)atof(argv[++i]);
+        }
+        else if (arg == "--no-culling") {
+            culling = false;
+        }
+        else if (arg == "--tess" && i + 1 < argc) {
+            tessPixels = (float)atof(argv[++i]);
+        }
+        else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+        else if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) sizes.push_back(atoi(item.c_str()));
+        }
+    }
+
+    // o benchmark sempre roda sem janela; o laco de quadros e' proprio
+    char* headlessArgs[] = { argv[0], (char*)"--headless" };
+    Headless app(2, headlessArgs);
+    app.createContext(4, 0, true, SCREEN_X, SCREEN_Y, "Terrain benchmark");
+    if (!app.isOk()) return -1;
+
+    GLState::current().depthTest(true);
+    GLuint shaderProgram = ShaderCache::instance().program(vertexShaderSource, fragmentShaderSource);
+
+    std::vector<Result> results;
+    for (int size : sizes) {
+        Scenario scenario;
+        scenario.name = "fractal_" + std::to_string(size);
+        auto start = std::chrono::high_resolution_clock::now();
+        scenario.map.generateFractal(size, size, 1234u);
+        std::chrono::duration<double, std::milli> setup = std::chrono::high_resolution_clock::now() - start;
+
+        std::cerr << "Cenario " << scenario.name << "..." << std::endl;
+        Terrain terrain(scenario.map, shaderProgram);
+        if (tessPixels > 0.0f && terrain.enableTessellation(fragmentShaderSource)) {
+            terrain.setTessellationDetail(tessPixels);
+            scenario.name += "_tess";
+        }
+        results.push_back(runScenario(scenario.name, terrain, frames, setup.count(), culling));
+
+        if (streamRadius > 0.0f) {
+            std::string name = "noise_stream_" + std::to_string(size);
+            std::cerr << "Cenario " << name << "..." << std::endl;
+            Terrain streamed(NoiseSource(NoiseSource::Settings(NoiseSource::FBM, 1234u)), size, size, shaderProgram,
+                             streamRadius);
+            results.push_back(runScenario(name, streamed, frames, 0.0, culling));
+        }
+    }
+    for (const std::string& path : maps) {
+        Scenario scenario;
+        scenario.name = path;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!scenario.map.load(path)) continue;
+        std::chrono::duration<double, std::milli> setup = std::chrono::high_resolution_clock::now() - start;
+
+        std::cerr << "Cenario " << scenario.name << "..." << std::endl;
+        Terrain terrain(scenario.map, shaderProgram);
+        if (tessPixels > 0.0f && terrain.enableTessellation(fragmentShaderSource)) {
+            terrain.setTessellationDetail(tessPixels);
+            scenario.name += "_tess";
+        }
+        results.push_back(runScenario(scenario.name, terrain, frames, setup.count(), culling));
+    }
+
+    ShaderCache::instance().clear();
+
+    std::string json = toJSON(results, (const char*)glGetString(GL_RENDERER));
+    if (outPath.empty()) {
+        std::cout << json;
+    }
+    else {
+        FILE* fp = NULL;
+        fopen_s(&fp, outPath.c_str(), "w");
+        if (fp == NULL) {
+            std::cerr << "Erro ao criar " << outPath << std::endl;
+            return -1;
+        }
+        fputs(json.c_str(), fp);
+        fclose(fp);
+    }
+    return 0;
+}
@@ -2,132 +2,48 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <stdlib.h>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
+#include "../../../Comum/GLState.h"
+#include "../../../Comum/Headless.h"
+#include "../../../Comum/MeshBuilder.h"
+#include "../../../Comum/SoftRasterizer.h"
+#include "InstancedRenderer.h"
+#include "Sphere.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-const char* vertexShaderSource = R"(
-    #version 400 core
-    layout(location = 0) in vec3 aPos;
-    layout(location = 1) in vec3 aColor;
-
-    out vec3 vertexColor;
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
-
-    void main() {
-        gl_Position = projection * view * model * vec4(aPos, 1.0);
-        vertexColor = aColor;
+int main(int argc, char** argv) {
+    // "--instances N" desenha uma grade de N objetos (cubos e esferas alternados);
+    // sem ele, a cena original com um cubo e uma esfera
+    // "--icosphere" troca a cadeia de esferas UV por icosferas
+    int instanceCount = 0;
+    bool useIcosphere = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--instances" && i + 1 < argc) instanceCount = atoi(argv[i + 1]);
+        else if (std::string(argv[i]) == "--icosphere") useIcosphere = true;
     }
-)";
-
-const char* fragmentShaderSource = R"(
-    #version 400 core
-    in vec3 vertexColor;
-    out vec4 FragColor;
 
-    void main() {
-        FragColor = vec4(vertexColor, 1.0);
-    }
-)";
+    Headless app(argc, argv);
+    app.createContext(4, 4, true, 800, 600, "Cubo e Esfera 3D");
+    if (!app.isOk()) return -1;
 
-void checkCompileErrors(GLuint shader, std::string type) {
-    GLint success;
-    GLchar infoLog[1024];
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n" << std::endl;
-        }
+    // "--software" desenha no SoftRasterizer, sem GL
+    std::unique_ptr<SoftRasterizer> software;
+    if (app.isSoftware()) {
+        software.reset(new SoftRasterizer(800, 600));
     }
     else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n" << std::endl;
-        }
-    }
-}
-
-void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectorCount, unsigned int stackCount) {
-    float x, y, z, xy;                              // vertex position
-    float nx, ny, nz, lengthInv = 1.0f / radius;    // normal
-    float s, t;                                     // texCoord
-
-    float sectorStep = 2 * M_PI / sectorCount;
-    float stackStep = M_PI / stackCount;
-    float sectorAngle, stackAngle;
-
-    for (unsigned int i = 0; i <= stackCount; ++i) {
-        stackAngle = M_PI / 2 - i * stackStep;        // starting from pi/2 to -pi/2
-        xy = radius * cosf(stackAngle);             // r * cos(u)
-        z = radius * sinf(stackAngle);              // r * sin(u)
-
-        for (unsigned int j = 0; j <= sectorCount; ++j) {
-            sectorAngle = j * sectorStep;           // starting from 0 to 2pi
-
-            x = xy * cosf(sectorAngle);             // r * cos(u) * cos(v)
-            y = xy * sinf(sectorAngle);             // r * cos(u) * sin(v)
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-            vertices.push_back((x * lengthInv + 1) / 2); // color
-            vertices.push_back((y * lengthInv + 1) / 2);
-            vertices.push_back((z * lengthInv + 1) / 2);
-        }
-    }
-
-    unsigned int k1, k2;
-    for (unsigned int i = 0; i < stackCount; ++i) {
-        k1 = i * (sectorCount + 1);
-        k2 = k1 + sectorCount + 1;
-
-        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
-            if (i != 0) {
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
-
-            if (i != (stackCount - 1)) {
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
-        }
-    }
-}
-
-int main() {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Cubo e Esfera 3D", NULL, NULL);
-    if (!window) {
-        std::cerr << "Erro ao criar janela GLFW" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Erro ao inicializar GLEW" << std::endl;
-        return -1;
+        GLState::current().depthTest(true);
+        glViewport(0, 0, 800, 600);
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glViewport(0, 0, 800, 600);
-
     // Define os vértices do cubo (posição + cor)
     GLfloat cubeVertices[] = {
         // Face traseira
@@ -179,103 +95,89 @@ int main() {
          -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 1.0f
     };
 
-    // Criação de VAO e VBO para o cubo
-    GLuint cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Criação de VAO, VBO e EBO para a esfera
-    std::vector<float> sphereVertices;
-    std::vector<unsigned int> sphereIndices;
-    createSphere(sphereVertices, sphereIndices, 1.0f, 36, 18);
-
-    GLuint sphereVAO, sphereVBO, sphereEBO;
-    glGenVertexArrays(1, &sphereVAO);
-    glGenBuffers(1, &sphereVBO);
-    glGenBuffers(1, &sphereEBO);
-
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), &sphereVertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), &sphereIndices[0], GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkCompileErrors(vertexShader, "VERTEX");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkCompileErrors(fragmentShader, "FRAGMENT");
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    checkCompileErrors(shaderProgram, "PROGRAM");
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    glUseProgram(shaderProgram);
+    // O cubo nao indexado (36 vertices) vira 18 vertices unicos + indices
+    MeshBuilder cubeMesh(6);
+    std::vector<unsigned int> cubeIndices(36);
+    for (unsigned int i = 0; i < 36; i++) cubeIndices[i] = i;
+    MeshBuilder::CacheStats cubeBefore = MeshBuilder::analyze(cubeIndices, 36);
+    cubeMesh.addMesh(std::vector<float>(cubeVertices, cubeVertices + sizeof(cubeVertices) / sizeof(GLfloat)), std::vector<unsigned int>());
+    cubeMesh.optimize();
+    std::cout << MeshBuilder::report("Cubo", cubeBefore, cubeMesh.analyze()) << std::endl;
+
+    // Esferas distantes usam niveis com poucos triangulos, escolhidos pelo raio projetado
+    std::vector<SphereLod> sphereLods = createSphereLods(1.0f, useIcosphere ? 5 : 4, useIcosphere);
+    std::vector<int> sphereMeshes;
+
+    // Uma chamada de desenho por tipo de malha, qualquer que seja o numero de objetos
+    InstancedRenderer renderer(software.get());
+    int cube = renderer.addMesh(cubeMesh.getVertices(), cubeMesh.getIndices());
+    for (size_t i = 0; i < sphereLods.size(); i++) {
+        MeshBuilder sphereMesh(6);
+        sphereMesh.addMesh(sphereLods[i].vertices, sphereLods[i].indices);
+        MeshBuilder::CacheStats sphereBefore = sphereMesh.analyze();
+        sphereMesh.optimize();
+        std::string name = "Esfera LOD " + std::to_string(i);
+        std::cout << MeshBuilder::report(name.c_str(), sphereBefore, sphereMesh.analyze()) << std::endl;
+        sphereMeshes.push_back(renderer.addMesh(sphereMesh.getVertices(), sphereMesh.getIndices()));
+    }
 
-    int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    int projLoc = glGetUniformLocation(shaderProgram, "projection");
+    // Grade centrada na origem, espacamento de 3 unidades
+    std::vector<glm::vec3> positions;
+    int side = (int)std::ceil(std::sqrt((double)instanceCount));
+    for (int i = 0; i < instanceCount; i++) {
+        positions.push_back(glm::vec3((i % side - side / 2) * 3.0f, 0.0f, (i / side - side / 2) * 3.0f));
+    }
 
     // Fator de velocidade para a rotação
     float rotationSpeed = 2.0f;
+    float radius = instanceCount > 0 ? std::max(5.0f, side * 2.0f) : 5.0f;
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+    float fovY = glm::radians(45.0f);
+    long long sphereTriangles = 0, sphereTrianglesFull = 0;
+    glm::mat4 projection = glm::perspective(fovY, 800.0f / 600.0f, 0.1f, std::max(100.0f, radius * 4.0f));
 
-    while (!glfwWindowShouldClose(window)) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    while (app.running()) {
+        if (software) software->clear(0.0f, 0.0f, 0.0f);
+        else glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        float time = (float)app.getTime();
 
         // Calcula a posição da câmera em uma órbita circular
-        float radius = 5.0f;
-        float camX = sin(glfwGetTime()) * radius;
-        float camZ = cos(glfwGetTime()) * radius;
-        glm::mat4 view = glm::lookAt(glm::vec3(camX, 0.0f, camZ), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-
-        // Renderiza o cubo
-        glm::mat4 model = glm::rotate(glm::mat4(1.0f), rotationSpeed * (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        float camX = sin(time) * radius;
+        float camZ = cos(time) * radius;
+        float camY = instanceCount > 0 ? radius * 0.5f : 0.0f;
+
+        glm::vec3 eye(camX, camY, camZ);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), up);
+
+        std::vector<InstancedRenderer::Instance>& cubes = renderer.instances(cube);
+        cubes.clear();
+        for (int mesh : sphereMeshes) renderer.instances(mesh).clear();
+        sphereTriangles = sphereTrianglesFull = 0;
+
+        for (int i = 0; i < std::max(instanceCount, 2); i++) {
+            glm::vec3 position = instanceCount > 0 ? positions[i] : glm::vec3(i * 2.0f, 0.0f, 0.0f);
+            InstancedRenderer::Instance instance =
+                InstancedRenderer::makeInstance(position, 1.0f, up, rotationSpeed * time + (instanceCount > 0 ? i * 0.1f : 0.0f));
+            if (!(i & 1)) {
+                cubes.push_back(instance);
+                continue;
+            }
 
-        // Renderiza a esfera
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, rotationSpeed * (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+            float pixels = projectedSphereRadius(1.0f, glm::length(position - eye), fovY, 600.0f);
+            int lod = selectSphereLod(sphereLods, pixels);
+            renderer.instances(sphereMeshes[lod]).push_back(instance);
+            sphereTriangles += sphereLods[lod].indices.size() / 3;
+            sphereTrianglesFull += sphereLods[0].indices.size() / 3;
+        }
 
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
+        renderer.render(projection * view);
+        if (software) software->finish();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        app.endFrame();
     }
+    if (software) software->save(app.getImagePath().c_str());
+
+    std::cout << "Esferas: " << sphereTriangles << " triangulos no ultimo quadro (" << sphereTrianglesFull << " sem LOD)" << std::endl;
 
-    glfwTerminate();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,182 @@
+#include "InstancedRenderer.h"
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include "../../../Comum/GLState.h"
+#include "../../../Comum/Profiler.h"
+#include "../../../Comum/ShaderCache.h"
+#include "../../../Comum/SoftRasterizer.h"
+
+static const char* instancedVertexSource = R"(
+    #version 400 core
+    layout(location = 0) in vec3 aPos;
+    layout(location = 1) in vec3 aColor;
+    layout(location = 2) in vec4 iPositionScale;
+    layout(location = 3) in vec4 iRotation;
+
+    layout(std140) uniform Camera {
+        mat4 viewProjection;
+    };
+
+    out vec3 vertexColor;
+
+    // rotacao de v pelo quaternion unitario q
+    vec3 rotate(vec4 q, vec3 v) {
+        return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+    }
+
+    void main() {
+        vec3 worldPos = rotate(iRotation, aPos * iPositionScale.w) + iPositionScale.xyz;
+        gl_Position = viewProjection * vec4(worldPos, 1.0);
+        vertexColor = aColor;
+    }
+)";
+
+static const char* instancedFragmentSource = R"(
+    #version 400 core
+    in vec3 vertexColor;
+    out vec4 FragColor;
+
+    void main() {
+        FragColor = vec4(vertexColor, 1.0);
+    }
+)";
+
+InstancedRenderer::InstancedRenderer(SoftRasterizer* target)
+    : program(0), cameraUbo(0), drawCalls(0), software(target)
+{
+    if (software) return;
+    program = ShaderCache::instance().program(instancedVertexSource, instancedFragmentSource);
+    ShaderCache::instance().reflection(program).setBlockBinding("Camera", CAMERA_BINDING);
+
+    glGenBuffers(1, &cameraUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, cameraUbo);
+}
+
+InstancedRenderer::~InstancedRenderer() {
+    if (software) return;
+    GLState& gl = GLState::current();
+    for (Mesh& mesh : meshes) {
+        gl.deleteVertexArray(mesh.vao);
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.ebo);
+        glDeleteBuffers(1, &mesh.instanceVbo);
+    }
+    glDeleteBuffers(1, &cameraUbo);
+}
+
+int InstancedRenderer::addMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+    Mesh mesh;
+    mesh.indexCount = (GLsizei)indices.size();
+    mesh.instanceCapacity = 0;
+    mesh.vao = mesh.vbo = mesh.ebo = mesh.instanceVbo = 0;
+    if (software) {
+        mesh.vertices = vertices;
+        mesh.indices = indices;
+        meshes.push_back(mesh);
+        return (int)meshes.size() - 1;
+    }
+
+    GLState& gl = GLState::current();
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+    glGenBuffers(1, &mesh.instanceVbo);
+    gl.bindVertexArray(mesh.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // atributos por instancia: avancam uma vez por instancia, nao por vertice
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVbo);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    gl.bindVertexArray(0);
+    meshes.push_back(mesh);
+    return (int)meshes.size() - 1;
+}
+
+InstancedRenderer::Instance InstancedRenderer::makeInstance(const glm::vec3& position, float scale, const glm::vec3& axis, float angle) {
+    float s = std::sin(angle * 0.5f);
+    Instance instance = {
+        { position.x, position.y, position.z }, scale,
+        { axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) }
+    };
+    return instance;
+}
+
+glm::mat4 InstancedRenderer::modelMatrix(const Instance& instance) {
+    const float x = instance.rotation[0], y = instance.rotation[1], z = instance.rotation[2], w = instance.rotation[3];
+    const float s = instance.scale;
+    glm::mat4 m(1.0f);
+    m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * s;
+    m[0][1] = 2.0f * (x * y + w * z) * s;
+    m[0][2] = 2.0f * (x * z - w * y) * s;
+    m[1][0] = 2.0f * (x * y - w * z) * s;
+    m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * s;
+    m[1][2] = 2.0f * (y * z + w * x) * s;
+    m[2][0] = 2.0f * (x * z + w * y) * s;
+    m[2][1] = 2.0f * (y * z - w * x) * s;
+    m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * s;
+    m[3][0] = instance.position[0];
+    m[3][1] = instance.position[1];
+    m[3][2] = instance.position[2];
+    return m;
+}
+
+void InstancedRenderer::render(const glm::mat4& viewProjection) {
+    PROFILE_SCOPE("InstancedRenderer::render");
+    if (software) {
+        // sem instancing na CPU: um draw por instancia, cor nos floats 3..5
+        const SoftRasterizer::Material material = { SoftRasterizer::VERTEX_COLOR, 3, NULL, false };
+        drawCalls = 0;
+        for (const Mesh& mesh : meshes) {
+            for (const Instance& instance : mesh.instances) {
+                software->draw(mesh.vertices.data(), mesh.vertices.size() / 6, 6, mesh.indices.data(), mesh.indices.size(),
+                               viewProjection * modelMatrix(instance), material);
+                drawCalls++;
+            }
+        }
+        return;
+    }
+    PROFILE_GPU_SCOPE("InstancedRenderer::render");
+
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(viewProjection));
+    PROFILE_UPLOAD(sizeof(glm::mat4));
+
+    GLState& gl = GLState::current();
+    gl.useProgram(program);
+    drawCalls = 0;
+
+    for (Mesh& mesh : meshes) {
+        if (mesh.instances.empty()) continue;
+
+        // Orphaning: um buffer novo a cada quadro, para nao esperar a GPU
+        // terminar de ler as instancias do quadro anterior
+        size_t bytes = mesh.instances.size() * sizeof(Instance);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVbo);
+        if (mesh.instances.size() > mesh.instanceCapacity) mesh.instanceCapacity = mesh.instances.size();
+        glBufferData(GL_ARRAY_BUFFER, mesh.instanceCapacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, mesh.instances.data());
+        PROFILE_UPLOAD(bytes);
+
+        gl.bindVertexArray(mesh.vao);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)mesh.instances.size());
+        PROFILE_DRAW((long long)mesh.indexCount / 3 * mesh.instances.size());
+        drawCalls++;
+    }
+}
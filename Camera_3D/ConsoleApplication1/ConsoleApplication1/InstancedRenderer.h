@@ -0,0 +1,68 @@
+#ifndef INSTANCEDRENDERER_H
+#define INSTANCEDRENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class SoftRasterizer;
+
+// Desenha muitas copias de poucas malhas com um glDrawElementsInstanced por
+// malha, independente do numero de objetos.
+//
+// Cada instancia ocupa 32 bytes no VBO de instancias (posicao + escala
+// uniforme, rotacao em quaternion) em vez de uma mat4 de 64 bytes; o vertex
+// shader monta a transformacao. A view-projection vai num uniform block
+// ("Camera", binding 0) atualizado uma vez por quadro.
+//
+// Com um SoftRasterizer (modo --software) nao cria nada no GL: guarda as
+// malhas na CPU e render() desenha cada instancia nele, com a mesma
+// transformacao do vertex shader.
+class InstancedRenderer {
+public:
+    struct Instance {
+        float position[3];
+        float scale;
+        float rotation[4];   // quaternion x, y, z, w
+    };
+
+    explicit InstancedRenderer(SoftRasterizer* software = NULL);
+    ~InstancedRenderer();
+
+    // Vertices com posicao (3) + cor (3). Retorna o id da malha.
+    int addMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+
+    // Instancias do quadro atual de uma malha; preencha e chame render()
+    std::vector<Instance>& instances(int mesh) { return meshes[mesh].instances; }
+
+    // Envia a camera e as instancias e desenha cada malha com uma chamada
+    void render(const glm::mat4& viewProjection);
+
+    int getDrawCalls() const { return drawCalls; }
+
+    static Instance makeInstance(const glm::vec3& position, float scale, const glm::vec3& axis, float angle);
+    // Matriz de modelo equivalente (escala, rotacao e translacao da instancia)
+    static glm::mat4 modelMatrix(const Instance& instance);
+
+private:
+    static const GLuint CAMERA_BINDING = 0;
+
+    struct Mesh {
+        GLuint vao, vbo, ebo, instanceVbo;
+        GLsizei indexCount;
+        size_t instanceCapacity;
+        std::vector<Instance> instances;
+        std::vector<float> vertices;            // so' no modo software
+        std::vector<unsigned int> indices;
+    };
+
+    std::vector<Mesh> meshes;
+    GLuint program, cameraUbo;
+    int drawCalls;
+    SoftRasterizer* software;
+
+    InstancedRenderer(const InstancedRenderer&);
+    InstancedRenderer& operator=(const InstancedRenderer&);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "Sphere.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectorCount, unsigned int stackCount) {
+    float lengthInv = 1.0f / radius;                // normal
+    float sectorStep = 2 * M_PI / sectorCount;
+    float stackStep = M_PI / stackCount;
+
+    // senos e cossenos calculados uma vez por setor e por pilha, nao por vertice
+    std::vector<float> sectorCos(sectorCount + 1), sectorSin(sectorCount + 1);
+    for (unsigned int j = 0; j < sectorCount; ++j) {
+        sectorCos[j] = cosf(j * sectorStep);
+        sectorSin[j] = sinf(j * sectorStep);
+    }
+    sectorCos[sectorCount] = sectorCos[0];          // a costura fecha exatamente
+    sectorSin[sectorCount] = sectorSin[0];
+
+    vertices.resize((size_t)(stackCount + 1) * (sectorCount + 1) * 6);
+    float* out = vertices.data();
+    for (unsigned int i = 0; i <= stackCount; ++i) {
+        float stackAngle = M_PI / 2 - i * stackStep;  // starting from pi/2 to -pi/2
+        float xy = radius * cosf(stackAngle);       // r * cos(u)
+        float z = radius * sinf(stackAngle);        // r * sin(u)
+
+        for (unsigned int j = 0; j <= sectorCount; ++j) {
+            float x = xy * sectorCos[j];            // r * cos(u) * cos(v)
+            float y = xy * sectorSin[j];            // r * cos(u) * sin(v)
+            *out++ = x;
+            *out++ = y;
+            *out++ = z;
+            *out++ = (x * lengthInv + 1) / 2;       // color
+            *out++ = (y * lengthInv + 1) / 2;
+            *out++ = (z * lengthInv + 1) / 2;
+        }
+    }
+
+    // as pilhas dos polos tem um triangulo por setor, as demais dois
+    indices.resize(stackCount > 1 ? (size_t)sectorCount * (stackCount - 1) * 6 : 0);
+    unsigned int* index = indices.data();
+    unsigned int k1, k2;
+    for (unsigned int i = 0; i < stackCount; ++i) {
+        k1 = i * (sectorCount + 1);
+        k2 = k1 + sectorCount + 1;
+
+        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
+            if (i != 0) {
+                *index++ = k1;
+                *index++ = k2;
+                *index++ = k1 + 1;
+            }
+
+            if (i != (stackCount - 1)) {
+                *index++ = k1 + 1;
+                *index++ = k2;
+                *index++ = k2 + 1;
+            }
+        }
+    }
+}
+
+void createIcosphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int subdivisions) {
+    // V = 10 * 4^n + 2, T = 20 * 4^n: tudo alocado de uma vez
+    size_t finalVertices = 10 * ((size_t)1 << (2 * subdivisions)) + 2;
+    size_t finalTriangles = 20 * ((size_t)1 << (2 * subdivisions));
+
+    const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    const float base[12][3] = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+    };
+    const unsigned int faces[60] = {
+        0, 11, 5,   0, 5, 1,   0, 1, 7,   0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,  11, 10, 2, 10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,   3, 2, 6,   3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,  6, 2, 10,  8, 6, 7,    9, 8, 1
+    };
+
+    // posicoes na esfera unitaria
+    std::vector<float> unit(finalVertices * 3);
+    float scale = 1.0f / sqrtf(1.0f + t * t);
+    for (int i = 0; i < 12; i++) {
+        for (int k = 0; k < 3; k++) unit[i * 3 + k] = base[i][k] * scale;
+    }
+    size_t vertexCount = 12;
+
+    std::vector<unsigned int> current(finalTriangles * 3), next(finalTriangles * 3);
+    std::copy(faces, faces + 60, current.begin());
+    size_t triangleCount = 20;
+
+    // cada aresta e' compartilhada por dois triangulos: o ponto medio e' criado
+    // uma vez so'. Tabela hash aberta (chave = par de vertices, 0 = vazio)
+    // dimensionada para o ultimo nivel, sem alocar dentro do laco
+    size_t tableSize = 1;
+    while (tableSize < finalTriangles * 3) tableSize <<= 1;
+    std::vector<unsigned long long> edgeKeys(tableSize);
+    std::vector<unsigned int> edgeMiddles(tableSize);
+
+    for (unsigned int level = 0; level < subdivisions; level++) {
+        std::fill(edgeKeys.begin(), edgeKeys.end(), 0ull);
+
+        unsigned int* out = next.data();
+        for (size_t tri = 0; tri < triangleCount; tri++) {
+            unsigned int corner[3], middle[3];
+            for (int k = 0; k < 3; k++) corner[k] = current[tri * 3 + k];
+
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = corner[k], b = corner[(k + 1) % 3];
+                if (a > b) std::swap(a, b);
+                unsigned long long key = ((unsigned long long)(a + 1) << 32) | b;
+                size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+                while (edgeKeys[slot] != 0 && edgeKeys[slot] != key) slot = (slot + 1) & (tableSize - 1);
+                if (edgeKeys[slot] == key) {
+                    middle[k] = edgeMiddles[slot];
+                    continue;
+                }
+
+                float mx = unit[a * 3] + unit[b * 3];
+                float my = unit[a * 3 + 1] + unit[b * 3 + 1];
+                float mz = unit[a * 3 + 2] + unit[b * 3 + 2];
+                float inv = 1.0f / sqrtf(mx * mx + my * my + mz * mz);
+                unit[vertexCount * 3] = mx * inv;
+                unit[vertexCount * 3 + 1] = my * inv;
+                unit[vertexCount * 3 + 2] = mz * inv;
+                middle[k] = (unsigned int)vertexCount++;
+                edgeKeys[slot] = key;
+                edgeMiddles[slot] = middle[k];
+            }
+
+            const unsigned int split[12] = {
+                corner[0], middle[0], middle[2],
+                corner[1], middle[1], middle[0],
+                corner[2], middle[2], middle[1],
+                middle[0], middle[1], middle[2]
+            };
+            std::copy(split, split + 12, out);
+            out += 12;
+        }
+        current.swap(next);
+        triangleCount *= 4;
+    }
+
+    vertices.resize(vertexCount * 6);
+    float* v = vertices.data();
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float* p = &unit[i * 3];
+        *v++ = p[0] * radius;
+        *v++ = p[1] * radius;
+        *v++ = p[2] * radius;
+        *v++ = (p[0] + 1) / 2;                      // mesma cor da esfera UV
+        *v++ = (p[1] + 1) / 2;
+        *v++ = (p[2] + 1) / 2;
+    }
+    current.resize(triangleCount * 3);
+    indices.swap(current);
+}
+
+std::vector<SphereLod> createSphereLods(float radius, unsigned int levels, bool icosphere, float maxErrorPixels) {
+    std::vector<SphereLod> lods(levels);
+    for (unsigned int i = 0; i < levels; i++) {
+        unsigned int detail = levels - 1 - i;
+        // Segmentos num circulo maximo: o poligono de n lados se afasta do
+        // circulo de raio r no maximo r * (1 - cos(pi / n))
+        unsigned int segments;
+        if (icosphere) {
+            createIcosphere(lods[i].vertices, lods[i].indices, radius, detail);
+            segments = 5u << detail;
+        }
+        else {
+            segments = 8u << detail;
+            createSphere(lods[i].vertices, lods[i].indices, radius, segments, segments / 2);
+        }
+        lods[i].maxPixels = i == 0 ? FLT_MAX : maxErrorPixels / (1.0f - cosf((float)M_PI / segments));
+    }
+    return lods;
+}
+
+float projectedSphereRadius(float radius, float distance, float fovY, float viewportHeight) {
+    if (distance <= radius) return FLT_MAX;
+    // tangente do raio angular da esfera sobre a tangente da meia abertura da camera
+    float tangent = radius / sqrtf(distance * distance - radius * radius);
+    return tangent / tanf(fovY * 0.5f) * viewportHeight * 0.5f;
+}
+
+int selectSphereLod(const std::vector<SphereLod>& lods, float projectedRadius) {
+    for (int i = (int)lods.size() - 1; i > 0; i--) {
+        if (projectedRadius <= lods[i].maxPixels) return i;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SPHERE_H
+#define SPHERE_H
+
+#include <vector>
+
+// Esfera UV: vertices com posicao (3) + cor (3) e indices de triangulos.
+// sectorCount divide a longitude e stackCount a latitude. Substitui o
+// conteudo de vertices e indices.
+void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectorCount, unsigned int stackCount);
+
+// Icosfera: icosaedro com cada triangulo dividido em 4, subdivisions vezes
+// (20 * 4^n triangulos). Os triangulos tem quase o mesmo tamanho em toda a
+// esfera, sem a concentracao nos polos da esfera UV. Mesmo formato de vertice.
+void createIcosphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int subdivisions);
+
+// Um nivel da cadeia de LODs; maxPixels e' o maior raio projetado (em
+// pixels) em que a silhueta ainda fica dentro do erro pedido
+struct SphereLod {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    float maxPixels;
+};
+
+// Cadeia do mais detalhado para o mais simples (levels niveis). Icosferas
+// com subdivisoes levels-1 .. 0, ou esferas UV com 8 * 2^i setores.
+// maxErrorPixels e' o desvio maximo aceito entre a silhueta e o circulo.
+std::vector<SphereLod> createSphereLods(float radius, unsigned int levels, bool icosphere, float maxErrorPixels = 0.5f);
+
+// Raio em pixels de uma esfera a distance da camera (perspectiva com fovY em radianos)
+float projectedSphereRadius(float radius, float distance, float fovY, float viewportHeight);
+
+// Nivel mais simples cujo maxPixels cobre o raio projetado
+int selectSphereLod(const std::vector<SphereLod>& lods, float projectedRadius);
+
+#endif
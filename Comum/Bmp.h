@@ -7,6 +7,11 @@
 //  Referencia:  http://astronomy.swin.edu.au/~pbourke/dataformats/bmp/
 //  Versao 09/2010
 //
+//  Suporta 1/4/8 bits com paleta, RLE8, RLE4, 24 bits e 32 bits (BGRA ou
+//  BI_BITFIELDS). Qualquer que seja a entrada, getImage() devolve 24 bits BGR,
+//  de baixo para cima, com linhas alinhadas em 4 bytes (o alfa e' descartado).
+//  Erros nao encerram o programa: consulte getStatus().
+//
 //**********************************************************
 
 #ifndef ___BMP__H___
@@ -20,6 +25,12 @@
 #define INFOHEADER_SIZE  40 //sizeof(INFOHEADER) da 40 e esta correto.
 #define uchar unsigned char
 
+//tipos de compressao do campo INFOHEADER.compression
+#define BMP_RGB          0
+#define BMP_RLE8         1
+#define BMP_RLE4         2
+#define BMP_BITFIELDS    3
+
 typedef struct {
    unsigned short int type;                 /* Magic identifier            */
    unsigned int size;                       /* File size in bytes          */
@@ -41,23 +52,53 @@ typedef struct {
 } INFOHEADER;
 
 
+//codigos de retorno de load()/getStatus()
+enum BmpStatus
+{
+   BMP_OK = 0,
+   BMP_ERROR_FILENAME,     //nome de arquivo vazio
+   BMP_ERROR_OPEN,         //arquivo nao pode ser aberto
+   BMP_ERROR_SIGNATURE,    //nao comeca com "BM"
+   BMP_ERROR_UNSUPPORTED,  //bits/compressao/planes nao suportados
+   BMP_ERROR_TRUNCATED,    //arquivo menor que o indicado no cabecalho
+   BMP_ERROR_CORRUPT,      //dados RLE ou paleta invalidos
+};
+
+
 class Bmp
 {
 private:
    int width, height, imagesize, bytesPerLine, bits;
    unsigned char *data;
+   BmpStatus status;
 
    HEADER     header;
    INFOHEADER info;
 
-   void load(const char *fileName);
+   BmpStatus load(const char *fileName);
+   void decodeRows(const uchar *src, size_t srcStride, bool topDown, const uchar *palette, const unsigned int *masks);
+   BmpStatus decodeRLE(const uchar *src, size_t srcSize, const uchar *palette);
+
+   Bmp(const Bmp&);
+   Bmp& operator=(const Bmp&);
 
 public:
    Bmp(const char *fileName);
+   ~Bmp();
    uchar* getImage();
    int    getWidth(void);
    int    getHeight(void);
    void   convertBGRtoRGB(void);
+
+   BmpStatus   getStatus(void);
+   static const char* statusMessage(BmpStatus s);
+
+   //grava uma imagem de 24 bits no mesmo layout de getImage() (BGR, de baixo para cima,
+   //linhas alinhadas em 4 bytes)
+   static BmpStatus save(const char *fileName, int width, int height, const uchar *bgr);
+
+   //liga/desliga as mensagens de carregamento no console (ligadas por padrao)
+   static void setVerbose(bool verbose);
 };
 
 #endif
@@ -0,0 +1,522 @@
+#include "Fft.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <immintrin.h>
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// Maior fator primo feito com Stockham; acima disso o tamanho vai para Bluestein
+static const int MAX_RADIX = 13;
+
+// Abaixo disso (amostras) um grupo de linhas ou colunas nao compensa acordar outra thread
+static const int MIN_SAMPLES_PER_TASK = 1 << 15;
+
+static const double PI = 3.14159265358979323846;
+
+// Um elemento das 4 transformadas: mesmo layout dos 8 floats de FftPlan
+struct CVec {
+    __m128 re, im;
+};
+
+static inline CVec load(const float* p) {
+    CVec v = { _mm_load_ps(p), _mm_load_ps(p + 4) };
+    return v;
+}
+
+static inline void store(float* p, CVec v) {
+    _mm_store_ps(p, v.re);
+    _mm_store_ps(p + 4, v.im);
+}
+
+static inline CVec add(CVec a, CVec b) {
+    CVec v = { _mm_add_ps(a.re, b.re), _mm_add_ps(a.im, b.im) };
+    return v;
+}
+
+static inline CVec sub(CVec a, CVec b) {
+    CVec v = { _mm_sub_ps(a.re, b.re), _mm_sub_ps(a.im, b.im) };
+    return v;
+}
+
+static inline CVec scale(CVec a, __m128 s) {
+    CVec v = { _mm_mul_ps(a.re, s), _mm_mul_ps(a.im, s) };
+    return v;
+}
+
+// a * w, com w = (wr, wi) igual nas 4 lanes
+static inline CVec mul(CVec a, __m128 wr, __m128 wi) {
+    CVec v = { _mm_sub_ps(_mm_mul_ps(a.re, wr), _mm_mul_ps(a.im, wi)),
+               _mm_add_ps(_mm_mul_ps(a.re, wi), _mm_mul_ps(a.im, wr)) };
+    return v;
+}
+
+static inline CVec mul(CVec a, const float* w) {
+    return mul(a, _mm_set1_ps(w[0]), _mm_set1_ps(w[1]));
+}
+
+// -i * a
+static inline CVec mulMinusI(CVec a) {
+    CVec v = { a.im, _mm_xor_ps(a.re, _mm_set1_ps(-0.0f)) };
+    return v;
+}
+
+// Rascunho alinhado em 16 bytes (std::vector nao garante no Win32)
+struct AlignedFloats {
+    float* data;
+    explicit AlignedFloats(size_t count) : data((float*)_mm_malloc(std::max<size_t>(count, 1) * sizeof(float), 16)) {}
+    ~AlignedFloats() { _mm_free(data); }
+private:
+    AlignedFloats(const AlignedFloats&);
+    AlignedFloats& operator=(const AlignedFloats&);
+};
+
+static void conjugate(float* data, int n) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (int k = 0; k < n; k++) {
+        _mm_store_ps(data + k * 8 + 4, _mm_xor_ps(_mm_load_ps(data + k * 8 + 4), sign));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// FftPlan
+
+FftPlan::FftPlan(int n) : n(std::max(n, 1)), inner(NULL) {
+    std::vector<int> radices;
+    int rest = this->n;
+    while (rest % 4 == 0) { radices.push_back(4); rest /= 4; }
+    while (rest % 2 == 0) { radices.push_back(2); rest /= 2; }
+    for (int p = 3; p <= MAX_RADIX && rest > 1; p += 2) {
+        while (rest % p == 0) { radices.push_back(p); rest /= p; }
+    }
+
+    if (rest > 1) {
+        // Bluestein: X[k] = c[k] * sum(x[j] c[j] conj(c[k - j])), c[k] = e^(-i pi k^2 / n),
+        // com a convolucao circular feita numa FFT de potencia de 2 >= 2n - 1
+        int m = 1;
+        while (m < 2 * this->n - 1) m *= 2;
+        inner = new FftPlan(m);
+
+        chirp.resize(this->n * 2);
+        for (int k = 0; k < this->n; k++) {
+            // k^2 mod 2n mantem o angulo pequeno (precisao para n grande)
+            long long k2 = (long long)k * k % (2LL * this->n);
+            double angle = -PI * (double)k2 / this->n;
+            chirp[k * 2] = (float)cos(angle);
+            chirp[k * 2 + 1] = (float)sin(angle);
+        }
+
+        AlignedFloats b(m * 8), scratch(inner->scratchFloats());
+        memset(b.data, 0, m * 8 * sizeof(float));
+        for (int k = 0; k < this->n; k++) {
+            float re = chirp[k * 2], im = -chirp[k * 2 + 1];
+            for (int lane = 0; lane < 4; lane++) {
+                b.data[k * 8 + lane] = re;
+                b.data[k * 8 + 4 + lane] = im;
+                if (k > 0) {
+                    b.data[(m - k) * 8 + lane] = re;
+                    b.data[(m - k) * 8 + 4 + lane] = im;
+                }
+            }
+        }
+        inner->transform(b.data, scratch.data, false);
+        // Ja' com o 1/m da inversa da convolucao
+        kernel.resize(m * 2);
+        for (int k = 0; k < m; k++) {
+            kernel[k * 2] = b.data[k * 8] / m;
+            kernel[k * 2 + 1] = b.data[k * 8 + 4] / m;
+        }
+        return;
+    }
+
+    // Twiddles de cada estagio: no estagio de raiz r sobre blocos de tamanho
+    // length, a saida k do grupo p e' multiplicada por e^(-2 pi i p k / length)
+    int length = this->n;
+    for (size_t s = 0; s < radices.size(); s++) {
+        int radix = radices[s], m = length / radix;
+        Stage stage = { radix, twiddles.size() };
+        stages.push_back(stage);
+        for (int p = 0; p < m; p++) {
+            for (int k = 1; k < radix; k++) {
+                double angle = -2.0 * PI * p * k / length;
+                twiddles.push_back((float)cos(angle));
+                twiddles.push_back((float)sin(angle));
+            }
+        }
+        length = m;
+    }
+    for (int radix = 5; radix <= MAX_RADIX; radix += 2) {
+        for (int t = 0; t < radix; t++) {
+            roots.push_back((float)cos(-2.0 * PI * t / radix));
+            roots.push_back((float)sin(-2.0 * PI * t / radix));
+        }
+    }
+}
+
+FftPlan::~FftPlan() {
+    delete inner;
+}
+
+size_t FftPlan::scratchFloats() const {
+    if (inner) return (size_t)inner->size() * 8 + inner->scratchFloats();
+    return (size_t)n * 8;
+}
+
+void FftPlan::transform(float* data, float* scratch, bool inverse) const {
+    // Inversa = conjugado da direta do conjugado
+    if (inverse) conjugate(data, n);
+    if (inner) bluestein(data, scratch);
+    else stockham(data, scratch);
+    if (inverse) conjugate(data, n);
+}
+
+// Stockham com decimacao na frequencia: o estagio de raiz r le os elementos
+// q + s * (p + k * m) (k = 0..r-1), faz a DFT de r pontos e grava em
+// q + s * (r * p + k), ja' multiplicado pelos twiddles. Entre estagios os
+// buffers trocam de papel e s cresce r vezes; no fim a saida esta' em ordem.
+void FftPlan::stockham(float* data, float* scratch) const {
+    CVec* x = (CVec*)data;
+    CVec* y = (CVec*)scratch;
+    int length = n, s = 1;
+
+    for (size_t stage = 0; stage < stages.size(); stage++) {
+        int radix = stages[stage].radix, m = length / radix;
+        const float* w = &twiddles[0] + stages[stage].twiddles;
+        const int sm = s * m;
+
+        if (radix == 4) {
+            for (int p = 0; p < m; p++, w += 6) {
+                const __m128 w1r = _mm_set1_ps(w[0]), w1i = _mm_set1_ps(w[1]);
+                const __m128 w2r = _mm_set1_ps(w[2]), w2i = _mm_set1_ps(w[3]);
+                const __m128 w3r = _mm_set1_ps(w[4]), w3i = _mm_set1_ps(w[5]);
+                const CVec* in = x + s * p;
+                CVec* out = y + s * 4 * p;
+                for (int q = 0; q < s; q++) {
+                    CVec a0 = in[q], a1 = in[q + sm], a2 = in[q + 2 * sm], a3 = in[q + 3 * sm];
+                    CVec t0 = add(a0, a2), t1 = sub(a0, a2);
+                    CVec t2 = add(a1, a3), t3 = mulMinusI(sub(a1, a3));
+                    out[q] = add(t0, t2);
+                    out[q + s] = mul(add(t1, t3), w1r, w1i);
+                    out[q + 2 * s] = mul(sub(t0, t2), w2r, w2i);
+                    out[q + 3 * s] = mul(sub(t1, t3), w3r, w3i);
+                }
+            }
+        }
+        else if (radix == 2) {
+            for (int p = 0; p < m; p++, w += 2) {
+                const __m128 wr = _mm_set1_ps(w[0]), wi = _mm_set1_ps(w[1]);
+                const CVec* in = x + s * p;
+                CVec* out = y + s * 2 * p;
+                for (int q = 0; q < s; q++) {
+                    CVec a0 = in[q], a1 = in[q + sm];
+                    out[q] = add(a0, a1);
+                    out[q + s] = mul(sub(a0, a1), wr, wi);
+                }
+            }
+        }
+        else if (radix == 3) {
+            // y1, y2 = a0 - (a1 + a2) / 2 -+ i sqrt(3)/2 (a1 - a2)
+            const __m128 half = _mm_set1_ps(0.5f), sin60 = _mm_set1_ps(0.86602540378f);
+            for (int p = 0; p < m; p++, w += 4) {
+                const __m128 w1r = _mm_set1_ps(w[0]), w1i = _mm_set1_ps(w[1]);
+                const __m128 w2r = _mm_set1_ps(w[2]), w2i = _mm_set1_ps(w[3]);
+                const CVec* in = x + s * p;
+                CVec* out = y + s * 3 * p;
+                for (int q = 0; q < s; q++) {
+                    CVec a0 = in[q], a1 = in[q + sm], a2 = in[q + 2 * sm];
+                    CVec t1 = add(a1, a2);
+                    CVec t2 = sub(a0, scale(t1, half));
+                    CVec u = mulMinusI(scale(sub(a1, a2), sin60));
+                    out[q] = add(a0, t1);
+                    out[q + s] = mul(add(t2, u), w1r, w1i);
+                    out[q + 2 * s] = mul(sub(t2, u), w2r, w2i);
+                }
+            }
+        }
+        else if (radix == 5) {
+            // Pares simetricos (a1, a4) e (a2, a3): cossenos nas somas e senos nas diferencas
+            const __m128 c1 = _mm_set1_ps(0.30901699437f), c2 = _mm_set1_ps(-0.80901699437f);
+            const __m128 s1 = _mm_set1_ps(0.95105651630f), s2 = _mm_set1_ps(0.58778525229f);
+            for (int p = 0; p < m; p++, w += 8) {
+                const CVec* in = x + s * p;
+                CVec* out = y + s * 5 * p;
+                for (int q = 0; q < s; q++) {
+                    CVec a0 = in[q], a1 = in[q + sm], a2 = in[q + 2 * sm], a3 = in[q + 3 * sm], a4 = in[q + 4 * sm];
+                    CVec t1 = add(a1, a4), t2 = add(a2, a3), t3 = sub(a1, a4), t4 = sub(a2, a3);
+                    CVec m1 = add(a0, add(scale(t1, c1), scale(t2, c2)));
+                    CVec m2 = add(a0, add(scale(t1, c2), scale(t2, c1)));
+                    CVec n1 = mulMinusI(add(scale(t3, s1), scale(t4, s2)));
+                    CVec n2 = mulMinusI(sub(scale(t3, s2), scale(t4, s1)));
+                    out[q] = add(a0, add(t1, t2));
+                    out[q + s] = mul(add(m1, n1), w);
+                    out[q + 2 * s] = mul(add(m2, n2), w + 2);
+                    out[q + 3 * s] = mul(sub(m2, n2), w + 4);
+                    out[q + 4 * s] = mul(sub(m1, n1), w + 6);
+                }
+            }
+        }
+        else {
+            // Raiz prima generica: DFT direta de radix pontos
+            const float* root = &roots[0];
+            for (int r = 5; r < radix; r += 2) root += r * 2;
+            CVec a[MAX_RADIX];
+            for (int p = 0; p < m; p++, w += (radix - 1) * 2) {
+                const CVec* in = x + s * p;
+                CVec* out = y + s * radix * p;
+                for (int q = 0; q < s; q++) {
+                    for (int j = 0; j < radix; j++) a[j] = in[q + j * sm];
+                    for (int k = 0; k < radix; k++) {
+                        CVec sum = a[0];
+                        for (int j = 1, t = k; j < radix; j++, t = (t + k) % radix) {
+                            sum = add(sum, mul(a[j], root + t * 2));
+                        }
+                        out[q + k * s] = k == 0 ? sum : mul(sum, w + (k - 1) * 2);
+                    }
+                }
+            }
+        }
+
+        std::swap(x, y);
+        length = m;
+        s *= radix;
+    }
+
+    if (x != (CVec*)data) memcpy(data, x, (size_t)n * sizeof(CVec));
+}
+
+void FftPlan::bluestein(float* data, float* scratch) const {
+    const int m = inner->size();
+    float* a = scratch;
+    float* innerScratch = scratch + (size_t)m * 8;
+
+    for (int k = 0; k < n; k++) store(a + k * 8, mul(load(data + k * 8), &chirp[k * 2]));
+    memset(a + (size_t)n * 8, 0, (size_t)(m - n) * 8 * sizeof(float));
+
+    inner->transform(a, innerScratch, false);
+    for (int k = 0; k < m; k++) store(a + k * 8, mul(load(a + k * 8), &kernel[k * 2]));
+    inner->transform(a, innerScratch, true);
+
+    for (int k = 0; k < n; k++) store(data + k * 8, mul(load(a + k * 8), &chirp[k * 2]));
+}
+
+// ---------------------------------------------------------------------------
+// FrequencyFilter
+
+float FrequencyFilter::gain(float d) const {
+    float low;
+    if (cutoff <= 0.0f) {
+        low = d <= 0.0f ? 1.0f : 0.0f;
+    }
+    else if (shape == IDEAL) {
+        low = d <= cutoff ? 1.0f : 0.0f;
+    }
+    else if (shape == BUTTERWORTH) {
+        low = 1.0f / (1.0f + powf(d / cutoff, 2.0f * order));
+    }
+    else {
+        low = expf(-d * d / (2.0f * cutoff * cutoff));
+    }
+    return highPass ? 1.0f - low : low;
+}
+
+// ---------------------------------------------------------------------------
+// Fft2D
+
+Fft2D::Fft2D(int width, int height) : width(std::max(width, 1)), height(std::max(height, 1)),
+                                      rows(std::max(width, 1)), columns(std::max(height, 1)) {
+}
+
+// FFT de coluna (direta ou inversa) em grupos de 4 colunas do espectro
+static void transformColumns(const FftPlan& plan, std::complex<float>* spectrum, int columns, bool inverse) {
+    const int height = plan.size();
+    size_t groups = (size_t)(columns + 3) / 4;
+    size_t minGroups = (size_t)std::max(1, MIN_SAMPLES_PER_TASK / (4 * height));
+
+    ThreadPool::shared().parallelFor(groups, [&](size_t begin, size_t end) {
+        AlignedFloats buffer((size_t)height * 8 + plan.scratchFloats());
+        float* data = buffer.data;
+        float* scratch = buffer.data + (size_t)height * 8;
+
+        for (size_t group = begin; group < end; group++) {
+            int c0 = (int)group * 4, count = std::min(4, columns - c0);
+            for (int y = 0; y < height; y++) {
+                const float* src = (const float*)(spectrum + (size_t)y * columns + c0);
+                if (count == 4) {
+                    // (re0 im0 re1 im1) (re2 im2 re3 im3) -> (re0..re3) (im0..im3)
+                    __m128 lo = _mm_loadu_ps(src), hi = _mm_loadu_ps(src + 4);
+                    _mm_store_ps(data + y * 8, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+                    _mm_store_ps(data + y * 8 + 4, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+                }
+                else {
+                    for (int lane = 0; lane < 4; lane++) {
+                        data[y * 8 + lane] = lane < count ? src[lane * 2] : 0.0f;
+                        data[y * 8 + 4 + lane] = lane < count ? src[lane * 2 + 1] : 0.0f;
+                    }
+                }
+            }
+
+            plan.transform(data, scratch, inverse);
+
+            for (int y = 0; y < height; y++) {
+                float* dst = (float*)(spectrum + (size_t)y * columns + c0);
+                if (count == 4) {
+                    __m128 re = _mm_load_ps(data + y * 8), im = _mm_load_ps(data + y * 8 + 4);
+                    _mm_storeu_ps(dst, _mm_unpacklo_ps(re, im));
+                    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(re, im));
+                }
+                else {
+                    for (int lane = 0; lane < count; lane++) {
+                        dst[lane * 2] = data[y * 8 + lane];
+                        dst[lane * 2 + 1] = data[y * 8 + 4 + lane];
+                    }
+                }
+            }
+        }
+    }, minGroups);
+}
+
+// Linhas reais vao aos pares numa FFT complexa: a linha 2l do grupo na parte
+// real da lane l e a 2l + 1 na imaginaria. Com X = FFT(a + ib):
+// A[k] = (X[k] + conj(X[n - k])) / 2 e B[k] = (X[k] - conj(X[n - k])) / 2i.
+void Fft2D::forward(const float* input, std::complex<float>* spectrum, int stride) const {
+    PROFILE_SCOPE("Fft2D::forward");
+    if (stride <= 0) stride = width;
+    const int columnsOut = spectrumWidth();
+    size_t groups = (size_t)(height + 7) / 8;
+    size_t minGroups = (size_t)std::max(1, MIN_SAMPLES_PER_TASK / (8 * width));
+
+    ThreadPool::shared().parallelFor(groups, [&](size_t begin, size_t end) {
+        AlignedFloats buffer((size_t)width * 8 + rows.scratchFloats());
+        float* data = buffer.data;
+        float* scratch = buffer.data + (size_t)width * 8;
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        for (size_t group = begin; group < end; group++) {
+            int y0 = (int)group * 8, count = std::min(8, height - y0);
+            for (int row = 0; row < 8; row++) {
+                float* dst = data + (row & 1) * 4 + row / 2;
+                if (row < count) {
+                    const float* src = input + (size_t)(y0 + row) * stride;
+                    for (int k = 0; k < width; k++) dst[k * 8] = src[k];
+                }
+                else {
+                    for (int k = 0; k < width; k++) dst[k * 8] = 0.0f;
+                }
+            }
+
+            rows.transform(data, scratch, false);
+
+            for (int k = 0; k < columnsOut; k++) {
+                CVec xk = load(data + k * 8), xn = load(data + (k ? width - k : 0) * 8);
+                __m128 values[4] = {
+                    _mm_mul_ps(_mm_add_ps(xk.re, xn.re), half),  // A re
+                    _mm_mul_ps(_mm_sub_ps(xk.im, xn.im), half),  // A im
+                    _mm_mul_ps(_mm_add_ps(xk.im, xn.im), half),  // B re
+                    _mm_mul_ps(_mm_sub_ps(xn.re, xk.re), half)   // B im
+                };
+                float v[16];
+                for (int i = 0; i < 4; i++) _mm_storeu_ps(v + i * 4, values[i]);
+                for (int row = 0; row < count; row++) {
+                    int lane = row / 2, part = (row & 1) * 8;
+                    spectrum[(size_t)(y0 + row) * columnsOut + k] = std::complex<float>(v[part + lane], v[part + 4 + lane]);
+                }
+            }
+        }
+    }, minGroups);
+
+    transformColumns(columns, spectrum, columnsOut, false);
+}
+
+// Volta das colunas no proprio espectro; nas linhas a metade que falta vem da
+// simetria (A[n - k] = conj(A[k])) e cada par de linhas volta junto em
+// X = A + iB: a parte real da inversa e' uma linha e a imaginaria a outra
+void Fft2D::inverse(std::complex<float>* spectrum, float* output, int stride) const {
+    PROFILE_SCOPE("Fft2D::inverse");
+    if (stride <= 0) stride = width;
+    const int columnsIn = spectrumWidth();
+    transformColumns(columns, spectrum, columnsIn, true);
+
+    size_t groups = (size_t)(height + 7) / 8;
+    size_t minGroups = (size_t)std::max(1, MIN_SAMPLES_PER_TASK / (8 * width));
+    const float norm = 1.0f / ((float)width * (float)height);
+
+    ThreadPool::shared().parallelFor(groups, [&](size_t begin, size_t end) {
+        AlignedFloats buffer((size_t)width * 8 + rows.scratchFloats());
+        float* data = buffer.data;
+        float* scratch = buffer.data + (size_t)width * 8;
+
+        for (size_t group = begin; group < end; group++) {
+            int y0 = (int)group * 8, count = std::min(8, height - y0);
+            for (int lane = 0; lane < 4; lane++) {
+                int rowA = 2 * lane, rowB = 2 * lane + 1;
+                const std::complex<float>* a = rowA < count ? spectrum + (size_t)(y0 + rowA) * columnsIn : NULL;
+                const std::complex<float>* b = rowB < count ? spectrum + (size_t)(y0 + rowB) * columnsIn : NULL;
+                for (int k = 0; k < width; k++) {
+                    bool mirrored = k >= columnsIn;
+                    int index = mirrored ? width - k : k;
+                    std::complex<float> va = a ? a[index] : std::complex<float>();
+                    std::complex<float> vb = b ? b[index] : std::complex<float>();
+                    if (mirrored) {
+                        va = std::conj(va);
+                        vb = std::conj(vb);
+                    }
+                    data[k * 8 + lane] = va.real() - vb.imag();
+                    data[k * 8 + 4 + lane] = va.imag() + vb.real();
+                }
+            }
+
+            rows.transform(data, scratch, true);
+
+            for (int row = 0; row < count; row++) {
+                const float* src = data + (row & 1) * 4 + row / 2;
+                float* dst = output + (size_t)(y0 + row) * stride;
+                for (int k = 0; k < width; k++) dst[k] = src[k * 8] * norm;
+            }
+        }
+    }, minGroups);
+}
+
+void Fft2D::applyFilter(std::complex<float>* spectrum, const FrequencyFilter& filter) const {
+    PROFILE_SCOPE("Fft2D::applyFilter");
+    const int columnsOut = spectrumWidth();
+    size_t minRows = (size_t)std::max(1, MIN_SAMPLES_PER_TASK / columnsOut);
+
+    // Frequencia da linha ky: 0..height/2 e depois negativas, como depois do fftshift
+    ThreadPool::shared().parallelFor((size_t)height, [&](size_t begin, size_t end) {
+        for (size_t ky = begin; ky < end; ky++) {
+            float fy = (float)((int)ky <= height / 2 ? (int)ky : (int)ky - height);
+            std::complex<float>* row = spectrum + ky * columnsOut;
+            for (int kx = 0; kx < columnsOut; kx++) {
+                row[kx] *= filter.gain(sqrtf((float)kx * kx + fy * fy));
+            }
+        }
+    }, minRows);
+}
+
+void Fft2D::filter(float* data, const FrequencyFilter& filter, int stride) {
+    spectrum.resize((size_t)spectrumWidth() * height);
+    forward(data, &spectrum[0], stride);
+    applyFilter(&spectrum[0], filter);
+    inverse(&spectrum[0], data, stride);
+}
+
+void Fft2D::filterImage(unsigned char* bgr, const FrequencyFilter& filter) {
+    const int rowBytes = (3 * width + 3) / 4 * 4;
+    channel.resize((size_t)width * height);
+
+    for (int c = 0; c < 3; c++) {
+        for (int y = 0; y < height; y++) {
+            const unsigned char* src = bgr + (size_t)y * rowBytes + c;
+            float* dst = &channel[(size_t)y * width];
+            for (int x = 0; x < width; x++) dst[x] = src[x * 3];
+        }
+
+        this->filter(&channel[0], filter);
+
+        for (int y = 0; y < height; y++) {
+            const float* src = &channel[(size_t)y * width];
+            unsigned char* dst = bgr + (size_t)y * rowBytes + c;
+            for (int x = 0; x < width; x++) dst[x * 3] = (unsigned char)std::min(fabsf(src[x]) + 0.5f, 255.0f);
+        }
+    }
+}
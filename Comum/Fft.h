@@ -0,0 +1,107 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <vector>
+
+// FFT complexa 1D de tamanho qualquer, calculando 4 transformadas de uma vez
+// (uma por lane SSE), o que deixa todas as borboletas vetoriais sem
+// embaralhar dados.
+//
+// Tamanhos com fatores 2, 3, 5, 7, 11 e 13 usam Stockham com raizes 4, 2, 3
+// e genericas (sem reordenacao de bits: cada estagio le um buffer e escreve
+// no outro ja' na ordem certa). Fatores primos maiores usam Bluestein (uma
+// convolucao com um chirp, via FFTs de potencia de 2).
+//
+// Os dados ficam em blocos de 8 floats por elemento: re das 4 transformadas
+// e depois im das 4 (alinhados em 16 bytes). A inversa nao divide por n.
+class FftPlan {
+public:
+    explicit FftPlan(int n);
+    ~FftPlan();
+
+    int size() const { return n; }
+    // floats de rascunho que transform() precisa
+    size_t scratchFloats() const;
+    void transform(float* data, float* scratch, bool inverse) const;
+
+private:
+    struct Stage {
+        int radix;
+        size_t twiddles;       // inicio em twiddles: (radix - 1) pares (cos, sin) por p
+    };
+
+    int n;
+    std::vector<Stage> stages;
+    std::vector<float> twiddles;
+    std::vector<float> roots;  // raizes da unidade das raizes genericas, por raiz: radix pares
+
+    // Bluestein
+    FftPlan* inner;
+    std::vector<float> chirp;  // n pares (cos, sin)
+    std::vector<float> kernel; // FFT do chirp conjugado, inner->size() pares
+
+    void stockham(float* data, float* scratch) const;
+    void bluestein(float* data, float* scratch) const;
+
+    FftPlan(const FftPlan&);
+    FftPlan& operator=(const FftPlan&);
+};
+
+// Filtro em frequencia, como no notebook Exercicios_de_aula/Luminancia (1).ipynb:
+// a distancia D de cada frequencia ao centro e' medida em amostras do espectro
+// (ciclos por imagem) e cutoff e' o raio de corte.
+struct FrequencyFilter {
+    enum Shape { IDEAL, BUTTERWORTH, GAUSSIAN };
+
+    Shape shape;
+    bool highPass;
+    float cutoff;
+    int order;      // so' Butterworth
+
+    FrequencyFilter(Shape shape = GAUSSIAN, bool highPass = false, float cutoff = 30.0f, int order = 2)
+        : shape(shape), highPass(highPass), cutoff(cutoff), order(order) {}
+
+    // Ganho na distancia d
+    float gain(float d) const;
+};
+
+// FFT 2D real -> complexa de width x height amostras, reaproveitavel: as
+// tabelas das FFTs de linha e coluna sao montadas uma vez no construtor.
+//
+// O espectro guarda so' as colunas 0..width/2 (o resto e' o conjugado), em
+// linhas de spectrumWidth() complexos. As linhas reais vao aos pares numa FFT
+// complexa (uma na parte real, outra na imaginaria) e as duas passadas rodam
+// em paralelo no ThreadPool::shared(), em grupos de 8 linhas e 4 colunas.
+//
+// filter() e filterImage() usam um espectro interno: um objeto nao pode
+// filtrar em duas threads ao mesmo tempo.
+class Fft2D {
+public:
+    Fft2D(int width, int height);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int spectrumWidth() const { return width / 2 + 1; }
+
+    // stride em floats (0 = width)
+    void forward(const float* input, std::complex<float>* spectrum, int stride = 0) const;
+    // Destroi o espectro (a passada das colunas e' feita nele). Ja' divide por width * height
+    void inverse(std::complex<float>* spectrum, float* output, int stride = 0) const;
+
+    void applyFilter(std::complex<float>* spectrum, const FrequencyFilter& filter) const;
+
+    // forward + filtro + inverse, no lugar (p.ex. HeightMap::getData())
+    void filter(float* data, const FrequencyFilter& filter, int stride = 0);
+    // Cada canal de uma imagem no layout de Bmp::getImage(); como no notebook
+    // o resultado e' o modulo da inversa (importa no passa-alta), limitado a 255
+    void filterImage(unsigned char* bgr, const FrequencyFilter& filter);
+
+private:
+    int width, height;
+    FftPlan rows, columns;
+    std::vector<std::complex<float> > spectrum;
+    std::vector<float> channel;
+};
+
+#endif
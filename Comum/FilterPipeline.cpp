@@ -0,0 +1,404 @@
+#include "FilterPipeline.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+FilterPipeline::FilterPipeline() : tileSize(128) {
+}
+
+FilterPipeline& FilterPipeline::addSeparable(Type type, const std::vector<float>& kernel, float amount) {
+    Stage stage;
+    stage.type = type;
+    stage.radius = (int)kernel.size() / 2;
+    stage.amount = amount;
+    stage.kernel = kernel;
+    stages.push_back(stage);
+    return *this;
+}
+
+static std::vector<float> gaussianKernel(float sigma) {
+    int radius = std::max(1, (int)ceilf(3.0f * sigma));
+    std::vector<float> kernel(2 * radius + 1);
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; i++) {
+        kernel[i + radius] = expf(-(float)(i * i) / (2.0f * sigma * sigma));
+        sum += kernel[i + radius];
+    }
+    for (size_t i = 0; i < kernel.size(); i++) kernel[i] /= sum;
+    return kernel;
+}
+
+FilterPipeline& FilterPipeline::gaussian(float sigma) {
+    if (sigma <= 0.0f) return *this;
+    return addSeparable(SEPARABLE, gaussianKernel(sigma), 0.0f);
+}
+
+FilterPipeline& FilterPipeline::box(int radius) {
+    if (radius <= 0) return *this;
+    return addSeparable(SEPARABLE, std::vector<float>(2 * radius + 1, 1.0f / (2 * radius + 1)), 0.0f);
+}
+
+FilterPipeline& FilterPipeline::sobel() {
+    Stage stage;
+    stage.type = SOBEL;
+    stage.radius = 1;
+    stage.amount = 0.0f;
+    stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::median(int radius) {
+    if (radius <= 0) return *this;
+    Stage stage;
+    stage.type = MEDIAN;
+    stage.radius = radius;
+    stage.amount = 0.0f;
+    stages.push_back(stage);
+    return *this;
+}
+
+FilterPipeline& FilterPipeline::unsharp(float sigma, float amount) {
+    if (sigma <= 0.0f) return *this;
+    return addSeparable(UNSHARP, gaussianKernel(sigma), amount);
+}
+
+void FilterPipeline::clear() {
+    stages.clear();
+}
+
+int FilterPipeline::halo() const {
+    int sum = 0;
+    for (size_t i = 0; i < stages.size(); i++) sum += stages[i].radius;
+    return sum;
+}
+
+// ---------------------------------------------------------------------------
+// Execucao
+
+void FilterPipeline::run(const float* input, float* output, int width, int height, int stride) const {
+    PROFILE_SCOPE("FilterPipeline::run");
+    if (width <= 0 || height <= 0) return;
+    if (stride <= 0) stride = width;
+
+    // No lugar: os ladrilhos vizinhos ainda precisam da entrada original
+    std::vector<float> copy;
+    if (input == output) {
+        copy.assign(input, input + (size_t)stride * height);
+        input = copy.data();
+    }
+
+    Plane in = { input, NULL, NULL, NULL, 1, (size_t)stride };
+    Plane out = { NULL, output, NULL, NULL, 1, (size_t)stride };
+    runPlanes(&in, &out, 1, width, height);
+}
+
+void FilterPipeline::runImage(const unsigned char* input, unsigned char* output, int width, int height) const {
+    PROFILE_SCOPE("FilterPipeline::runImage");
+    if (width <= 0 || height <= 0) return;
+    size_t rowBytes = (size_t)(3 * width + 3) / 4 * 4;
+
+    std::vector<unsigned char> copy;
+    if (input == output) {
+        copy.assign(input, input + rowBytes * height);
+        input = copy.data();
+    }
+
+    Plane in[3], out[3];
+    for (int c = 0; c < 3; c++) {
+        Plane source = { NULL, NULL, input + c, NULL, 3, rowBytes };
+        Plane target = { NULL, NULL, NULL, output + c, 3, rowBytes };
+        in[c] = source;
+        out[c] = target;
+    }
+    runPlanes(in, out, 3, width, height);
+}
+
+// Os planos de um ladrilho sao feitos em sequencia pela mesma thread, com os
+// buffers ainda no cache
+void FilterPipeline::runPlanes(const Plane* inputs, const Plane* outputs, int planes, int width, int height) const {
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+
+    ThreadPool::shared().parallelFor((size_t)tilesX * tilesY, [&](size_t begin, size_t end) {
+        Workspace ws;
+        for (size_t t = begin; t < end; t++) {
+            Rect tile;
+            tile.x0 = (int)(t % tilesX) * tileSize;
+            tile.y0 = (int)(t / tilesX) * tileSize;
+            tile.x1 = std::min(width, tile.x0 + tileSize);
+            tile.y1 = std::min(height, tile.y0 + tileSize);
+            for (int p = 0; p < planes; p++) {
+                processTile(inputs[p], outputs[p], tile, width, height, ws);
+            }
+        }
+    });
+}
+
+void FilterPipeline::processTile(const Plane& input, const Plane& output, const Rect& tile, int width, int height,
+                                 Workspace& ws) const {
+    // Da saida para a entrada: cada filtro precisa da regiao do seguinte
+    // aumentada pelo proprio raio (cortada na imagem, onde vale o clamp)
+    const size_t count = stages.size();
+    Rect rects[64];
+    std::vector<Rect> manyRects;
+    Rect* rect = rects;
+    if (count + 1 > 64) {
+        manyRects.resize(count + 1);
+        rect = manyRects.data();
+    }
+    rect[count] = tile;
+    for (size_t k = count; k-- > 0;) {
+        int r = stages[k].radius;
+        rect[k].x0 = std::max(0, rect[k + 1].x0 - r);
+        rect[k].y0 = std::max(0, rect[k + 1].y0 - r);
+        rect[k].x1 = std::min(width, rect[k + 1].x1 + r);
+        rect[k].y1 = std::min(height, rect[k + 1].y1 + r);
+    }
+
+    size_t area = (size_t)rect[0].width() * rect[0].height();
+    if (ws.a.size() < area) ws.a.resize(area);
+    if (ws.b.size() < area) ws.b.resize(area);
+    float* current = ws.a.data();
+    float* next = ws.b.data();
+
+    const int w0 = rect[0].width();
+    for (int y = rect[0].y0; y < rect[0].y1; y++) {
+        float* dst = current + (size_t)(y - rect[0].y0) * w0;
+        if (input.floats) {
+            memcpy(dst, input.floats + y * input.rowStride + rect[0].x0, w0 * sizeof(float));
+        }
+        else {
+            const unsigned char* src = input.bytes + y * input.rowStride + (size_t)rect[0].x0 * input.pixelStride;
+            for (int x = 0; x < w0; x++) dst[x] = src[x * input.pixelStride];
+        }
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        const Stage& stage = stages[k];
+        switch (stage.type) {
+        case SEPARABLE: separable(current, rect[k], next, rect[k + 1], stage.kernel, ws); break;
+        case SOBEL: sobel(current, rect[k], next, rect[k + 1], ws); break;
+        case MEDIAN:
+            if (stage.radius == 1) median3(current, rect[k], next, rect[k + 1], ws);
+            else median(current, rect[k], next, rect[k + 1], stage.radius, ws);
+            break;
+        case UNSHARP: unsharp(current, rect[k], next, rect[k + 1], stage, ws); break;
+        }
+        std::swap(current, next);
+    }
+
+    const int w = tile.width();
+    for (int y = tile.y0; y < tile.y1; y++) {
+        const float* src = current + (size_t)(y - tile.y0) * w;
+        if (output.floatsOut) {
+            memcpy(output.floatsOut + y * output.rowStride + tile.x0, src, w * sizeof(float));
+        }
+        else {
+            unsigned char* dst = output.bytesOut + y * output.rowStride + (size_t)tile.x0 * output.pixelStride;
+            for (int x = 0; x < w; x++) {
+                float v = std::min(std::max(src[x] + 0.5f, 0.0f), 255.0f);
+                dst[x * output.pixelStride] = (unsigned char)v;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Filtros: in cobre inRect e out cobre outRect, linhas sem preenchimento
+
+static inline int clampInt(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+const float* FilterPipeline::paddedLine(const float* in, const Rect& inRect, const Rect& outRect, int y, int r,
+                                        float* line) {
+    const int inW = inRect.width();
+    const float* row = in + (size_t)(clampInt(y, inRect.y0, inRect.y1 - 1) - inRect.y0) * inW;
+    // inRect comeca em outRect.x0 - r, ou antes disso na borda da imagem
+    const int offset = inRect.x0 - (outRect.x0 - r);
+    const int length = outRect.width() + 2 * r;
+    for (int i = 0; i < offset; i++) line[i] = row[0];
+    memcpy(line + offset, row, inW * sizeof(float));
+    for (int i = offset + inW; i < length; i++) line[i] = row[inW - 1];
+    return line;
+}
+
+// Vertical da linha de entrada para uma linha com as bordas repetidas, depois
+// horizontal dessa linha para a saida
+void FilterPipeline::separable(const float* in, const Rect& inRect, float* out, const Rect& outRect,
+                               const std::vector<float>& kernel, Workspace& ws) {
+    const int r = (int)kernel.size() / 2, taps = (int)kernel.size();
+    const int inW = inRect.width(), outW = outRect.width();
+    const int offset = inRect.x0 - (outRect.x0 - r);
+    const int length = outW + 2 * r;
+    if (ws.lines.size() < (size_t)length) ws.lines.resize(length);
+    if (ws.rows.size() < (size_t)taps) ws.rows.resize(taps);
+    float* line = ws.lines.data();
+    const float* k = kernel.data();
+
+    for (int y = outRect.y0; y < outRect.y1; y++) {
+        for (int j = 0; j < taps; j++) {
+            ws.rows[j] = in + (size_t)(clampInt(y + j - r, inRect.y0, inRect.y1 - 1) - inRect.y0) * inW;
+        }
+
+        float* vertical = line + offset;
+        int x = 0;
+        for (; x + 4 <= inW; x += 4) {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(k[0]), _mm_loadu_ps(ws.rows[0] + x));
+            for (int j = 1; j < taps; j++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(k[j]), _mm_loadu_ps(ws.rows[j] + x)));
+            }
+            _mm_storeu_ps(vertical + x, sum);
+        }
+        for (; x < inW; x++) {
+            float sum = 0.0f;
+            for (int j = 0; j < taps; j++) sum += k[j] * ws.rows[j][x];
+            vertical[x] = sum;
+        }
+        for (int i = 0; i < offset; i++) line[i] = vertical[0];
+        for (int i = offset + inW; i < length; i++) line[i] = vertical[inW - 1];
+
+        float* dst = out + (size_t)(y - outRect.y0) * outW;
+        x = 0;
+        for (; x + 4 <= outW; x += 4) {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(k[0]), _mm_loadu_ps(line + x));
+            for (int j = 1; j < taps; j++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(k[j]), _mm_loadu_ps(line + x + j)));
+            }
+            _mm_storeu_ps(dst + x, sum);
+        }
+        for (; x < outW; x++) {
+            float sum = 0.0f;
+            for (int j = 0; j < taps; j++) sum += k[j] * line[x + j];
+            dst[x] = sum;
+        }
+    }
+}
+
+// |G| com gx = [1 2 1]^T [-1 0 1] e gy = [-1 0 1]^T [1 2 1]
+void FilterPipeline::sobel(const float* in, const Rect& inRect, float* out, const Rect& outRect, Workspace& ws) {
+    const int outW = outRect.width(), length = outW + 2;
+    if (ws.lines.size() < (size_t)length * 3) ws.lines.resize((size_t)length * 3);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for (int y = outRect.y0; y < outRect.y1; y++) {
+        const float* r0 = paddedLine(in, inRect, outRect, y - 1, 1, ws.lines.data());
+        const float* r1 = paddedLine(in, inRect, outRect, y, 1, ws.lines.data() + length);
+        const float* r2 = paddedLine(in, inRect, outRect, y + 1, 1, ws.lines.data() + 2 * length);
+        float* dst = out + (size_t)(y - outRect.y0) * outW;
+
+        int x = 0;
+        for (; x + 4 <= outW; x += 4) {
+            __m128 a0 = _mm_loadu_ps(r0 + x), a1 = _mm_loadu_ps(r0 + x + 1), a2 = _mm_loadu_ps(r0 + x + 2);
+            __m128 b0 = _mm_loadu_ps(r1 + x), b2 = _mm_loadu_ps(r1 + x + 2);
+            __m128 c0 = _mm_loadu_ps(r2 + x), c1 = _mm_loadu_ps(r2 + x + 1), c2 = _mm_loadu_ps(r2 + x + 2);
+            __m128 gx = _mm_add_ps(_mm_add_ps(_mm_sub_ps(a2, a0), _mm_sub_ps(c2, c0)),
+                                   _mm_mul_ps(two, _mm_sub_ps(b2, b0)));
+            __m128 gy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(c0, c2), _mm_mul_ps(two, c1)),
+                                   _mm_add_ps(_mm_add_ps(a0, a2), _mm_mul_ps(two, a1)));
+            _mm_storeu_ps(dst + x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy))));
+        }
+        for (; x < outW; x++) {
+            float gx = (r0[x + 2] - r0[x]) + (r2[x + 2] - r2[x]) + 2.0f * (r1[x + 2] - r1[x]);
+            float gy = (r2[x] + r2[x + 2] + 2.0f * r2[x + 1]) - (r0[x] + r0[x + 2] + 2.0f * r0[x + 1]);
+            dst[x] = sqrtf(gx * gx + gy * gy);
+        }
+    }
+}
+
+static inline void sort2(__m128& a, __m128& b) {
+    __m128 low = _mm_min_ps(a, b);
+    b = _mm_max_ps(a, b);
+    a = low;
+}
+
+static inline void sort2(float& a, float& b) {
+    float low = std::min(a, b);
+    b = std::max(a, b);
+    a = low;
+}
+
+// Rede de 19 comparacoes que deixa a mediana de 9 valores em p[4]
+template <typename T>
+static inline T median9(T* p) {
+    sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+    sort2(p[0], p[1]); sort2(p[3], p[4]); sort2(p[6], p[7]);
+    sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+    sort2(p[0], p[3]); sort2(p[5], p[8]); sort2(p[4], p[7]);
+    sort2(p[3], p[6]); sort2(p[1], p[4]); sort2(p[2], p[5]);
+    sort2(p[4], p[7]); sort2(p[4], p[2]); sort2(p[6], p[4]);
+    sort2(p[4], p[2]);
+    return p[4];
+}
+
+void FilterPipeline::median3(const float* in, const Rect& inRect, float* out, const Rect& outRect, Workspace& ws) {
+    const int outW = outRect.width(), length = outW + 2;
+    if (ws.lines.size() < (size_t)length * 3) ws.lines.resize((size_t)length * 3);
+
+    for (int y = outRect.y0; y < outRect.y1; y++) {
+        const float* lines[3] = {
+            paddedLine(in, inRect, outRect, y - 1, 1, ws.lines.data()),
+            paddedLine(in, inRect, outRect, y, 1, ws.lines.data() + length),
+            paddedLine(in, inRect, outRect, y + 1, 1, ws.lines.data() + 2 * length)
+        };
+        float* dst = out + (size_t)(y - outRect.y0) * outW;
+
+        int x = 0;
+        for (; x + 4 <= outW; x += 4) {
+            __m128 p[9];
+            for (int i = 0; i < 9; i++) p[i] = _mm_loadu_ps(lines[i / 3] + x + i % 3);
+            _mm_storeu_ps(dst + x, median9(p));
+        }
+        for (; x < outW; x++) {
+            float p[9];
+            for (int i = 0; i < 9; i++) p[i] = lines[i / 3][x + i % 3];
+            dst[x] = median9(p);
+        }
+    }
+}
+
+void FilterPipeline::median(const float* in, const Rect& inRect, float* out, const Rect& outRect, int radius,
+                            Workspace& ws) {
+    const int outW = outRect.width(), length = outW + 2 * radius, taps = 2 * radius + 1;
+    if (ws.lines.size() < (size_t)length * taps) ws.lines.resize((size_t)length * taps);
+    if (ws.window.size() < (size_t)taps * taps) ws.window.resize((size_t)taps * taps);
+    if (ws.rows.size() < (size_t)taps) ws.rows.resize(taps);
+    float* window = ws.window.data();
+    const int middle = taps * taps / 2;
+
+    for (int y = outRect.y0; y < outRect.y1; y++) {
+        for (int j = 0; j < taps; j++) {
+            ws.rows[j] = paddedLine(in, inRect, outRect, y + j - radius, radius, ws.lines.data() + (size_t)j * length);
+        }
+        float* dst = out + (size_t)(y - outRect.y0) * outW;
+        for (int x = 0; x < outW; x++) {
+            for (int j = 0; j < taps; j++) memcpy(window + j * taps, ws.rows[j] + x, taps * sizeof(float));
+            std::nth_element(window, window + middle, window + taps * taps);
+            dst[x] = window[middle];
+        }
+    }
+}
+
+void FilterPipeline::unsharp(const float* in, const Rect& inRect, float* out, const Rect& outRect,
+                             const Stage& stage, Workspace& ws) {
+    const int outW = outRect.width(), inW = inRect.width();
+    const size_t area = (size_t)outW * outRect.height();
+    if (ws.blur.size() < area) ws.blur.resize(area);
+    separable(in, inRect, ws.blur.data(), outRect, stage.kernel, ws);
+
+    const __m128 amount = _mm_set1_ps(stage.amount);
+    for (int y = outRect.y0; y < outRect.y1; y++) {
+        const float* src = in + (size_t)(y - inRect.y0) * inW + (outRect.x0 - inRect.x0);
+        const float* blur = ws.blur.data() + (size_t)(y - outRect.y0) * outW;
+        float* dst = out + (size_t)(y - outRect.y0) * outW;
+        int x = 0;
+        for (; x + 4 <= outW; x += 4) {
+            __m128 v = _mm_loadu_ps(src + x);
+            _mm_storeu_ps(dst + x, _mm_add_ps(v, _mm_mul_ps(amount, _mm_sub_ps(v, _mm_loadu_ps(blur + x)))));
+        }
+        for (; x < outW; x++) dst[x] = src[x] + stage.amount * (src[x] - blur[x]);
+    }
+}
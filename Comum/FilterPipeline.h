@@ -0,0 +1,106 @@
+#ifndef FILTERPIPELINE_H
+#define FILTERPIPELINE_H
+
+#include <stddef.h>
+#include <vector>
+
+// Cadeia de filtros espaciais (gaussiano, caixa, Sobel, mediana, unsharp mask)
+// aplicada de uma vez, ladrilho por ladrilho: cada ladrilho de saida le da
+// entrada a regiao que precisa (o ladrilho mais a soma dos raios dos
+// filtros), passa pela cadeia inteira em buffers que cabem no cache e so'
+// entao grava. Sem isso cada filtro leria e gravaria a imagem inteira.
+//
+// As bordas repetem o pixel da borda em cada filtro (clamp), entao o
+// resultado e' o mesmo de aplicar os filtros um de cada vez na imagem toda.
+// Os lacos internos usam SSE (4 pixels) e os ladrilhos rodam em paralelo no
+// ThreadPool::shared().
+//
+//     FilterPipeline pipeline;
+//     pipeline.median(1).gaussian(1.0f);
+//     pipeline.run(map.getData(), map.getData(), map.getWidth(), map.getHeight());
+class FilterPipeline {
+public:
+    FilterPipeline();
+
+    // Cada um acrescenta um filtro ao fim da cadeia
+    FilterPipeline& gaussian(float sigma);            // raio ceil(3 sigma)
+    FilterPipeline& box(int radius);                  // media (2r + 1) x (2r + 1)
+    FilterPipeline& sobel();                          // modulo do gradiente 3x3
+    FilterPipeline& median(int radius);               // 3x3 (raio 1) vetorizado; maiores escalares
+    FilterPipeline& unsharp(float sigma, float amount);   // x + amount * (x - gaussiano(x))
+    void clear();
+
+    size_t size() const { return stages.size(); }
+    // Soma dos raios: quanto cada ladrilho le alem das proprias bordas
+    int halo() const;
+
+    // Lado do ladrilho de saida (padrao 128: ~64 KB por buffer)
+    void setTileSize(int size) { tileSize = size < 8 ? 8 : size; }
+    int getTileSize() const { return tileSize; }
+
+    // Um plano de floats; stride em floats (0 = width). input pode ser output
+    // (a entrada e' copiada antes)
+    void run(const float* input, float* output, int width, int height, int stride = 0) const;
+    // Imagem no layout de Bmp::getImage() (3 canais, linhas alinhadas em 4
+    // bytes), cada canal filtrado separadamente e arredondado para [0, 255].
+    // input tambem pode ser output
+    void runImage(const unsigned char* input, unsigned char* output, int width, int height) const;
+
+private:
+    enum Type { SEPARABLE, SOBEL, MEDIAN, UNSHARP };
+
+    struct Stage {
+        Type type;
+        int radius;
+        float amount;
+        std::vector<float> kernel;   // 2 * radius + 1 pesos (separaveis e unsharp)
+    };
+
+    // Retangulo [x0, x1) x [y0, y1) em coordenadas da imagem
+    struct Rect {
+        int x0, y0, x1, y1;
+        int width() const { return x1 - x0; }
+        int height() const { return y1 - y0; }
+    };
+
+    // Plano de entrada ou saida: floats, ou um canal de bytes intercalados
+    struct Plane {
+        const float* floats;
+        float* floatsOut;
+        const unsigned char* bytes;
+        unsigned char* bytesOut;
+        int pixelStride;             // em elementos
+        size_t rowStride;
+    };
+
+    // Buffers de uma thread
+    struct Workspace {
+        std::vector<float> a, b, blur;
+        std::vector<float> lines;    // linhas com as bordas repetidas
+        std::vector<float> window;   // janela da mediana escalar
+        std::vector<const float*> rows;
+    };
+
+    std::vector<Stage> stages;
+    int tileSize;
+
+    FilterPipeline& addSeparable(Type type, const std::vector<float>& kernel, float amount);
+
+    void runPlanes(const Plane* inputs, const Plane* outputs, int planes, int width, int height) const;
+    void processTile(const Plane& input, const Plane& output, const Rect& tile, int width, int height,
+                     Workspace& ws) const;
+
+    static void separable(const float* in, const Rect& inRect, float* out, const Rect& outRect,
+                          const std::vector<float>& kernel, Workspace& ws);
+    static void sobel(const float* in, const Rect& inRect, float* out, const Rect& outRect, Workspace& ws);
+    static void median3(const float* in, const Rect& inRect, float* out, const Rect& outRect, Workspace& ws);
+    static void median(const float* in, const Rect& inRect, float* out, const Rect& outRect, int radius,
+                       Workspace& ws);
+    static void unsharp(const float* in, const Rect& inRect, float* out, const Rect& outRect, const Stage& stage,
+                        Workspace& ws);
+    // Linha y de in (y limitado a inRect) com as colunas de outRect +- r,
+    // repetindo as bordas de inRect
+    static const float* paddedLine(const float* in, const Rect& inRect, const Rect& outRect, int y, int r, float* line);
+};
+
+#endif
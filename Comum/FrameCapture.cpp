@@ -0,0 +1,241 @@
+#include "FrameCapture.h"
+#include <chrono>
+#include <ctype.h>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include "Bmp.h"
+#include "Profiler.h"
+
+static bool isRaw(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".raw") == 0;
+}
+
+FrameCapture::FrameCapture(const std::string& fileName, int w, int h, GLuint fb)
+    : path(fileName), valid(false), raw(false), video(NULL), width(w), height(h), frameBytes((size_t)(3 * w + 3) / 4 * 4 * h),
+      framebuffer(fb), next(0), captured(0), calls(0), totalMs(0.0), maxMs(0.0), written(0), dropped(0), failed(0), stopping(false)
+{
+    valid = validPath(path);
+    raw = isRaw(path);
+    if (valid && raw) {
+        fopen_s(&video, path.c_str(), "wb");
+        if (video == NULL) std::cerr << "Erro ao criar " << path << std::endl;
+    }
+
+    for (int i = 0; i < RING_SIZE; i++) {
+        glGenBuffers(1, &slots[i].buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+        slots[i].fence = NULL;
+        slots[i].frame = -1;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // um buffer para cada lugar da fila, o que a thread esta' gravando e o
+    // que esta' sendo copiado: o render nunca aloca
+    pool.resize(QUEUE_SIZE + 2);
+    for (std::vector<unsigned char>& pixels : pool) pixels.resize(frameBytes);
+
+    writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+bool FrameCapture::validPath(const std::string& path) {
+    if (isRaw(path)) return true;
+
+    // o padrao vai direto para o snprintf: so' "%%" e uma conversao inteira
+    int conversions = 0;
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] != '%') continue;
+        if (++i < path.size() && path[i] == '%') continue;
+        while (i < path.size() && strchr("-+ 0", path[i]) != NULL) i++;
+        while (i < path.size() && isdigit((unsigned char)path[i])) i++;
+        if (i < path.size() && path[i] == '.') {
+            i++;
+            while (i < path.size() && isdigit((unsigned char)path[i])) i++;
+        }
+        if (i >= path.size() || (path[i] != 'd' && path[i] != 'i')) {
+            std::cerr << "Captura: " << path << " tem uma conversao que nao e' %d (use %% para '%')" << std::endl;
+            return false;
+        }
+        conversions++;
+    }
+    if (conversions != 1) {
+        std::cerr << "Captura: " << path << " precisa de exatamente um %d para o numero do quadro"
+                  << " (ex.: quadros/q%05d.bmp) ou terminar em .raw" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+    for (int i = 0; i < RING_SIZE; i++) glDeleteBuffers(1, &slots[i].buffer);
+}
+
+void FrameCapture::finish() {
+    if (!writer.joinable()) return;
+
+    // do mais antigo ao mais novo; aqui pode esperar a GPU e a fila
+    for (int k = 0; k < RING_SIZE; k++) {
+        Slot& slot = slots[(next + k) % RING_SIZE];
+        if (slot.fence == NULL) continue;
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        collect(slot, true);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    if (video != NULL) {
+        fclose(video);
+        video = NULL;
+    }
+}
+
+void FrameCapture::capture(int frame) {
+    PROFILE_SCOPE("FrameCapture::capture");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Recolhe os quadros que a GPU ja' terminou, do mais antigo ao mais novo.
+    // So' com o fence sinalizado: assim o map nunca espera a GPU
+    for (int k = 0; k < RING_SIZE; k++) {
+        Slot& slot = slots[(next + k) % RING_SIZE];
+        if (slot.fence == NULL) continue;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        collect(slot, false);
+    }
+
+    Slot& slot = slots[next];
+    if (slot.fence != NULL) {
+        // GPU RING_SIZE quadros atrasada: descarta em vez de esperar
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped++;
+    }
+    else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame;
+        next = (next + 1) % RING_SIZE;
+        captured++;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    totalMs += elapsed.count();
+    if (elapsed.count() > maxMs) maxMs = elapsed.count();
+    calls++;
+}
+
+void FrameCapture::collect(Slot& slot, bool wait) {
+    std::vector<unsigned char> pixels;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pool.empty()) {
+            pixels.swap(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    const void* data = NULL;
+    if (!pixels.empty()) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+        if (data != NULL) {
+            memcpy(pixels.data(), data, frameBytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    if (data != NULL) {
+        push(slot.frame, pixels, wait);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped++;
+        if (!pixels.empty()) {
+            pool.push_back(std::vector<unsigned char>());
+            pool.back().swap(pixels);
+        }
+    }
+
+    glDeleteSync(slot.fence);
+    slot.fence = NULL;
+}
+
+void FrameCapture::push(int index, std::vector<unsigned char>& pixels, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait) space.wait(lock, [this] { return queue.size() < (size_t)QUEUE_SIZE; });
+    if (queue.size() >= (size_t)QUEUE_SIZE) {
+        // disco mais lento que o render: perde o quadro, nao o tempo do quadro
+        dropped++;
+        pool.push_back(std::vector<unsigned char>());
+        pool.back().swap(pixels);
+        return;
+    }
+    queue.push_back(Frame());
+    queue.back().index = index;
+    queue.back().pixels.swap(pixels);
+    lock.unlock();
+    wake.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+    Frame frame;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+        frame.index = queue.front().index;
+        frame.pixels.swap(queue.front().pixels);
+        queue.pop_front();
+        lock.unlock();
+        space.notify_one();
+
+        bool ok = write(frame);
+
+        lock.lock();
+        pool.push_back(std::vector<unsigned char>());
+        pool.back().swap(frame.pixels);
+        if (ok) written++;
+        else failed++;
+    }
+}
+
+bool FrameCapture::write(const Frame& frame) {
+    if (!valid) return false;
+    if (raw) {
+        // sem o alinhamento das linhas
+        if (video == NULL) return false;
+        const size_t stride = (size_t)(3 * width + 3) / 4 * 4, row = (size_t)3 * width;
+        for (int y = 0; y < height; y++) {
+            if (fwrite(frame.pixels.data() + y * stride, 1, row, video) != row) return false;
+        }
+        return true;
+    }
+
+    char fileName[1024];
+    int length = snprintf(fileName, sizeof(fileName), path.c_str(), frame.index);
+    if (length < 0 || length >= (int)sizeof(fileName)) return false;
+    return Bmp::save(fileName, width, height, frame.pixels.data()) == BMP_OK;
+}
+
+int FrameCapture::getWritten() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+int FrameCapture::getDropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+int FrameCapture::getFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
@@ -0,0 +1,101 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Gravacao dos quadros de um demo sem travar o render.
+//
+// capture() so' enfileira um glReadPixels para um pixel pack buffer do anel
+// (RING_SIZE buffers) e poe um fence depois dele; a copia acontece na GPU.
+// O buffer e' lido RING_SIZE - 1 quadros depois, quando o fence ja' passou,
+// copiado para um buffer de CPU e entregue a uma fila limitada que uma thread
+// de gravacao esvazia. Nada espera: com a fila cheia (disco lento) ou a GPU
+// atrasada (fence ainda pendente), o quadro e' descartado e contado.
+//
+// Os pixels vem como GL_BGR com linhas alinhadas em 4 bytes e linha 0
+// embaixo, o layout de Bmp::save(), entao cada quadro vira um BMP sem
+// conversao. Caminho terminado em ".raw" grava um unico arquivo de video cru
+// (BGR24, quadros de baixo para cima), por exemplo:
+//   ffmpeg -f rawvideo -pixel_format bgr24 -video_size WxH -framerate 60 -i video.raw -vf vflip video.mp4
+// Outro caminho e' um padrao de printf com o numero do quadro ("quadros/q%05d.bmp"):
+// exatamente uma conversao %d ou %i (flags, largura e precisao opcionais) e
+// "%%" para um '%' literal. Qualquer outro padrao e' recusado por validPath(),
+// inclusive sem conversao nenhuma, que regravaria o mesmo arquivo a cada quadro.
+class FrameCapture {
+public:
+    static const int RING_SIZE = 3;
+    static const int QUEUE_SIZE = 8;
+
+    // Contexto GL corrente; framebuffer = o lido em capture() (0 = janela).
+    // Com um caminho invalido nenhum quadro e' gravado (todos contam em getFailed())
+    FrameCapture(const std::string& path, int width, int height, GLuint framebuffer);
+    ~FrameCapture();
+
+    // Chamado no fim de cada quadro, antes da troca de buffers
+    void capture(int frame);
+    // Le o que ainda esta' no anel, espera a fila esvaziar e fecha os
+    // arquivos (o destrutor chama se preciso). Depois disso os contadores
+    // sao os finais
+    void finish();
+
+    int getCaptured() const { return captured; }
+    int getWritten() const;
+    int getDropped() const;          // fila cheia ou GPU atrasada
+    int getFailed() const;           // erro de escrita
+    double getAverageMs() const { return calls > 0 ? totalMs / calls : 0.0; }
+    double getMaxMs() const { return maxMs; }
+
+    // ".raw" ou padrao com uma unica conversao inteira; senao explica em std::cerr
+    static bool validPath(const std::string& path);
+
+private:
+    struct Slot {
+        GLuint buffer;
+        GLsync fence;                // NULL = livre
+        int frame;
+    };
+
+    struct Frame {
+        int index;
+        std::vector<unsigned char> pixels;
+    };
+
+    std::string path;
+    bool valid, raw;
+    FILE* video;
+    int width, height;
+    size_t frameBytes;               // linhas alinhadas em 4 bytes
+    GLuint framebuffer;
+
+    Slot slots[RING_SIZE];
+    int next;                        // proximo slot a receber um quadro
+    int captured, calls;
+    double totalMs, maxMs;
+
+    // fila de gravacao e buffers de CPU reaproveitados, protegidos por mutex
+    mutable std::mutex mutex;
+    std::condition_variable wake, space;
+    std::deque<Frame> queue;
+    std::vector<std::vector<unsigned char> > pool;
+    int written, dropped, failed;
+    bool stopping;
+    std::thread writer;
+
+    // Copia o slot (fence ja' sinalizado) para a fila e libera. wait: espera
+    // lugar na fila em vez de descartar (so' em finish())
+    void collect(Slot& slot, bool wait);
+    void push(int index, std::vector<unsigned char>& pixels, bool wait);
+    void writerLoop();
+    bool write(const Frame& frame);
+
+    FrameCapture(const FrameCapture&);
+    FrameCapture& operator=(const FrameCapture&);
+};
+
+#endif
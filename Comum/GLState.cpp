@@ -0,0 +1,145 @@
+#include "GLState.h"
+#include "Profiler.h"
+
+GLState& GLState::current() {
+    static GLState state;
+    return state;
+}
+
+GLState::GLState() : skipped(0) {
+    invalidate();
+}
+
+void GLState::invalidate() {
+    program = vao = activeUnit = UNKNOWN;
+    for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        textureTargets[i] = 0;
+        textures[i] = UNKNOWN;
+    }
+    polygon = depthCompare = cullMode = 0;
+    depthEnabled = depthWrite = cullEnabled = -1;
+}
+
+void GLState::useProgram(GLuint p) {
+    if (p == program) {
+        skipped++;
+        return;
+    }
+    glUseProgram(p);
+    program = p;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::bindVertexArray(GLuint v) {
+    if (v == vao) {
+        skipped++;
+        return;
+    }
+    glBindVertexArray(v);
+    vao = v;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::setActiveUnit(unsigned int unit) {
+    if (unit == activeUnit) return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+    // unidades acima do limite nao sao rastreadas, vao sempre ao driver
+    if (unit < MAX_TEXTURE_UNITS && textures[unit] == texture && textureTargets[unit] == target) {
+        skipped++;
+        return;
+    }
+    setActiveUnit(unit);
+    glBindTexture(target, texture);
+    if (unit < MAX_TEXTURE_UNITS) {
+        textures[unit] = texture;
+        textureTargets[unit] = target;
+    }
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::polygonMode(GLenum mode) {
+    if (mode == polygon) {
+        skipped++;
+        return;
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    polygon = mode;
+    PROFILE_STATE_CHANGE(1);
+}
+
+bool GLState::setCap(GLenum cap, bool enabled, int& cached) {
+    if (cached == (enabled ? 1 : 0)) return false;
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+    cached = enabled ? 1 : 0;
+    PROFILE_STATE_CHANGE(1);
+    return true;
+}
+
+void GLState::depthTest(bool enabled) {
+    if (!setCap(GL_DEPTH_TEST, enabled, depthEnabled)) skipped++;
+}
+
+void GLState::cullFace(bool enabled) {
+    if (!setCap(GL_CULL_FACE, enabled, cullEnabled)) skipped++;
+}
+
+void GLState::depthMask(bool enabled) {
+    if (depthWrite == (enabled ? 1 : 0)) {
+        skipped++;
+        return;
+    }
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    depthWrite = enabled ? 1 : 0;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::depthFunc(GLenum func) {
+    if (func == depthCompare) {
+        skipped++;
+        return;
+    }
+    glDepthFunc(func);
+    depthCompare = func;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::cullFaceMode(GLenum mode) {
+    if (mode == cullMode) {
+        skipped++;
+        return;
+    }
+    glCullFace(mode);
+    cullMode = mode;
+    PROFILE_STATE_CHANGE(1);
+}
+
+void GLState::deleteProgram(GLuint& p) {
+    if (p == 0) return;
+    glDeleteProgram(p);
+    // um programa em uso so' e' apagado quando deixa de ser usado; o nome pode
+    // ser reaproveitado pelo driver, entao o cache precisa esquecer
+    if (p == program) program = UNKNOWN;
+    p = 0;
+}
+
+void GLState::deleteVertexArray(GLuint& v) {
+    if (v == 0) return;
+    glDeleteVertexArrays(1, &v);
+    if (v == vao) vao = 0;
+    v = 0;
+}
+
+void GLState::deleteTexture(GLuint& texture) {
+    if (texture == 0) return;
+    glDeleteTextures(1, &texture);
+    for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        if (textures[i] == texture) textures[i] = 0;
+    }
+    texture = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+
+// Cache do estado do OpenGL: guarda o ultimo valor pedido de programa, VAO,
+// texturas por unidade, modo de poligono, depth e cull, e so' chama o driver
+// quando o valor muda.
+//
+// O cache so' e' valido se todo codigo que muda esses estados passar por ele.
+// Codigo que chama o GL direto (ou bibliotecas externas) deve chamar
+// invalidate() depois, para o proximo pedido ir ao driver de novo.
+//
+// Os demos usam um unico contexto, por isso ha' uma instancia global.
+class GLState {
+public:
+    static GLState& current();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // Ativa a unidade e liga a textura; nao chama nada se a unidade ja' tem essa textura
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+    void polygonMode(GLenum mode);   // GL_FRONT_AND_BACK
+    void depthTest(bool enabled);
+    void depthMask(bool enabled);
+    void depthFunc(GLenum func);
+    void cullFace(bool enabled);
+    void cullFaceMode(GLenum mode);
+
+    // Apagar um objeto ligado faz o GL voltar ao objeto 0; estas versoes
+    // mantem o cache coerente e zeram o nome
+    void deleteProgram(GLuint& program);
+    void deleteVertexArray(GLuint& vao);
+    void deleteTexture(GLuint& texture);
+
+    // Esquece tudo; o proximo pedido de cada estado vai ao driver
+    void invalidate();
+
+    // Chamadas ao driver evitadas desde o inicio
+    long long getSkipped() const { return skipped; }
+
+private:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program, vao;
+    GLuint activeUnit;
+    GLenum textureTargets[MAX_TEXTURE_UNITS];
+    GLuint textures[MAX_TEXTURE_UNITS];
+    GLenum polygon, depthCompare, cullMode;
+    int depthEnabled, depthWrite, cullEnabled;   // -1 = desconhecido
+    long long skipped;
+
+    GLState();
+    void setActiveUnit(unsigned int unit);
+    static bool setCap(GLenum cap, bool enabled, int& cached);
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "Headless.h"
+#include <ctype.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include "FrameCapture.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+Headless::Headless(int argc, char** argv)
+    : headless(false), software(false), ok(false), maxFrames(600), frame(0), width(800), height(600),
+      csvPath("frames.csv"), imagePath("software.bmp"), overlay(false), window(NULL), fbo(0), colorBuffer(0), depthBuffer(0),
+      eglDisplay(NULL), eglContext(NULL)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless" || arg == "--software") {
+            headless = true;
+            software |= arg == "--software";
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) maxFrames = atoi(argv[++i]);
+        }
+        else if (arg == "--image" && i + 1 < argc) {
+            imagePath = argv[++i];
+        }
+        else if (arg == "--capture" && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (arg == "--csv" && i + 1 < argc) {
+            csvPath = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+        else if (arg == "--overlay") {
+            overlay = true;
+        }
+    }
+}
+
+Headless::~Headless() {
+    shutdown();
+}
+
+GLFWwindow* Headless::createContext(int major, int minor, bool coreProfile, int w, int h, const char* title) {
+    width = w;
+    height = h;
+
+    if (software) {
+        std::cerr << "Software: " << maxFrames << " quadros " << width << "x" << height
+                  << " sem GL, ultimo quadro em " << imagePath << std::endl;
+        if (!capturePath.empty()) std::cerr << "--capture exige GL, ignorado com --software" << std::endl;
+        ok = true;
+        return NULL;
+    }
+
+    if (!(headless && createEGLContext(major, minor, coreProfile))) {
+        if (!glfwInit()) {
+            std::cerr << "Erro ao inicializar GLFW" << std::endl;
+            return NULL;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, coreProfile ? GLFW_OPENGL_CORE_PROFILE : GLFW_OPENGL_COMPAT_PROFILE);
+        if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        window = glfwCreateWindow(width, height, title, NULL, NULL);
+        if (!window) {
+            std::cerr << "Erro ao criar janela GLFW" << std::endl;
+            glfwTerminate();
+            return NULL;
+        }
+        glfwMakeContextCurrent(window);
+        if (headless) glfwSwapInterval(0);
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    // GLEW compilado para GLX devolve GLEW_ERROR_NO_GLX_DISPLAY num contexto EGL,
+    // mas as funcoes do GL ja' foram carregadas
+    if (err != GLEW_OK && !(eglContext != NULL && err == GLEW_ERROR_NO_GLX_DISPLAY)) {
+        std::cerr << "Erro ao inicializar GLEW" << std::endl;
+        return NULL;
+    }
+
+    if (headless) {
+        createRenderTarget();
+        glGenQueries(QUERY_RING * 2, queries);
+        std::cerr << "Headless: " << maxFrames << " quadros " << width << "x" << height
+                  << " (" << (eglContext ? "EGL" : "GLFW oculto") << "), renderer "
+                  << glGetString(GL_RENDERER) << std::endl;
+    }
+
+#ifndef ENABLE_PROFILER
+    if (overlay || !tracePath.empty()) {
+        std::cerr << "--trace/--overlay exigem compilar com ENABLE_PROFILER" << std::endl;
+    }
+#endif
+    PROFILE_OVERLAY(overlay);
+
+    // caminho invalido: avisa e segue sem captura
+    if (!capturePath.empty() && !FrameCapture::validPath(capturePath)) capturePath.clear();
+    if (!capturePath.empty()) {
+        capture.reset(new FrameCapture(capturePath, width, height, fbo));
+        std::cerr << "Captura: " << width << "x" << height << " -> " << capturePath << std::endl;
+    }
+
+    ok = true;
+    return window;
+}
+
+bool Headless::createEGLContext(int major, int minor, bool coreProfile) {
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        std::cerr << "EGL indisponivel, usando janela GLFW oculta" << std::endl;
+        return false;
+    }
+
+    // sem superficie: qualquer tipo de superficie serve, so' precisa renderizar GL desktop
+    const EGLint configAttribs[] = { EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count == 0 || !eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        coreProfile ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    eglDisplay = display;
+    eglContext = context;
+    return true;
+#else
+    (void)major; (void)minor; (void)coreProfile;
+    return false;
+#endif
+}
+
+void Headless::createRenderTarget() {
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Erro: FBO headless incompleto" << std::endl;
+    }
+    glViewport(0, 0, width, height);
+}
+
+double Headless::getTime() const {
+    return headless ? frame / 60.0 : glfwGetTime();
+}
+
+bool Headless::running() {
+    if (!ok) return false;
+    if (headless) {
+        if (frame >= maxFrames) return false;
+        if (!software) glQueryCounter(queries[(frame % QUERY_RING) * 2], GL_TIMESTAMP);
+    }
+    else if (glfwWindowShouldClose(window)) {
+        return false;
+    }
+    frameStart = std::chrono::high_resolution_clock::now();
+    PROFILE_BEGIN_FRAME();
+    return true;
+}
+
+void Headless::endFrame() {
+    // antes do overlay do Profiler, que nao entra na gravacao
+    if (capture) capture->capture(frame);
+    if (!software) PROFILE_DRAW_OVERLAY(window, width, height);
+    PROFILE_END_FRAME();
+
+    if (!headless) {
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        frame++;
+        return;
+    }
+
+    if (!software) {
+        glQueryCounter(queries[(frame % QUERY_RING) * 2 + 1], GL_TIMESTAMP);
+        glFlush();
+    }
+    std::chrono::duration<double, std::milli> cpu = std::chrono::high_resolution_clock::now() - frameStart;
+    cpuTimes.push_back(cpu.count());
+    gpuTimes.push_back(-1.0);
+    if (software) {
+        frame++;
+        return;
+    }
+
+    // A query de QUERY_RING-1 quadros atras normalmente ja' terminou na GPU e
+    // o slot dela e' o do proximo quadro: le agora sem esperar. Se a GPU
+    // estiver mais atrasada que isso o quadro fica sem amostra (-1)
+    if (frame >= QUERY_RING - 1) collectQuery(frame - (QUERY_RING - 1), false);
+    frame++;
+}
+
+bool Headless::collectQuery(int frameIndex, bool wait) {
+    GLuint begin = queries[(frameIndex % QUERY_RING) * 2], end = queries[(frameIndex % QUERY_RING) * 2 + 1];
+    if (!wait) {
+        // a de fim foi emitida por ultimo: se ela esta' pronta, a de inicio tambem
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) return false;
+    }
+    GLuint64 beginTime = 0, endTime = 0;
+    glGetQueryObjectui64v(begin, GL_QUERY_RESULT, &beginTime);
+    glGetQueryObjectui64v(end, GL_QUERY_RESULT, &endTime);
+    gpuTimes[frameIndex] = (endTime - beginTime) / 1.0e6;
+    return true;
+}
+
+void Headless::writeCSV() {
+    FILE* fp = NULL;
+    fopen_s(&fp, csvPath.c_str(), "w");
+    if (fp == NULL) {
+        std::cerr << "Erro ao criar " << csvPath << std::endl;
+        return;
+    }
+
+    double cpuSum = 0.0, gpuSum = 0.0;
+    int gpuSamples = 0;
+    fprintf(fp, "frame,cpu_ms,gpu_ms\n");
+    for (size_t i = 0; i < cpuTimes.size(); i++) {
+        fprintf(fp, "%d,%.4f,%.4f\n", (int)i, cpuTimes[i], gpuTimes[i]);
+        cpuSum += cpuTimes[i];
+        // -1 = query nao ficou pronta a tempo
+        if (gpuTimes[i] >= 0.0) {
+            gpuSum += gpuTimes[i];
+            gpuSamples++;
+        }
+    }
+    fclose(fp);
+
+    if (software) {
+        printf("Software: %d quadros, CPU %.3f ms/quadro -> %s\n", (int)cpuTimes.size(), cpuSum / cpuTimes.size(), csvPath.c_str());
+    }
+    else if (!cpuTimes.empty()) {
+        printf("Headless: %d quadros, CPU %.3f ms/quadro, GPU %.3f ms/quadro -> %s\n",
+               (int)cpuTimes.size(), cpuSum / cpuTimes.size(), gpuSamples > 0 ? gpuSum / gpuSamples : -1.0, csvPath.c_str());
+    }
+}
+
+void Headless::shutdown() {
+    if (ok) {
+        if (!tracePath.empty()) PROFILE_WRITE_TRACE(tracePath);
+        PROFILE_SHUTDOWN();
+    }
+    if (capture) {
+        capture->finish();
+        printf("Captura: %d quadros, %d gravados, %d descartados, %d com erro, render %.3f ms/quadro (max %.3f) -> %s\n",
+               frame, capture->getWritten(), capture->getDropped(), capture->getFailed(), capture->getAverageMs(),
+               capture->getMaxMs(), capturePath.c_str());
+        capture.reset();
+    }
+    if (ok && software) {
+        if (!cpuTimes.empty()) writeCSV();
+    }
+    else if (ok && headless) {
+        int first = frame - (QUERY_RING - 1);
+        for (int i = first < 0 ? 0 : first; i < frame; i++) collectQuery(i, true);
+        // programas que so' usam o contexto (ex.: benchmarks) nao geram CSV
+        if (!cpuTimes.empty()) writeCSV();
+
+        glDeleteQueries(QUERY_RING * 2, queries);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+    ok = false;
+
+#ifdef HEADLESS_EGL
+    if (eglContext != NULL) {
+        eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)eglDisplay, (EGLContext)eglContext);
+        eglTerminate((EGLDisplay)eglDisplay);
+        eglContext = NULL;
+        eglDisplay = NULL;
+        return;
+    }
+#endif
+    if (window != NULL) {
+        glfwDestroyWindow(window);
+        window = NULL;
+        glfwTerminate();
+    }
+}
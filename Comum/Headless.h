@@ -0,0 +1,88 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Profiler.h"
+
+class FrameCapture;
+
+// Laco de quadros compartilhado pelos demos, com modo headless para CI.
+//
+// Sem argumentos, cria a janela GLFW de sempre e roda ate' ela ser fechada.
+// Com "--headless [quadros]" cria um contexto sem janela, desenha num FBO,
+// para depois do numero de quadros pedido e grava o tempo de CPU e de GPU
+// (par de GL_TIMESTAMP) de cada quadro em CSV ("--csv arquivo", padrao frames.csv).
+//
+// Compilado com ENABLE_PROFILER, cada quadro tambem alimenta o Profiler:
+// "--trace arquivo.json" grava o trace no final e "--overlay" desenha o
+// grafico de tempos de quadro (ver Profiler.h).
+//
+// O contexto headless usa EGL surfaceless quando compilado com HEADLESS_EGL
+// (Mesa llvmpipe em maquinas sem GPU); caso contrario usa uma janela GLFW oculta.
+//
+// "--software [quadros]" e' o modo headless sem GL nenhum: createContext() nao
+// cria contexto e o demo desenha com o SoftRasterizer, gravando o ultimo
+// quadro em BMP ("--image arquivo", padrao software.bmp). O CSV sai so' com
+// o tempo de CPU (gpu_ms = -1). No modo GL, gpu_ms = -1 tambem marca um
+// quadro cuja query ainda nao estava pronta quando o slot foi reaproveitado.
+//
+// "--capture arquivo" grava os quadros (janela ou headless) com FrameCapture:
+// um BMP por quadro ("quadros/q%05d.bmp") ou video cru ("video.raw"), lidos
+// de forma assincrona; quadros que nao dao tempo de gravar sao descartados.
+class Headless {
+public:
+    Headless(int argc, char** argv);
+    ~Headless();
+
+    // Cria o contexto e inicializa o GLEW. Retorna a janela (NULL no EGL)
+    // ou NULL com isOk() == false em caso de erro.
+    GLFWwindow* createContext(int major, int minor, bool coreProfile, int width, int height, const char* title);
+
+    bool isOk() const { return ok; }
+    bool isHeadless() const { return headless; }
+    bool isSoftware() const { return software; }
+    const std::string& getImagePath() const { return imagePath; }
+    int getFrame() const { return frame; }
+
+    // Tempo da animacao em segundos: quadro / 60 no headless (deterministico),
+    // glfwGetTime() com janela
+    double getTime() const;
+
+    // Chamado no inicio de cada quadro; false quando o programa deve terminar
+    bool running();
+    // Fim do quadro: troca os buffers (janela) ou fecha as medicoes (headless)
+    void endFrame();
+
+private:
+    static const int QUERY_RING = 4;
+
+    bool headless, software, ok;
+    int maxFrames, frame, width, height;
+    std::string csvPath, tracePath, imagePath, capturePath;
+    bool overlay;
+    GLFWwindow* window;
+
+    GLuint fbo, colorBuffer, depthBuffer;
+    GLuint queries[QUERY_RING * 2];   // inicio e fim de cada quadro
+    std::chrono::high_resolution_clock::time_point frameStart;
+    std::vector<double> cpuTimes, gpuTimes;
+
+    std::unique_ptr<FrameCapture> capture;
+
+    void* eglDisplay;
+    void* eglContext;
+
+    bool createEGLContext(int major, int minor, bool coreProfile);
+    void createRenderTarget();
+    // Le as queries do quadro; wait = false: so' se ja' estiverem prontas
+    bool collectQuery(int frameIndex, bool wait);
+    void writeCSV();
+    void shutdown();
+};
+
+#endif
@@ -0,0 +1,486 @@
+#include "ImageOps.h"
+#include <algorithm>
+#include <string.h>
+#include <vector>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// MSVC aceita intrinsics AVX2 em qualquer funcao; o GCC/Clang precisa do atributo
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+// Pesos da luminancia em ponto fixo de 16 bits: 0.299, 0.587 e 0.114 * 65536,
+// somando exatamente 65536. O de G e' dividido em dois para caber em int16 no
+// _mm_madd_epi16, que soma os pares (R, G) e (B, G).
+static const int WEIGHT_R = 19595, WEIGHT_G = 38470, WEIGHT_B = 7471;
+
+// Abaixo disso (pixels) uma faixa de linhas nao compensa acordar outra thread
+static const int MIN_PIXELS_PER_TASK = 1 << 15;
+
+static ImageOps::Simd detectSimd() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return ImageOps::SIMD_SSE2;
+    __cpuid(info, 1);
+    // AVX precisa do suporte do sistema (OSXSAVE + registradores YMM salvos)
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) return ImageOps::SIMD_SSE2;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) ? ImageOps::SIMD_AVX2 : ImageOps::SIMD_SSE2;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("avx2") ? ImageOps::SIMD_AVX2 : ImageOps::SIMD_SSE2;
+#else
+    return ImageOps::SIMD_SSE2;
+#endif
+}
+
+static const ImageOps::Simd supportedSimd = detectSimd();
+static ImageOps::Simd activeSimd = supportedSimd;
+
+ImageOps::Simd ImageOps::getSimd() {
+    return activeSimd;
+}
+
+void ImageOps::setSimd(Simd simd) {
+    activeSimd = std::min(simd, supportedSimd);
+}
+
+// Faixas de linhas [y0, y1) no pool compartilhado
+template <typename Function>
+static void forRows(int width, int height, const Function& function) {
+    size_t minRows = (size_t)std::max(1, MIN_PIXELS_PER_TASK / std::max(width, 1));
+    ThreadPool::shared().parallelFor((size_t)height, [&](size_t begin, size_t end) {
+        function((int)begin, (int)end);
+    }, minRows);
+}
+
+// ---------------------------------------------------------------------------
+// Um pixel
+
+unsigned char ImageOps::luminance(unsigned char r, unsigned char g, unsigned char b) {
+    return (unsigned char)((WEIGHT_R * r + WEIGHT_G * g + WEIGHT_B * b) >> 16);
+}
+
+void ImageOps::rgbToHls(unsigned char r, unsigned char g, unsigned char b, float& h, float& l, float& s) {
+    const float scale = 1.0f / 255.0f;
+    float rf = r * scale, gf = g * scale, bf = b * scale;
+    float maxValue = std::max(rf, std::max(gf, bf));
+    float minValue = std::min(rf, std::min(gf, bf));
+    float dif = maxValue - minValue, sum = maxValue + minValue;
+    l = sum * 0.5f;
+    if (dif < 1e-8f) {
+        h = s = 0.0f;
+        return;
+    }
+    s = l <= 0.5f ? dif / sum : dif / (2.0f - sum);
+
+    // mesma escolha do notebook: R, depois G, depois B como maximo
+    float base, numerator;
+    if (rf == maxValue) { base = 0.0f; numerator = gf - bf; }
+    else if (gf == maxValue) { base = 2.0f; numerator = bf - rf; }
+    else { base = 4.0f; numerator = rf - gf; }
+    h = (base + numerator / dif) / 6.0f;
+    if (h < 0.0f) h += 1.0f;
+}
+
+void ImageOps::rgbToHsv(unsigned char r, unsigned char g, unsigned char b, float& h, float& s, float& v) {
+    const float scale = 1.0f / 255.0f;
+    float rf = r * scale, gf = g * scale, bf = b * scale;
+    float maxValue = std::max(rf, std::max(gf, bf));
+    float minValue = std::min(rf, std::min(gf, bf));
+    float dif = maxValue - minValue;
+    v = maxValue;
+    if (dif < 1e-8f) {
+        h = s = 0.0f;
+        return;
+    }
+    s = dif / maxValue;
+
+    float base, numerator;
+    if (rf == maxValue) { base = 0.0f; numerator = gf - bf; }
+    else if (gf == maxValue) { base = 2.0f; numerator = bf - rf; }
+    else { base = 4.0f; numerator = rf - gf; }
+    h = (base + numerator / dif) / 6.0f;
+    if (h < 0.0f) h += 1.0f;
+}
+
+static unsigned char toByte(float value) {
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+// rgb_helper do notebook, com o matiz em graus
+static float hueToChannel(float p1, float p2, float hue) {
+    if (hue > 360.0f) hue -= 360.0f;
+    if (hue < 0.0f) hue += 360.0f;
+    if (hue < 60.0f) return p1 + (p2 - p1) * hue / 60.0f;
+    if (hue < 180.0f) return p2;
+    if (hue < 240.0f) return p1 + (p2 - p1) * (240.0f - hue) / 60.0f;
+    return p1;
+}
+
+void ImageOps::hlsToRgb(float h, float l, float s, unsigned char& r, unsigned char& g, unsigned char& b) {
+    if (s == 0.0f) {
+        r = g = b = toByte(l);
+        return;
+    }
+    float hue = h * 360.0f;
+    float p2 = l <= 0.5f ? l * (1.0f + s) : l + s - l * s;
+    float p1 = 2.0f * l - p2;
+    r = toByte(hueToChannel(p1, p2, hue + 120.0f));
+    g = toByte(hueToChannel(p1, p2, hue));
+    b = toByte(hueToChannel(p1, p2, hue - 120.0f));
+}
+
+void ImageOps::hsvToRgb(float h, float s, float v, unsigned char& r, unsigned char& g, unsigned char& b) {
+    float h6 = h * 6.0f;
+    if (h6 >= 6.0f) h6 -= 6.0f;
+    int sector = (int)h6;
+    float f = h6 - sector;
+    float p = v * (1.0f - s), q = v * (1.0f - s * f), t = v * (1.0f - s * (1.0f - f));
+    float rf, gf, bf;
+    switch (sector) {
+        case 0:  rf = v; gf = t; bf = p; break;
+        case 1:  rf = q; gf = v; bf = p; break;
+        case 2:  rf = p; gf = v; bf = t; break;
+        case 3:  rf = p; gf = q; bf = v; break;
+        case 4:  rf = t; gf = p; bf = v; break;
+        default: rf = v; gf = p; bf = q; break;
+    }
+    r = toByte(rf);
+    g = toByte(gf);
+    b = toByte(bf);
+}
+
+// ---------------------------------------------------------------------------
+// Luminancia
+
+static void luminanceRowScalar(const unsigned char* in, unsigned char* out, int begin, int end) {
+    for (int x = begin; x < end; x++) out[x] = ImageOps::luminance(in[3 * x + 2], in[3 * x + 1], in[3 * x]);
+}
+
+static inline int load32(const unsigned char* p) {
+    int value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+// 4 pixels lidos como inteiros de 32 bits (B, G, R + 1 byte do proximo pixel);
+// o byte extra vira G de novo com shufflelo/hi, e o madd soma (B, G) e (R, G)
+static inline __m128i luminance4Sse2(const unsigned char* p, __m128i weights) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pixels = _mm_setr_epi32(load32(p), load32(p + 3), load32(p + 6), load32(p + 9));
+    __m128i sums[2];
+    for (int half = 0; half < 2; half++) {
+        __m128i words = half == 0 ? _mm_unpacklo_epi8(pixels, zero) : _mm_unpackhi_epi8(pixels, zero);
+        words = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, _MM_SHUFFLE(1, 2, 1, 0)), _MM_SHUFFLE(1, 2, 1, 0));
+        __m128i products = _mm_madd_epi16(words, weights);
+        // soma dos dois produtos de cada pixel nas lanes 0 e 2
+        products = _mm_add_epi32(products, _mm_srli_epi64(products, 32));
+        sums[half] = _mm_shuffle_epi32(products, _MM_SHUFFLE(3, 3, 2, 0));
+    }
+    return _mm_srli_epi32(_mm_unpacklo_epi64(sums[0], sums[1]), 16);
+}
+
+// 8 pixels por iteracao; para antes do ultimo pixel, cuja carga de 32 bits passaria do fim da linha
+static int luminanceRowSse2(const unsigned char* in, unsigned char* out, int width) {
+    const __m128i weights = _mm_setr_epi16(WEIGHT_B, WEIGHT_G / 2, WEIGHT_R, WEIGHT_G / 2, WEIGHT_B, WEIGHT_G / 2, WEIGHT_R, WEIGHT_G / 2);
+    int x = 0;
+    for (; x + 8 < width; x += 8) {
+        const unsigned char* p = in + 3 * x;
+        __m128i words = _mm_packs_epi32(luminance4Sse2(p, weights), luminance4Sse2(p + 12, weights));
+        _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(words, words));
+    }
+    return x;
+}
+
+// 16 pixels: os 48 bytes BGR sao separados em planos B, G, R com pshufb
+AVX2_FUNCTION static int luminanceRowAvx2(const unsigned char* in, unsigned char* out, int width) {
+    // para cada canal, de onde vem cada um dos 16 bytes em cada bloco de 16 (-1 = zero)
+    const __m128i shuffleB0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shuffleB1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i shuffleB2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i shuffleG0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shuffleG1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i shuffleG2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i shuffleR0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shuffleR1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i shuffleR2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    const __m256i weightsRG = _mm256_set1_epi32((WEIGHT_G / 2) << 16 | WEIGHT_R);
+    const __m256i weightsBG = _mm256_set1_epi32((WEIGHT_G / 2) << 16 | WEIGHT_B);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const unsigned char* p = in + 3 * x;
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+        __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, shuffleB0), _mm_shuffle_epi8(b, shuffleB1)), _mm_shuffle_epi8(c, shuffleB2));
+        __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, shuffleG0), _mm_shuffle_epi8(b, shuffleG1)), _mm_shuffle_epi8(c, shuffleG2));
+        __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, shuffleR0), _mm_shuffle_epi8(b, shuffleR1)), _mm_shuffle_epi8(c, shuffleR2));
+
+        __m256i r16 = _mm256_cvtepu8_epi16(red);
+        __m256i g16 = _mm256_cvtepu8_epi16(green);
+        __m256i b16 = _mm256_cvtepu8_epi16(blue);
+        // unpack e pack trabalham dentro de cada metade de 128 bits, entao a ordem volta no pack
+        __m256i low = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r16, g16), weightsRG),
+                                       _mm256_madd_epi16(_mm256_unpacklo_epi16(b16, g16), weightsBG));
+        __m256i high = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r16, g16), weightsRG),
+                                        _mm256_madd_epi16(_mm256_unpackhi_epi16(b16, g16), weightsBG));
+        __m256i words = _mm256_packs_epi32(_mm256_srli_epi32(low, 16), _mm256_srli_epi32(high, 16));
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0xD8);
+        _mm_storeu_si128((__m128i*)(out + x), _mm256_castsi256_si128(bytes));
+    }
+    return x;
+}
+
+void ImageOps::luminance(const unsigned char* bgr, int width, int height, unsigned char* gray) {
+    PROFILE_SCOPE("ImageOps::luminance");
+    int lineSize = stride(width);
+    Simd simd = activeSimd;
+    forRows(width, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* in = bgr + (size_t)y * lineSize;
+            unsigned char* out = gray + (size_t)y * width;
+            int done = 0;
+            if (simd == SIMD_AVX2) done = luminanceRowAvx2(in, out, width);
+            else if (simd == SIMD_SSE2) done = luminanceRowSse2(in, out, width);
+            luminanceRowScalar(in, out, done, width);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Conversoes de cor, 4 pixels por vez com as mesmas operacoes das versoes de um pixel
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline void loadPixels(const unsigned char* p, __m128& r, __m128& g, __m128& b) {
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(p[2], p[5], p[8], p[11])), scale);
+    g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(p[1], p[4], p[7], p[10])), scale);
+    b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(p[0], p[3], p[6], p[9])), scale);
+}
+
+static inline __m128i toBytes(__m128 value) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+static inline void storePixels(unsigned char* p, __m128 r, __m128 g, __m128 b) {
+    int rs[4], gs[4], bs[4];
+    _mm_storeu_si128((__m128i*)rs, toBytes(r));
+    _mm_storeu_si128((__m128i*)gs, toBytes(g));
+    _mm_storeu_si128((__m128i*)bs, toBytes(b));
+    for (int i = 0; i < 4; i++) {
+        p[3 * i] = (unsigned char)bs[i];
+        p[3 * i + 1] = (unsigned char)gs[i];
+        p[3 * i + 2] = (unsigned char)rs[i];
+    }
+}
+
+// Matiz em [0, 1) comum a HLS e HSV; lanes cinza (dif ~ 0) ficam com lixo e sao zeradas por quem chama
+static inline __m128 hue(__m128 r, __m128 g, __m128 b, __m128 maxValue, __m128 dif) {
+    __m128 isR = _mm_cmpeq_ps(r, maxValue);
+    __m128 isG = _mm_andnot_ps(isR, _mm_cmpeq_ps(g, maxValue));
+    __m128 base = select(isR, _mm_setzero_ps(), select(isG, _mm_set1_ps(2.0f), _mm_set1_ps(4.0f)));
+    __m128 numerator = select(isR, _mm_sub_ps(g, b), select(isG, _mm_sub_ps(b, r), _mm_sub_ps(r, g)));
+    __m128 h = _mm_div_ps(_mm_add_ps(base, _mm_div_ps(numerator, dif)), _mm_set1_ps(6.0f));
+    return _mm_add_ps(h, _mm_and_ps(_mm_cmplt_ps(h, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+}
+
+static int rgbToHlsRowSse2(const unsigned char* in, float* h, float* l, float* s, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 r, g, b;
+        loadPixels(in + 3 * x, r, g, b);
+        __m128 maxValue = _mm_max_ps(r, _mm_max_ps(g, b));
+        __m128 minValue = _mm_min_ps(r, _mm_min_ps(g, b));
+        __m128 dif = _mm_sub_ps(maxValue, minValue), sum = _mm_add_ps(maxValue, minValue);
+        __m128 lightness = _mm_mul_ps(sum, _mm_set1_ps(0.5f));
+        __m128 saturation = select(_mm_cmple_ps(lightness, _mm_set1_ps(0.5f)), _mm_div_ps(dif, sum),
+                                   _mm_div_ps(dif, _mm_sub_ps(_mm_set1_ps(2.0f), sum)));
+        __m128 chromatic = _mm_cmpge_ps(dif, _mm_set1_ps(1e-8f));
+        _mm_storeu_ps(h + x, _mm_and_ps(chromatic, hue(r, g, b, maxValue, dif)));
+        _mm_storeu_ps(l + x, lightness);
+        _mm_storeu_ps(s + x, _mm_and_ps(chromatic, saturation));
+    }
+    return x;
+}
+
+static int rgbToHsvRowSse2(const unsigned char* in, float* h, float* s, float* v, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 r, g, b;
+        loadPixels(in + 3 * x, r, g, b);
+        __m128 maxValue = _mm_max_ps(r, _mm_max_ps(g, b));
+        __m128 dif = _mm_sub_ps(maxValue, _mm_min_ps(r, _mm_min_ps(g, b)));
+        __m128 chromatic = _mm_cmpge_ps(dif, _mm_set1_ps(1e-8f));
+        _mm_storeu_ps(h + x, _mm_and_ps(chromatic, hue(r, g, b, maxValue, dif)));
+        _mm_storeu_ps(s + x, _mm_and_ps(chromatic, _mm_div_ps(dif, maxValue)));
+        _mm_storeu_ps(v + x, maxValue);
+    }
+    return x;
+}
+
+static inline __m128 hueToChannel(__m128 p1, __m128 p2, __m128 hue) {
+    const __m128 full = _mm_set1_ps(360.0f), sixty = _mm_set1_ps(60.0f);
+    hue = _mm_sub_ps(hue, _mm_and_ps(_mm_cmpgt_ps(hue, full), full));
+    hue = _mm_add_ps(hue, _mm_and_ps(_mm_cmplt_ps(hue, _mm_setzero_ps()), full));
+    __m128 delta = _mm_sub_ps(p2, p1);
+    __m128 rising = _mm_add_ps(p1, _mm_div_ps(_mm_mul_ps(delta, hue), sixty));
+    __m128 falling = _mm_add_ps(p1, _mm_div_ps(_mm_mul_ps(delta, _mm_sub_ps(_mm_set1_ps(240.0f), hue)), sixty));
+    __m128 value = select(_mm_cmplt_ps(hue, _mm_set1_ps(180.0f)), p2, select(_mm_cmplt_ps(hue, _mm_set1_ps(240.0f)), falling, p1));
+    return select(_mm_cmplt_ps(hue, sixty), rising, value);
+}
+
+static int hlsToRgbRowSse2(const float* h, const float* l, const float* s, unsigned char* out, int width) {
+    const __m128 one = _mm_set1_ps(1.0f), third = _mm_set1_ps(120.0f);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 hue = _mm_mul_ps(_mm_loadu_ps(h + x), _mm_set1_ps(360.0f));
+        __m128 lightness = _mm_loadu_ps(l + x), saturation = _mm_loadu_ps(s + x);
+        __m128 p2 = select(_mm_cmple_ps(lightness, _mm_set1_ps(0.5f)), _mm_mul_ps(lightness, _mm_add_ps(one, saturation)),
+                           _mm_sub_ps(_mm_add_ps(lightness, saturation), _mm_mul_ps(lightness, saturation)));
+        __m128 p1 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f), lightness), p2);
+        __m128 gray = _mm_cmpeq_ps(saturation, _mm_setzero_ps());
+        __m128 r = select(gray, lightness, hueToChannel(p1, p2, _mm_add_ps(hue, third)));
+        __m128 g = select(gray, lightness, hueToChannel(p1, p2, hue));
+        __m128 b = select(gray, lightness, hueToChannel(p1, p2, _mm_sub_ps(hue, third)));
+        storePixels(out + 3 * x, r, g, b);
+    }
+    return x;
+}
+
+static int hsvToRgbRowSse2(const float* h, const float* s, const float* v, unsigned char* out, int width) {
+    const __m128 one = _mm_set1_ps(1.0f), six = _mm_set1_ps(6.0f);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 h6 = _mm_mul_ps(_mm_loadu_ps(h + x), six);
+        h6 = _mm_sub_ps(h6, _mm_and_ps(_mm_cmpge_ps(h6, six), six));
+        __m128 sector = _mm_cvtepi32_ps(_mm_cvttps_epi32(h6));
+        __m128 f = _mm_sub_ps(h6, sector);
+        __m128 saturation = _mm_loadu_ps(s + x), value = _mm_loadu_ps(v + x);
+        __m128 p = _mm_mul_ps(value, _mm_sub_ps(one, saturation));
+        __m128 q = _mm_mul_ps(value, _mm_sub_ps(one, _mm_mul_ps(saturation, f)));
+        __m128 t = _mm_mul_ps(value, _mm_sub_ps(one, _mm_mul_ps(saturation, _mm_sub_ps(one, f))));
+
+        // setores 0..5, do ultimo para o primeiro: (v,t,p) (q,v,p) (p,v,t) (p,q,v) (t,p,v) (v,p,q)
+        __m128 r = value, g = p, b = q;
+        const __m128 rs[5] = { value, q, p, p, t }, gs[5] = { t, value, value, q, p }, bs[5] = { p, p, t, value, value };
+        for (int k = 4; k >= 0; k--) {
+            __m128 here = _mm_cmpeq_ps(sector, _mm_set1_ps((float)k));
+            r = select(here, rs[k], r);
+            g = select(here, gs[k], g);
+            b = select(here, bs[k], b);
+        }
+        storePixels(out + 3 * x, r, g, b);
+    }
+    return x;
+}
+
+void ImageOps::rgbToHls(const unsigned char* bgr, int width, int height, float* h, float* l, float* s) {
+    PROFILE_SCOPE("ImageOps::rgbToHls");
+    int lineSize = stride(width);
+    bool vector = activeSimd != SIMD_NONE;
+    forRows(width, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* in = bgr + (size_t)y * lineSize;
+            size_t row = (size_t)y * width;
+            int x = vector ? rgbToHlsRowSse2(in, h + row, l + row, s + row, width) : 0;
+            for (; x < width; x++) rgbToHls(in[3 * x + 2], in[3 * x + 1], in[3 * x], h[row + x], l[row + x], s[row + x]);
+        }
+    });
+}
+
+void ImageOps::rgbToHsv(const unsigned char* bgr, int width, int height, float* h, float* s, float* v) {
+    PROFILE_SCOPE("ImageOps::rgbToHsv");
+    int lineSize = stride(width);
+    bool vector = activeSimd != SIMD_NONE;
+    forRows(width, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* in = bgr + (size_t)y * lineSize;
+            size_t row = (size_t)y * width;
+            int x = vector ? rgbToHsvRowSse2(in, h + row, s + row, v + row, width) : 0;
+            for (; x < width; x++) rgbToHsv(in[3 * x + 2], in[3 * x + 1], in[3 * x], h[row + x], s[row + x], v[row + x]);
+        }
+    });
+}
+
+void ImageOps::hlsToRgb(const float* h, const float* l, const float* s, int width, int height, unsigned char* bgr) {
+    PROFILE_SCOPE("ImageOps::hlsToRgb");
+    int lineSize = stride(width);
+    bool vector = activeSimd != SIMD_NONE;
+    forRows(width, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            unsigned char* out = bgr + (size_t)y * lineSize;
+            size_t row = (size_t)y * width;
+            int x = vector ? hlsToRgbRowSse2(h + row, l + row, s + row, out, width) : 0;
+            for (; x < width; x++) hlsToRgb(h[row + x], l[row + x], s[row + x], out[3 * x + 2], out[3 * x + 1], out[3 * x]);
+            memset(out + 3 * width, 0, lineSize - 3 * width);
+        }
+    });
+}
+
+void ImageOps::hsvToRgb(const float* h, const float* s, const float* v, int width, int height, unsigned char* bgr) {
+    PROFILE_SCOPE("ImageOps::hsvToRgb");
+    int lineSize = stride(width);
+    bool vector = activeSimd != SIMD_NONE;
+    forRows(width, height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            unsigned char* out = bgr + (size_t)y * lineSize;
+            size_t row = (size_t)y * width;
+            int x = vector ? hsvToRgbRowSse2(h + row, s + row, v + row, out, width) : 0;
+            for (; x < width; x++) hsvToRgb(h[row + x], s[row + x], v[row + x], out[3 * x + 2], out[3 * x + 1], out[3 * x]);
+            memset(out + 3 * width, 0, lineSize - 3 * width);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Histogramas: cada faixa conta no proprio histograma, somados no fim
+
+void ImageOps::histogram(const unsigned char* bgr, int width, int height, Histogram& out) {
+    PROFILE_SCOPE("ImageOps::histogram");
+    int lineSize = stride(width);
+    size_t minRows = (size_t)std::max(1, MIN_PIXELS_PER_TASK / std::max(width, 1));
+    size_t bands = std::min((size_t)ThreadPool::shared().getThreadCount() * 4, (height + minRows - 1) / minRows);
+    bands = std::max(bands, (size_t)1);
+    std::vector<Histogram> partial(bands);
+    memset(partial.data(), 0, bands * sizeof(Histogram));
+
+    ThreadPool::shared().parallelFor(bands, [&](size_t first, size_t last) {
+        for (size_t band = first; band < last; band++) {
+            Histogram& hist = partial[band];
+            int y0 = (int)(height * band / bands), y1 = (int)(height * (band + 1) / bands);
+            for (int y = y0; y < y1; y++) {
+                const unsigned char* p = bgr + (size_t)y * lineSize;
+                for (int x = 0; x < width; x++, p += 3) {
+                    hist.blue[p[0]]++;
+                    hist.green[p[1]]++;
+                    hist.red[p[2]]++;
+                    hist.luminance[luminance(p[2], p[1], p[0])]++;
+                }
+            }
+        }
+    });
+
+    memset(&out, 0, sizeof(out));
+    for (size_t band = 0; band < bands; band++) {
+        for (int i = 0; i < 256; i++) {
+            out.blue[i] += partial[band].blue[i];
+            out.green[i] += partial[band].green[i];
+            out.red[i] += partial[band].red[i];
+            out.luminance[i] += partial[band].luminance[i];
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef IMAGEOPS_H
+#define IMAGEOPS_H
+
+#include <stddef.h>
+
+// Processamento de imagens no layout de Bmp::getImage(): 24 bits BGR (antes
+// de convertBGRtoRGB), linhas de baixo para cima alinhadas em 4 bytes
+// (stride()). Saidas de um canal (luminancia, planos H/L/S) tem linhas sem
+// preenchimento, na mesma ordem das linhas da imagem.
+//
+// Mesmas formulas do notebook Exercicios_de_aula/Luminancia (1).ipynb:
+//
+// - luminancia Y = 0.299R + 0.587G + 0.114B truncada para 8 bits, em ponto
+//   fixo com pesos de 16 bits que somam 65536 (cinza continua exato). Difere
+//   do numpy por +-1 nivel em ~0.06% das cores, nos dois sentidos: os pesos
+//   arredondados puxam alguns valores para baixo e o double do notebook deixa
+//   outros um pouco abaixo de um inteiro (p.ex. 65 cinzas viram v - 1 la');
+// - rgb_to_hls / hls_to_rgb com h, l, s em [0, 1]; HSV com as mesmas
+//   convencoes. A volta para 8 bits arredonda (o notebook trunca com int(),
+//   o que perde um nivel numa ida e volta).
+//
+// Luminancia usa AVX2 (16 pixels por iteracao) quando a CPU tem, senao SSE2
+// (8 pixels); as conversoes de cor usam SSE2 (4 pixels); histogramas sao
+// escalares. Tudo roda em faixas de linhas no ThreadPool::shared().
+class ImageOps {
+public:
+    enum Simd { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 };
+
+    struct Histogram {
+        unsigned int blue[256], green[256], red[256];
+        unsigned int luminance[256];
+    };
+
+    // Bytes por linha no layout de Bmp
+    static int stride(int width) { return (3 * width + 3) / 4 * 4; }
+
+    // Caminho vetorial em uso; o padrao e' o melhor que a CPU suporta.
+    // setSimd() limita (para comparar nos benchmarks)
+    static Simd getSimd();
+    static void setSimd(Simd simd);
+
+    // gray: width * height bytes
+    static void luminance(const unsigned char* bgr, int width, int height, unsigned char* gray);
+
+    // h, l, s (ou h, s, v): planos de width * height floats em [0, 1]
+    static void rgbToHls(const unsigned char* bgr, int width, int height, float* h, float* l, float* s);
+    static void hlsToRgb(const float* h, const float* l, const float* s, int width, int height, unsigned char* bgr);
+    static void rgbToHsv(const unsigned char* bgr, int width, int height, float* h, float* s, float* v);
+    static void hsvToRgb(const float* h, const float* s, const float* v, int width, int height, unsigned char* bgr);
+
+    static void histogram(const unsigned char* bgr, int width, int height, Histogram& out);
+
+    // Versoes de um pixel, iguais as funcoes do notebook (referencia e bordas)
+    static unsigned char luminance(unsigned char r, unsigned char g, unsigned char b);
+    static void rgbToHls(unsigned char r, unsigned char g, unsigned char b, float& h, float& l, float& s);
+    static void hlsToRgb(float h, float l, float s, unsigned char& r, unsigned char& g, unsigned char& b);
+    static void rgbToHsv(unsigned char r, unsigned char g, unsigned char b, float& h, float& s, float& v);
+    static void hsvToRgb(float h, float s, float v, unsigned char& r, unsigned char& g, unsigned char& b);
+};
+
+#endif
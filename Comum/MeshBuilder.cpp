@@ -0,0 +1,276 @@
+#include "MeshBuilder.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+MeshBuilder::MeshBuilder(int floatsPerVertex) : stride(floatsPerVertex), buckets(1024, 0) {}
+
+// FNV-1a sobre os bytes do vertice
+unsigned long long MeshBuilder::hashVertex(const float* vertex) const {
+    const unsigned char* bytes = (const unsigned char*)vertex;
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < stride * sizeof(float); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Mantem a ocupacao da tabela abaixo de 50%
+void MeshBuilder::growTable() {
+    std::vector<unsigned int> old;
+    old.swap(buckets);
+    buckets.assign(old.size() * 2, 0);
+    size_t mask = buckets.size() - 1;
+    for (unsigned int slot : old) {
+        if (slot == 0) continue;
+        size_t i = (size_t)hashVertex(&vertices[(size_t)(slot - 1) * stride]) & mask;
+        while (buckets[i] != 0) i = (i + 1) & mask;
+        buckets[i] = slot;
+    }
+}
+
+unsigned int MeshBuilder::addVertex(const float* vertex) {
+    size_t mask = buckets.size() - 1;
+    size_t i = (size_t)hashVertex(vertex) & mask;
+    while (buckets[i] != 0) {
+        const float* other = &vertices[(size_t)(buckets[i] - 1) * stride];
+        if (memcmp(other, vertex, stride * sizeof(float)) == 0) return buckets[i] - 1;
+        i = (i + 1) & mask;
+    }
+
+    unsigned int index = (unsigned int)getVertexCount();
+    vertices.insert(vertices.end(), vertex, vertex + stride);
+    buckets[i] = index + 1;
+    if ((size_t)(index + 1) * 2 > buckets.size()) growTable();
+    return index;
+}
+
+void MeshBuilder::addTriangle(const float* a, const float* b, const float* c) {
+    indices.push_back(addVertex(a));
+    indices.push_back(addVertex(b));
+    indices.push_back(addVertex(c));
+}
+
+void MeshBuilder::addMesh(const std::vector<float>& source, const std::vector<unsigned int>& sourceIndices) {
+    size_t count = source.size() / stride;
+    std::vector<unsigned int> remap(count);
+    for (size_t i = 0; i < count; i++) {
+        remap[i] = addVertex(&source[i * stride]);
+    }
+
+    if (sourceIndices.empty()) {
+        indices.insert(indices.end(), remap.begin(), remap.end());
+    }
+    else {
+        indices.reserve(indices.size() + sourceIndices.size());
+        for (unsigned int index : sourceIndices) indices.push_back(remap[index]);
+    }
+}
+
+void MeshBuilder::optimize() {
+    optimizeVertexCache();
+    optimizeVertexFetch();
+}
+
+void MeshBuilder::optimizeVertexCache() {
+    optimizeVertexCache(indices, getVertexCount());
+}
+
+// Renumera os vertices na ordem em que o index buffer os usa pela primeira
+// vez; vertices nao referenciados sao descartados
+void MeshBuilder::optimizeVertexFetch() {
+    const unsigned int unused = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(getVertexCount(), unused);
+    std::vector<float> reordered;
+    reordered.reserve(vertices.size());
+
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+            reordered.insert(reordered.end(), &vertices[(size_t)index * stride], &vertices[(size_t)index * stride] + stride);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+
+    // a tabela de deduplicacao aponta para os indices antigos
+    buckets.assign(buckets.size(), 0);
+    size_t mask = buckets.size() - 1;
+    for (unsigned int v = 0; v < next; v++) {
+        size_t i = (size_t)hashVertex(&vertices[(size_t)v * stride]) & mask;
+        while (buckets[i] != 0) i = (i + 1) & mask;
+        buckets[i] = v + 1;
+    }
+}
+
+MeshBuilder::CacheStats MeshBuilder::analyze(int cacheSize) const {
+    return analyze(indices, getVertexCount(), cacheSize);
+}
+
+// Simula um cache pos-transformacao FIFO, como o das GPUs
+MeshBuilder::CacheStats MeshBuilder::analyze(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize) {
+    CacheStats stats = { indices.size() / 3, 0, 0, 0.0, 0.0 };
+    std::vector<int> insertedAt(vertexCount, -1);   // "tempo" em que o vertice entrou no cache
+    std::vector<char> seen(vertexCount, 0);
+    int time = 0;
+
+    for (unsigned int index : indices) {
+        if (!seen[index]) {
+            seen[index] = 1;
+            stats.vertices++;
+        }
+        if (insertedAt[index] < 0 || time - insertedAt[index] >= cacheSize) {
+            insertedAt[index] = time++;
+            stats.transformed++;
+        }
+    }
+
+    stats.acmr = stats.triangles ? (double)stats.transformed / stats.triangles : 0.0;
+    stats.atvr = stats.vertices ? (double)stats.transformed / stats.vertices : 0.0;
+    return stats;
+}
+
+std::string MeshBuilder::report(const char* name, const CacheStats& before, const CacheStats& after) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s: %d triangulos, %d vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+             name, (int)after.triangles, (int)after.vertices, before.acmr, after.acmr, before.atvr, after.atvr);
+    return line;
+}
+
+// Parametros do artigo do Forsyth
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const int MAX_VALENCE = 32;
+
+// Tabelas com as parcelas da pontuacao, para nao chamar powf no laco principal
+struct ScoreTables {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[MAX_VALENCE + 1];
+
+    ScoreTables() {
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            // os vertices do ultimo triangulo tem pontuacao fixa, para nao
+            // favorecer a mesma orientacao sempre
+            if (i < 3) cache[i] = LAST_TRIANGLE_SCORE;
+            else cache[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        // vertices com poucos triangulos restantes sao resolvidos antes, para nao virarem orfaos
+        valence[0] = 0.0f;
+        for (int i = 1; i <= MAX_VALENCE; i++) valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+    }
+};
+
+static float vertexScore(const ScoreTables& tables, int cachePosition, int remainingTriangles) {
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+    if (remainingTriangles <= MAX_VALENCE) score += tables.valence[remainingTriangles];
+    else score += VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void MeshBuilder::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // adjacencia vertice -> triangulos em formato compacto (offsets + lista)
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int index : indices) offsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    static const ScoreTables tables;
+    std::vector<int> remaining(vertexCount), cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        remaining[v] = (int)(offsets[v + 1] - offsets[v]);
+        score[v] = vertexScore(tables, -1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    int cache[FORSYTH_CACHE_SIZE + 3], cacheCount = 0;
+    int scan = 0;   // proximo triangulo para a busca linear quando o cache nao tem candidatos
+
+    // primeiro triangulo: o de maior pontuacao
+    int best = 0;
+    for (size_t t = 1; t < triangleCount; t++) {
+        if (triangleScore[t] > triangleScore[best]) best = (int)t;
+    }
+
+    while (best >= 0) {
+        emitted[best] = 1;
+        int newCache[FORSYTH_CACHE_SIZE + 3], newCount = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[best * 3 + k];
+            output.push_back(v);
+            newCache[newCount++] = (int)v;
+
+            // tira o triangulo da lista de pendentes do vertice
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            for (unsigned int* it = begin; it != end; ++it) {
+                if (*it == (unsigned int)best) {
+                    *it = *(end - 1);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // LRU: o triangulo emitido vai para a frente, o resto desloca
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) newCache[newCount++] = v;
+        }
+        for (int i = FORSYTH_CACHE_SIZE; i < newCount; i++) cachePosition[newCache[i]] = -1;
+        cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+
+        // atualiza as pontuacoes dos vertices do cache (e dos que acabaram de sair)
+        for (int i = 0; i < newCount; i++) {
+            int v = newCache[i];
+            if (i < FORSYTH_CACHE_SIZE) cachePosition[v] = i;
+            float updated = vertexScore(tables, cachePosition[v], remaining[v]);
+            float delta = updated - score[v];
+            score[v] = updated;
+            for (int a = 0; a < remaining[v]; a++) triangleScore[adjacency[offsets[v] + a]] += delta;
+        }
+        memcpy(cache, newCache, cacheCount * sizeof(int));
+
+        // proximo: melhor triangulo pendente que toca o cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            for (int a = 0; a < remaining[v]; a++) {
+                unsigned int t = adjacency[offsets[v] + a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+        if (best < 0) {
+            while (scan < (int)triangleCount && emitted[scan]) scan++;
+            if (scan < (int)triangleCount) best = scan;
+        }
+    }
+
+    indices.swap(output);
+}
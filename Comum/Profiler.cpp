@@ -0,0 +1,276 @@
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+static const char* overlayVertexSource = R"(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+})";
+
+static const char* overlayFragmentSource = R"(
+#version 330 core
+uniform vec3 color;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(color, 1.0);
+})";
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : origin(Clock::now()), current(), last(), frameStart(origin), frame(0), lastCpu(0.0), lastGpu(0.0),
+      gpuReady(false), gpuOffsetNs(0), overlay(false), overlayProgram(0), overlayVao(0), overlayVbo(0)
+{
+    for (int i = 0; i < GPU_SETS; i++) {
+        gpuSets[i].count = 0;
+        gpuSets[i].frame = -1;
+    }
+    for (int i = 0; i < HISTORY; i++) {
+        cpuHistory[i] = gpuHistory[i] = 0.0f;
+    }
+}
+
+double Profiler::toUs(Clock::time_point t) const {
+    return std::chrono::duration<double, std::micro>(t - origin).count();
+}
+
+// Indice pequeno e estavel por thread, usado como "tid" no trace (chamado com o mutex travado)
+int Profiler::threadIndex() {
+    std::thread::id id = std::this_thread::get_id();
+    for (size_t i = 0; i < threads.size(); i++) {
+        if (threads[i] == id) return (int)i + 1;
+    }
+    threads.push_back(id);
+    return (int)threads.size();
+}
+
+void Profiler::addCpuEvent(const char* name, Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.size() >= MAX_EVENTS) return;
+    Event e = { name, toUs(start), std::chrono::duration<double, std::micro>(end - start).count(), threadIndex() };
+    events.push_back(e);
+}
+
+void Profiler::initGpu() {
+    for (int i = 0; i < GPU_SETS; i++) {
+        glGenQueries(GPU_SCOPES * 2, gpuSets[i].queries);
+    }
+
+    // Alinha o relogio da GPU com o da CPU uma vez; a deriva em uma sessao e' desprezivel
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    long long cpuNow = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+    gpuOffsetNs = cpuNow - (long long)gpuNow;
+    gpuReady = true;
+}
+
+void Profiler::collectGpu(GpuSet& set) {
+    // Com um quadro inteiro de folga o resultado normalmente ja' esta' pronto;
+    // se nao estiver, descarta o quadro em vez de esperar a GPU. Basta olhar o
+    // fim do escopo do quadro (queries[1]): endFrame() o emite por ultimo, depois
+    // de todos os escopos aninhados
+    GLint available = 0;
+    glGetQueryObjectiv(set.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        set.count = 0;
+        return;
+    }
+
+    GLuint64 first = 0, lastEnd = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < set.count; i++) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(set.queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(set.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        if (i == 0 || begin < first) first = begin;
+        if (end > lastEnd) lastEnd = end;
+
+        if (events.size() < MAX_EVENTS) {
+            Event e = { set.names[i], ((long long)begin + gpuOffsetNs) / 1000.0, (end - begin) / 1000.0, 0 };
+            events.push_back(e);
+        }
+    }
+    lastGpu = (lastEnd - first) / 1.0e6;
+    gpuHistory[set.frame % HISTORY] = (float)lastGpu;
+    set.count = 0;
+}
+
+void Profiler::beginFrame() {
+    if (!gpuReady && GLEW_VERSION_3_3) initGpu();
+
+    frame++;
+    if (gpuReady) {
+        GpuSet& set = gpuSets[frame % GPU_SETS];
+        if (set.count > 0) collectGpu(set);
+        set.frame = frame;
+    }
+
+    current = Counters();
+    frameStart = Clock::now();
+    beginGpu("Quadro");
+}
+
+void Profiler::endFrame() {
+    endGpu(0);
+
+    Clock::time_point now = Clock::now();
+    addCpuEvent("Quadro", frameStart, now);
+    lastCpu = std::chrono::duration<double, std::milli>(now - frameStart).count();
+    cpuHistory[frame % HISTORY] = (float)lastCpu;
+    last = current;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    FrameRecord record = { toUs(now), current };
+    frames.push_back(record);
+}
+
+int Profiler::beginGpu(const char* name) {
+    if (!gpuReady) return -1;
+    GpuSet& set = gpuSets[frame % GPU_SETS];
+    if (set.count >= GPU_SCOPES) return -1;
+    int scope = set.count++;
+    set.names[scope] = name;
+    glQueryCounter(set.queries[scope * 2], GL_TIMESTAMP);
+    return scope;
+}
+
+void Profiler::endGpu(int scope) {
+    if (scope < 0 || !gpuReady) return;
+    glQueryCounter(gpuSets[frame % GPU_SETS].queries[scope * 2 + 1], GL_TIMESTAMP);
+}
+
+bool Profiler::writeTrace(const std::string& path) {
+    FILE* fp = NULL;
+    fopen_s(&fp, path.c_str(), "w");
+    if (fp == NULL) {
+        std::cerr << "Erro ao criar " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+    for (size_t i = 0; i < threads.size(); i++) {
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}}",
+                (int)i + 1, (int)i);
+    }
+    // os nomes sao literais do codigo, sem aspas ou barras para escapar
+    for (const Event& e : events) {
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                e.name, e.thread, e.startUs, e.durationUs);
+    }
+    for (const FrameRecord& f : frames) {
+        fprintf(fp, ",\n{\"name\":\"contadores\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{"
+                    "\"draw_calls\":%d,\"triangles\":%lld,\"upload_bytes\":%lld,\"state_changes\":%d}}",
+                f.timeUs, f.counters.drawCalls, f.counters.triangles, f.counters.uploadBytes, f.counters.stateChanges);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    std::cerr << "Profiler: " << events.size() << " eventos, " << frames.size() << " quadros -> " << path << std::endl;
+    return true;
+}
+
+void Profiler::initOverlay() {
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &overlayVertexSource, NULL);
+    glCompileShader(vertexShader);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &overlayFragmentSource, NULL);
+    glCompileShader(fragmentShader);
+
+    overlayProgram = glCreateProgram();
+    glAttachShader(overlayProgram, vertexShader);
+    glAttachShader(overlayProgram, fragmentShader);
+    glLinkProgram(overlayProgram);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    glGenVertexArrays(1, &overlayVao);
+    glGenBuffers(1, &overlayVbo);
+    glBindVertexArray(overlayVao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlayVbo);
+    glBufferData(GL_ARRAY_BUFFER, HISTORY * 2 * sizeof(float), NULL, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+}
+
+void Profiler::drawOverlay(GLFWwindow* window, int width, int height) {
+    if (!overlay) return;
+
+    if (window != NULL && frame % 30 == 0) {
+        char title[160];
+        snprintf(title, sizeof(title), "CPU %.2f ms | GPU %.2f ms | %d draws | %lld tris | %lld KB | %d estados",
+                 lastCpu, lastGpu, last.drawCalls, last.triangles, last.uploadBytes / 1024, last.stateChanges);
+        glfwSetWindowTitle(window, title);
+    }
+
+    // preserva o estado do demo; o overlay nao entra nos contadores
+    GLint program, vao, viewport[4];
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+    if (overlayProgram == 0) initOverlay();
+
+    // grafico de 0 a 33.3 ms no canto inferior esquerdo
+    int graphW = std::min(width / 3, 360), graphH = std::min(height / 5, 120);
+    glViewport(8, 8, graphW, graphH);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(overlayProgram);
+    glBindVertexArray(overlayVao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlayVbo);
+    GLint colorLoc = glGetUniformLocation(overlayProgram, "color");
+
+    const float* series[2] = { cpuHistory, gpuHistory };
+    const float colors[2][3] = { { 0.2f, 1.0f, 0.2f }, { 1.0f, 0.3f, 0.2f } };
+    float points[HISTORY * 2];
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < HISTORY; i++) {
+            float ms = series[s][(frame + 1 + i) % HISTORY];
+            points[i * 2] = -1.0f + 2.0f * i / (HISTORY - 1);
+            points[i * 2 + 1] = -1.0f + 2.0f * std::min(ms / 33.3f, 1.0f);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(points), points);
+        glUniform3fv(colorLoc, 1, colors[s]);
+        glDrawArrays(GL_LINE_STRIP, 0, HISTORY);
+    }
+
+    float budget[4] = { -1.0f, 0.0f, 1.0f, 0.0f };   // 16.6 ms
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(budget), budget);
+    glUniform3f(colorLoc, 1.0f, 1.0f, 0.3f);
+    glDrawArrays(GL_LINES, 0, 2);
+
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+}
+
+void Profiler::shutdown() {
+    if (gpuReady) {
+        for (int i = 0; i < GPU_SETS; i++) {
+            glDeleteQueries(GPU_SCOPES * 2, gpuSets[i].queries);
+            gpuSets[i].count = 0;
+        }
+        gpuReady = false;
+    }
+    if (overlayProgram != 0) {
+        glDeleteProgram(overlayProgram);
+        glDeleteVertexArrays(1, &overlayVao);
+        glDeleteBuffers(1, &overlayVbo);
+        overlayProgram = 0;
+    }
+}
+
+#endif
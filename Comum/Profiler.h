@@ -0,0 +1,176 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Instrumentacao de quadros: escopos de CPU (RAII), escopos de GPU com queries
+// GL_TIMESTAMP, contadores por quadro e exportacao no formato de trace do
+// Chrome (chrome://tracing ou ui.perfetto.dev).
+//
+// So' existe quando compilado com ENABLE_PROFILER; sem ele todas as macros
+// abaixo viram nada e Profiler.cpp fica vazio.
+//
+//   void Terrain::render(...) {
+//       PROFILE_SCOPE("Terrain::render");
+//       PROFILE_GPU_SCOPE("Terrain::render");
+//       ...
+//       glDrawElements(...);
+//       PROFILE_DRAW(indexCount / 3);
+//   }
+//
+// O Headless ja' marca inicio e fim de cada quadro, grava o trace com
+// "--trace arquivo.json" e desenha o overlay com "--overlay".
+
+#ifdef ENABLE_PROFILER
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Profiler {
+public:
+    struct Counters {
+        int drawCalls;
+        long long triangles;
+        long long uploadBytes;
+        int stateChanges;
+    };
+
+    static Profiler& instance();
+
+    // Inicio do quadro: le as queries de GPU de dois quadros atras, que ja'
+    // terminaram, sem travar o pipeline
+    void beginFrame();
+    void endFrame();
+
+    void addCpuEvent(const char* name, std::chrono::high_resolution_clock::time_point start,
+                     std::chrono::high_resolution_clock::time_point end);
+
+    // Par de glQueryCounter(GL_TIMESTAMP); retorna -1 se o quadro ja' usou todas as queries
+    int beginGpu(const char* name);
+    void endGpu(int scope);
+
+    void countDraw(long long triangles) { current.drawCalls++; current.triangles += triangles; }
+    void countUpload(long long bytes) { current.uploadBytes += bytes; }
+    void countStateChange(int n) { current.stateChanges += n; }
+
+    const Counters& lastFrame() const { return last; }
+    double lastCpuMs() const { return lastCpu; }
+    double lastGpuMs() const { return lastGpu; }
+
+    bool writeTrace(const std::string& path);
+
+    // Grafico dos ultimos quadros (CPU em verde, GPU em vermelho, linha de
+    // 16.6 ms) no canto da tela; com janela tambem mostra os contadores no titulo
+    void setOverlay(bool enabled) { overlay = enabled; }
+    void drawOverlay(GLFWwindow* window, int width, int height);
+
+    void shutdown();
+
+private:
+    static const int GPU_SCOPES = 64;     // por quadro
+    static const int GPU_SETS = 2;        // double-buffer
+    static const int HISTORY = 120;       // quadros no grafico
+    static const size_t MAX_EVENTS = 1 << 20;
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Event {
+        const char* name;
+        double startUs, durationUs;
+        int thread;
+    };
+
+    struct FrameRecord {
+        double timeUs;
+        Counters counters;
+    };
+
+    struct GpuSet {
+        GLuint queries[GPU_SCOPES * 2];
+        const char* names[GPU_SCOPES];
+        int count;
+        int frame;
+    };
+
+    Profiler();
+
+    std::mutex mutex;
+    Clock::time_point origin;
+    std::vector<Event> events;
+    std::vector<FrameRecord> frames;
+    std::vector<std::thread::id> threads;
+
+    Counters current, last;
+    Clock::time_point frameStart;
+    int frame;
+    double lastCpu, lastGpu;
+
+    bool gpuReady;
+    long long gpuOffsetNs;   // relogio da GPU -> relogio da CPU (origin)
+    GpuSet gpuSets[GPU_SETS];
+
+    bool overlay;
+    GLuint overlayProgram, overlayVao, overlayVbo;
+    float cpuHistory[HISTORY], gpuHistory[HISTORY];
+
+    double toUs(Clock::time_point t) const;
+    int threadIndex();
+    void initGpu();
+    void collectGpu(GpuSet& set);
+    void initOverlay();
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(std::chrono::high_resolution_clock::now()) {}
+    ~ProfileScope() { Profiler::instance().addCpuEvent(name, start, std::chrono::high_resolution_clock::now()); }
+
+private:
+    const char* name;
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : scope(Profiler::instance().beginGpu(name)) {}
+    ~GpuProfileScope() { Profiler::instance().endGpu(scope); }
+
+private:
+    int scope;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_DRAW(triangles) Profiler::instance().countDraw(triangles)
+#define PROFILE_UPLOAD(bytes) Profiler::instance().countUpload(bytes)
+#define PROFILE_STATE_CHANGE(n) Profiler::instance().countStateChange(n)
+#define PROFILE_BEGIN_FRAME() Profiler::instance().beginFrame()
+#define PROFILE_END_FRAME() Profiler::instance().endFrame()
+#define PROFILE_OVERLAY(enabled) Profiler::instance().setOverlay(enabled)
+#define PROFILE_DRAW_OVERLAY(window, width, height) Profiler::instance().drawOverlay(window, width, height)
+#define PROFILE_WRITE_TRACE(path) Profiler::instance().writeTrace(path)
+#define PROFILE_SHUTDOWN() Profiler::instance().shutdown()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_DRAW(triangles) ((void)0)
+#define PROFILE_UPLOAD(bytes) ((void)0)
+#define PROFILE_STATE_CHANGE(n) ((void)0)
+#define PROFILE_BEGIN_FRAME() ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+#define PROFILE_OVERLAY(enabled) ((void)0)
+#define PROFILE_DRAW_OVERLAY(window, width, height) ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+#define PROFILE_SHUTDOWN() ((void)0)
+
+#endif
+
+#endif
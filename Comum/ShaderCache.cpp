@@ -0,0 +1,288 @@
+#include "ShaderCache.h"
+#include "GLState.h"
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+// Cabecalho dos arquivos de binario: "PGB1", formato, hash do driver, hash dos fontes, tamanho
+static const char BINARY_MAGIC[4] = { 'P', 'G', 'B', '1' };
+
+ShaderCache& ShaderCache::instance() {
+    static ShaderCache cache;
+    return cache;
+}
+
+ShaderCache::ShaderCache()
+    : binaryDirectory("shader_cache"), initialized(false), parallel(false), binaries(false),
+      driverHash(0), compiled(0), loadedFromBinary(0) {}
+
+void ShaderCache::setBinaryDirectory(const std::string& directory) {
+    binaryDirectory = directory;
+    initialized = false;
+}
+
+// FNV-1a de 64 bits
+unsigned long long ShaderCache::hashBytes(const void* data, size_t size, unsigned long long hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+const char* ShaderCache::stageName(GLenum type) {
+    switch (type) {
+    case GL_VERTEX_SHADER: return "VERTEX";
+    case GL_FRAGMENT_SHADER: return "FRAGMENT";
+    case GL_GEOMETRY_SHADER: return "GEOMETRY";
+    case GL_TESS_CONTROL_SHADER: return "TESS_CONTROL";
+    case GL_TESS_EVALUATION_SHADER: return "TESS_EVALUATION";
+    case GL_COMPUTE_SHADER: return "COMPUTE";
+    default: return "?";
+    }
+}
+
+// Precisa do contexto, por isso so' roda no primeiro pedido
+void ShaderCache::init() {
+    initialized = true;
+
+    parallel = GLEW_KHR_parallel_shader_compile != 0;
+    if (parallel) glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);   // o driver escolhe quantas threads
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binaries = formats > 0 && !binaryDirectory.empty();
+    if (binaries) makeDirectory(binaryDirectory.c_str());
+
+    // binarios so' valem para o mesmo driver; versao nova invalida todos
+    driverHash = 14695981039346656037ull;
+    const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (int i = 0; i < 3; i++) {
+        const char* s = (const char*)glGetString(names[i]);
+        if (s) driverHash = hashBytes(s, strlen(s) + 1, driverHash);
+    }
+}
+
+std::string ShaderCache::binaryPath(unsigned long long hash) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", hash);
+    return binaryDirectory + "/" + name;
+}
+
+ShaderCache::Entry* ShaderCache::find(GLuint program) {
+    std::map<GLuint, unsigned long long>::iterator it = byProgram.find(program);
+    return it == byProgram.end() ? NULL : &entries[it->second];
+}
+
+GLuint ShaderCache::request(const char* vertexSource, const char* fragmentSource) {
+    std::vector<Stage> stages(2);
+    stages[0].type = GL_VERTEX_SHADER;
+    stages[0].source = vertexSource;
+    stages[1].type = GL_FRAGMENT_SHADER;
+    stages[1].source = fragmentSource;
+    return request(stages);
+}
+
+GLuint ShaderCache::request(const std::vector<Stage>& stages) {
+    if (!initialized) init();
+
+    unsigned long long hash = 14695981039346656037ull;
+    for (const Stage& stage : stages) {
+        hash = hashBytes(&stage.type, sizeof(stage.type), hash);
+        hash = hashBytes(stage.source, strlen(stage.source) + 1, hash);
+    }
+
+    std::map<unsigned long long, Entry>::iterator it = entries.find(hash);
+    if (it != entries.end()) {
+        return it->second.state == FAILED ? 0 : it->second.program;
+    }
+
+    Entry& entry = entries[hash];
+    entry.hash = hash;
+    entry.program = glCreateProgram();
+    entry.state = PENDING;
+    byProgram[entry.program] = hash;
+
+    if (binaries) {
+        glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        if (loadBinary(entry)) {
+            entry.state = READY;
+            entry.reflection.reflect(entry.program);
+            loadedFromBinary++;
+            return entry.program;
+        }
+    }
+
+    // Sem consultar status aqui: com KHR_parallel_shader_compile a consulta
+    // bloquearia ate' o fim da compilacao e tiraria o paralelismo
+    for (const Stage& stage : stages) {
+        GLuint shader = glCreateShader(stage.type);
+        glShaderSource(shader, 1, &stage.source, NULL);
+        glCompileShader(shader);
+        glAttachShader(entry.program, shader);
+        entry.shaders.push_back(shader);
+        entry.types.push_back(stage.type);
+    }
+    glLinkProgram(entry.program);
+    compiled++;
+    return entry.program;
+}
+
+GLuint ShaderCache::program(const char* vertexSource, const char* fragmentSource) {
+    GLuint p = request(vertexSource, fragmentSource);
+    Entry* entry = find(p);
+    return entry != NULL && complete(*entry) ? p : 0;
+}
+
+GLuint ShaderCache::program(const std::vector<Stage>& stages) {
+    GLuint p = request(stages);
+    Entry* entry = find(p);
+    return entry != NULL && complete(*entry) ? p : 0;
+}
+
+bool ShaderCache::ready(GLuint program) {
+    Entry* entry = find(program);
+    if (entry == NULL) return false;
+    if (entry->state != PENDING) return true;
+
+    if (parallel) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done) return false;
+    }
+    complete(*entry);
+    return true;
+}
+
+bool ShaderCache::finish() {
+    bool ok = true;
+    for (std::map<unsigned long long, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        if (!complete(it->second)) ok = false;
+    }
+    return ok;
+}
+
+ShaderReflection& ShaderCache::reflection(GLuint program) {
+    // programa desconhecido ou com erro: reflexao vazia, limpa a cada chamada
+    static ShaderReflection empty;
+    Entry* entry = find(program);
+    if (entry == NULL || !complete(*entry)) {
+        empty = ShaderReflection();
+        return empty;
+    }
+    return entry->reflection;
+}
+
+// Verifica os logs de um programa pendente, libera os shaders e grava o binario
+bool ShaderCache::complete(Entry& entry) {
+    if (entry.state != PENDING) return entry.state == READY;
+
+    GLint success = GL_FALSE;
+    GLchar infoLog[1024];
+    for (size_t i = 0; i < entry.shaders.size(); i++) {
+        glGetShaderiv(entry.shaders[i], GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(entry.shaders[i], sizeof(infoLog), NULL, infoLog);
+            std::cerr << "Erro ao compilar shader " << stageName(entry.types[i]) << ":\n" << infoLog << std::endl;
+        }
+    }
+
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(entry.program, sizeof(infoLog), NULL, infoLog);
+        std::cerr << "Erro ao linkar programa:\n" << infoLog << std::endl;
+    }
+
+    for (GLuint shader : entry.shaders) {
+        glDetachShader(entry.program, shader);
+        glDeleteShader(shader);
+    }
+    entry.shaders.clear();
+    entry.types.clear();
+
+    if (!success) {
+        entry.state = FAILED;
+        return false;
+    }
+
+    entry.state = READY;
+    entry.reflection.reflect(entry.program);
+    if (binaries) saveBinary(entry);
+    return true;
+}
+
+bool ShaderCache::loadBinary(Entry& entry) {
+    FILE* fp = NULL;
+    fopen_s(&fp, binaryPath(entry.hash).c_str(), "rb");
+    if (fp == NULL) return false;
+
+    char magic[4];
+    GLenum format = 0;
+    unsigned long long fileDriver = 0, fileHash = 0;
+    unsigned int length = 0;
+    bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0 &&
+              fread(&format, sizeof(format), 1, fp) == 1 &&
+              fread(&fileDriver, sizeof(fileDriver), 1, fp) == 1 &&
+              fread(&fileHash, sizeof(fileHash), 1, fp) == 1 &&
+              fread(&length, sizeof(length), 1, fp) == 1 &&
+              fileDriver == driverHash && fileHash == entry.hash && length > 0;
+
+    std::vector<char> data;
+    if (ok) {
+        data.resize(length);
+        ok = fread(data.data(), 1, length, fp) == length;
+    }
+    fclose(fp);
+    if (!ok) return false;
+
+    // O driver pode recusar um binario antigo mesmo com a mesma versao;
+    // nesse caso o programa volta a estar vazio e e' compilado normalmente
+    glProgramBinary(entry.program, format, data.data(), (GLsizei)length);
+    GLint success = GL_FALSE;
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+    if (!success) {
+        std::cerr << "Binario de shader recusado pelo driver, recompilando " << binaryPath(entry.hash) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::saveBinary(const Entry& entry) {
+    GLint length = 0;
+    glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> data(length);
+    GLenum format = 0;
+    glGetProgramBinary(entry.program, length, NULL, &format, data.data());
+
+    FILE* fp = NULL;
+    fopen_s(&fp, binaryPath(entry.hash).c_str(), "wb");
+    if (fp == NULL) return;
+    unsigned int size = (unsigned int)length;
+    fwrite(BINARY_MAGIC, 1, 4, fp);
+    fwrite(&format, sizeof(format), 1, fp);
+    fwrite(&driverHash, sizeof(driverHash), 1, fp);
+    fwrite(&entry.hash, sizeof(entry.hash), 1, fp);
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(data.data(), 1, size, fp);
+    fclose(fp);
+}
+
+void ShaderCache::clear() {
+    for (std::map<unsigned long long, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        for (GLuint shader : it->second.shaders) glDeleteShader(shader);
+        GLState::current().deleteProgram(it->second.program);
+    }
+    entries.clear();
+    byProgram.clear();
+}
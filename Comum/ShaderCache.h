@@ -0,0 +1,93 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <GL/glew.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ShaderReflection.h"
+
+// Gerenciador de programas GLSL compartilhado pelos demos.
+//
+// - Programas com os mesmos fontes (mesmo hash) sao compilados uma unica vez.
+// - Com GL 4.1 / ARB_get_program_binary o programa linkado e' gravado em
+//   disco (padrao "shader_cache/") e carregado com glProgramBinary na proxima
+//   execucao; se o driver mudou ou rejeitar o binario, recompila e regrava.
+// - request() so' envia a compilacao; com GL_KHR_parallel_shader_compile o
+//   driver compila varios programas ao mesmo tempo em threads proprias, e os
+//   erros so' sao verificados em finish() (ou ao pedir o programa pronto).
+//
+//   ShaderCache& shaders = ShaderCache::instance();
+//   GLuint program = shaders.program(vertexSource, fragmentSource);
+//   GLint mvpLoc = shaders.reflection(program).uniform("mvp");
+class ShaderCache {
+public:
+    struct Stage {
+        GLenum type;          // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_TESS_*...
+        const char* source;
+    };
+
+    static ShaderCache& instance();
+
+    // Diretorio dos binarios; vazio desliga a persistencia
+    void setBinaryDirectory(const std::string& directory);
+
+    // Envia a compilacao e retorna o nome do programa, que pode ainda nao
+    // estar pronto. O mesmo conjunto de fontes sempre devolve o mesmo programa.
+    GLuint request(const std::vector<Stage>& stages);
+    GLuint request(const char* vertexSource, const char* fragmentSource);
+
+    // request() seguido da espera por esse programa; 0 se falhou
+    GLuint program(const std::vector<Stage>& stages);
+    GLuint program(const char* vertexSource, const char* fragmentSource);
+
+    // true quando o driver terminou de compilar/linkar. Sem bloquear quando o
+    // driver tem GL_KHR_parallel_shader_compile; senao espera a compilacao e o
+    // link ali mesmo (quem consulta a cada quadro pode ter um quadro lento)
+    bool ready(GLuint program);
+    // Espera todos os pedidos pendentes; false se algum falhou
+    bool finish();
+
+    // Localizacoes dos uniforms do programa (espera o programa ficar pronto).
+    // Nao const para setBlockBinding(): o binding fica no cache de todos que
+    // pedem o mesmo programa
+    ShaderReflection& reflection(GLuint program);
+
+    // Apaga todos os programas (antes de destruir o contexto)
+    void clear();
+
+    int getCompiled() const { return compiled; }
+    int getLoadedFromBinary() const { return loadedFromBinary; }
+
+private:
+    enum State { PENDING, READY, FAILED };
+
+    struct Entry {
+        GLuint program;
+        State state;
+        std::vector<GLuint> shaders;
+        std::vector<GLenum> types;
+        unsigned long long hash;
+        ShaderReflection reflection;
+    };
+
+    std::map<unsigned long long, Entry> entries;
+    std::map<GLuint, unsigned long long> byProgram;
+    std::string binaryDirectory;
+    bool initialized, parallel, binaries;
+    unsigned long long driverHash;
+    int compiled, loadedFromBinary;
+
+    ShaderCache();
+    void init();
+    Entry* find(GLuint program);
+    bool complete(Entry& entry);
+    bool loadBinary(Entry& entry);
+    void saveBinary(const Entry& entry);
+    std::string binaryPath(unsigned long long hash) const;
+
+    static unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash);
+    static const char* stageName(GLenum type);
+};
+
+#endif
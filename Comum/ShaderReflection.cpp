@@ -0,0 +1,68 @@
+#include "ShaderReflection.h"
+#include <vector>
+
+ShaderReflection::ShaderReflection() : program(0) {}
+
+ShaderReflection::ShaderReflection(GLuint p) : program(0) {
+    reflect(p);
+}
+
+void ShaderReflection::reflect(GLuint p) {
+    program = p;
+    uniforms.clear();
+    blocks.clear();
+    if (program == 0) return;
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+        // uniforms dentro de blocos nao tem localizacao
+        GLint location = glGetUniformLocation(program, name.data());
+        if (location < 0) continue;
+
+        std::string key = name.data();
+        size_t bracket = key.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == key.size()) {
+            uniforms[key.substr(0, bracket)] = location;
+        }
+        uniforms[key] = location;
+    }
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.assign(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; i++) {
+        glGetActiveUniformBlockName(program, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+        Block block;
+        block.index = (GLuint)i;
+        glGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+        blocks[name.data()] = block;
+    }
+}
+
+GLint ShaderReflection::uniform(const std::string& name) const {
+    std::map<std::string, GLint>::const_iterator it = uniforms.find(name);
+    return it == uniforms.end() ? -1 : it->second;
+}
+
+GLuint ShaderReflection::blockIndex(const std::string& name) const {
+    std::map<std::string, Block>::const_iterator it = blocks.find(name);
+    return it == blocks.end() ? GL_INVALID_INDEX : it->second.index;
+}
+
+GLint ShaderReflection::blockBinding(const std::string& name) const {
+    std::map<std::string, Block>::const_iterator it = blocks.find(name);
+    return it == blocks.end() ? -1 : it->second.binding;
+}
+
+void ShaderReflection::setBlockBinding(const std::string& name, GLuint binding) {
+    std::map<std::string, Block>::iterator it = blocks.find(name);
+    if (it == blocks.end()) return;
+    glUniformBlockBinding(program, it->second.index, binding);
+    it->second.binding = (GLint)binding;
+}
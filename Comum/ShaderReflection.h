@@ -0,0 +1,48 @@
+#ifndef SHADERREFLECTION_H
+#define SHADERREFLECTION_H
+
+#include <GL/glew.h>
+#include <map>
+#include <string>
+
+// Reflexao de um programa ja' linkado: le uma vez as localizacoes de todos
+// os uniforms ativos e os indices/bindings dos uniform blocks, para o laco de
+// render nao chamar glGetUniformLocation a cada quadro.
+//
+//   ShaderReflection reflection(program);
+//   GLint mvpLoc = reflection.uniform("mvp");
+//
+// Arrays aparecem pelo nome base ("luzes" e "luzes[0]" dao a mesma localizacao).
+class ShaderReflection {
+public:
+    ShaderReflection();
+    explicit ShaderReflection(GLuint program);
+
+    void reflect(GLuint program);
+
+    GLuint getProgram() const { return program; }
+
+    // -1 se o uniform nao existe ou foi eliminado pelo compilador
+    GLint uniform(const std::string& name) const;
+    // GL_INVALID_INDEX se o bloco nao existe
+    GLuint blockIndex(const std::string& name) const;
+    // Binding atual do bloco (o da declaracao layout(binding) ou o de glUniformBlockBinding), -1 se nao existe
+    GLint blockBinding(const std::string& name) const;
+    // Liga o bloco a um ponto de binding e atualiza o cache
+    void setBlockBinding(const std::string& name, GLuint binding);
+
+    int uniformCount() const { return (int)uniforms.size(); }
+    int blockCount() const { return (int)blocks.size(); }
+
+private:
+    struct Block {
+        GLuint index;
+        GLint binding;
+    };
+
+    GLuint program;
+    std::map<std::string, GLint> uniforms;
+    std::map<std::string, Block> blocks;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "SimulationLoop.h"
+#include <algorithm>
+#include "Profiler.h"
+
+SimulationLoop::SimulationLoop(double stepSeconds, const StepFunction& step, const CaptureFunction& capture)
+    : stepSeconds(stepSeconds), step(step), capture(capture), maxCatchUp(8),
+      back(0), ready(1), front(2), fresh(false), simulatedTime(0.0), syncTime(0.0),
+      started(false), running(false), steps(0), dropped(0) {}
+
+SimulationLoop::~SimulationLoop() {
+    stop();
+}
+
+double SimulationLoop::clock() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+}
+
+// Estado inicial em todos os buffers, para acquire() ter o que devolver antes do primeiro passo
+void SimulationLoop::publishInitial() {
+    started = true;
+    capture(buffers[0].current);
+    for (int i = 0; i < 3; i++) {
+        buffers[i].current = buffers[0].current;
+        buffers[i].previous = buffers[0].current;
+        buffers[i].time = 0.0;
+        buffers[i].step = 0;
+    }
+}
+
+void SimulationLoop::start() {
+    if (running) return;
+    if (!started) publishInitial();
+    origin = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(simulatedTime));
+    running = true;
+    thread = std::thread(&SimulationLoop::threadLoop, this);
+}
+
+void SimulationLoop::stop() {
+    if (!running) return;
+    running = false;
+    thread.join();
+}
+
+void SimulationLoop::advanceTo(double time) {
+    if (!started) publishInitial();
+    syncTime = time;
+    runSteps(time);
+}
+
+void SimulationLoop::threadLoop() {
+    while (running) {
+        runSteps(clock());
+        // dorme ate' o proximo passo vencer
+        std::chrono::steady_clock::time_point next = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(simulatedTime + stepSeconds));
+        std::this_thread::sleep_until(next);
+    }
+}
+
+// Roda os passos pendentes ate' now. Do lote so' o ultimo passo precisa do
+// estado anterior, entao sao duas capturas por lote e nao por passo.
+void SimulationLoop::runSteps(double now) {
+    int pending = (int)std::min((now - simulatedTime) / stepSeconds, 1e9);
+    if (pending <= 0) return;
+    if (pending > maxCatchUp) {
+        dropped += pending - maxCatchUp;
+        simulatedTime += (pending - maxCatchUp) * stepSeconds;
+        pending = maxCatchUp;
+    }
+
+    PROFILE_SCOPE("SimulationLoop::runSteps");
+    Snapshot& target = buffers[back];
+    for (int i = 0; i < pending; i++) {
+        if (i == pending - 1) capture(target.previous);
+        step(stepSeconds);
+        simulatedTime += stepSeconds;
+        steps++;
+    }
+    capture(target.current);
+    target.time = simulatedTime;
+    target.step = steps;
+    publish();
+}
+
+void SimulationLoop::publish() {
+    std::lock_guard<std::mutex> lock(swapMutex);
+    std::swap(back, ready);
+    fresh = true;
+}
+
+const SimulationLoop::Snapshot& SimulationLoop::acquire(float& alpha) {
+    {
+        std::lock_guard<std::mutex> lock(swapMutex);
+        if (fresh) {
+            std::swap(front, ready);
+            fresh = false;
+        }
+    }
+
+    // current vale em snapshot.time; o desenho mostra o instante now - stepSeconds
+    const Snapshot& snapshot = buffers[front];
+    double now = running ? clock() : syncTime;
+    alpha = (float)std::min(std::max((now - snapshot.time) / stepSeconds, 0.0), 1.0);
+    return snapshot;
+}
+
+void SimulationLoop::interpolate(const Snapshot& snapshot, float alpha, std::vector<float>& out) {
+    size_t n = std::min(snapshot.previous.size(), snapshot.current.size());
+    out.resize(n);
+    const float* a = snapshot.previous.data();
+    const float* b = snapshot.current.data();
+    for (size_t i = 0; i < n; i++) out[i] = a[i] + (b[i] - a[i]) * alpha;
+}
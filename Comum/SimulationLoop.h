@@ -0,0 +1,85 @@
+#ifndef SIMULATIONLOOP_H
+#define SIMULATIONLOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Simulacao com passo fixo, independente da taxa de quadros.
+//
+// Um acumulador de tempo decide quantos passos de stepSeconds rodar; o
+// estado (um vetor de floats escolhido por quem usa, p.ex. posicoes) e'
+// publicado num buffer triplo com o estado anterior e o atual, e quem
+// desenha interpola entre os dois com alpha = fracao do passo ja' decorrida.
+// O desenho fica um passo atras da simulacao, sem saltos.
+//
+// Dois modos:
+// - start(): a simulacao roda numa thread propria com relogio real; um
+//   quadro lento nao atrasa a simulacao e vice-versa. Publicar e adquirir
+//   so' trocam indices dos buffers sob o mutex;
+// - advanceTo(t): sem thread, roda na chamadora os passos ate' t. Usado no
+//   modo headless, onde o tempo vem do numero do quadro e o resultado tem
+//   que ser deterministico.
+class SimulationLoop {
+public:
+    struct Snapshot {
+        std::vector<float> previous, current;
+        double time;       // tempo simulado de current
+        long long step;
+    };
+
+    typedef std::function<void(double dt)> StepFunction;
+    typedef std::function<void(std::vector<float>& state)> CaptureFunction;
+
+    SimulationLoop(double stepSeconds, const StepFunction& step, const CaptureFunction& capture);
+    ~SimulationLoop();
+
+    void start();
+    void stop();
+    void advanceTo(double time);
+
+    // Estado mais recente para desenhar; alpha em [0, 1]
+    const Snapshot& acquire(float& alpha);
+    // out = previous + (current - previous) * alpha
+    static void interpolate(const Snapshot& snapshot, float alpha, std::vector<float>& out);
+
+    // Se a simulacao atrasar mais que isso (em passos), o atraso e' descartado
+    // em vez de acumular (evita a "espiral da morte")
+    void setMaxCatchUp(int steps) { maxCatchUp = steps; }
+
+    double getStepSeconds() const { return stepSeconds; }
+    long long getSteps() const { return steps.load(); }
+    long long getDroppedSteps() const { return dropped.load(); }
+
+private:
+    double stepSeconds;
+    StepFunction step;
+    CaptureFunction capture;
+    int maxCatchUp;
+
+    Snapshot buffers[3];
+    int back, ready, front;     // back: simulacao escreve; front: quem desenha le
+    bool fresh;                 // ready tem um estado que front ainda nao viu
+    std::mutex swapMutex;
+
+    double simulatedTime, syncTime;
+    bool started;
+    std::atomic<bool> running;
+    std::atomic<long long> steps, dropped;
+    std::thread thread;
+    std::chrono::steady_clock::time_point origin;
+
+    double clock() const;
+    void publishInitial();
+    void runSteps(double now);
+    void publish();
+    void threadLoop();
+
+    SimulationLoop(const SimulationLoop&);
+    SimulationLoop& operator=(const SimulationLoop&);
+};
+
+#endif
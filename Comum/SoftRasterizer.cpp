@@ -0,0 +1,549 @@
+#include "SoftRasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "Bmp.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// Abaixo disso uma faixa de vertices ou de triangulos nao compensa acordar outra thread
+static const size_t MIN_VERTICES_PER_TASK = 4096;
+static const size_t MIN_TRIANGLES_PER_CHUNK = 2048;
+
+// Grade das posicoes na tela: 1/256 de pixel (8 bits, como nas GPUs). Com a
+// guard band as coordenadas ficam abaixo de 2^15 pixels, entao as diferencas
+// sao exatas em float e os produtos das funcoes de aresta sao exatos em double
+static const float SUBPIXELS = 256.0f;
+
+// Bits de pixels cobertos num grupo de 4
+static const int BIT_COUNT[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Planos do recorte, distancia >= 0 dentro
+enum ClipPlane { CLIP_NEAR, CLIP_RIGHT, CLIP_LEFT, CLIP_TOP, CLIP_BOTTOM, CLIP_PLANES };
+
+static inline float planeDistance(const float* c, int plane, float guardX, float guardY) {
+    switch (plane) {
+    case CLIP_NEAR: return c[2] + c[3];
+    case CLIP_RIGHT: return guardX * c[3] - c[0];
+    case CLIP_LEFT: return guardX * c[3] + c[0];
+    case CLIP_TOP: return guardY * c[3] - c[1];
+    default: return guardY * c[3] + c[1];
+    }
+}
+
+static inline float snap(float v) {
+    return floorf(v * SUBPIXELS + 0.5f) * (1.0f / SUBPIXELS);
+}
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// E > 0, ou E = 0 numa aresta que pertence ao triangulo (regra top-left)
+static inline __m128 inside(__m128 e, __m128 owner) {
+    const __m128 zero = _mm_setzero_ps();
+    return _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), owner));
+}
+
+static inline __m128 interpolate(float v, float d1, float d2, __m128 b1, __m128 b2) {
+    return _mm_add_ps(_mm_set1_ps(v), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(d1), b1), _mm_mul_ps(_mm_set1_ps(d2), b2)));
+}
+
+// [0, 1] -> 0..255 arredondado, como a conversao UNORM do GL; NaN vira 0
+static inline __m128i toBytes(__m128 v) {
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+static inline __m128i packColor(__m128 r, __m128 g, __m128 b) {
+    return _mm_or_si128(_mm_or_si128(toBytes(r), _mm_slli_epi32(toBytes(g), 8)),
+                        _mm_or_si128(_mm_slli_epi32(toBytes(b), 16), _mm_set1_epi32((int)0xFF000000)));
+}
+
+static inline __m128 floorPs(__m128 v) {
+    const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+
+// Texels inteiros (valores em float) de uma coordenada: GL_REPEAT ou GL_CLAMP_TO_EDGE
+static inline void wrapTexels(__m128 i, float size, bool repeat, __m128i& i0, __m128i& i1) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), last = _mm_set1_ps(size - 1.0f);
+    if (!repeat) {
+        i0 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(i, zero), last));
+        i1 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(i, one), zero), last));
+        return;
+    }
+    const __m128 n = _mm_set1_ps(size);
+    __m128 w = _mm_sub_ps(i, _mm_mul_ps(floorPs(_mm_mul_ps(i, _mm_set1_ps(1.0f / size))), n));
+    // o arredondamento de i / size pode deixar w um periodo fora de [0, size)
+    w = _mm_add_ps(w, _mm_and_ps(_mm_cmplt_ps(w, zero), n));
+    w = _mm_sub_ps(w, _mm_and_ps(_mm_cmpge_ps(w, n), n));
+    const __m128 next = _mm_add_ps(w, one);
+    i0 = _mm_cvttps_epi32(w);
+    i1 = _mm_cvttps_epi32(_mm_andnot_ps(_mm_cmpge_ps(next, n), next));
+}
+
+// a * (256 - f) + b * f, por canal de 4 pixels RGBX com pesos f em 0..256
+static inline __m128i lerpTexels(__m128i a, __m128i b, __m128i f) {
+    const __m128i zero = _mm_setzero_si128(), full = _mm_set1_epi16(256), half = _mm_set1_epi16(128);
+    // peso de cada pixel repetido nos seus 4 canais de 16 bits
+    const __m128i f16 = _mm_packs_epi32(f, f);
+    const __m128i pairs = _mm_unpacklo_epi16(f16, f16);
+    const __m128i fLo = _mm_unpacklo_epi32(pairs, pairs), fHi = _mm_unpackhi_epi32(pairs, pairs);
+    const __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_sub_epi16(full, fLo)),
+                                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), fLo)), half);
+    const __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_sub_epi16(full, fHi)),
+                                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), fHi)), half);
+    return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+static inline unsigned int texel(const unsigned char* row, int x) {
+    const unsigned char* p = row + x * 3;
+    return p[0] | p[1] << 8 | p[2] << 16;
+}
+
+// Filtro GL_LINEAR de 4 pixels: media dos 4 texels em volta de cada um (centros
+// em (i + 0.5) / tamanho), com pesos de 8 bits como nas GPUs. So' as leituras
+// dos texels sao escalares, e so' nos pixels de bits
+static __m128i sampleBilinear(const SoftRasterizer::Texture& texture, __m128 s, __m128 t, int bits) {
+    const __m128 limit = _mm_set1_ps(1e7f), half = _mm_set1_ps(0.5f), scale = _mm_set1_ps(256.0f);
+    // fora de [-1e7, 1e7] (ou NaN) o float ja' nao tem fracao; satura
+    __m128 x = _mm_sub_ps(_mm_mul_ps(s, _mm_set1_ps((float)texture.width)), half);
+    __m128 y = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps((float)texture.height)), half);
+    x = _mm_max_ps(_mm_min_ps(x, limit), _mm_sub_ps(_mm_setzero_ps(), limit));
+    y = _mm_max_ps(_mm_min_ps(y, limit), _mm_sub_ps(_mm_setzero_ps(), limit));
+    const __m128 fx0 = floorPs(x), fy0 = floorPs(y);
+    const __m128i fx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, fx0), scale), half));
+    const __m128i fy = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(y, fy0), scale), half));
+
+    __m128i x0, x1, y0, y1;
+    wrapTexels(fx0, (float)texture.width, texture.repeat, x0, x1);
+    wrapTexels(fy0, (float)texture.height, texture.repeat, y0, y1);
+    int ix0[4], ix1[4], iy0[4], iy1[4];
+    _mm_storeu_si128((__m128i*)ix0, x0);
+    _mm_storeu_si128((__m128i*)ix1, x1);
+    _mm_storeu_si128((__m128i*)iy0, y0);
+    _mm_storeu_si128((__m128i*)iy1, y1);
+
+    unsigned int c00[4] = { 0, 0, 0, 0 }, c10[4] = { 0, 0, 0, 0 }, c01[4] = { 0, 0, 0, 0 }, c11[4] = { 0, 0, 0, 0 };
+    for (int l = 0; l < 4; l++) {
+        if (!(bits & (1 << l))) continue;
+        const unsigned char* row0 = texture.rgb + (size_t)iy0[l] * texture.stride;
+        const unsigned char* row1 = texture.rgb + (size_t)iy1[l] * texture.stride;
+        c00[l] = texel(row0, ix0[l]);
+        c10[l] = texel(row0, ix1[l]);
+        c01[l] = texel(row1, ix0[l]);
+        c11[l] = texel(row1, ix1[l]);
+    }
+    const __m128i top = lerpTexels(_mm_loadu_si128((const __m128i*)c00), _mm_loadu_si128((const __m128i*)c10), fx);
+    const __m128i bottom = lerpTexels(_mm_loadu_si128((const __m128i*)c01), _mm_loadu_si128((const __m128i*)c11), fx);
+    return _mm_or_si128(lerpTexels(top, bottom, fy), _mm_set1_epi32((int)0xFF000000));
+}
+
+SoftRasterizer::SoftRasterizer(int w, int h)
+    : width(std::max(w, 1)), height(std::max(h, 1)), chunkCount(0)
+{
+    pitch = (width + 3) & ~3;
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    color.resize((size_t)pitch * height);
+    depth.resize((size_t)pitch * height);
+    tileFragments.resize((size_t)tilesX * tilesY);
+    clear(0.0f, 0.0f, 0.0f);
+}
+
+void SoftRasterizer::clear(float r, float g, float b) {
+    // desenhos ainda nao rasterizados seriam apagados pelo clear no GL
+    vertices.clear();
+    triangles.clear();
+    materials.clear();
+
+    unsigned int packed[4];
+    _mm_storeu_si128((__m128i*)packed, packColor(_mm_set1_ps(r), _mm_set1_ps(g), _mm_set1_ps(b)));
+    std::fill(color.begin(), color.end(), packed[0]);
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    memset(&stats, 0, sizeof(stats));
+}
+
+void SoftRasterizer::draw(const float* source, size_t vertexCount, int stride,
+                          const unsigned int* indices, size_t indexCount,
+                          const glm::mat4& mvp, const Material& material) {
+    PROFILE_SCOPE("SoftRasterizer::draw");
+    const int varyings = material.shading == VERTEX_COLOR ? 3 : 2;
+    const int attribute = material.attribute;
+    const size_t base = vertices.size();
+    vertices.resize(base + vertexCount);
+    ClipVertex* out = vertices.data() + base;
+
+    ThreadPool::shared().parallelFor(vertexCount, [=, &mvp](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float* in = source + i * stride;
+            const glm::vec4 p = mvp * glm::vec4(in[0], in[1], in[2], 1.0f);
+            ClipVertex& v = out[i];
+            v.x = p.x;
+            v.y = p.y;
+            v.z = p.z;
+            v.w = p.w;
+            for (int k = 0; k < 3; k++) v.v[k] = k < varyings ? in[attribute + k] : 0.0f;
+        }
+    }, MIN_VERTICES_PER_TASK);
+
+    const unsigned int id = (unsigned int)materials.size();
+    materials.push_back(material);
+    triangles.reserve(triangles.size() + indexCount / 3);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        // indice fora do buffer: o GL teria comportamento indefinido, aqui o triangulo some
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) continue;
+        const Triangle t = { { (unsigned int)(base + indices[i]), (unsigned int)(base + indices[i + 1]),
+                               (unsigned int)(base + indices[i + 2]) }, id };
+        triangles.push_back(t);
+    }
+    stats.triangles += (long long)(indexCount / 3);
+}
+
+void SoftRasterizer::finish() {
+    if (triangles.empty()) {
+        vertices.clear();
+        materials.clear();
+        return;
+    }
+    PROFILE_SCOPE("SoftRasterizer::finish");
+    typedef std::chrono::high_resolution_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    // Faixas fixas (e nao as do parallelFor) para cada uma ter as suas
+    // listas; o raster le as faixas em ordem e mantem a ordem de submissao
+    const size_t count = triangles.size();
+    chunkCount = std::min((size_t)ThreadPool::shared().getThreadCount() * 4,
+                          (count + MIN_TRIANGLES_PER_CHUNK - 1) / MIN_TRIANGLES_PER_CHUNK);
+    if (chunks.size() < chunkCount) chunks.resize(chunkCount);
+    ThreadPool::shared().parallelFor(chunkCount, [this, count](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) setupChunk(chunks[c], c * count / chunkCount, (c + 1) * count / chunkCount);
+    });
+    const Clock::time_point setupEnd = Clock::now();
+
+    ThreadPool::shared().parallelFor((size_t)tilesX * tilesY, [this](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) rasterTile((int)tile);
+    });
+    const Clock::time_point rasterEnd = Clock::now();
+
+    for (size_t c = 0; c < chunkCount; c++) stats.binned += (long long)chunks[c].triangles.size();
+    for (size_t tile = 0; tile < tileFragments.size(); tile++) stats.fragments += tileFragments[tile];
+    stats.setupMs += std::chrono::duration<double, std::milli>(setupEnd - start).count();
+    stats.rasterMs += std::chrono::duration<double, std::milli>(rasterEnd - setupEnd).count();
+
+    vertices.clear();
+    triangles.clear();
+    materials.clear();
+}
+
+void SoftRasterizer::setupChunk(Chunk& chunk, size_t begin, size_t end) {
+    chunk.triangles.clear();
+    chunk.bins.resize((size_t)tilesX * tilesY);
+    for (size_t i = 0; i < chunk.bins.size(); i++) chunk.bins[i].clear();
+
+    // guard band em coordenadas normalizadas: GUARD_BAND pixels alem de cada borda
+    const float guardX = 1.0f + 2.0f * GUARD_BAND / width, guardY = 1.0f + 2.0f * GUARD_BAND / height;
+
+    for (size_t i = begin; i < end; i++) {
+        const Triangle& triangle = triangles[i];
+        const ClipVertex* v[3] = { &vertices[triangle.index[0]], &vertices[triangle.index[1]], &vertices[triangle.index[2]] };
+
+        // todo fora do mesmo plano do frustum: descarta
+        unsigned int outside[3];
+        for (int k = 0; k < 3; k++) {
+            const ClipVertex& c = *v[k];
+            outside[k] = (c.x < -c.w) | (c.x > c.w) << 1 | (c.y < -c.w) << 2 | (c.y > c.w) << 3 |
+                         (c.z < -c.w) << 4 | (c.z > c.w) << 5;
+        }
+        if (outside[0] & outside[1] & outside[2]) continue;
+
+        // Recorte so' no near e na guard band; o far nao recorta, o teste de
+        // profundidade contra o 1 do clear descarta o que passa dele
+        bool needsClip = false;
+        for (int k = 0; k < 3; k++) {
+            for (int p = 0; p < CLIP_PLANES; p++) needsClip |= planeDistance(&v[k]->x, p, guardX, guardY) < 0.0f;
+        }
+        if (!needsClip) {
+            setupPolygon(v, 3, triangle.material, chunk);
+            continue;
+        }
+
+        // Sutherland-Hodgman: ate' 3 + CLIP_PLANES vertices no fim
+        ClipVertex polygon[2][3 + CLIP_PLANES];
+        int size = 3, current = 0;
+        for (int k = 0; k < 3; k++) polygon[0][k] = *v[k];
+        for (int p = 0; p < CLIP_PLANES && size >= 3; p++) {
+            bool any = false;
+            float d[3 + CLIP_PLANES];
+            for (int k = 0; k < size; k++) {
+                d[k] = planeDistance(&polygon[current][k].x, p, guardX, guardY);
+                any |= d[k] < 0.0f;
+            }
+            if (!any) continue;
+
+            const ClipVertex* in = polygon[current];
+            ClipVertex* out = polygon[current ^ 1];
+            int clipped = 0;
+            for (int k = 0; k < size; k++) {
+                const int next = k + 1 == size ? 0 : k + 1;
+                if (d[k] >= 0.0f) out[clipped++] = in[k];
+                if ((d[k] >= 0.0f) != (d[next] >= 0.0f)) {
+                    // sempre do vertice de dentro para o de fora: a aresta
+                    // compartilhada por dois triangulos gera o mesmo ponto nos dois
+                    const int a = d[k] >= 0.0f ? k : next, b = a == k ? next : k;
+                    const float t = d[a] / (d[a] - d[b]);
+                    ClipVertex& c = out[clipped++];
+                    c.x = in[a].x + (in[b].x - in[a].x) * t;
+                    c.y = in[a].y + (in[b].y - in[a].y) * t;
+                    c.z = in[a].z + (in[b].z - in[a].z) * t;
+                    c.w = in[a].w + (in[b].w - in[a].w) * t;
+                    for (int m = 0; m < 3; m++) c.v[m] = in[a].v[m] + (in[b].v[m] - in[a].v[m]) * t;
+                }
+            }
+            size = clipped;
+            current ^= 1;
+        }
+        const ClipVertex* clipped[3 + CLIP_PLANES];
+        for (int k = 0; k < size; k++) clipped[k] = &polygon[current][k];
+        setupPolygon(clipped, size, triangle.material, chunk);
+    }
+}
+
+// Poligono convexo ja' recortado: leque de triangulos, ou so' o contorno no wireframe
+void SoftRasterizer::setupPolygon(const ClipVertex* const* polygon, int size, unsigned int material, Chunk& chunk) const {
+    if (size < 3) return;
+    ScreenVertex screen[3 + CLIP_PLANES];
+    for (int k = 0; k < size; k++) screen[k] = project(*polygon[k]);
+    if (materials[material].wireframe) {
+        for (int k = 0; k < size; k++) setupLine(screen[k], screen[k + 1 == size ? 0 : k + 1], material, chunk);
+        return;
+    }
+    for (int k = 1; k + 1 < size; k++) setupTriangle(screen[0], screen[k], screen[k + 1], material, chunk);
+}
+
+SoftRasterizer::ScreenVertex SoftRasterizer::project(const ClipVertex& c) const {
+    ScreenVertex s;
+    s.w = 1.0f / c.w;
+    s.x = snap((c.x * s.w + 1.0f) * 0.5f * width);
+    s.y = snap((c.y * s.w + 1.0f) * 0.5f * height);
+    s.z = c.z * s.w * 0.5f + 0.5f;
+    for (int m = 0; m < 3; m++) s.v[m] = c.v[m] * s.w;
+    return s;
+}
+
+// Linha de 1 pixel como nas linhas do GL: um paralelogramo de altura 1 no eixo
+// menor (uma amostra por coluna, ou por linha), em dois triangulos
+void SoftRasterizer::setupLine(const ScreenVertex& p, const ScreenVertex& q, unsigned int material, Chunk& chunk) const {
+    const float dx = q.x - p.x, dy = q.y - p.y;
+    if (dx == 0.0f && dy == 0.0f) return;
+    const bool majorX = fabsf(dx) >= fabsf(dy);
+    ScreenVertex p0 = p, p1 = p, q0 = q, q1 = q;
+    if (majorX) {
+        p0.y -= 0.5f;
+        p1.y += 0.5f;
+        q0.y -= 0.5f;
+        q1.y += 0.5f;
+    }
+    else {
+        p0.x -= 0.5f;
+        p1.x += 0.5f;
+        q0.x -= 0.5f;
+        q1.x += 0.5f;
+    }
+    setupTriangle(p0, q0, q1, material, chunk);
+    setupTriangle(p0, q1, p1, material, chunk);
+}
+
+void SoftRasterizer::setupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                                   unsigned int material, Chunk& chunk) const {
+    // area * 2 = E_0 no vertice 0; negativa (horario na tela) troca 1 e 2 para
+    // as arestas ficarem positivas dentro
+    double area = (double)(v1.y - v2.y) * (v0.x - v1.x) + (double)(v2.x - v1.x) * (v0.y - v1.y);
+    if (area == 0.0) return;
+    const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+    if (area < 0.0) {
+        v[1] = &v2;
+        v[2] = &v1;
+        area = -area;
+    }
+
+    SetupTriangle t;
+    for (int k = 0; k < 3; k++) {
+        t.x[k] = v[k]->x;
+        t.y[k] = v[k]->y;
+    }
+    t.minX = std::max((int)ceilf(std::min(std::min(t.x[0], t.x[1]), t.x[2]) - 0.5f), 0);
+    t.maxX = std::min((int)floorf(std::max(std::max(t.x[0], t.x[1]), t.x[2]) - 0.5f), width - 1);
+    t.minY = std::max((int)ceilf(std::min(std::min(t.y[0], t.y[1]), t.y[2]) - 0.5f), 0);
+    t.maxY = std::min((int)floorf(std::max(std::max(t.y[0], t.y[1]), t.y[2]) - 0.5f), height - 1);
+    if (t.minX > t.maxX || t.minY > t.maxY) return;
+
+    t.owner = 0;
+    for (int i = 0; i < 3; i++) {
+        const int j = (i + 1) % 3, k = (i + 2) % 3;
+        t.a[i] = t.y[j] - t.y[k];
+        t.b[i] = t.x[k] - t.x[j];
+        // aresta da esquerda (dentro a' direita) ou de cima (dentro abaixo, y para cima)
+        if (t.a[i] > 0.0f || (t.a[i] == 0.0f && t.b[i] < 0.0f)) t.owner |= 1u << i;
+    }
+    t.invArea = (float)(1.0 / area);
+
+    const ScreenVertex& p0 = *v[0];
+    const ScreenVertex& p1 = *v[1];
+    const ScreenVertex& p2 = *v[2];
+    t.z = p0.z;
+    t.dz1 = p1.z - p0.z;
+    t.dz2 = p2.z - p0.z;
+    t.w = p0.w;
+    t.dw1 = p1.w - p0.w;
+    t.dw2 = p2.w - p0.w;
+    for (int m = 0; m < 3; m++) {
+        t.v[m] = p0.v[m];
+        t.dv1[m] = p1.v[m] - p0.v[m];
+        t.dv2[m] = p2.v[m] - p0.v[m];
+    }
+    t.material = material;
+
+    const unsigned int index = (unsigned int)chunk.triangles.size();
+    const int tx0 = t.minX / TILE_SIZE, tx1 = t.maxX / TILE_SIZE;
+    const int ty0 = t.minY / TILE_SIZE, ty1 = t.maxY / TILE_SIZE;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            // Retangulos de varios tiles: pula os tiles inteiros do lado de
+            // fora de uma aresta (testa o centro de pixel mais a' frente dela)
+            if (tx0 != tx1 && ty0 != ty1) {
+                bool outside = false;
+                for (int i = 0; i < 3 && !outside; i++) {
+                    const int j = (i + 1) % 3;
+                    const double cx = tx * TILE_SIZE + (t.a[i] > 0.0f ? TILE_SIZE - 0.5 : 0.5);
+                    const double cy = ty * TILE_SIZE + (t.b[i] > 0.0f ? TILE_SIZE - 0.5 : 0.5);
+                    outside = (double)t.a[i] * (cx - t.x[j]) + (double)t.b[i] * (cy - t.y[j]) < 0.0;
+                }
+                if (outside) continue;
+            }
+            chunk.bins[(size_t)ty * tilesX + tx].push_back(index);
+        }
+    }
+    chunk.triangles.push_back(t);
+}
+
+void SoftRasterizer::rasterTile(int tile) {
+    const int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    long long fragments = 0;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const Chunk& chunk = chunks[c];
+        const std::vector<unsigned int>& bin = chunk.bins[tile];
+        for (size_t i = 0; i < bin.size(); i++) {
+            const SetupTriangle& t = chunk.triangles[bin[i]];
+            switch (materials[t.material].shading) {
+            case VERTEX_COLOR: fragments += rasterTriangle<VERTEX_COLOR>(t, tileX, tileY); break;
+            case TEXCOORD_COLOR: fragments += rasterTriangle<TEXCOORD_COLOR>(t, tileX, tileY); break;
+            case TEXTURE: fragments += rasterTriangle<TEXTURE>(t, tileX, tileY); break;
+            }
+        }
+    }
+    tileFragments[tile] = fragments;
+}
+
+template <int SHADING>
+long long SoftRasterizer::rasterTriangle(const SetupTriangle& t, int tileX, int tileY) {
+    const int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+    const int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+    if (x0 > x1 || y0 > y1) return 0;
+
+    // Arestas no centro do primeiro pixel do tile, em double (exato na grade
+    // de 1/256): o triangulo do outro lado de uma aresta compartilhada chega
+    // exatamente a -E em cada pixel, e a regra top-left decide os E = 0
+    float origin[3];
+    __m128 a[3], owner[3];
+    for (int i = 0; i < 3; i++) {
+        const int j = (i + 1) % 3;
+        origin[i] = (float)((double)t.a[i] * (tileX + 0.5 - t.x[j]) + (double)t.b[i] * (tileY + 0.5 - t.y[j]));
+        a[i] = _mm_set1_ps(t.a[i]);
+        owner[i] = _mm_castsi128_ps(_mm_set1_epi32((t.owner >> i) & 1 ? -1 : 0));
+    }
+    const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 invArea = _mm_set1_ps(t.invArea), one = _mm_set1_ps(1.0f);
+    const Material& material = materials[t.material];
+
+    long long fragments = 0;
+    for (int y = y0; y <= y1; y++) {
+        const float ly = (float)(y - tileY);
+        const __m128 row0 = _mm_set1_ps(origin[0] + t.b[0] * ly);
+        const __m128 row1 = _mm_set1_ps(origin[1] + t.b[1] * ly);
+        const __m128 row2 = _mm_set1_ps(origin[2] + t.b[2] * ly);
+        float* depthRow = &depth[(size_t)y * pitch];
+        unsigned int* colorRow = &color[(size_t)y * pitch];
+
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            const __m128 lx = _mm_add_ps(_mm_set1_ps((float)(x - tileX)), lane);
+            const __m128 e0 = _mm_add_ps(row0, _mm_mul_ps(a[0], lx));
+            const __m128 e1 = _mm_add_ps(row1, _mm_mul_ps(a[1], lx));
+            const __m128 e2 = _mm_add_ps(row2, _mm_mul_ps(a[2], lx));
+            __m128 mask = _mm_and_ps(inside(e0, owner[0]), _mm_and_ps(inside(e1, owner[1]), inside(e2, owner[2])));
+            // colunas do preenchimento do pitch, depois da ultima
+            if (x + 4 > width) mask = _mm_and_ps(mask, _mm_cmplt_ps(lane, _mm_set1_ps((float)(width - x))));
+            if (_mm_movemask_ps(mask) == 0) continue;
+
+            // baricentricas dos vertices 1 e 2; z/w e' linear na tela
+            const __m128 b1 = _mm_mul_ps(e1, invArea), b2 = _mm_mul_ps(e2, invArea);
+            const __m128 z = interpolate(t.z, t.dz1, t.dz2, b1, b2);
+            const __m128 oldDepth = _mm_loadu_ps(depthRow + x);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(z, oldDepth));
+            const int bits = _mm_movemask_ps(mask);
+            if (bits == 0) continue;
+            _mm_storeu_ps(depthRow + x, select(mask, z, oldDepth));
+            fragments += BIT_COUNT[bits];
+
+            // atributos / w e 1/w sao lineares na tela: divide no pixel
+            const __m128 w = _mm_div_ps(one, interpolate(t.w, t.dw1, t.dw2, b1, b2));
+            const __m128 s = _mm_mul_ps(interpolate(t.v[0], t.dv1[0], t.dv2[0], b1, b2), w);
+            const __m128 r = _mm_mul_ps(interpolate(t.v[1], t.dv1[1], t.dv2[1], b1, b2), w);
+            __m128i rgba;
+            if (SHADING == VERTEX_COLOR) {
+                const __m128 q = _mm_mul_ps(interpolate(t.v[2], t.dv1[2], t.dv2[2], b1, b2), w);
+                rgba = packColor(s, r, q);
+            }
+            else if (SHADING == TEXCOORD_COLOR) {
+                rgba = packColor(s, r, one);
+            }
+            else {
+                rgba = sampleBilinear(*material.texture, s, r, bits);
+            }
+
+            const __m128i maskBits = _mm_castps_si128(mask);
+            __m128i* target = (__m128i*)(colorRow + x);
+            const __m128i old = _mm_loadu_si128(target);
+            _mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(maskBits, rgba), _mm_andnot_si128(maskBits, old)));
+        }
+    }
+    return fragments;
+}
+
+void SoftRasterizer::readPixels(std::vector<unsigned char>& rgba) {
+    finish();
+    rgba.resize((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        memcpy(&rgba[(size_t)y * width * 4], &color[(size_t)y * pitch], (size_t)width * 4);
+    }
+}
+
+bool SoftRasterizer::save(const char* fileName) {
+    finish();
+    // layout do Bmp: BGR, de baixo para cima, linhas alinhadas em 4 bytes
+    const int stride = (3 * width + 3) / 4 * 4;
+    std::vector<unsigned char> bgr((size_t)stride * height, 0);
+    for (int y = 0; y < height; y++) {
+        const unsigned int* in = &color[(size_t)y * pitch];
+        unsigned char* out = &bgr[(size_t)y * stride];
+        for (int x = 0; x < width; x++) {
+            out[x * 3 + 0] = (unsigned char)(in[x] >> 16);
+            out[x * 3 + 1] = (unsigned char)(in[x] >> 8);
+            out[x * 3 + 2] = (unsigned char)in[x];
+        }
+    }
+    return Bmp::save(fileName, width, height, bgr.data()) == BMP_OK;
+}
@@ -0,0 +1,148 @@
+#ifndef SOFTRASTERIZER_H
+#define SOFTRASTERIZER_H
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Rasterizador em CPU para maquinas sem GPU (CI, nos de render): desenha os
+// mesmos vertex/index buffers que os demos mandam para o GL (triangulos
+// indexados, posicao nos 3 primeiros floats do vertice) num framebuffer RGBA8
+// com profundidade float, e grava o resultado em BMP.
+//
+// draw() so' transforma os vertices e guarda os triangulos; o resto fica para
+// finish() (chamado tambem por save() e readPixels()):
+// - setup: recorte no plano near e numa guard band de GUARD_BAND pixels,
+//   posicoes arredondadas para 1/256 de pixel e binning: cada triangulo entra
+//   na lista de cada tile de TILE_SIZE^2 pixels que o retangulo dele toca.
+//   Faixas de triangulos rodam em paralelo, cada uma com as suas listas;
+// - raster: um tile por tarefa no ThreadPool::shared(), lendo as listas das
+//   faixas em ordem (a ordem de submissao, como no GL). Funcoes de aresta,
+//   profundidade e interpolacao em SSE2, 4 pixels por vez, com a regra
+//   top-left: aresta compartilhada por dois triangulos nao deixa buraco nem
+//   pinta o mesmo pixel duas vezes.
+//
+// Como o estado padrao do GL nos demos: sem descarte de faces, teste de
+// profundidade GL_LESS em [0, 1], atributos com correcao de perspectiva e
+// linha 0 da imagem embaixo.
+class SoftRasterizer {
+public:
+    static const int TILE_SIZE = 64;
+    static const int GUARD_BAND = 8192;
+
+    enum Shading {
+        VERTEX_COLOR,     // cor rgb nos floats attribute..attribute+2 do vertice (Camera_3D)
+        TEXCOORD_COLOR,   // cor (s, t, 1) das coordenadas em attribute..attribute+1 (Terrain)
+        TEXTURE           // amostra bilinear de texture nas coordenadas em attribute..attribute+1
+    };
+
+    // RGB8 com linhas de stride bytes e linha 0 em t = 0, como no
+    // glTexImage2D (ex.: Bmp::getImage() depois de convertBGRtoRGB())
+    struct Texture {
+        const unsigned char* rgb;
+        int width, height, stride;
+        bool repeat;                 // GL_REPEAT; false = GL_CLAMP_TO_EDGE
+    };
+
+    struct Material {
+        Shading shading;
+        int attribute;               // indice (em floats) do primeiro componente no vertice
+        const Texture* texture;      // so' TEXTURE; tem que valer ate' finish()
+        bool wireframe;              // so' as arestas, em linhas de 1 pixel (GL_LINE)
+    };
+
+    // Contadores desde o ultimo clear()
+    struct Stats {
+        long long triangles;         // submetidos em draw()
+        long long binned;            // depois de recorte e descarte (um triangulo recortado pode virar varios)
+        long long fragments;         // pixels que passaram no teste de profundidade
+        double setupMs, rasterMs;
+    };
+
+    SoftRasterizer(int width, int height);
+
+    // Cor de fundo em [0, 1] e profundidade 1
+    void clear(float r, float g, float b);
+
+    // stride em floats por vertice; indices de 3 em 3 (GL_TRIANGLES).
+    // Os buffers podem ser liberados logo depois
+    void draw(const float* vertices, size_t vertexCount, int stride,
+              const unsigned int* indices, size_t indexCount,
+              const glm::mat4& mvp, const Material& material);
+
+    // Rasteriza o que foi desenhado desde o ultimo finish()
+    void finish();
+
+    // RGBA8, width * height * 4 bytes, linha 0 embaixo (como glReadPixels)
+    void readPixels(std::vector<unsigned char>& rgba);
+    bool save(const char* fileName);
+
+    const Stats& getStats() const { return stats; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    // Vertice em clip space com ate' 3 atributos
+    struct ClipVertex {
+        float x, y, z, w;
+        float v[3];
+    };
+
+    // Vertice na tela: x, y na grade de subpixels, z em [0, 1], w = 1 / w do
+    // clip space e atributos / w (lineares na tela)
+    struct ScreenVertex {
+        float x, y, z, w;
+        float v[3];
+    };
+
+    struct Triangle {
+        unsigned int index[3];
+        unsigned int material;
+    };
+
+    // Triangulo pronto para o raster: posicoes na grade de 1/256 de pixel,
+    // arestas E_i(p) = a_i (px - x_j) + b_i (py - y_j) (positivas dentro), e
+    // valores no vertice 0 + diferencas para os vertices 1 e 2
+    struct SetupTriangle {
+        float x[3], y[3];
+        float a[3], b[3];
+        unsigned int owner;          // bit i: pixel com E_i = 0 pertence a este triangulo
+        float invArea;
+        float z, dz1, dz2;
+        float w, dw1, dw2;           // 1/w
+        float v[3], dv1[3], dv2[3];  // atributos / w
+        int minX, minY, maxX, maxY;
+        unsigned int material;
+    };
+
+    // Faixa de triangulos do setup e as listas dela por tile
+    struct Chunk {
+        std::vector<SetupTriangle> triangles;
+        std::vector<std::vector<unsigned int> > bins;
+    };
+
+    int width, height, pitch;        // pitch: largura arredondada para 4
+    int tilesX, tilesY;
+    std::vector<unsigned int> color;
+    std::vector<float> depth;
+
+    std::vector<ClipVertex> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<Material> materials;
+    std::vector<Chunk> chunks;
+    size_t chunkCount;
+    std::vector<long long> tileFragments;
+    Stats stats;
+
+    void setupChunk(Chunk& chunk, size_t begin, size_t end);
+    void setupPolygon(const ClipVertex* const* polygon, int size, unsigned int material, Chunk& chunk) const;
+    ScreenVertex project(const ClipVertex& c) const;
+    void setupLine(const ScreenVertex& p, const ScreenVertex& q, unsigned int material, Chunk& chunk) const;
+    void setupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                       unsigned int material, Chunk& chunk) const;
+    void rasterTile(int tile);
+    template <int SHADING>
+    long long rasterTriangle(const SetupTriangle& t, int tileX, int tileY);
+};
+
+#endif
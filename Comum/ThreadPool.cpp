@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Verdadeiro nas threads do pool e na chamadora durante um parallelFor
+static thread_local bool insideParallelFor = false;
+
+ThreadPool::ThreadPool(int threads)
+    : task(NULL), count(0), chunkSize(0), chunkCount(0), nextChunk(0), finishedChunks(0),
+      activeWorkers(0), generation(0), stopping(false)
+{
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+static int sharedThreadCount = 0;
+
+void ThreadPool::setSharedThreadCount(int threads) {
+    sharedThreadCount = threads;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(sharedThreadCount);
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t items, const RangeFunction& function, size_t minChunk) {
+    if (items == 0) return;
+    minChunk = std::max(minChunk, (size_t)1);
+
+    if (insideParallelFor || workers.empty() || items < minChunk * 2) {
+        function(0, items);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // ~4 faixas por thread equilibram faixas de custo desigual sem muita disputa
+        size_t chunks = std::min(items / minChunk, (size_t)getThreadCount() * 4);
+        task = &function;
+        count = items;
+        chunkSize = (items + chunks - 1) / chunks;
+        chunkCount = (items + chunkSize - 1) / chunkSize;
+        nextChunk = 0;
+        finishedChunks = 0;
+        generation++;
+    }
+    wake.notify_all();
+
+    insideParallelFor = true;
+    size_t ran = runChunks();
+    insideParallelFor = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finishedChunks += ran;
+    // espera tambem os workers que acordaram tarde: nenhum pode estar em
+    // runChunks quando o proximo parallelFor reiniciar os contadores
+    done.wait(lock, [this] { return finishedChunks == chunkCount && activeWorkers == 0; });
+    task = NULL;
+}
+
+size_t ThreadPool::runChunks() {
+    size_t ran = 0;
+    for (;;) {
+        size_t chunk = nextChunk.fetch_add(1);
+        if (chunk >= chunkCount) break;
+        size_t begin = chunk * chunkSize;
+        (*task)(begin, std::min(begin + chunkSize, count));
+        ran++;
+    }
+    return ran;
+}
+
+void ThreadPool::workerLoop() {
+    insideParallelFor = true;
+    unsigned long long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || (generation != seen && task != NULL); });
+            if (stopping) return;
+            seen = generation;
+            activeWorkers++;
+        }
+
+        size_t ran = runChunks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedChunks += ran;
+        activeWorkers--;
+        if (finishedChunks == chunkCount && activeWorkers == 0) done.notify_one();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads fixas para lacos paralelos. parallelFor divide [0, count) em
+// faixas contiguas e cada thread pega a proxima faixa livre; a thread que
+// chamou tambem trabalha e so' retorna quando todas as faixas terminaram.
+//
+// Chamadas aninhadas (de dentro de uma faixa) rodam direto na thread atual,
+// e chamadas simultaneas de threads diferentes sao serializadas.
+class ThreadPool {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+    // threads = 0 usa std::thread::hardware_concurrency()
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    // Pool global, criado no primeiro uso com setSharedThreadCount() threads (0 = todas)
+    static ThreadPool& shared();
+    static void setSharedThreadCount(int threads);
+
+    // Numero de threads que executam faixas, contando a chamadora
+    int getThreadCount() const { return (int)workers.size() + 1; }
+
+    // Faixas de pelo menos minChunk itens; com poucos itens roda tudo na chamadora
+    void parallelFor(size_t count, const RangeFunction& task, size_t minChunk = 1);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;              // uma chamada de parallelFor por vez
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    // trabalho atual
+    const RangeFunction* task;
+    size_t count, chunkSize, chunkCount;
+    std::atomic<size_t> nextChunk;
+    size_t finishedChunks;
+    int activeWorkers;                   // workers dentro de runChunks
+    unsigned long long generation;
+    bool stopping;
+
+    void workerLoop();
+    // Executa faixas ate' acabar; retorna quantas executou
+    size_t runChunks();
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
@@ -0,0 +1,411 @@
+//*********************************************************
+//
+// classe para fazer o carregamento de arquivos no formato BMP
+// Autor: Cesar Tadeu Pozzer
+//        pozzer@inf.ufsm.br
+//  Versao 09/2010
+//
+//**********************************************************
+
+#include "Bmp.h"
+#include <limits.h>
+#include <string.h>
+#include <vector>
+#include "ThreadPool.h"
+
+static bool verboseLoad = true;
+
+//pixels minimos por faixa de linhas: imagens pequenas ficam inteiras na
+//thread chamadora, onde dividir custa mais que ganha
+static const int PIXELS_PER_TASK = 256 * 256;
+
+//numero de bits e deslocamento de uma mascara BI_BITFIELDS
+static void maskShift(unsigned int mask, int &shift, int &count)
+{
+   shift = count = 0;
+   if( mask == 0 ) return;
+   while( (mask & 1) == 0 ) { mask >>= 1; shift++; }
+   while( (mask & 1) == 1 ) { mask >>= 1; count++; }
+}
+
+Bmp::Bmp(const char *fileName)
+{
+   width = height = 0;
+   data = NULL;
+   if( fileName != NULL && strlen(fileName) > 0 )
+   {
+      status = load(fileName);
+   }
+   else
+   {
+      status = BMP_ERROR_FILENAME;
+   }
+
+   if( status != BMP_OK && verboseLoad )
+   {
+      printf("\nError: %s (%s)", statusMessage(status), fileName ? fileName : "");
+   }
+   if( status != BMP_OK )
+   {
+      delete [] data;
+      data = NULL;
+   }
+}
+
+Bmp::~Bmp()
+{
+   delete [] data;
+}
+
+uchar* Bmp::getImage()
+{
+  return data;
+}
+
+int Bmp::getWidth(void)
+{
+  return width;
+}
+
+int Bmp::getHeight(void)
+{
+  return height;
+}
+
+BmpStatus Bmp::getStatus(void)
+{
+  return status;
+}
+
+const char* Bmp::statusMessage(BmpStatus s)
+{
+   switch( s )
+   {
+      case BMP_OK:                return "OK";
+      case BMP_ERROR_FILENAME:    return "Nome de arquivo BMP invalido";
+      case BMP_ERROR_OPEN:        return "Erro ao abrir arquivo para leitura";
+      case BMP_ERROR_SIGNATURE:   return "Arquivo BMP invalido";
+      case BMP_ERROR_UNSUPPORTED: return "Formato BMP nao suportado";
+      case BMP_ERROR_TRUNCATED:   return "Arquivo BMP truncado";
+      case BMP_ERROR_CORRUPT:     return "Arquivo BMP corrompido";
+   }
+   return "Erro desconhecido";
+}
+
+void Bmp::setVerbose(bool verbose)
+{
+   verboseLoad = verbose;
+}
+
+BmpStatus Bmp::save(const char *fileName, int width, int height, const uchar *bgr)
+{
+   FILE* fp;
+   fopen_s(&fp, fileName, "wb");
+   if( fp == NULL )
+   {
+      return BMP_ERROR_OPEN;
+   }
+
+   int lineSize = (3 * width + 3) / 4 * 4;
+   HEADER     h;
+   INFOHEADER i;
+   h.type      = 19778;
+   h.offset    = HEADER_SIZE + INFOHEADER_SIZE;
+   h.size      = h.offset + lineSize * height;
+   h.reserved1 = h.reserved2 = 0;
+   memset(&i, 0, sizeof(i));
+   i.size      = INFOHEADER_SIZE;
+   i.width     = width;
+   i.height    = height;
+   i.planes    = 1;
+   i.bits      = 24;
+   i.imagesize = lineSize * height;
+
+   //grava componente a componente pelo mesmo motivo da leitura (alinhamento do HEADER)
+   fwrite(&h.type,      sizeof(unsigned short int), 1, fp);
+   fwrite(&h.size,      sizeof(unsigned int),       1, fp);
+   fwrite(&h.reserved1, sizeof(unsigned short int), 1, fp);
+   fwrite(&h.reserved2, sizeof(unsigned short int), 1, fp);
+   fwrite(&h.offset,    sizeof(unsigned int),       1, fp);
+   fwrite(&i, INFOHEADER_SIZE, 1, fp);
+   size_t written = fwrite(bgr, 1, (size_t)lineSize * height, fp);
+   fclose(fp);
+
+   return written == (size_t)lineSize * height ? BMP_OK : BMP_ERROR_TRUNCATED;
+}
+
+void Bmp::convertBGRtoRGB()
+{
+  unsigned char tmp;
+  if( data != NULL )
+  {
+     for(int y=0; y<height; y++)
+     for(int x=0; x<width*3; x+=3)
+     {
+        int pos = y*bytesPerLine + x;
+        tmp = data[pos];
+        data[pos] = data[pos+2];
+        data[pos+2] = tmp;
+     }
+  }
+}
+
+
+BmpStatus Bmp::load(const char *fileName)
+{
+  FILE* fp;
+  errno_t err = fopen_s(&fp, fileName, "rb");
+  if( fp == NULL )
+  {
+     return BMP_ERROR_OPEN;
+  }
+
+  if( verboseLoad )
+     printf("\n\nCarregando arquivo %s", fileName);
+
+  //le o HEADER componente a componente devido ao problema de alinhamento de bytes. Usando
+  //o comando fread(header, sizeof(HEADER),1,fp) sao lidos 16 bytes ao inves de 14
+  size_t ok = 0;
+  ok += fread(&header.type,      sizeof(unsigned short int), 1, fp);
+  ok += fread(&header.size,      sizeof(unsigned int),       1, fp);
+  ok += fread(&header.reserved1, sizeof(unsigned short int), 1, fp);
+  ok += fread(&header.reserved2, sizeof(unsigned short int), 1, fp);
+  ok += fread(&header.offset,    sizeof(unsigned int),       1, fp); //indica inicio do bloco de pixels
+
+  //le o INFOHEADER componente a componente devido ao problema de alinhamento de bytes
+  ok += fread(&info.size,        sizeof(unsigned int),       1, fp);
+  ok += fread(&info.width,       sizeof(int),                1, fp);
+  ok += fread(&info.height,      sizeof(int),                1, fp);
+  ok += fread(&info.planes,      sizeof(unsigned short int), 1, fp);
+  ok += fread(&info.bits,        sizeof(unsigned short int), 1, fp);
+  ok += fread(&info.compression, sizeof(unsigned int),       1, fp);
+  ok += fread(&info.imagesize,   sizeof(unsigned int),       1, fp);
+  ok += fread(&info.xresolution, sizeof(int),                1, fp);
+  ok += fread(&info.yresolution, sizeof(int),                1, fp);
+  ok += fread(&info.ncolours,    sizeof(unsigned int),       1, fp);
+  ok += fread(&info.impcolours,  sizeof(unsigned int),       1, fp);
+
+  //realiza diversas verificacoes de erro e compatibilidade
+  if( ok != 16 )
+  {
+     fclose(fp);
+     return BMP_ERROR_TRUNCATED;
+  }
+  if( header.type != 19778 )
+  {
+     fclose(fp);
+     return BMP_ERROR_SIGNATURE;
+  }
+
+  bool topDown = info.height < 0;
+  width  = info.width;
+  height = topDown && info.height != INT_MIN ? -info.height : info.height;
+  bits   = info.bits;
+
+  if( verboseLoad )
+     printf("\nImagem: %dx%d - Bits: %d - Compressao: %d", width, height, bits, info.compression);
+
+  bool supported;
+  switch( info.compression )
+  {
+     case BMP_RGB:       supported = bits == 1 || bits == 4 || bits == 8 || bits == 24 || bits == 32; break;
+     case BMP_RLE8:      supported = bits == 8 && !topDown; break;
+     case BMP_RLE4:      supported = bits == 4 && !topDown; break;
+     case BMP_BITFIELDS: supported = bits == 32; break;
+     default:            supported = false;
+  }
+  if( !supported || info.planes != 1 || info.size < INFOHEADER_SIZE )
+  {
+     fclose(fp);
+     return BMP_ERROR_UNSUPPORTED;
+  }
+  if( width <= 0 || height <= 0 )
+  {
+     fclose(fp);
+     return BMP_ERROR_CORRUPT;
+  }
+  //dimensoes vem do arquivo: a imagem decodificada tem que caber em int
+  //(getImage() e imagesize) antes de qualquer conta com elas
+  if( width > (INT_MAX - 3) / 3 || (long long)((3 * width + 3) / 4 * 4) * height > INT_MAX )
+  {
+     fclose(fp);
+     return BMP_ERROR_UNSUPPORTED;
+  }
+  bytesPerLine = (3 * width + 3) / 4 * 4;
+  imagesize    = bytesPerLine*height;
+
+  //mascaras BI_BITFIELDS vem logo apos os 40 bytes do INFOHEADER
+  unsigned int masks[3] = { 0x00ff0000, 0x0000ff00, 0x000000ff };
+  if( info.compression == BMP_BITFIELDS )
+  {
+     if( fread(masks, sizeof(unsigned int), 3, fp) != 3 )
+     {
+        fclose(fp);
+        return BMP_ERROR_TRUNCATED;
+     }
+  }
+
+  //a paleta (B,G,R,0) comeca depois do INFOHEADER, que pode ser maior que 40 bytes (V4/V5).
+  //Entradas ausentes ficam pretas, entao indices invalidos nao leem fora do buffer.
+  uchar palette[256 * 4];
+  int ncolours = 0;
+  memset(palette, 0, sizeof(palette));
+  if( bits <= 8 )
+  {
+     ncolours = info.ncolours != 0 && info.ncolours < (1u << bits) ? info.ncolours : (1 << bits);
+     fseek(fp, HEADER_SIZE + info.size, SEEK_SET);
+     if( fread(palette, 4, ncolours, fp) != (size_t)ncolours )
+     {
+        fclose(fp);
+        return BMP_ERROR_TRUNCATED;
+     }
+  }
+
+  //le o bloco de pixels inteiro de uma vez
+  fseek(fp, 0, SEEK_END);
+  long fileSize = ftell(fp);
+  if( fileSize < (long)header.offset )
+  {
+     fclose(fp);
+     return BMP_ERROR_TRUNCATED;
+  }
+  std::vector<uchar> pixels(fileSize - header.offset);
+  fseek(fp, header.offset, SEEK_SET);
+  size_t got = fread(pixels.data(), 1, pixels.size(), fp);
+  fclose(fp);
+
+  data = new unsigned char[imagesize];
+
+  if( info.compression == BMP_RLE8 || info.compression == BMP_RLE4 )
+  {
+     memset(data, 0, imagesize);
+     return decodeRLE(pixels.data(), got, palette);
+  }
+
+  size_t srcStride = ((size_t)bits * width + 31) / 32 * 4;
+  if( got / srcStride < (size_t)height )
+     return BMP_ERROR_TRUNCATED;
+
+  decodeRows(pixels.data(), srcStride, topDown, palette,
+             info.compression == BMP_BITFIELDS ? masks : NULL);
+  return BMP_OK;
+}
+
+//formatos sem compressao: cada linha e' independente, entao sao convertidas em paralelo
+void Bmp::decodeRows(const uchar *src, size_t srcStride, bool topDown, const uchar *palette, const unsigned int *masks)
+{
+  int shift[3], count[3];
+  if( masks != NULL )
+     for(int c = 0; c < 3; c++)
+        maskShift(masks[c], shift[c], count[c]);
+
+  ThreadPool::shared().parallelFor((size_t)height, [&](size_t y0, size_t y1)
+  {
+     for(int y = (int)y0; y < (int)y1; y++)
+     {
+        const uchar *in = src + (size_t)(topDown ? height - 1 - y : y) * srcStride;
+        uchar *out = data + (size_t)y * bytesPerLine;
+
+        if( bits == 24 )
+        {
+           memcpy(out, in, width * 3);
+        }
+        else if( bits == 32 && masks == NULL )
+        {
+           for(int x = 0; x < width; x++)
+           {
+              out[3*x]   = in[4*x];
+              out[3*x+1] = in[4*x+1];
+              out[3*x+2] = in[4*x+2];
+           }
+        }
+        else if( bits == 32 )
+        {
+           for(int x = 0; x < width; x++)
+           {
+              unsigned int v = in[4*x] | (in[4*x+1] << 8) | (in[4*x+2] << 16) | ((unsigned int)in[4*x+3] << 24);
+              //canal c da mascara vai para a posicao BGR 2-c
+              for(int c = 0; c < 3; c++)
+              {
+                 unsigned int max = count[c] ? (count[c] >= 32 ? 0xffffffffu : (1u << count[c]) - 1) : 1;
+                 unsigned int ch  = (v & masks[c]) >> shift[c];
+                 out[3*x + 2 - c] = (uchar)((unsigned long long)ch * 255 / max);
+              }
+           }
+        }
+        else
+        {
+           //1, 4 ou 8 bits: indice na paleta, bit mais significativo primeiro
+           int perByte = 8 / bits;
+           int mask    = (1 << bits) - 1;
+           for(int x = 0; x < width; x++)
+           {
+              int idx = (in[x / perByte] >> ((perByte - 1 - x % perByte) * bits)) & mask;
+              const uchar *c = palette + 4 * idx;
+              out[3*x]   = c[0];
+              out[3*x+1] = c[1];
+              out[3*x+2] = c[2];
+           }
+        }
+        memset(out + width * 3, 0, bytesPerLine - width * 3);
+     }
+  }, (size_t)(PIXELS_PER_TASK / width + 1));
+}
+
+//RLE8/RLE4: o inicio de cada linha so' e' conhecido depois de decodificar a
+//anterior, entao a decodificacao e' sequencial
+BmpStatus Bmp::decodeRLE(const uchar *src, size_t srcSize, const uchar *palette)
+{
+  int x = 0, y = 0;
+  size_t pos = 0;
+  bool rle8 = info.compression == BMP_RLE8;
+
+  while( pos + 1 < srcSize )
+  {
+     int count = src[pos++];
+     int value = src[pos++];
+
+     if( count > 0 )
+     {
+        //sequencia codificada: repete o indice (RLE4 alterna os dois nibbles)
+        for(int i = 0; i < count; i++, x++)
+        {
+           int idx = rle8 ? value : ((i & 1) ? (value & 15) : (value >> 4));
+           if( x < width && y < height )
+              memcpy(data + (size_t)y * bytesPerLine + 3 * x, palette + 4 * idx, 3);
+        }
+     }
+     else if( value == 0 )  //fim de linha
+     {
+        x = 0;
+        y++;
+     }
+     else if( value == 1 )  //fim do bitmap
+     {
+        return BMP_OK;
+     }
+     else if( value == 2 )  //deslocamento
+     {
+        if( pos + 1 >= srcSize )
+           return BMP_ERROR_CORRUPT;
+        x += src[pos++];
+        y += src[pos++];
+     }
+     else                   //sequencia absoluta, alinhada em 16 bits
+     {
+        size_t bytes = rle8 ? value : (value + 1) / 2;
+        if( pos + bytes > srcSize )
+           return BMP_ERROR_CORRUPT;
+        for(int i = 0; i < value; i++, x++)
+        {
+           int idx = rle8 ? src[pos + i] : ((i & 1) ? (src[pos + i/2] & 15) : (src[pos + i/2] >> 4));
+           if( x < width && y < height )
+              memcpy(data + (size_t)y * bytesPerLine + 3 * x, palette + 4 * idx, 3);
+        }
+        pos += bytes + (bytes & 1);
+     }
+  }
+
+  //sem marcador de fim: aceita o que foi decodificado
+  return BMP_OK;
+}
@@ -0,0 +1,389 @@
+#include "Erosion.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "HeightMap.h"
+#include "../Comum/Profiler.h"
+#include "../Comum/ThreadPool.h"
+
+// Gotas de um ladrilho que andam juntas, um passo por vez
+static const int BATCH = 64;
+
+// Gerador congruente linear: sequencia reproduzivel por ladrilho e passada
+struct Random {
+    unsigned int state;
+    explicit Random(unsigned int seed) : state(seed) {}
+    // [0, 1), 24 bits
+    float next() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+static unsigned int mixSeed(unsigned int seed, unsigned int pass, unsigned int tile) {
+    unsigned int h = seed ^ pass * 374761393u ^ tile * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return h ^ (h >> 16);
+}
+
+Erosion::Erosion(HeightMap& heightmap, const Settings& s)
+    : map(heightmap), settings(s), width(heightmap.getWidth()), height(heightmap.getHeight()), passCount(0),
+      droplets(0)
+{
+    settings.tileSize = std::max(32, settings.tileSize);
+    settings.radius = std::min(std::max(1, settings.radius), settings.tileSize / 4);
+    settings.thermalRate = std::min(std::max(0.0f, settings.thermalRate), 1.0f);
+
+    const int size = settings.tileSize;
+    tilesX = (width + size - 1) / size;
+    tilesY = (height + size - 1) / size;
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            Tile tile = { tx * size, ty * size, std::min(width, (tx + 1) * size), std::min(height, (ty + 1) * size) };
+            tiles.push_back(tile);
+        }
+    }
+    dirty.assign(tiles.size(), 0);
+
+    // Pincel: pesos caindo linearmente do centro ate' o raio, somando 1
+    const int r = settings.radius;
+    float sum = 0.0f;
+    for (int y = -r; y <= r; y++) {
+        for (int x = -r; x <= r; x++) {
+            float d2 = (float)(x * x + y * y);
+            if (d2 >= (float)(r * r)) continue;
+            float w = 1.0f - sqrtf(d2) / r;
+            brushX.push_back(x);
+            brushY.push_back(y);
+            brushWeight.push_back(w);
+            sum += w;
+        }
+    }
+    for (float& w : brushWeight) w /= sum;
+}
+
+void Erosion::markDirty(int x0, int y0, int x1, int y1) {
+    const int size = settings.tileSize;
+    int tx0 = std::max(0, x0 / size), ty0 = std::max(0, y0 / size);
+    int tx1 = std::min(tilesX - 1, (x1 - 1) / size), ty1 = std::min(tilesY - 1, (y1 - 1) / size);
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) dirty[(size_t)ty * tilesX + tx] = 1;
+    }
+}
+
+void Erosion::takeDirty(std::vector<Region>& regions) {
+    regions.clear();
+    for (size_t t = 0; t < tiles.size(); t++) {
+        if (!dirty[t]) continue;
+        const Tile& tile = tiles[t];
+        Region region = { tile.x0, tile.y0, tile.x1 - tile.x0, tile.y1 - tile.y0 };
+        regions.push_back(region);
+        dirty[t] = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Hidraulica
+
+void Erosion::hydraulic(int count) {
+    PROFILE_SCOPE("Erosion::hydraulic");
+    if (count <= 0 || width < 2 || height < 2) return;
+    const unsigned int pass = passCount++;
+
+    // Gotas por ladrilho proporcionais a' area (ladrilhos da borda sao menores)
+    std::vector<int> perTile(tiles.size());
+    const long long total = (long long)width * height;
+    long long area = 0;
+    for (size_t t = 0; t < tiles.size(); t++) {
+        long long before = count * area / total;
+        area += (long long)(tiles[t].x1 - tiles[t].x0) * (tiles[t].y1 - tiles[t].y0);
+        perTile[t] = (int)(count * area / total - before);
+    }
+
+    // 4 grupos em xadrez 2x2: ladrilhos do mesmo grupo estao a um ladrilho de
+    // distancia e as gotas de cada um nao passam de meio ladrilho para fora
+    std::vector<Region> touched(tiles.size());
+    std::vector<int> group;
+    for (int parity = 0; parity < 4; parity++) {
+        group.clear();
+        for (int ty = parity >> 1; ty < tilesY; ty += 2) {
+            for (int tx = parity & 1; tx < tilesX; tx += 2) group.push_back(ty * tilesX + tx);
+        }
+        ThreadPool::shared().parallelFor(group.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                int t = group[i];
+                simulateDroplets(tiles[t], perTile[t], mixSeed(settings.seed, pass, (unsigned int)t), touched[t]);
+            }
+        });
+    }
+
+    for (const Region& region : touched) {
+        if (region.width > 0) markDirty(region.x0, region.y0, region.x0 + region.width, region.y0 + region.height);
+    }
+    droplets += count;
+}
+
+void Erosion::simulateDroplets(const Tile& tile, int count, unsigned int seed, Region& touched) const {
+    touched.width = touched.height = 0;
+    if (count <= 0) return;
+
+    float* h = map.getData();
+    const size_t w = (size_t)width;
+    const float scale = settings.heightScale, invScale = 1.0f / scale;
+    const int r = settings.radius;
+    // Copias locais: as escritas em h (float*) obrigariam o compilador a reler
+    // os campos de settings e os vetores do pincel a cada uso
+    const float inertia = settings.inertia, capacityFactor = settings.capacity, minCapacity = settings.minCapacity;
+    const float erodeRate = settings.erodeRate, depositRate = settings.depositRate;
+    const float evaporation = 1.0f - settings.evaporateRate, gravity = settings.gravity;
+    const int lifetime = settings.lifetime;
+    const int* brushX = this->brushX.data();
+    const int* brushY = this->brushY.data();
+    const float* brushWeight = this->brushWeight.data();
+    const int brushSize = (int)this->brushWeight.size();
+
+    // Caixa em que a gota pode estar: as celulas (cx, cy) e (cx + 1, cy + 1)
+    // da interpolacao ficam no mapa e a mais de meio ladrilho dos ladrilhos
+    // do mesmo grupo, contando o pincel
+    const int margin = std::max(1, std::min(settings.lifetime + 1, settings.tileSize / 2 - r - 2));
+    const float bx0 = (float)std::max(0, tile.x0 - margin), by0 = (float)std::max(0, tile.y0 - margin);
+    const float bx1 = (float)std::min(width - 1, tile.x1 + margin), by1 = (float)std::min(height - 1, tile.y1 + margin);
+    // As gotas nascem dentro do ladrilho
+    const int sx1 = std::min(tile.x1, width - 1), sy1 = std::min(tile.y1, height - 1);
+    if (sx1 <= tile.x0 || sy1 <= tile.y0) return;
+
+    float px[BATCH], py[BATCH], dx[BATCH], dy[BATCH], speed[BATCH], water[BATCH], sediment[BATCH];
+    bool alive[BATCH];
+    int minX = width, minY = height, maxX = -1, maxY = -1;
+    Random random(seed);
+
+    for (int first = 0; first < count; first += BATCH) {
+        const int n = std::min(BATCH, count - first);
+        for (int i = 0; i < n; i++) {
+            px[i] = std::min(tile.x0 + random.next() * (sx1 - tile.x0), sx1 - 0.5f);
+            py[i] = std::min(tile.y0 + random.next() * (sy1 - tile.y0), sy1 - 0.5f);
+            dx[i] = dy[i] = 0.0f;
+            speed[i] = 1.0f;
+            water[i] = 1.0f;
+            sediment[i] = 0.0f;
+            alive[i] = true;
+        }
+
+        int remaining = n;
+        for (int step = 0; step < lifetime && remaining > 0; step++) {
+            for (int i = 0; i < n; i++) {
+                if (!alive[i]) continue;
+
+                // Altura e gradiente interpolados na celula atual
+                const int cx = (int)px[i], cy = (int)py[i];
+                const float u = px[i] - cx, v = py[i] - cy;
+                const size_t cell = (size_t)cy * w + cx;
+                const float h00 = h[cell], h10 = h[cell + 1], h01 = h[cell + w], h11 = h[cell + w + 1];
+                const float gx = ((h10 - h00) * (1.0f - v) + (h11 - h01) * v) * scale;
+                const float gy = ((h01 - h00) * (1.0f - u) + (h11 - h10) * u) * scale;
+                const float current = (h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) +
+                                       h01 * (1.0f - u) * v + h11 * u * v) * scale;
+
+                // Nova direcao: mistura da anterior com a descida do gradiente
+                float ndx = dx[i] * inertia - gx * (1.0f - inertia);
+                float ndy = dy[i] * inertia - gy * (1.0f - inertia);
+                const float length = sqrtf(ndx * ndx + ndy * ndy);
+                if (length <= 1e-6f) {
+                    // parada num plano: evapora
+                    alive[i] = false;
+                    remaining--;
+                    continue;
+                }
+                ndx /= length;
+                ndy /= length;
+                const float nx = px[i] + ndx, ny = py[i] + ndy;
+                if (nx < bx0 || ny < by0 || nx >= bx1 || ny >= by1) {
+                    alive[i] = false;
+                    remaining--;
+                    continue;
+                }
+
+                minX = std::min(minX, cx);
+                minY = std::min(minY, cy);
+                maxX = std::max(maxX, cx);
+                maxY = std::max(maxY, cy);
+
+                const int ix = (int)nx, iy = (int)ny;
+                const float nu = nx - ix, nv = ny - iy;
+                const size_t next = (size_t)iy * w + ix;
+                const float target = (h[next] * (1.0f - nu) * (1.0f - nv) + h[next + 1] * nu * (1.0f - nv) +
+                                      h[next + w] * (1.0f - nu) * nv + h[next + w + 1] * nu * nv) * scale;
+                const float delta = target - current;
+
+                const float capacity =
+                    std::max(-delta * speed[i] * water[i] * capacityFactor, minCapacity);
+                if (sediment[i] > capacity || delta > 0.0f) {
+                    // Subindo ou carregada demais: deposita nos 4 cantos da celula
+                    // (subindo, o bastante para tapar o buraco)
+                    const float amount = delta > 0.0f ? std::min(delta, sediment[i])
+                                                      : (sediment[i] - capacity) * depositRate;
+                    sediment[i] -= amount;
+                    const float a = amount * invScale;
+                    h[cell] += a * (1.0f - u) * (1.0f - v);
+                    h[cell + 1] += a * u * (1.0f - v);
+                    h[cell + w] += a * (1.0f - u) * v;
+                    h[cell + w + 1] += a * u * v;
+                }
+                else {
+                    // Descendo com folga: arranca material em volta, sem cavar
+                    // mais fundo que o desnivel
+                    const float amount = std::min((capacity - sediment[i]) * erodeRate, -delta);
+                    for (int k = 0; k < brushSize; k++) {
+                        const int x = cx + brushX[k], y = cy + brushY[k];
+                        if (x < 0 || y < 0 || x >= width || y >= height) continue;
+                        float& sample = h[(size_t)y * w + x];
+                        const float removed = std::min(sample * scale, amount * brushWeight[k]);
+                        sample -= removed * invScale;
+                        sediment[i] += removed;
+                    }
+                }
+
+                speed[i] = sqrtf(std::max(0.0f, speed[i] * speed[i] - delta * gravity));
+                water[i] *= evaporation;
+                px[i] = nx;
+                py[i] = ny;
+                dx[i] = ndx;
+                dy[i] = ndy;
+            }
+        }
+    }
+
+    if (maxX >= 0) {
+        touched.x0 = std::max(0, minX - r);
+        touched.y0 = std::max(0, minY - r);
+        touched.width = std::min(width, maxX + r + 2) - touched.x0;
+        touched.height = std::min(height, maxY + r + 2) - touched.y0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Termica
+
+// Fluxo vindo de um vizinho d mais alto (ou indo, se d < 0): o que passa do talude
+static inline float thermalFlux(float d, float talus) {
+    return d - std::min(std::max(d, -talus), talus);
+}
+
+static inline __m128 thermalFlux(__m128 d, __m128 talus, __m128 negTalus) {
+    return _mm_sub_ps(d, _mm_min_ps(_mm_max_ps(d, negTalus), talus));
+}
+
+// Uma iteracao nas colunas [x0, x1) de uma linha; as duas versoes fazem as
+// mesmas operacoes na mesma ordem
+static void thermalRow(const float* below, const float* row, const float* above, float* out, int x0, int x1,
+                       float rate, float talus, bool simd) {
+    int x = x0;
+    if (simd) {
+        const __m128 t = _mm_set1_ps(talus), nt = _mm_set1_ps(-talus), k = _mm_set1_ps(rate);
+        for (; x + 4 <= x1; x += 4) {
+            __m128 c = _mm_loadu_ps(row + x);
+            __m128 sum = _mm_add_ps(thermalFlux(_mm_sub_ps(_mm_loadu_ps(row + x - 1), c), t, nt),
+                                    thermalFlux(_mm_sub_ps(_mm_loadu_ps(row + x + 1), c), t, nt));
+            sum = _mm_add_ps(sum, thermalFlux(_mm_sub_ps(_mm_loadu_ps(below + x), c), t, nt));
+            sum = _mm_add_ps(sum, thermalFlux(_mm_sub_ps(_mm_loadu_ps(above + x), c), t, nt));
+            _mm_storeu_ps(out + x, _mm_add_ps(c, _mm_mul_ps(k, sum)));
+        }
+    }
+    for (; x < x1; x++) {
+        float c = row[x];
+        float sum = thermalFlux(row[x - 1] - c, talus) + thermalFlux(row[x + 1] - c, talus);
+        sum = sum + thermalFlux(below[x] - c, talus);
+        sum = sum + thermalFlux(above[x] - c, talus);
+        out[x] = c + rate * sum;
+    }
+}
+
+void Erosion::thermal(int iterations) {
+    PROFILE_SCOPE("Erosion::thermal");
+    if (iterations <= 0 || width < 2 || height < 2) return;
+
+    buffer.resize((size_t)width * height);
+    float* src = map.getData();
+    float* dst = buffer.data();
+    std::vector<unsigned char> changed(tiles.size(), 0);
+
+    while (iterations > 0) {
+        const int steps = std::min((int)HALO, iterations);
+        ThreadPool::shared().parallelFor(tiles.size(), [&](size_t begin, size_t end) {
+            std::vector<float> a, b;
+            for (size_t t = begin; t < end; t++) {
+                bool tileChanged = false;
+                thermalTile(tiles[t], src, dst, steps, a, b, tileChanged);
+                if (tileChanged) changed[t] = 1;
+            }
+        });
+        std::swap(src, dst);
+        iterations -= steps;
+    }
+
+    // numero impar de trocas: o resultado esta' no buffer
+    if (src != map.getData()) {
+        float* out = map.getData();
+        ThreadPool::shared().parallelFor((size_t)height, [&](size_t begin, size_t end) {
+            memcpy(out + begin * width, src + begin * width, (end - begin) * width * sizeof(float));
+        }, 64);
+    }
+
+    for (size_t t = 0; t < tiles.size(); t++) {
+        if (changed[t]) dirty[t] = 1;
+    }
+}
+
+// Copia o ladrilho com halo de steps amostras (fora do mapa repete a borda),
+// avanca steps iteracoes encolhendo a regiao valida de uma amostra por
+// iteracao e grava o interior em dst
+void Erosion::thermalTile(const Tile& tile, const float* src, float* dst, int steps, std::vector<float>& a,
+                          std::vector<float>& b, bool& changed) const {
+    const int lw = tile.x1 - tile.x0 + 2 * steps, lh = tile.y1 - tile.y0 + 2 * steps;
+    const int ox = tile.x0 - steps, oy = tile.y0 - steps;    // canto do buffer local no mapa
+    a.resize((size_t)lw * lh);
+    b.resize((size_t)lw * lh);
+
+    for (int ly = 0; ly < lh; ly++) {
+        const float* line = src + (size_t)std::min(std::max(oy + ly, 0), height - 1) * width;
+        float* out = a.data() + (size_t)ly * lw;
+        for (int lx = 0; lx < lw; lx++) out[lx] = line[std::min(std::max(ox + lx, 0), width - 1)];
+    }
+
+    const float rate = 0.125f * settings.thermalRate;
+    const float talus = settings.talus / settings.heightScale;
+    // Colunas e linhas locais da primeira e da ultima amostra dentro do mapa
+    const int left = -ox, right = width - 1 - ox, bottom = -oy, top = height - 1 - oy;
+
+    for (int s = 1; s <= steps; s++) {
+        const int x0 = s, x1 = lw - s, y0 = s, y1 = lh - s;
+        for (int ly = y0; ly < y1; ly++) {
+            const float* row = a.data() + (size_t)ly * lw;
+            thermalRow(row - lw, row, row + lw, b.data() + (size_t)ly * lw, x0, x1, rate, talus, settings.simd);
+        }
+
+        // Fora do mapa as amostras repetem a borda, entao nada flui por ela
+        for (int ly = y0; ly < y1; ly++) {
+            float* row = b.data() + (size_t)ly * lw;
+            for (int lx = x0; lx < std::min(left, x1); lx++) row[lx] = row[left];
+            for (int lx = std::max(right + 1, x0); lx < x1; lx++) row[lx] = row[right];
+        }
+        for (int ly = y0; ly < std::min(bottom, y1); ly++) {
+            memcpy(b.data() + (size_t)ly * lw + x0, b.data() + (size_t)bottom * lw + x0, (x1 - x0) * sizeof(float));
+        }
+        for (int ly = std::max(top + 1, y0); ly < y1; ly++) {
+            memcpy(b.data() + (size_t)ly * lw + x0, b.data() + (size_t)top * lw + x0, (x1 - x0) * sizeof(float));
+        }
+        a.swap(b);
+    }
+
+    for (int y = tile.y0; y < tile.y1; y++) {
+        const float* in = a.data() + (size_t)(y - oy) * lw + steps;
+        const float* old = src + (size_t)y * width + tile.x0;
+        float* out = dst + (size_t)y * width + tile.x0;
+        const int count = tile.x1 - tile.x0;
+        if (!changed && memcmp(in, old, count * sizeof(float)) != 0) changed = true;
+        memcpy(out, in, count * sizeof(float));
+    }
+}
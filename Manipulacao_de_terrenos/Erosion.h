@@ -0,0 +1,102 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <stddef.h>
+#include <vector>
+
+class HeightMap;
+
+// Erosao de um HeightMap (alturas normalizadas) em passadas curtas, que podem
+// ser intercaladas com o render: depois de cada passada takeDirty() diz quais
+// regioes mudaram, para o Terrain refazer so' as malhas delas.
+//
+// - hydraulic(): gotas de chuva que descem o relevo arrancando material onde
+//   aceleram e depositando onde perdem velocidade (Hans Beyer, 2015). O estado
+//   das gotas fica em vetores separados (posicao, direcao, velocidade, agua,
+//   sedimento) e um lote de gotas anda um passo por vez.
+// - thermal(): o material acima do angulo de repouso escorrega para os 4
+//   vizinhos. Kernel de grade em SSE2 (opcional, mesmo resultado do escalar).
+//
+// O mapa e' dividido em ladrilhos processados em paralelo no
+// ThreadPool::shared(). Na termica cada ladrilho copia sua regiao mais uma
+// borda (halo) de HALO amostras, avanca ate' HALO iteracoes sem falar com os
+// vizinhos e grava o interior em outro buffer; so' entao os halos sao trocados
+// pela proxima copia. Na hidraulica as gotas de um ladrilho nao saem do
+// ladrilho mais uma margem menor que meio ladrilho, entao os ladrilhos rodam
+// em 4 grupos alternados (xadrez 2x2) sem dois escrevendo no mesmo lugar.
+// Em ambas o resultado nao depende do numero de threads.
+class Erosion {
+public:
+    struct Settings {
+        unsigned int seed;
+        float heightScale;       // altura no mundo de uma amostra 1.0 (o Terrain usa 20)
+        int tileSize;            // lado dos ladrilhos, em amostras (minimo 32)
+        bool simd;               // kernel termico em SSE2
+
+        // Hidraulica
+        int lifetime;            // passos de cada gota (limitado a meio ladrilho)
+        int radius;              // raio do pincel de erosao
+        float inertia;           // 0: segue o gradiente; 1: ignora o relevo
+        float capacity;          // sedimento por desnivel * velocidade * agua
+        float minCapacity;
+        float erodeRate;
+        float depositRate;
+        float evaporateRate;
+        float gravity;
+
+        // Termica
+        float talus;             // desnivel estavel entre vizinhos, em unidades do mundo
+        float thermalRate;       // fracao (0, 1] do excesso movida por iteracao
+
+        Settings()
+            : seed(1234u), heightScale(20.0f), tileSize(128), simd(true),
+              lifetime(30), radius(3), inertia(0.05f), capacity(4.0f), minCapacity(0.01f), erodeRate(0.3f),
+              depositRate(0.3f), evaporateRate(0.01f), gravity(4.0f),
+              talus(0.7f), thermalRate(0.5f) {}
+    };
+
+    // Retangulo [x0, x0 + width) x [y0, y0 + height) do mapa
+    struct Region {
+        int x0, y0, width, height;
+    };
+
+    // O mapa e' alterado no lugar e precisa existir enquanto o Erosion existir
+    explicit Erosion(HeightMap& map, const Settings& settings = Settings());
+
+    // droplets gotas espalhadas uniformemente pelo mapa
+    void hydraulic(int droplets);
+    void thermal(int iterations);
+
+    // Regioes (ladrilhos) alteradas desde a ultima chamada
+    void takeDirty(std::vector<Region>& regions);
+
+    const Settings& getSettings() const { return settings; }
+    long long getDropletCount() const { return droplets; }
+
+private:
+    // Iteracoes termicas entre trocas de halo
+    static const int HALO = 4;
+
+    struct Tile {
+        int x0, y0, x1, y1;
+    };
+
+    HeightMap& map;
+    Settings settings;
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<Tile> tiles;
+    std::vector<unsigned char> dirty;    // um por ladrilho
+    std::vector<float> buffer;           // segundo buffer da termica
+    std::vector<int> brushX, brushY;     // pincel de erosao: deslocamentos e pesos
+    std::vector<float> brushWeight;
+    unsigned int passCount;
+    long long droplets;
+
+    void markDirty(int x0, int y0, int x1, int y1);
+    void simulateDroplets(const Tile& tile, int count, unsigned int seed, Region& touched) const;
+    void thermalTile(const Tile& tile, const float* src, float* dst, int steps, std::vector<float>& a,
+                     std::vector<float>& b, bool& changed) const;
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "HeightMap.h"
+#include "../Comum/Bmp.h"
+#include "Png.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <stdio.h>
+
+HeightMap::HeightMap()
+    : width(0), height(0)
+{
+}
+
+void HeightMap::resize(int w, int h) {
+    width = w;
+    height = h;
+    heights.assign((size_t)w * h, 0.0f);
+}
+
+// hash inteiro -> [0,1), usado como valor nos vertices da grade de ruido
+static float latticeValue(int x, int y, unsigned int seed) {
+    unsigned int h = seed ^ (unsigned int)x * 374761393u ^ (unsigned int)y * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (h & 0xffffff) / 16777216.0f;
+}
+
+static float valueNoise(float x, float y, unsigned int seed) {
+    int xi = (int)std::floor(x), yi = (int)std::floor(y);
+    float tx = x - xi, ty = y - yi;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    ty = ty * ty * (3.0f - 2.0f * ty);
+    float a = latticeValue(xi, yi, seed), b = latticeValue(xi + 1, yi, seed);
+    float c = latticeValue(xi, yi + 1, seed), d = latticeValue(xi + 1, yi + 1, seed);
+    return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * ty;
+}
+
+void HeightMap::generateFractal(int w, int h, unsigned int seed, int octaves, float persistence) {
+    resize(w, h);
+
+    // a oitava mais grave tem ~4 celulas no lado maior, independente do tamanho
+    float baseFrequency = 4.0f / std::max(w, h);
+    float norm = 0.0f, amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        norm += amplitude;
+        amplitude *= persistence;
+    }
+
+    for (int y = 0; y < height; y++) {
+        float* dst = heights.data() + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            float sum = 0.0f, frequency = baseFrequency;
+            amplitude = 1.0f;
+            for (int o = 0; o < octaves; o++) {
+                sum += amplitude * valueNoise(x * frequency, y * frequency, seed + o * 1013u);
+                frequency *= 2.0f;
+                amplitude *= persistence;
+            }
+            dst[x] = sum / norm;
+        }
+    }
+}
+
+bool HeightMap::load(const std::string& path) {
+    std::string ext;
+    size_t dot = path.find_last_of('.');
+    if (dot != std::string::npos) ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == "pgm") return loadPGM(path);
+    if (ext == "png") return loadPNG(path);
+    if (ext == "r16" || ext == "raw") return loadRaw16(path);
+    if (ext == "r32" || ext == "f32") return loadRawFloat(path);
+    return loadBMP(path);
+}
+
+bool HeightMap::loadBMP(const std::string& path) {
+    Bmp bmp(path.c_str());
+    unsigned char* data = bmp.getImage();
+    if (data == NULL) return false;
+
+    // BMP ja' vem de baixo para cima; usa o canal 0 como altura
+    resize(bmp.getWidth(), bmp.getHeight());
+    int bytesPerLine = (3 * width + 3) / 4 * 4;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = data + (size_t)y * bytesPerLine;
+        float* dst = heights.data() + (size_t)y * width;
+        for (int x = 0; x < width; x++) dst[x] = src[x * 3] / 255.0f;
+    }
+    return true;
+}
+
+bool HeightMap::loadPGM(const std::string& path) {
+    FILE* fp;
+    fopen_s(&fp, path.c_str(), "rb");
+    if (fp == NULL) {
+        std::cerr << "Erro ao abrir arquivo " << path << std::endl;
+        return false;
+    }
+
+    // cabecalho: "P5" largura altura maxval, com comentarios iniciados por '#'
+    int fields[3] = { 0, 0, 0 };
+    char magic[3] = { 0, 0, 0 };
+    bool ok = fread(magic, 1, 2, fp) == 2 && magic[0] == 'P' && magic[1] == '5';
+    for (int i = 0; ok && i < 3; i++) {
+        int c = fgetc(fp);
+        while (c == '#' || isspace(c)) {
+            if (c == '#') while (c != '\n' && c != EOF) c = fgetc(fp);
+            c = fgetc(fp);
+        }
+        ungetc(c, fp);
+        ok = fscanf_s(fp, "%d", &fields[i]) == 1;
+    }
+    ok = ok && isspace(fgetc(fp)) && fields[0] > 0 && fields[1] > 0 && fields[2] > 0 && fields[2] < 65536;
+    if (!ok) {
+        std::cerr << "Erro: arquivo PGM (P5) invalido " << path << std::endl;
+        fclose(fp);
+        return false;
+    }
+
+    resize(fields[0], fields[1]);
+    int maxval = fields[2];
+    int bytesPerSample = maxval < 256 ? 1 : 2;
+    float scale = 1.0f / maxval;
+
+    // le uma linha por vez direto para o campo de alturas
+    std::vector<unsigned char> line((size_t)width * bytesPerSample);
+    for (int y = 0; y < height; y++) {
+        if (fread(line.data(), 1, line.size(), fp) != line.size()) {
+            std::cerr << "Erro: arquivo PGM truncado " << path << std::endl;
+            fclose(fp);
+            return false;
+        }
+        float* dst = row(y);
+        if (bytesPerSample == 1) {
+            for (int x = 0; x < width; x++) dst[x] = line[x] * scale;
+        }
+        else {
+            // PGM de 16 bits e' big-endian
+            for (int x = 0; x < width; x++) dst[x] = ((line[2 * x] << 8) | line[2 * x + 1]) * scale;
+        }
+    }
+
+    fclose(fp);
+    return true;
+}
+
+bool HeightMap::loadPNG(const std::string& path) {
+    return Png::decode(path.c_str(),
+        [this](int w, int h) { resize(w, h); },
+        [this](int y, const unsigned short* src) {
+            float* dst = row(y);
+            for (int x = 0; x < width; x++) dst[x] = src[x] / 65535.0f;
+        });
+}
+
+bool HeightMap::rawDimensions(const std::string& path, int bytesPerSample, int& w, int& h) {
+    if (w > 0 && h > 0) return true;
+
+    FILE* fp;
+    fopen_s(&fp, path.c_str(), "rb");
+    if (fp == NULL) return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+
+    long samples = size / bytesPerSample;
+    int side = (int)std::lround(std::sqrt((double)samples));
+    if (side <= 0 || (long)side * side != samples) {
+        std::cerr << "Erro: RAW " << path << " nao e' quadrado; informe largura e altura" << std::endl;
+        return false;
+    }
+    w = h = side;
+    return true;
+}
+
+bool HeightMap::loadRaw16(const std::string& path, int rawWidth, int rawHeight) {
+    if (!rawDimensions(path, 2, rawWidth, rawHeight)) return false;
+
+    FILE* fp;
+    fopen_s(&fp, path.c_str(), "rb");
+    if (fp == NULL) {
+        std::cerr << "Erro ao abrir arquivo " << path << std::endl;
+        return false;
+    }
+
+    resize(rawWidth, rawHeight);
+    std::vector<unsigned char> line((size_t)width * 2);
+    for (int y = 0; y < height; y++) {
+        if (fread(line.data(), 1, line.size(), fp) != line.size()) {
+            std::cerr << "Erro: arquivo RAW truncado " << path << std::endl;
+            fclose(fp);
+            return false;
+        }
+        float* dst = row(y);
+        for (int x = 0; x < width; x++) dst[x] = (line[2 * x] | (line[2 * x + 1] << 8)) / 65535.0f;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+bool HeightMap::loadRawFloat(const std::string& path, int rawWidth, int rawHeight) {
+    if (!rawDimensions(path, 4, rawWidth, rawHeight)) return false;
+
+    FILE* fp;
+    fopen_s(&fp, path.c_str(), "rb");
+    if (fp == NULL) {
+        std::cerr << "Erro ao abrir arquivo " << path << std::endl;
+        return false;
+    }
+
+    // float32 little-endian: mesma representacao da memoria em x86/x64,
+    // entao cada linha e' lida direto no destino
+    resize(rawWidth, rawHeight);
+    for (int y = 0; y < height; y++) {
+        if (fread(row(y), sizeof(float), width, fp) != (size_t)width) {
+            std::cerr << "Erro: arquivo RAW truncado " << path << std::endl;
+            fclose(fp);
+            return false;
+        }
+    }
+
+    fclose(fp);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <string>
+#include <vector>
+
+// Campo de alturas em float, uma amostra por texel, usado como entrada do Terrain.
+//
+// Formatos inteiros sao normalizados para [0,1] pelo valor maximo do formato;
+// RAW float e' mantido como esta' no arquivo. A linha 0 e' a linha de baixo da
+// imagem (convencao do BMP), por isso os formatos gravados de cima para baixo
+// sao invertidos na leitura.
+class HeightMap {
+public:
+    HeightMap();
+
+    // Escolhe o carregador pela extensao: .bmp, .pgm, .png, .r16/.raw, .r32/.f32
+    bool load(const std::string& path);
+
+    bool loadBMP(const std::string& path);
+    bool loadPGM(const std::string& path);
+    bool loadPNG(const std::string& path);
+    // RAW sem cabecalho, little-endian. Com width/height = 0 assume mapa quadrado.
+    bool loadRaw16(const std::string& path, int rawWidth = 0, int rawHeight = 0);
+    bool loadRawFloat(const std::string& path, int rawWidth = 0, int rawHeight = 0);
+
+    // Mapa sintetico (fBm de value noise) deterministico para um dado seed,
+    // para testar terrenos grandes sem precisar de arquivos
+    void generateFractal(int w, int h, unsigned int seed, int octaves = 8, float persistence = 0.5f);
+
+    void resize(int w, int h);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float at(int x, int y) const { return heights[(size_t)y * width + x]; }
+    float* getData() { return heights.data(); }
+    const float* getData() const { return heights.data(); }
+
+private:
+    int width, height;
+    std::vector<float> heights;
+
+    float* row(int fileRow) { return heights.data() + (size_t)(height - 1 - fileRow) * width; }
+    bool rawDimensions(const std::string& path, int bytesPerSample, int& w, int& h);
+};
+
+#endif
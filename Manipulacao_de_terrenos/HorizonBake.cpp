@@ -0,0 +1,185 @@
+#include "HorizonBake.h"
+#include <algorithm>
+#include <math.h>
+#include "HeightMap.h"
+#include "../Comum/Profiler.h"
+#include "../Comum/ThreadPool.h"
+
+static const float PI = 3.14159265f;
+// Linhas de varredura processadas juntas por uma thread
+static const int LINE_GROUP = 16;
+
+// Ponto ja' visto de uma linha: distancia ao longo da direcao e altura
+struct HullPoint {
+    float t, z;
+};
+
+static inline unsigned char toByte(float v) {
+    return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+HorizonBake::HorizonBake(const Settings& s)
+    : settings(s), width(0), height(0)
+{
+    settings.azimuths = std::min(std::max(settings.azimuths, 1), 64);
+}
+
+void HorizonBake::bake(const HeightMap& map) {
+    PROFILE_SCOPE("HorizonBake::bake");
+    width = map.getWidth();
+    height = map.getHeight();
+    const size_t count = (size_t)width * height;
+    horizons.assign(count * settings.azimuths, 0);
+    lighting.assign(count * 4, 0);
+    if (count == 0) return;
+
+    const float* heights = map.getData();
+    float maxHeight = 0.0f;
+    for (size_t i = 0; i < count; i++) maxHeight = std::max(maxHeight, heights[i]);
+    const float scale = settings.heightScale / (maxHeight > 0.0f ? maxHeight : 1.0f);
+
+    for (int a = 0; a < settings.azimuths; a++) sweep(a, heights, scale);
+
+    // Ceu visivel e normal, uma faixa de linhas por tarefa. Ponteiros e
+    // tamanhos em copias locais: como uma escrita de byte pode alterar
+    // qualquer coisa, com membros o compilador os releria a cada amostra
+    const int n = settings.azimuths, w = width, h = height;
+    const float invCount = 1.0f / n;
+    const unsigned char* horizon = horizons.data();
+    unsigned char* light = lighting.data();
+    ThreadPool::shared().parallelFor((size_t)height, [=](size_t begin, size_t end) {
+        for (int y = (int)begin; y < (int)end; y++) {
+            const int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, h - 1);
+            for (int x = 0; x < w; x++) {
+                const size_t i = (size_t)y * w + x;
+                // horizonte de elevacao h tapa 1 - cos^2(h) = sin^2(h) do ceu (peso do cosseno)
+                float visible = 0.0f;
+                for (int a = 0; a < n; a++) {
+                    float s = horizon[i * n + a] * (1.0f / 255.0f);
+                    visible += 1.0f - s * s;
+                }
+
+                // diferencas centrais (de um lado so' na borda)
+                const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, w - 1);
+                const float gx = (heights[(size_t)y * w + x1] - heights[(size_t)y * w + x0]) * scale *
+                                 (x1 - x0 == 2 ? 0.5f : 1.0f);
+                const float gz = (heights[(size_t)y1 * w + x] - heights[(size_t)y0 * w + x]) * scale *
+                                 (y1 - y0 == 2 ? 0.5f : 1.0f);
+                const float normal = 0.5f / sqrtf(gx * gx + 1.0f + gz * gz);
+
+                unsigned char* out = light + i * 4;
+                out[0] = toByte(visible * invCount);
+                out[2] = toByte(0.5f - gx * normal);
+                out[3] = toByte(0.5f - gz * normal);
+            }
+        }
+    }, 16);
+
+    shadeSun();
+}
+
+// Linhas paralelas a' direcao do azimute, uma amostra por coluna (ou linha)
+// do eixo mais alinhado com ela: no eixo menor a linha anda s < 1 por passo e
+// cada amostra fica com a linha que passa a menos de meia amostra dela, entao
+// linhas vizinhas nunca escrevem na mesma amostra
+void HorizonBake::sweep(int azimuth, const float* heights, float scale) {
+    const float angle = 2.0f * PI * azimuth / settings.azimuths;
+    const float dx = cosf(angle), dy = sinf(angle);
+    const bool majorX = fabsf(dx) >= fabsf(dy);
+    const int U = majorX ? width : height, V = majorX ? height : width;
+    const float du = majorX ? dx : dy, dv = majorX ? dy : dx;
+    const float s = dv / du;
+    const int stepU = du > 0.0f ? 1 : -1;
+    const float stepLength = sqrtf(1.0f + s * s);
+
+    // linha i: v = i + s * u
+    const int first = (int)floorf(std::min(0.0f, -s * (U - 1))) - 1;
+    const int last = V + (int)ceilf(std::max(0.0f, -s * (U - 1)));
+    const int n = settings.azimuths, w = width;
+    unsigned char* out = horizons.data() + azimuth;
+
+    // Um grupo de linhas vizinhas anda junto: no mesmo passo elas leem
+    // amostras vizinhas, o que importa quando a linha corta as linhas do mapa
+    ThreadPool::shared().parallelFor((size_t)(last - first + 1), [=](size_t begin, size_t end) {
+        // fechos das linhas do grupo, cada um com espaco para a linha inteira
+        std::vector<HullPoint> hullStorage((size_t)LINE_GROUP * U);
+        int sizes[LINE_GROUP];
+        for (size_t group = begin; group < end; group += LINE_GROUP) {
+            const int lines = (int)std::min((size_t)LINE_GROUP, end - group);
+            for (int l = 0; l < lines; l++) sizes[l] = 0;
+
+            // de tras para frente: os pontos no fecho estao a' frente do atual
+            for (int k = 0; k < U; k++) {
+                const int u = stepU > 0 ? U - 1 - k : k;
+                const float t = (float)(u * stepU) * stepLength;
+                for (int l = 0; l < lines; l++) {
+                    const int v = (int)floorf((float)(first + (int)group + l) + s * u + 0.5f);
+                    if (v < 0 || v >= V) continue;
+                    const size_t i = majorX ? (size_t)v * w + u : (size_t)u * w + v;
+                    const HullPoint q = { t, heights[i] * scale };
+                    HullPoint* hull = &hullStorage[(size_t)l * U];
+                    int size = sizes[l];
+
+                    // tira do topo os pontos abaixo do segmento q -> anterior a eles
+                    while (size >= 2) {
+                        const HullPoint& b = hull[size - 1];
+                        const HullPoint& a = hull[size - 2];
+                        if ((b.z - q.z) * (a.t - q.t) > (a.z - q.z) * (b.t - q.t)) break;
+                        size--;
+                    }
+                    if (size > 0) {
+                        const float rise = hull[size - 1].z - q.z;
+                        if (rise > 0.0f) {
+                            const float run = hull[size - 1].t - q.t;
+                            out[i * n] = toByte(rise / sqrtf(rise * rise + run * run));
+                        }
+                    }
+                    hull[size] = q;
+                    sizes[l] = size + 1;
+                }
+            }
+        }
+    }, LINE_GROUP);
+}
+
+float HorizonBake::horizon(int x, int y, int a) const {
+    return asinf(horizons[((size_t)y * width + x) * settings.azimuths + a] * (1.0f / 255.0f));
+}
+
+void HorizonBake::setSun(float azimuth, float elevation) {
+    settings.sunAzimuth = azimuth;
+    settings.sunElevation = elevation;
+    if (!lighting.empty()) shadeSun();
+}
+
+void HorizonBake::sunDirection(float& x, float& y, float& z) const {
+    x = cosf(settings.sunElevation) * cosf(settings.sunAzimuth);
+    y = sinf(settings.sunElevation);
+    z = cosf(settings.sunElevation) * sinf(settings.sunAzimuth);
+}
+
+// Horizonte na direcao do sol interpolado entre os dois azimutes vizinhos
+void HorizonBake::shadeSun() {
+    const int n = settings.azimuths;
+    float position = settings.sunAzimuth / (2.0f * PI) * n;
+    position -= floorf(position / n) * n;
+    const int a0 = std::min((int)position, n - 1), a1 = (a0 + 1) % n;
+    const float f = position - a0;
+    const float elevation = settings.sunElevation, penumbra = std::max(settings.penumbra, 1e-4f);
+    const float invWidth = 0.5f / penumbra;
+
+    // asin de cada valor quantizado, calculado uma vez
+    float angles[256];
+    for (int i = 0; i < 256; i++) angles[i] = asinf(i / 255.0f);
+
+    const unsigned char* horizon = horizons.data();
+    unsigned char* light = lighting.data();
+    ThreadPool::shared().parallelFor((size_t)width * height, [&, horizon, light](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float h = angles[horizon[i * n + a0]] * (1.0f - f) + angles[horizon[i * n + a1]] * f;
+            float t = (elevation - h + penumbra) * invWidth;
+            t = std::min(std::max(t, 0.0f), 1.0f);
+            light[i * 4 + 1] = toByte(t * t * (3.0f - 2.0f * t));
+        }
+    }, 4096);
+}
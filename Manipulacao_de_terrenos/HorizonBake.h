@@ -0,0 +1,66 @@
+#ifndef HORIZONBAKE_H
+#define HORIZONBAKE_H
+
+#include <vector>
+
+class HeightMap;
+
+// Iluminacao pre-calculada de um HeightMap, para o shader do terreno so'
+// ler uma textura por fragmento em vez de calcular sombras a cada quadro.
+//
+// Para cada amostra e cada um de N azimutes guarda o angulo do horizonte (a
+// maior elevacao do relevo vista dali naquela direcao). Os horizontes saem de
+// uma varredura por azimute: o mapa e' percorrido em linhas paralelas a'
+// direcao, de tras para frente, mantendo o fecho convexo superior dos pontos
+// ja' vistos, entao cada amostra custa O(1) amortizado (Timonen e Westerholm,
+// 2010). As linhas sao independentes e rodam em paralelo no ThreadPool::shared().
+//
+// A partir dos horizontes:
+// - ceu visivel: fracao do hemisferio nao bloqueada, com peso do cosseno (AO);
+// - sombra do sol: 1 onde o sol esta' acima do horizonte na direcao dele,
+//   com uma penumbra suave; setSun() refaz so' isso, sem nova varredura.
+//
+// getLighting() devolve RGBA8 por amostra (linha 0 = linha 0 do mapa):
+// R = ceu visivel, G = sol visivel, B e A = x e z da normal em [0,1].
+// Coordenadas: a coluna do mapa e' o x do mundo e a linha e' o z, com a
+// altura ja' multiplicada por heightScale, como na malha do Terrain.
+class HorizonBake {
+public:
+    struct Settings {
+        int azimuths;            // direcoes de horizonte (ate' 64)
+        float heightScale;       // altura no mundo de uma amostra 1.0 (o Terrain usa 20)
+        float sunAzimuth;        // radianos, 0 = +x, pi/2 = +z
+        float sunElevation;      // radianos acima do horizonte
+        float penumbra;          // meia largura da transicao luz/sombra, em radianos
+
+        Settings()
+            : azimuths(16), heightScale(20.0f), sunAzimuth(2.356f), sunElevation(0.35f), penumbra(0.04f) {}
+    };
+
+    explicit HorizonBake(const Settings& settings = Settings());
+
+    // Normaliza pela maior altura do mapa, como o Terrain
+    void bake(const HeightMap& map);
+    void setSun(float azimuth, float elevation);
+
+    const Settings& getSettings() const { return settings; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const unsigned char* getLighting() const { return lighting.data(); }
+
+    // Elevacao do horizonte em radianos na amostra (x, y), azimute a
+    float horizon(int x, int y, int a) const;
+    // Direcao para o sol, no mundo (x, y para cima, z)
+    void sunDirection(float& x, float& y, float& z) const;
+
+private:
+    Settings settings;
+    int width, height;
+    std::vector<unsigned char> horizons;   // seno do horizonte * 255, azimutes de cada amostra juntos
+    std::vector<unsigned char> lighting;
+
+    void sweep(int azimuth, const float* heights, float scale);
+    void shadeSun();
+};
+
+#endif
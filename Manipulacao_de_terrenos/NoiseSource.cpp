@@ -0,0 +1,266 @@
+#include "NoiseSource.h"
+#include <algorithm>
+#include <math.h>
+#include <emmintrin.h>
+#include "HeightMap.h"
+#include "../Comum/Profiler.h"
+#include "../Comum/ThreadPool.h"
+
+// Lado dos ladrilhos de generate()
+static const int TILE_SIZE = 64;
+// Oitavas dos dois fBm que deslocam o dominio no WARPED
+static const int WARP_OCTAVES = 4;
+
+// Constantes do simplex 2D: (sqrt(3) - 1) / 2 e (3 - sqrt(3)) / 6
+static const float F2 = 0.36602540378f;
+static const float G2 = 0.21132486540f;
+// Leva a soma das 3 contribuicoes para ~[-1,1] com gradientes (+-1, +-0.5)
+static const float SIMPLEX_SCALE = 88.0f;
+
+// ---------------------------------------------------------------------------
+// O simplex e os fBm sao templates sobre float (uma amostra) e F4 (4 amostras
+// em SSE2) com as mesmas operacoes na mesma ordem, entao sample() e fill()
+// dao exatamente o mesmo valor
+
+struct F4 {
+    __m128 v;
+    F4() {}
+    F4(__m128 v) : v(v) {}
+    F4(float f) : v(_mm_set1_ps(f)) {}
+};
+
+struct I4 {
+    __m128i v;
+    I4() {}
+    I4(__m128i v) : v(v) {}
+};
+
+static inline F4 operator+(F4 a, F4 b) { return _mm_add_ps(a.v, b.v); }
+static inline F4 operator-(F4 a, F4 b) { return _mm_sub_ps(a.v, b.v); }
+static inline F4 operator*(F4 a, F4 b) { return _mm_mul_ps(a.v, b.v); }
+static inline I4 operator+(I4 a, I4 b) { return _mm_add_epi32(a.v, b.v); }
+static inline I4 operator-(I4 a, I4 b) { return _mm_sub_epi32(a.v, b.v); }
+
+static inline F4 floorValue(F4 a) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+}
+static inline float floorValue(float a) { return floorf(a); }
+
+static inline I4 toInt(F4 a) { return _mm_cvttps_epi32(a.v); }
+static inline int toInt(float a) { return (int)a; }
+
+static inline F4 maxZero(F4 a) { return _mm_max_ps(a.v, _mm_setzero_ps()); }
+static inline float maxZero(float a) { return a > 0.0f ? a : 0.0f; }
+
+static inline F4 absValue(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+static inline float absValue(float a) { return fabsf(a); }
+
+// a > b: mascara de bits (F4) ou bool, e o -1/0 inteiro correspondente
+static inline F4 greater(F4 a, F4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+static inline bool greater(float a, float b) { return a > b; }
+static inline F4 maskOne(F4 mask) { return _mm_and_ps(mask.v, _mm_set1_ps(1.0f)); }
+static inline float maskOne(bool mask) { return mask ? 1.0f : 0.0f; }
+static inline I4 maskInt(F4 mask) { return _mm_castps_si128(mask.v); }
+static inline int maskInt(bool mask) { return mask ? -1 : 0; }
+static inline I4 constant(I4, int c) { return _mm_set1_epi32(c); }
+static inline int constant(int, int c) { return c; }
+
+// SSE2 nao tem multiplicacao de 32 bits; duas de 64 (lanes pares e impares)
+static inline __m128i mul32(__m128i a, unsigned int b) {
+    __m128i factor = _mm_set1_epi32((int)b);
+    __m128i even = _mm_mul_epu32(a, factor);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), factor);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Mesmo hash do value noise de HeightMap::generateFractal
+static inline I4 hash(I4 i, I4 j, unsigned int seed) {
+    __m128i h = _mm_xor_si128(_mm_xor_si128(_mm_set1_epi32((int)seed), mul32(i.v, 374761393u)), mul32(j.v, 668265263u));
+    h = mul32(_mm_xor_si128(h, _mm_srli_epi32(h, 13)), 1274126177u);
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+static inline unsigned int hash(int i, int j, unsigned int seed) {
+    unsigned int h = seed ^ (unsigned int)i * 374761393u ^ (unsigned int)j * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return h ^ (h >> 16);
+}
+
+// Produto com um de 8 gradientes (+-1, +-0.5) ou (+-0.5, +-1): o bit 2 do
+// hash troca os eixos e os bits 0 e 1 os sinais
+static inline F4 gradient(I4 h, F4 x, F4 y) {
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h.v, _mm_set1_epi32(4)), _mm_set1_epi32(4)));
+    __m128 u = _mm_or_ps(_mm_and_ps(swap, x.v), _mm_andnot_ps(swap, y.v));
+    __m128 v = _mm_or_ps(_mm_and_ps(swap, y.v), _mm_andnot_ps(swap, x.v));
+    u = _mm_xor_ps(u, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h.v, _mm_set1_epi32(1)), 31)));
+    v = _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h.v, _mm_set1_epi32(2)), 30)));
+    return _mm_add_ps(u, _mm_mul_ps(_mm_set1_ps(0.5f), v));
+}
+
+static inline float gradient(unsigned int h, float x, float y) {
+    float u = (h & 4) ? x : y;
+    float v = (h & 4) ? y : x;
+    if (h & 1) u = -u;
+    if (h & 2) v = -v;
+    return u + 0.5f * v;
+}
+
+// Contribuicao de um vertice: (0.5 - r^2)^4 * (g . d)
+template <typename V, typename H>
+static inline V corner(H h, V x, V y) {
+    V t = maxZero(V(0.5f) - x * x - y * y);
+    t = t * t;
+    return t * t * gradient(h, x, y);
+}
+
+template <typename V, typename I>
+static inline V simplexT(V x, V y, unsigned int seed) {
+    // Celula na grade inclinada e os 3 vertices do triangulo que contem o ponto
+    V s = (x + y) * V(F2);
+    V fi = floorValue(x + s), fj = floorValue(y + s);
+    V t = (fi + fj) * V(G2);
+    V x0 = x - (fi - t), y0 = y - (fj - t);
+
+    // Triangulo de baixo (x0 > y0): segundo vertice (1, 0); senao (0, 1)
+    auto lower = greater(x0, y0);
+    V i1 = maskOne(lower);
+    V j1 = V(1.0f) - i1;
+    V x1 = x0 - i1 + V(G2), y1 = y0 - j1 + V(G2);
+    V x2 = x0 - V(1.0f - 2.0f * G2), y2 = y0 - V(1.0f - 2.0f * G2);
+
+    I i = toInt(fi), j = toInt(fj);
+    I one = constant(i, 1);
+    I lowerInt = maskInt(lower);
+    V n0 = corner(hash(i, j, seed), x0, y0);
+    V n1 = corner(hash(i - lowerInt, j + one + lowerInt, seed), x1, y1);
+    V n2 = corner(hash(i + one, j + one, seed), x2, y2);
+    return V(SIMPLEX_SCALE) * (n0 + n1 + n2);
+}
+
+// Seed de cada oitava (razao aurea em 32 bits: oitavas sem correlacao)
+static inline unsigned int octaveSeed(unsigned int seed, int octave) {
+    return seed + (unsigned int)octave * 0x9E3779B9u;
+}
+
+template <typename V, typename I>
+static inline V fbmT(V x, V y, const NoiseSource::Settings& settings, int octaves, unsigned int seed) {
+    V sum(0.0f);
+    float amplitude = 1.0f, frequency = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum = sum + V(amplitude) * simplexT<V, I>(x * V(frequency), y * V(frequency), octaveSeed(seed, o));
+        amplitude *= settings.gain;
+        frequency *= settings.lacunarity;
+    }
+    return sum;
+}
+
+template <typename V, typename I>
+static inline V ridgedT(V x, V y, const NoiseSource::Settings& settings) {
+    V sum(0.0f);
+    float amplitude = 1.0f, frequency = 1.0f;
+    for (int o = 0; o < settings.octaves; o++) {
+        V ridge = V(1.0f) - absValue(simplexT<V, I>(x * V(frequency), y * V(frequency), octaveSeed(settings.seed, o)));
+        sum = sum + V(amplitude) * ridge * ridge;
+        amplitude *= settings.gain;
+        frequency *= settings.lacunarity;
+    }
+    return sum;
+}
+
+static float amplitudeSum(const NoiseSource::Settings& settings, int octaves) {
+    float sum = 0.0f, amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += amplitude;
+        amplitude *= settings.gain;
+    }
+    return sum > 0.0f ? sum : 1.0f;
+}
+
+// Altura em [0,1] no ponto (x, y) ja' em unidades de ruido (amostra * frequency)
+template <typename V, typename I>
+static inline V heightT(V x, V y, const NoiseSource::Settings& settings, float norm) {
+    if (settings.type == NoiseSource::RIDGED) {
+        return ridgedT<V, I>(x, y, settings) * V(norm);
+    }
+    if (settings.type == NoiseSource::WARPED) {
+        // q = (fbm(p), fbm(p + (5.2, 1.3))) com outro seed; altura = fbm(p + warp * q)
+        const int warpOctaves = std::min(settings.octaves, WARP_OCTAVES);
+        const float warpNorm = 1.0f / amplitudeSum(settings, warpOctaves);
+        const unsigned int warpSeed = settings.seed ^ 0x5bd1e995u;
+        V strength(settings.warp * settings.frequency * warpNorm);
+        V qx = fbmT<V, I>(x, y, settings, warpOctaves, warpSeed);
+        V qy = fbmT<V, I>(x + V(5.2f), y + V(1.3f), settings, warpOctaves, warpSeed);
+        x = x + strength * qx;
+        y = y + strength * qy;
+    }
+    return V(0.5f) + V(0.5f * norm) * fbmT<V, I>(x, y, settings, settings.octaves, settings.seed);
+}
+
+// ---------------------------------------------------------------------------
+// NoiseSource
+
+NoiseSource::NoiseSource() : settings(), norm(1.0f / amplitudeSum(settings, settings.octaves)) {
+}
+
+NoiseSource::NoiseSource(const Settings& settings)
+    : settings(settings), norm(1.0f / amplitudeSum(settings, settings.octaves)) {
+}
+
+float NoiseSource::simplex(float x, float y, unsigned int seed) {
+    return simplexT<float, int>(x, y, seed);
+}
+
+float NoiseSource::sample(float x, float y) const {
+    float h = heightT<float, int>(x * settings.frequency, y * settings.frequency, settings, norm);
+    return std::min(std::max(h, 0.0f), 1.0f);
+}
+
+void NoiseSource::fillRow(float x0, float y, int count, float* out) const {
+    const F4 frequency(settings.frequency);
+    const F4 py = F4(y) * frequency;
+    const F4 zero(0.0f), one(1.0f);
+    int x = 0;
+    for (; x < count; x += 4) {
+        F4 px = (F4(x0) + F4(_mm_setr_ps((float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3)))) * frequency;
+        F4 h = heightT<F4, I4>(px, py, settings, norm);
+        __m128 clamped = _mm_min_ps(_mm_max_ps(h.v, zero.v), one.v);
+        if (x + 4 <= count) {
+            _mm_storeu_ps(out + x, clamped);
+        }
+        else {
+            float tail[4];
+            _mm_storeu_ps(tail, clamped);
+            for (int i = 0; x + i < count; i++) out[x + i] = tail[i];
+        }
+    }
+}
+
+void NoiseSource::fill(int x0, int y0, int w, int h, float* out, size_t stride) const {
+    if (stride == 0) stride = (size_t)w;
+    for (int y = 0; y < h; y++) {
+        fillRow((float)x0, (float)(y0 + y), w, out + (size_t)y * stride);
+    }
+}
+
+void NoiseSource::generate(int x0, int y0, int w, int h, float* out, size_t stride) const {
+    PROFILE_SCOPE("NoiseSource::generate");
+    if (w <= 0 || h <= 0) return;
+    if (stride == 0) stride = (size_t)w;
+    const int tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+
+    ThreadPool::shared().parallelFor((size_t)tilesX * tilesY, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            int tx = (int)(t % tilesX) * TILE_SIZE, ty = (int)(t / tilesX) * TILE_SIZE;
+            fill(x0 + tx, y0 + ty, std::min(TILE_SIZE, w - tx), std::min(TILE_SIZE, h - ty),
+                 out + (size_t)ty * stride + tx, stride);
+        }
+    });
+}
+
+void NoiseSource::generate(HeightMap& map, int w, int h) const {
+    map.resize(w, h);
+    generate(0, 0, w, h, map.getData());
+}
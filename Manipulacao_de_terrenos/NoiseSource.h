@@ -0,0 +1,65 @@
+#ifndef NOISESOURCE_H
+#define NOISESOURCE_H
+
+#include <stddef.h>
+
+class HeightMap;
+
+// Alturas procedurais em [0,1] a partir de ruido simplex 2D, como
+// alternativa a um arquivo de heightmap: o valor de cada amostra (x, y) e'
+// funcao so' de (x, y) e do seed, entao qualquer regiao pode ser gerada a
+// qualquer momento, em qualquer ordem e por qualquer thread, sempre igual.
+//
+// Os gradientes vem de um hash inteiro do vertice da grade (sem tabela de
+// permutacao), o que permite calcular 4 amostras por instrucao com SSE2.
+// sample() e' a versao escalar, com as mesmas operacoes (mesmo resultado).
+//
+// Variantes:
+// - FBM: soma de oitavas (cada uma com frequencia * lacunarity e amplitude * gain);
+// - RIDGED: oitavas de (1 - |ruido|)^2, cristas finas como cordilheiras;
+// - WARPED: fBm com o dominio deslocado por outros dois fBm (Inigo Quilez),
+//   formas mais organicas ao custo de ~3x.
+class NoiseSource {
+public:
+    enum Type { FBM, RIDGED, WARPED };
+
+    struct Settings {
+        Type type;
+        unsigned int seed;
+        int octaves;
+        float frequency;     // ciclos por amostra na oitava mais grave
+        float lacunarity;
+        float gain;
+        float warp;          // deslocamento do WARPED, em amostras
+
+        Settings(Type type = FBM, unsigned int seed = 1234u, int octaves = 6, float frequency = 1.0f / 128.0f)
+            : type(type), seed(seed), octaves(octaves), frequency(frequency), lacunarity(2.0f), gain(0.5f),
+              warp(64.0f) {}
+    };
+
+    NoiseSource();
+    explicit NoiseSource(const Settings& settings);
+
+    const Settings& getSettings() const { return settings; }
+
+    // Altura em [0,1] da amostra (x, y)
+    float sample(float x, float y) const;
+    // Ruido simplex de uma oitava em ~[-1,1]
+    static float simplex(float x, float y, unsigned int seed);
+
+    // Amostras [x0, x0 + w) x [y0, y0 + h) em out (linhas de stride floats; 0 = w),
+    // na thread que chama
+    void fill(int x0, int y0, int w, int h, float* out, size_t stride = 0) const;
+    // O mesmo em ladrilhos de 64x64 no ThreadPool::shared()
+    void generate(int x0, int y0, int w, int h, float* out, size_t stride = 0) const;
+    // Mapa w x h a partir da origem
+    void generate(HeightMap& map, int w, int h) const;
+
+private:
+    Settings settings;
+    float norm;              // 1 / soma das amplitudes
+
+    void fillRow(float x0, float y, int count, float* out) const;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <functional>
+#include <vector>
+
+// Decodificador PNG minimo (com inflate embutido, sem dependencia de zlib/libpng)
+// usado para carregar mapas de altura de 16 bits.
+//
+// Suporta imagens nao entrelacadas em escala de cinza, cinza+alfa, RGB e RGBA
+// com 8 ou 16 bits por canal. Apenas o primeiro canal e' entregue, ja' expandido
+// para 16 bits (amostras de 8 bits sao replicadas: v * 257).
+class Png {
+public:
+    // Chamado uma vez por linha, na ordem do arquivo (de cima para baixo).
+    typedef std::function<void(int y, const unsigned short* row)> RowCallback;
+
+    // Le o cabecalho e chama onHeader(width, height) antes da primeira linha,
+    // para o chamador poder alocar o destino. Retorna false em caso de erro.
+    static bool decode(const char* fileName,
+                       const std::function<void(int width, int height)>& onHeader,
+                       const RowCallback& onRow);
+
+private:
+    // Recebe a saida descomprimida aos pedacos e devolve quantos bytes usou;
+    // o resto volta no proximo pedaco. (size_t)-1 interrompe com erro
+    typedef std::function<size_t(const unsigned char* data, size_t size)> ByteSink;
+
+    static bool inflate(const std::vector<unsigned char>& in, const ByteSink& sink);
+};
+
+#endif
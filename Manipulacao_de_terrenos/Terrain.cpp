@@ -1,51 +1,134 @@
 #include "Terrain.h"
-#include "Bmp.h"
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <math.h>
+#include <unordered_set>
+#include "../Comum/GLState.h"
+#include "../Comum/Profiler.h"
+#include "../Comum/ShaderCache.h"
+#include "../Comum/ShaderReflection.h"
+#include "../Comum/SoftRasterizer.h"
+#include "../Comum/ThreadPool.h"
 
-Terrain::Terrain(const std::string& bmpPath, GLuint shader)
-    : shaderProgram(shader), lodLevel(1)
+Terrain::Terrain(const std::string& heightmapPath, GLuint shader)
+    : shaderProgram(shader), mvpLocation(-1), lightMap(0), streamRadius(0.0f), lodLevel(1), stats(), culling(true),
+      tessProgram(0), heightTexture(0), patchVao(0), patchVbo(0), primitivesQuery(0), queryPending(false),
+      patchesDirty(true), pixelsPerSegment(8.0f), tessTriangles(0), tessMvpLocation(-1), tessPixelScaleLocation(-1), tessDetailLocation(-1)
 {
-    heightmap = new Bmp(bmpPath.c_str());
-    imageData = heightmap->getImage();
-    width = heightmap->getWidth();
-    height = heightmap->getHeight();
+    if (!heightmap.load(heightmapPath)) {
+        std::cerr << "Erro ao carregar heightmap " << heightmapPath << std::endl;
+    }
+    initHeights();
+}
+
+Terrain::Terrain(const HeightMap& map, GLuint shader)
+    : shaderProgram(shader), mvpLocation(-1), lightMap(0), heightmap(map), streamRadius(0.0f), lodLevel(1), stats(), culling(true),
+      tessProgram(0), heightTexture(0), patchVao(0), patchVbo(0), primitivesQuery(0), queryPending(false),
+      patchesDirty(true), pixelsPerSegment(8.0f), tessTriangles(0), tessMvpLocation(-1), tessPixelScaleLocation(-1), tessDetailLocation(-1)
+{
+    initHeights();
+}
+
+Terrain::Terrain(const NoiseSource& source, int w, int h, GLuint shader, float radius)
+    : shaderProgram(shader), mvpLocation(-1), lightMap(0), noise(source), streamRadius(radius), lodLevel(1), stats(), culling(true),
+      tessProgram(0), heightTexture(0), patchVao(0), patchVbo(0), primitivesQuery(0), queryPending(false),
+      patchesDirty(true), pixelsPerSegment(8.0f), tessTriangles(0), tessMvpLocation(-1), tessPixelScaleLocation(-1), tessDetailLocation(-1)
+{
+    if (streamRadius > 0.0f) {
+        // as alturas do ruido ja' estao em [0,1]
+        width = w;
+        height = h;
+        maxHeight = 1.0f;
+    }
+    else {
+        noise.generate(heightmap, w, h);
+        initHeights();
+    }
 }
 
 Terrain::~Terrain() {
-    delete heightmap;
+    for (auto& block : blocks) {
+        deleteBlockMesh(block);
+    }
+    if (patchVao != 0) {
+        GLState::current().deleteVertexArray(patchVao);
+        glDeleteBuffers(1, &patchVbo);
+    }
+    if (heightTexture != 0) GLState::current().deleteTexture(heightTexture);
+    if (primitivesQuery != 0) glDeleteQueries(1, &primitivesQuery);
 }
 
-/*
+void Terrain::initHeights() {
+    width = heightmap.getWidth();
+    height = heightmap.getHeight();
+
+    // Normaliza pela maior altura do mapa, calculada uma unica vez
+    const float* data = heightmap.getData();
+    float maxVal = 0.0f;
+    for (size_t i = 0; i < (size_t)width * height; ++i) {
+        if (data[i] > maxVal) maxVal = data[i];
+    }
+    maxHeight = maxVal > 0.0f ? maxVal : 1.0f;
+}
+
+// Cria a grade de blocos uma unica vez; as malhas sao geradas sob demanda
+// em render(), so' quando o LOD do bloco muda
 void Terrain::setup(const glm::vec3& cameraPosition) {
-    int blocksize = 32; // Tamanho de cada bloco (em pixels)
-    for (int y = 0; y < height; y += blocksize) {
-        for (int x = 0; x < width; x += blocksize) {
+    if (shaderProgram != 0) mvpLocation = ShaderReflection(shaderProgram).uniform("mvp");
+
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        for (int x = 0; x < width; x += BLOCK_SIZE) {
             Block block;
-            block.lodLevel = 1; // LOD inicial
-            generateBlockMesh(block, block.lodLevel, x, y, blocksize, blocksize);
+            block.vao = block.vbo = block.ebo = 0;
+            block.lodLevel = 0; // sem malha
+            block.startX = x;
+            block.startY = y;
+            block.indexCount = 0;
+            block.minY = block.maxY = block.roughness = 0.0f;
             blocks.push_back(block);
         }
     }
     calculateBlockCenter();
+    ThreadPool::shared().parallelFor(blocks.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) updateBlockBounds(blocks[i]);
+    });
 }
-*/
 
-void Terrain::generateBlockMesh(Block& block, int lodLevel, int startX, int startY, int blockWidth, int blockHeight) {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+void Terrain::deleteBlockMesh(Block& block) {
+    if (block.vao == 0) return;
+    GLState::current().deleteVertexArray(block.vao);
+    glDeleteBuffers(1, &block.vbo);
+    glDeleteBuffers(1, &block.ebo);
+    block.vbo = block.ebo = 0;
+}
 
-    unsigned char maxVal = 0;
-    for (int i = 0; i < width * height * 3; i += 3) {
-        if (imageData[i] > maxVal) maxVal = imageData[i];
-    }
-    float maxHeight = std::max(1.0f, static_cast<float>(maxVal));
+void Terrain::buildBlockMesh(int lodLevel, int startX, int startY, int blockWidth, int blockHeight,
+                             std::vector<float>& vertices, std::vector<unsigned int>& indices) const {
+    buildMesh(lodLevel, startX, startY, blockWidth, blockHeight, heightmap.getData(), 0, 0, (size_t)width,
+              vertices, indices);
+}
+
+// samples tem as alturas a partir de (originX, originY), linhas de stride floats:
+// o mapa inteiro, ou so' o bloco no modo streaming
+void Terrain::buildMesh(int lodLevel, int startX, int startY, int blockWidth, int blockHeight,
+                        const float* samples, int originX, int originY, size_t stride,
+                        std::vector<float>& vertices, std::vector<unsigned int>& indices) const {
+    PROFILE_SCOPE("Terrain::buildBlockMesh");
+    int w = (blockWidth / lodLevel) + 1;
+    int h = (blockHeight / lodLevel) + 1;
+    vertices.clear();
+    indices.clear();
+    vertices.reserve((size_t)w * h * 5);
+    indices.reserve((size_t)(w - 1) * (h - 1) * 6);
 
     for (int y = startY; y <= startY + blockHeight; y += lodLevel) {
         for (int x = startX; x <= startX + blockWidth; x += lodLevel) {
-            int index = (y * width + x) * 3;
-            float intensity = imageData[index] / maxHeight;
+            // a borda do ultimo bloco repete a ultima linha/coluna do mapa
+            int sx = std::min(x, width - 1) - originX, sy = std::min(y, height - 1) - originY;
+            float intensity = samples[(size_t)sy * stride + sx] / maxHeight;
             vertices.push_back(static_cast<float>(x));
             vertices.push_back(intensity * 20.0f);
             vertices.push_back(static_cast<float>(y));
@@ -54,7 +137,6 @@ void Terrain::generateBlockMesh(Block& block, int lodLevel, int startX, int star
         }
     }
 
-    int w = (blockWidth / lodLevel) + 1;
     for (int y = 0; y < (blockHeight / lodLevel); ++y) {
         for (int x = 0; x < (blockWidth / lodLevel); ++x) {
             int i = y * w + x;
@@ -66,12 +148,62 @@ void Terrain::generateBlockMesh(Block& block, int lodLevel, int startX, int star
             indices.push_back(i + w);
         }
     }
+}
+
+void Terrain::updateHeights(const float* heights, size_t stride, int x0, int y0, int w, int h) {
+    if (streamRadius > 0.0f) return;
+    int x1 = std::min(x0 + w, width), y1 = std::min(y0 + h, height);
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    float* data = heightmap.getData();
+    for (int y = y0; y < y1; y++) {
+        std::copy(heights + (size_t)y * stride + x0, heights + (size_t)y * stride + x1, data + (size_t)y * width + x0);
+    }
+    if (heightTexture != 0) {
+        GLState::current().bindTexture(1, GL_TEXTURE_2D, heightTexture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, GL_RED, GL_FLOAT, data + (size_t)y0 * width + x0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        patchesDirty = true;
+    }
+    if (blocks.empty()) return;
+
+    // Os blocos estao em ordem de linhas (setup) e cada um inclui a primeira
+    // coluna e linha do vizinho, entao a regiao toca tambem o bloco anterior
+    const int blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const int blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int bx0 = std::max(0, (x0 - 1) / BLOCK_SIZE), by0 = std::max(0, (y0 - 1) / BLOCK_SIZE);
+    int bx1 = std::min(blocksX - 1, (x1 - 1) / BLOCK_SIZE), by1 = std::min(blocksY - 1, (y1 - 1) / BLOCK_SIZE);
+    for (int by = by0; by <= by1; by++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            Block& block = blocks[(size_t)by * blocksX + bx];
+            block.lodLevel = 0; // malha desatualizada
+            updateBlockBounds(block);
+        }
+    }
+}
+
+void Terrain::generateBlockMesh(Block& block, int lodLevel, int startX, int startY, int blockWidth, int blockHeight) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    if (block.heights.empty()) {
+        buildBlockMesh(lodLevel, startX, startY, blockWidth, blockHeight, vertices, indices);
+    }
+    else {
+        buildMesh(lodLevel, startX, startY, blockWidth, blockHeight, block.heights.data(), block.startX, block.startY,
+                  BLOCK_SIZE + 1, vertices, indices);
+    }
 
+    deleteBlockMesh(block);
     glGenVertexArrays(1, &block.vao);
     glGenBuffers(1, &block.vbo);
     glGenBuffers(1, &block.ebo);
 
-    glBindVertexArray(block.vao);
+    GLState& gl = GLState::current();
+    gl.bindVertexArray(block.vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, block.vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
@@ -85,55 +217,352 @@ void Terrain::generateBlockMesh(Block& block, int lodLevel, int startX, int star
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    gl.bindVertexArray(0);
 
     block.indexCount = static_cast<int>(indices.size());
+    block.lodLevel = lodLevel;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    stats.meshTimeMs += elapsed.count();
+    stats.uploadBytes += vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int);
+    stats.blocksMeshed++;
+    PROFILE_UPLOAD(vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int));
 }
 
 
 
+// Passo da malha de um bloco pela distancia da camera ao centro dele
+int Terrain::blockLod(float distance) {
+    if (distance < 100.0f) {
+        return 1; // Alta resoluo
+    }
+    else if (distance < 175.0f) {
+        return 2; // Mdia resoluo
+    }
+    return 4; // Baixa resoluo
+}
+
+void Terrain::resetStats() {
+    stats.drawCalls = 0;
+    stats.triangles = 0;
+    stats.uploadBytes = 0;
+    stats.blocksMeshed = 0;
+    stats.meshTimeMs = 0.0;
+    stats.blocksGenerated = 0;
+    stats.generateMs = 0.0;
+    stats.blocksCulled = 0;
+    stats.blocksOccluded = 0;
+}
+
 void Terrain::render(const glm::mat4& mvp, const glm::vec3& cameraPosition) {
     // Atualizar o LOD com base na posio da cmera
     //updateLOD(cameraPosition);
+    PROFILE_SCOPE("Terrain::render");
+    PROFILE_GPU_SCOPE("Terrain::render");
 
-    // Configurar o shader e enviar a matriz MVP
-    glUseProgram(shaderProgram);
-    GLuint mvpLoc = glGetUniformLocation(shaderProgram, "mvp");
-    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+    resetStats();
 
-    int blocksize = 32; // Tamanho de cada bloco (em pixels)
-    for (int y = 0; y < height; y += blocksize) {
-        for (int x = 0; x < width; x += blocksize) {
-            Block block;
+    if (streamRadius > 0.0f) {
+        if (mvpLocation < 0) mvpLocation = ShaderReflection(shaderProgram).uniform("mvp");
+        streamBlocks(cameraPosition);
+    }
+    else if (blocks.empty()) {
+        setup(cameraPosition);
+    }
+    cullBlocks(mvp, cameraPosition);
+    if (tessProgram != 0) {
+        renderPatches(mvp);
+        return;
+    }
 
-            // Calcular o LOD com base na distncia da cmera
-            float distance = glm::distance(cameraPosition, glm::vec3(x + blocksize / 2, 0, y + blocksize / 2));
-            if (distance < 100.0f) {
-                block.lodLevel = 1; // Alta resoluo
-            }
-            else if (distance < 175.0f) {
-                block.lodLevel = 2; // Mdia resoluo
+    // Configurar o shader e enviar a matriz MVP (localizacao lida uma vez no setup)
+    GLState& gl = GLState::current();
+    gl.useProgram(shaderProgram);
+    glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+    if (lightMap != 0) gl.bindTexture(0, GL_TEXTURE_2D, lightMap);
+
+    for (size_t index : drawList) {
+        Block& block = blocks[index];
+        int lod = blockLod(glm::distance(cameraPosition, block.center));
+
+        // Regerar a malha do bloco apenas quando o LOD muda
+        if (lod != block.lodLevel) {
+            generateBlockMesh(block, lod, block.startX, block.startY, BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+
+    gl.polygonMode(GL_LINE);
+    for (size_t index : drawList) {
+        const Block& block = blocks[index];
+        gl.bindVertexArray(block.vao);
+        glDrawElements(GL_TRIANGLES, block.indexCount, GL_UNSIGNED_INT, 0);
+        PROFILE_DRAW(block.indexCount / 3);
+        stats.drawCalls++;
+        stats.triangles += block.indexCount / 3;
+    }
+
+    gl.bindVertexArray(0);
+    gl.polygonMode(GL_FILL);
+}
+
+void Terrain::rasterize(SoftRasterizer& target, const glm::mat4& mvp, const glm::vec3& cameraPosition) {
+    PROFILE_SCOPE("Terrain::rasterize");
+
+    resetStats();
+    if (streamRadius > 0.0f) streamBlocks(cameraPosition);
+    else if (blocks.empty()) setup(cameraPosition);
+    cullBlocks(mvp, cameraPosition);
+
+    // Sem buffers na GPU para guardar: as malhas dos blocos visiveis saem de
+    // novo a cada quadro, em paralelo, e vao para o rasterizador em ordem
+    auto start = std::chrono::high_resolution_clock::now();
+    meshVertices.resize(drawList.size());
+    meshIndices.resize(drawList.size());
+    ThreadPool::shared().parallelFor(drawList.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Block& block = blocks[drawList[i]];
+            const int lod = blockLod(glm::distance(cameraPosition, block.center));
+            meshVertices[i].clear();
+            meshIndices[i].clear();
+            if (block.heights.empty()) {
+                buildBlockMesh(lod, block.startX, block.startY, BLOCK_SIZE, BLOCK_SIZE, meshVertices[i], meshIndices[i]);
             }
             else {
-                block.lodLevel = 4; // Baixa resoluo
+                buildMesh(lod, block.startX, block.startY, BLOCK_SIZE, BLOCK_SIZE, block.heights.data(), block.startX,
+                          block.startY, BLOCK_SIZE + 1, meshVertices[i], meshIndices[i]);
             }
+        }
+    });
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    stats.meshTimeMs += elapsed.count();
+    stats.blocksMeshed = (int)drawList.size();
 
-            // Gerar a malha do bloco
-            generateBlockMesh(block, block.lodLevel, x, y, blocksize, blocksize);
-            blocks.push_back(block);
+    // Cor das coordenadas de textura, como o shader sem o lightMap
+    const SoftRasterizer::Material material = { SoftRasterizer::TEXCOORD_COLOR, 3, NULL, true };
+    for (size_t i = 0; i < drawList.size(); i++) {
+        target.draw(meshVertices[i].data(), meshVertices[i].size() / 5, 5, meshIndices[i].data(), meshIndices[i].size(),
+                    mvp, material);
+        stats.drawCalls++;
+        stats.triangles += meshIndices[i].size() / 3;
+    }
+}
+
+// Modo por tesselacao: os cantos de cada patch sao (x, z, aspereza)
+static const char* tessVertexSource = R"(
+#version 400 core
+layout(location = 0) in vec3 aCorner;
+out vec3 corner;
+void main() {
+    corner = aCorner;
+})";
+
+static const char* tessControlSource = R"(
+#version 400 core
+layout(vertices = 4) out;
+in vec3 corner[];
+out vec2 position[];
+uniform mat4 mvp;
+uniform sampler2D heightMap;
+uniform vec2 mapSize;
+uniform float heightScale;
+uniform float pixelScale;        // pixels por unidade do mundo a distancia 1
+uniform float pixelsPerSegment;
+uniform float maxLevel;
+
+vec3 surface(vec2 xz) {
+    return vec3(xz.x, textureLod(heightMap, (xz + 0.5) / mapSize, 0.0).r * heightScale, xz.y);
+}
+
+// Diametro na tela da esfera em volta da aresta (nao encolhe quando a aresta
+// aponta para a camera), em segmentos, com menos detalhe onde os blocos dos
+// dois lados sao lisos. So' depende dos dois cantos, na mesma ordem nos dois
+// patches que dividem a aresta, entao eles concordam e nao abrem fendas
+float edgeLevel(int a, int b) {
+    vec3 p0 = surface(corner[a].xy), p1 = surface(corner[b].xy);
+    vec4 center = mvp * vec4((p0 + p1) * 0.5, 1.0);
+    float pixels = distance(p0, p1) * pixelScale / max(center.w, 1.0);
+    float detail = mix(0.25, 1.0, max(corner[a].z, corner[b].z));
+    return clamp(pixels * detail / pixelsPerSegment, 1.0, maxLevel);
+}
+
+void main() {
+    position[gl_InvocationID] = corner[gl_InvocationID].xy;
+    if (gl_InvocationID == 0) {
+        // cantos 0 (x0, z0), 1 (x1, z0), 2 (x1, z1), 3 (x0, z1)
+        gl_TessLevelOuter[0] = edgeLevel(0, 3);
+        gl_TessLevelOuter[1] = edgeLevel(0, 1);
+        gl_TessLevelOuter[2] = edgeLevel(1, 2);
+        gl_TessLevelOuter[3] = edgeLevel(3, 2);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+    }
+})";
+
+static const char* tessEvaluationSource = R"(
+#version 400 core
+layout(quads, fractional_even_spacing, ccw) in;
+in vec2 position[];
+out vec2 TexCoord;
+uniform mat4 mvp;
+uniform sampler2D heightMap;
+uniform vec2 mapSize;
+uniform float heightScale;
+void main() {
+    vec2 xz = mix(mix(position[0], position[1], gl_TessCoord.x),
+                  mix(position[3], position[2], gl_TessCoord.x), gl_TessCoord.y);
+    float y = textureLod(heightMap, (xz + 0.5) / mapSize, 0.0).r * heightScale;
+    TexCoord = xz / mapSize;
+    gl_Position = mvp * vec4(xz.x, y, xz.y, 1.0);
+})";
+
+// Desvio do bilinear (no mundo) a partir do qual a aresta recebe todo o detalhe
+static const float FULL_DETAIL_ROUGHNESS = 2.0f;
+
+bool Terrain::enableTessellation(const char* fragmentShaderSource) {
+    if (streamRadius > 0.0f || width <= 0 || height <= 0) return false;
+    if (!GLEW_VERSION_4_0 && !GLEW_ARB_tessellation_shader) return false;
+
+    std::vector<ShaderCache::Stage> stages(4);
+    stages[0].type = GL_VERTEX_SHADER;
+    stages[0].source = tessVertexSource;
+    stages[1].type = GL_TESS_CONTROL_SHADER;
+    stages[1].source = tessControlSource;
+    stages[2].type = GL_TESS_EVALUATION_SHADER;
+    stages[2].source = tessEvaluationSource;
+    stages[3].type = GL_FRAGMENT_SHADER;
+    stages[3].source = fragmentShaderSource;
+    GLuint program = ShaderCache::instance().program(stages);
+    if (program == 0) return false;
+
+    // alturas cruas: a normalizacao vai no heightScale, e updateHeights()
+    // copia as regioes alteradas direto do mapa
+    GLState& gl = GLState::current();
+    glGenTextures(1, &heightTexture);
+    gl.bindTexture(1, GL_TEXTURE_2D, heightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, heightmap.getData());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // a borda do ultimo bloco repete a ultima linha/coluna, como em buildMesh
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    PROFILE_UPLOAD((size_t)width * height * sizeof(float));
+
+    GLint maxLevel = 64;
+    glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxLevel);
+    const ShaderReflection& reflection = ShaderCache::instance().reflection(program);
+    gl.useProgram(program);
+    glUniform1i(reflection.uniform("heightMap"), 1);
+    glUniform2f(reflection.uniform("mapSize"), (float)width, (float)height);
+    glUniform1f(reflection.uniform("heightScale"), 20.0f / maxHeight);
+    // mais vertices que amostras nao acrescenta relevo
+    glUniform1f(reflection.uniform("maxLevel"), (float)std::min(maxLevel, (GLint)BLOCK_SIZE));
+    tessMvpLocation = reflection.uniform("mvp");
+    tessPixelScaleLocation = reflection.uniform("pixelScale");
+    tessDetailLocation = reflection.uniform("pixelsPerSegment");
+
+    glGenQueries(1, &primitivesQuery);
+    tessProgram = program;
+    patchesDirty = true;
+    return true;
+}
+
+// Um patch por bloco, na ordem de blocks. A aspereza vai nos cantos, como a
+// maior dos blocos que os tocam, para as duas pontas de uma aresta terem o
+// mesmo valor nos dois patches
+void Terrain::uploadPatches() {
+    const int blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const int blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<float> corners((size_t)(blocksX + 1) * (blocksY + 1), 0.0f);
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            const float r = std::min(blocks[(size_t)by * blocksX + bx].roughness / FULL_DETAIL_ROUGHNESS, 1.0f);
+            for (int c = 0; c < 4; c++) {
+                float& corner = corners[(size_t)(by + (c >> 1)) * (blocksX + 1) + bx + (c & 1)];
+                corner = std::max(corner, r);
+            }
         }
     }
-    calculateBlockCenter();
 
-    for (auto& block : blocks) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    std::vector<float> vertices;
+    vertices.reserve(blocks.size() * 12);
+    static const int cornerX[4] = { 0, 1, 1, 0 }, cornerY[4] = { 0, 0, 1, 1 };
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            for (int c = 0; c < 4; c++) {
+                vertices.push_back((float)((bx + cornerX[c]) * BLOCK_SIZE));
+                vertices.push_back((float)((by + cornerY[c]) * BLOCK_SIZE));
+                vertices.push_back(corners[(size_t)(by + cornerY[c]) * (blocksX + 1) + bx + cornerX[c]]);
+            }
+        }
+    }
 
-        glBindVertexArray(block.vao);
-        glDrawElements(GL_TRIANGLES, block.indexCount, GL_UNSIGNED_INT, 0);
+    GLState& gl = GLState::current();
+    if (patchVao == 0) {
+        glGenVertexArrays(1, &patchVao);
+        glGenBuffers(1, &patchVbo);
+        gl.bindVertexArray(patchVao);
+        glBindBuffer(GL_ARRAY_BUFFER, patchVbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        gl.bindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, patchVbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    stats.uploadBytes += vertices.size() * sizeof(float);
+    PROFILE_UPLOAD(vertices.size() * sizeof(float));
+    patchesDirty = false;
+}
+
+void Terrain::renderPatches(const glm::mat4& mvp) {
+    if (patchesDirty) uploadPatches();
+
+    // triangulos do quadro anterior, sem esperar a GPU
+    if (queryPending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint primitives = 0;
+            glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, &primitives);
+            tessTriangles = primitives;
+            queryPending = false;
+        }
+    }
+
+    // linha y do mvp = P[1][1] * (linha y da vista), que tem norma 1
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const float projectionY = glm::length(glm::vec3(mvp[0][1], mvp[1][1], mvp[2][1]));
+
+    GLState& gl = GLState::current();
+    gl.useProgram(tessProgram);
+    glUniformMatrix4fv(tessMvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniform1f(tessPixelScaleLocation, projectionY * viewport[3] * 0.5f);
+    glUniform1f(tessDetailLocation, pixelsPerSegment);
+    if (lightMap != 0) gl.bindTexture(0, GL_TEXTURE_2D, lightMap);
+    gl.bindTexture(1, GL_TEXTURE_2D, heightTexture);
+
+    patchFirst.clear();
+    patchCount.clear();
+    for (size_t index : drawList) {
+        patchFirst.push_back((GLint)index * 4);
+        patchCount.push_back(4);
+    }
+
+    gl.polygonMode(GL_LINE);
+    gl.bindVertexArray(patchVao);
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
+    if (!queryPending) glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+    glMultiDrawArrays(GL_PATCHES, patchFirst.data(), patchCount.data(), (GLsizei)patchFirst.size());
+    if (!queryPending) {
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        queryPending = true;
     }
+    PROFILE_DRAW(0); // triangulos gerados na GPU
+    stats.drawCalls = 1;
+    stats.triangles = tessTriangles;
 
-    glBindVertexArray(0);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl.bindVertexArray(0);
+    gl.polygonMode(GL_FILL);
 }
 
 /*
@@ -162,6 +591,315 @@ void Terrain::updateLOD(const glm::vec3& cameraPosition) {
 
 void Terrain::calculateBlockCenter() {
     for (auto& block : blocks) {
-        block.center = glm::vec3(block.vao / 2.0f, 0.0f, block.ebo / 2.0f);
+        block.center = glm::vec3(block.startX + BLOCK_SIZE / 2, 0.0f, block.startY + BLOCK_SIZE / 2);
     }
-}
\ No newline at end of file
+}
+
+void Terrain::updateBlockBounds(Block& block) const {
+    // as mesmas amostras de buildMesh, com a borda do ultimo bloco repetida
+    const float* samples = heightmap.getData();
+    int originX = 0, originY = 0;
+    size_t stride = (size_t)width;
+    if (!block.heights.empty()) {
+        samples = block.heights.data();
+        originX = block.startX;
+        originY = block.startY;
+        stride = BLOCK_SIZE + 1;
+    }
+    const int x1 = std::min(block.startX + BLOCK_SIZE, width - 1), y1 = std::min(block.startY + BLOCK_SIZE, height - 1);
+    auto sample = [&](int x, int y) { return samples[(size_t)(y - originY) * stride + (x - originX)]; };
+    // aspereza: distancia ao bilinear dos cantos, o que um patch sem subdivisao mostraria
+    const float c00 = sample(block.startX, block.startY), c10 = sample(x1, block.startY);
+    const float c01 = sample(block.startX, y1), c11 = sample(x1, y1);
+    const float invW = x1 > block.startX ? 1.0f / (x1 - block.startX) : 0.0f;
+    const float invH = y1 > block.startY ? 1.0f / (y1 - block.startY) : 0.0f;
+    float lo = c00, hi = c00, deviation = 0.0f;
+    for (int y = block.startY; y <= y1; y++) {
+        const float v = (y - block.startY) * invH;
+        const float left = c00 + (c01 - c00) * v, right = c10 + (c11 - c10) * v;
+        for (int x = block.startX; x <= x1; x++) {
+            const float h = sample(x, y);
+            lo = std::min(lo, h);
+            hi = std::max(hi, h);
+            deviation = std::max(deviation, fabsf(h - (left + (right - left) * ((x - block.startX) * invW))));
+        }
+    }
+    block.minY = lo / maxHeight * 20.0f;
+    block.maxY = hi / maxHeight * 20.0f;
+    block.roughness = deviation / maxHeight * 20.0f;
+}
+
+// Maior altura do bloco a menos de radius de (x, z) no plano xz (0 se ele
+// nao chega la')
+float Terrain::groundHeight(const Block& block, float x, float z, float radius) const {
+    const float* samples = heightmap.getData();
+    int originX = 0, originY = 0;
+    size_t stride = (size_t)width;
+    if (!block.heights.empty()) {
+        samples = block.heights.data();
+        originX = block.startX;
+        originY = block.startY;
+        stride = BLOCK_SIZE + 1;
+    }
+    const int lastX = std::min(block.startX + BLOCK_SIZE, width - 1), lastY = std::min(block.startY + BLOCK_SIZE, height - 1);
+    // amostras da grade que tocam o quadrado de lado 2 * radius em volta
+    const int x0 = std::max((int)floorf(x - radius), block.startX), x1 = std::min((int)ceilf(x + radius), lastX);
+    const int y0 = std::max((int)floorf(z - radius), block.startY), y1 = std::min((int)ceilf(z + radius), lastY);
+    float ground = 0.0f;
+    for (int y = y0; y <= y1; y++) {
+        for (int sx = x0; sx <= x1; sx++) {
+            ground = std::max(ground, samples[(size_t)(y - originY) * stride + (sx - originX)]);
+        }
+    }
+    return ground / maxHeight * 20.0f;
+}
+
+void Terrain::setObjects(const std::vector<Bounds>& list) {
+    objects = list;
+    objectVisible.assign(objects.size(), 1);
+}
+
+bool Terrain::isObjectVisible(size_t index) const {
+    return index < objectVisible.size() && objectVisible[index] != 0;
+}
+
+// Azimutes em torno da camera no buffer de horizonte
+static const int HORIZON_BINS = 1024;
+static const float PI = 3.14159265f;
+
+// Planos do frustum (dentro: dot(plano, (p, 1)) >= 0) tirados da matriz mvp
+static void frustumPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+    const glm::vec4 x(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 y(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 z(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[0] = w + x;
+    planes[1] = w - x;
+    planes[2] = w + y;
+    planes[3] = w - y;
+    planes[4] = w + z;
+    planes[5] = w - z;
+}
+
+static bool outsideFrustum(const glm::vec4 planes[6], const glm::vec3& lo, const glm::vec3& hi) {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& p = planes[i];
+        // canto da caixa mais a' frente do plano
+        const glm::vec3 v(p.x >= 0.0f ? hi.x : lo.x, p.y >= 0.0f ? hi.y : lo.y, p.z >= 0.0f ? hi.z : lo.z);
+        if (p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0.0f) return true;
+    }
+    return false;
+}
+
+// Um retangulo do plano xz visto da camera: distancias horizontais minima e
+// maxima e a faixa de azimutes em bins [first, last] (last pode passar de
+// HORIZON_BINS, o indice da volta com % HORIZON_BINS)
+struct HorizonSpan {
+    float nearDistance, farDistance;
+    float first, last;
+};
+
+// false com a camera sobre o retangulo: ele cobre todos os azimutes
+static bool horizonSpan(const glm::vec3& camera, float x0, float z0, float x1, float z1, HorizonSpan& span) {
+    const float nx = std::max(std::max(x0 - camera.x, camera.x - x1), 0.0f);
+    const float nz = std::max(std::max(z0 - camera.z, camera.z - z1), 0.0f);
+    span.nearDistance = sqrtf(nx * nx + nz * nz);
+    if (span.nearDistance < 1e-3f) return false;
+    const float fx = std::max(fabsf(x0 - camera.x), fabsf(x1 - camera.x));
+    const float fz = std::max(fabsf(z0 - camera.z), fabsf(z1 - camera.z));
+    span.farDistance = sqrtf(fx * fx + fz * fz);
+
+    // cantos em relacao ao azimute do centro: sem a camera dentro, o
+    // retangulo ocupa menos de pi e a faixa nao da' a volta
+    const float center = atan2f((z0 + z1) * 0.5f - camera.z, (x0 + x1) * 0.5f - camera.x);
+    const float xs[2] = { x0, x1 }, zs[2] = { z0, z1 };
+    float lo = 0.0f, hi = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        float a = atan2f(zs[i >> 1] - camera.z, xs[i & 1] - camera.x) - center;
+        if (a > PI) a -= 2.0f * PI;
+        else if (a < -PI) a += 2.0f * PI;
+        lo = std::min(lo, a);
+        hi = std::max(hi, a);
+    }
+    const float scale = HORIZON_BINS / (2.0f * PI);
+    span.first = (center + lo) * scale;
+    while (span.first < 0.0f) span.first += HORIZON_BINS;
+    span.last = span.first + (hi - lo) * scale;
+    return true;
+}
+
+// Tudo no retangulo ate' a altura top (relativa a' camera) fica abaixo do
+// horizonte em todos os azimutes que ele toca
+static bool belowHorizon(const float* horizon, const HorizonSpan& span, float top) {
+    const float slope = top / (top >= 0.0f ? span.nearDistance : span.farDistance);
+    for (int b = (int)span.first; b <= (int)span.last; b++) {
+        if (horizon[b % HORIZON_BINS] < slope) return false;
+    }
+    return true;
+}
+
+// O terreno abaixo de solidTop (a menor altura do bloco, relativa a' camera)
+// e' macico: em cada azimute coberto por inteiro o horizonte sobe pelo menos
+// ate' a inclinacao do ponto desse solido menos inclinado
+static void raiseHorizon(float* horizon, const HorizonSpan& span, float solidTop) {
+    const float slope = solidTop / (solidTop >= 0.0f ? span.farDistance : span.nearDistance);
+    for (int b = (int)ceilf(span.first); b + 1 <= (int)span.last; b++) {
+        float& h = horizon[b % HORIZON_BINS];
+        h = std::max(h, slope);
+    }
+}
+
+static int cellDistance(int cell, int first, int last) {
+    return cell < first ? first - cell : (cell > last ? cell - last : 0);
+}
+
+// Descarte por frustum e por horizonte (Downs, Moller e Sequin, 2001), com o
+// horizonte em azimute/inclinacao em torno da camera em vez de colunas da
+// tela, o que vale com a camera inclinada. Os blocos vao de frente para tras
+// pela distancia em celulas |dx| + |dz| da celula da camera: uma reta
+// horizontal saindo da camera atravessa celulas com essa distancia sempre
+// crescente, entao tudo que pode esconder um bloco entrou no horizonte antes
+// dele. Se a linha de visao passa abaixo do macico de um bloco anterior no
+// mesmo azimute, ela cruzou o terreno. Os objetos sao testados antes dos
+// blocos da mesma distancia, so' contra os estritamente mais proximos
+void Terrain::cullBlocks(const glm::mat4& mvp, const glm::vec3& cameraPosition) {
+    PROFILE_SCOPE("Terrain::cullBlocks");
+    drawList.clear();
+    objectVisible.assign(objects.size(), 1);
+    if (!culling) {
+        for (size_t i = 0; i < blocks.size(); i++) drawList.push_back(i);
+        return;
+    }
+
+    // chave 2 * distancia (+1 para blocos), ordenada por contagem
+    const size_t entries = blocks.size() + objects.size();
+    const int cx = (int)floorf(cameraPosition.x / BLOCK_SIZE), cz = (int)floorf(cameraPosition.z / BLOCK_SIZE);
+    orderKeys.resize(entries);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const int bx = blocks[i].startX / BLOCK_SIZE, bz = blocks[i].startY / BLOCK_SIZE;
+        orderKeys[i] = (unsigned int)(abs(bx - cx) + abs(bz - cz)) * 2 + 1;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        const Bounds& o = objects[i];
+        const int dx = cellDistance(cx, (int)floorf(o.min.x / BLOCK_SIZE), (int)floorf(o.max.x / BLOCK_SIZE));
+        const int dz = cellDistance(cz, (int)floorf(o.min.z / BLOCK_SIZE), (int)floorf(o.max.z / BLOCK_SIZE));
+        orderKeys[blocks.size() + i] = (unsigned int)(dx + dz) * 2;
+    }
+    unsigned int minKey = ~0u, maxKey = 0;
+    for (unsigned int key : orderKeys) {
+        minKey = std::min(minKey, key);
+        maxKey = std::max(maxKey, key);
+    }
+    std::vector<unsigned int> counts(entries > 0 ? maxKey - minKey + 2 : 1, 0);
+    for (unsigned int key : orderKeys) counts[key - minKey + 1]++;
+    for (size_t k = 1; k < counts.size(); k++) counts[k] += counts[k - 1];
+    order.resize(entries);
+    for (size_t i = 0; i < entries; i++) order[counts[orderKeys[i] - minKey]++] = (unsigned int)i;
+
+    glm::vec4 planes[6];
+    frustumPlanes(mvp, planes);
+
+    // O argumento vale com a camera sobre o mapa e acima do terreno, com
+    // folga do plano near: de fora do mapa, abaixo da borda, a linha de visao
+    // entra por baixo do relevo sem cruzar a superficie, e a superficie mais
+    // perto que o near nao e' desenhada. Nesses casos fica so' o frustum
+    const glm::vec4& nearPlane = planes[4];
+    const float nearDistance = fabsf(glm::dot(nearPlane, glm::vec4(cameraPosition, 1.0f))) / glm::length(glm::vec3(nearPlane.x, nearPlane.y, nearPlane.z));
+    bool overMap = false;
+    float ground = 0.0f;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        // a celula da camera (chave 1) e as 8 vizinhas (chave ate' 5)
+        if (orderKeys[i] > 5) continue;
+        overMap = overMap || orderKeys[i] == 1;
+        ground = std::max(ground, groundHeight(blocks[i], cameraPosition.x, cameraPosition.z, nearDistance));
+    }
+    const bool occlusion = overMap && cameraPosition.y - nearDistance >= ground;
+    horizon.assign(HORIZON_BINS, -1e30f);
+    float* h = horizon.data();
+
+    for (unsigned int entry : order) {
+        HorizonSpan span;
+        if (entry >= blocks.size()) {
+            const Bounds& o = objects[entry - blocks.size()];
+            bool occluded = occlusion && horizonSpan(cameraPosition, o.min.x, o.min.z, o.max.x, o.max.z, span) &&
+                            belowHorizon(h, span, o.max.y - cameraPosition.y);
+            objectVisible[entry - blocks.size()] = !occluded && !outsideFrustum(planes, o.min, o.max);
+            continue;
+        }
+
+        const Block& block = blocks[entry];
+        const float x0 = (float)block.startX, z0 = (float)block.startY;
+        const float x1 = x0 + BLOCK_SIZE, z1 = z0 + BLOCK_SIZE;
+        bool occluded = false;
+        if (occlusion && horizonSpan(cameraPosition, x0, z0, x1, z1, span)) {
+            occluded = belowHorizon(h, span, block.maxY - cameraPosition.y);
+            // escondido: o macico dele tambem esta' abaixo do horizonte
+            if (!occluded) raiseHorizon(h, span, block.minY - cameraPosition.y);
+        }
+        // fora do frustum ainda conta como oclusor acima
+        if (outsideFrustum(planes, glm::vec3(x0, block.minY, z0), glm::vec3(x1, block.maxY, z1))) stats.blocksCulled++;
+        else if (occluded) stats.blocksOccluded++;
+        else drawList.push_back(entry);
+    }
+}
+
+static float planarDistance(const glm::vec3& a, const glm::vec3& b) {
+    return glm::distance(glm::vec2(a.x, a.z), glm::vec2(b.x, b.z));
+}
+
+// Modo streaming: libera os blocos que sairam do raio (com folga de um bloco,
+// para a camera parada na borda nao gerar e liberar o mesmo bloco a cada
+// quadro) e cria os que entraram, com as alturas geradas em paralelo, um bloco
+// por tarefa. As malhas saem no laco de LOD de render(), como sempre
+void Terrain::streamBlocks(const glm::vec3& cameraPosition) {
+    PROFILE_SCOPE("Terrain::streamBlocks");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::unordered_set<long long> present;
+    for (size_t i = 0; i < blocks.size();) {
+        if (planarDistance(cameraPosition, blocks[i].center) > streamRadius + BLOCK_SIZE) {
+            deleteBlockMesh(blocks[i]);
+            blocks[i] = std::move(blocks.back());
+            blocks.pop_back();
+        }
+        else {
+            present.insert((long long)blocks[i].startY << 32 | blocks[i].startX);
+            i++;
+        }
+    }
+
+    const size_t first = blocks.size();
+    int bx0 = std::max(0, (int)floorf((cameraPosition.x - streamRadius) / BLOCK_SIZE));
+    int by0 = std::max(0, (int)floorf((cameraPosition.z - streamRadius) / BLOCK_SIZE));
+    int bx1 = std::min((width - 1) / BLOCK_SIZE, (int)floorf((cameraPosition.x + streamRadius) / BLOCK_SIZE));
+    int by1 = std::min((height - 1) / BLOCK_SIZE, (int)floorf((cameraPosition.z + streamRadius) / BLOCK_SIZE));
+    for (int by = by0; by <= by1; by++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            Block block;
+            block.vao = block.vbo = block.ebo = 0;
+            block.lodLevel = 0; // sem malha
+            block.startX = bx * BLOCK_SIZE;
+            block.startY = by * BLOCK_SIZE;
+            block.center = glm::vec3(block.startX + BLOCK_SIZE / 2, 0.0f, block.startY + BLOCK_SIZE / 2);
+            block.indexCount = 0;
+            block.minY = block.maxY = block.roughness = 0.0f;
+            if (planarDistance(cameraPosition, block.center) > streamRadius) continue;
+            if (present.count((long long)block.startY << 32 | block.startX)) continue;
+            blocks.push_back(block);
+        }
+    }
+
+    const size_t created = blocks.size() - first;
+    ThreadPool::shared().parallelFor(created, [&](size_t begin, size_t end) {
+        for (size_t i = first + begin; i < first + end; i++) {
+            Block& block = blocks[i];
+            block.heights.resize((size_t)(BLOCK_SIZE + 1) * (BLOCK_SIZE + 1));
+            noise.fill(block.startX, block.startY, BLOCK_SIZE + 1, BLOCK_SIZE + 1, block.heights.data());
+            updateBlockBounds(block);
+        }
+    });
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    stats.blocksGenerated = (int)created;
+    stats.generateMs = elapsed.count();
+}
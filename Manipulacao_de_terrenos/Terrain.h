@@ -5,36 +5,157 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
+#include "HeightMap.h"
+#include "NoiseSource.h"
 
-class Bmp;
+class SoftRasterizer;
 
 class Terrain {
 public:
-    Terrain(const std::string& bmpPath, GLuint shaderProgram);
+    // Aceita .bmp (canal 0), .pgm, .png, .r16/.raw e .r32/.f32 (ver HeightMap::load)
+    Terrain(const std::string& heightmapPath, GLuint shaderProgram);
+    Terrain(const HeightMap& heightmap, GLuint shaderProgram);
+    // Alturas procedurais. Com streamRadius = 0 o mapa width x height e' gerado
+    // inteiro aqui, em paralelo. Com streamRadius > 0 so' existem os blocos a
+    // menos de streamRadius da camera (no plano xz): render() gera as alturas
+    // dos que entram no raio e libera os que saem, entao o mapa pode ser
+    // muito maior que a memoria
+    Terrain(const NoiseSource& source, int width, int height, GLuint shaderProgram, float streamRadius = 0.0f);
     ~Terrain();
 
+    // Contadores do ultimo render(), usados pelo benchmark
+    struct Stats {
+        int drawCalls;
+        long long triangles;
+        long long uploadBytes;
+        int blocksMeshed;
+        double meshTimeMs;
+        int blocksGenerated;     // blocos com alturas geradas no quadro (streaming)
+        double generateMs;
+        int blocksCulled;        // fora do frustum
+        int blocksOccluded;      // no frustum, mas escondidos atras do relevo
+    };
+
+    // Caixa alinhada aos eixos de um objeto sobre o terreno (arvore, casa...)
+    struct Bounds {
+        glm::vec3 min, max;
+    };
+
     void setup(const glm::vec3& cameraPosition);
     void render(const glm::mat4& mvp, const glm::vec3& cameraPosition);
     // void updateLOD(const glm::vec3& cameraPosition);
+    // O mesmo quadro de render() (streaming, descarte, LOD) desenhado em
+    // wireframe no rasterizador de CPU, sem nenhuma chamada GL: as cores sao
+    // as coordenadas de textura, sem o lightMap. Nao usa a tesselacao
+    void rasterize(SoftRasterizer& target, const glm::mat4& mvp, const glm::vec3& cameraPosition);
+
+    // Parte de CPU da geracao de malha de um bloco (sem chamadas GL):
+    // vertices com posicao (3) + coordenada de textura (2) e indices de triangulos
+    void buildBlockMesh(int lodLevel, int startX, int startY, int blockWidth, int blockHeight,
+                        std::vector<float>& vertices, std::vector<unsigned int>& indices) const;
+
+    // Copia para o mapa do terreno a regiao [x0, x0 + w) x [y0, y0 + h) de
+    // heights (mapa do mesmo tamanho, linhas de stride floats) e marca os
+    // blocos que a tocam para refazer a malha no proximo render(). A
+    // normalizacao (maior altura) continua a do mapa original, para o relevo
+    // nao mudar de escala a cada atualizacao. Sem efeito no modo streaming
+    void updateHeights(const float* heights, size_t stride, int x0, int y0, int w, int h);
+
+    // Textura ligada na unidade 0 durante render() (0 = nenhuma), por exemplo
+    // a iluminacao do HorizonBake, amostrada com as coordenadas de textura
+    // dos vertices (x / largura, y / altura)
+    void setLightMap(GLuint texture) { lightMap = texture; }
+
+    // Descarte por frustum e por oclusao em render() (ligado por padrao).
+    // A oclusao trata o terreno como solido: o que so' apareceria pelas
+    // frestas do wireframe atras de um morro tambem e' descartado
+    void setCulling(bool enabled) { culling = enabled; }
+    // Objetos testados contra o horizonte a cada render(), na mesma varredura
+    // dos blocos; isObjectVisible(i) vale ate' o proximo render()
+    void setObjects(const std::vector<Bounds>& objects);
+    bool isObjectVisible(size_t index) const;
+
+    // Modo por tesselacao (GL 4.0), sem malhas na CPU: um patch de 4 cantos
+    // por bloco visivel, todos num unico draw. O TCS escolhe a subdivisao de
+    // cada aresta pelo tamanho dela na tela e pela aspereza dos blocos que a
+    // dividem, e o TES tira a altura de cada vertice de uma textura do mapa.
+    // fragmentShaderSource recebe TexCoord como no modo de malhas. Nao existe
+    // no modo streaming; false se nao for possivel (continua com malhas)
+    bool enableTessellation(const char* fragmentShaderSource);
+    // Tamanho na tela de um segmento de aresta (menor = mais triangulos)
+    void setTessellationDetail(float pixels) { pixelsPerSegment = pixels; }
+    // Programa usado por render() (o da tesselacao, se ligada)
+    GLuint getProgram() const { return tessProgram != 0 ? tessProgram : shaderProgram; }
+
+    const Stats& getStats() const { return stats; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
 
 private:
     struct Block {
         GLuint vao, vbo, ebo;
         int lodLevel;
+        int startX, startY;
         glm::vec3 center;
         int indexCount;
+        float minY, maxY;             // faixa de alturas no mundo (a malha de qualquer LOD fica dentro dela)
+        float roughness;              // maior desvio (no mundo) do bilinear entre os 4 cantos
+        std::vector<float> heights;   // streaming: (BLOCK_SIZE + 1)^2 amostras a partir de (startX, startY)
     };
 
+    static const int BLOCK_SIZE = 32; // Tamanho de cada bloco (em pixels)
+
     std::vector<Block> blocks;
     GLuint shaderProgram;
-    class Bmp* heightmap;
-    unsigned char* imageData;
+    GLint mvpLocation;
+    GLuint lightMap;
+    HeightMap heightmap;
     int width, height;
+    float maxHeight;
+    NoiseSource noise;
+    float streamRadius;
 
     int lodLevel;
+    Stats stats;
+
+    bool culling;
+    std::vector<Bounds> objects;
+    std::vector<char> objectVisible;
+    std::vector<size_t> drawList;       // blocos visiveis no quadro, de frente para tras
+    std::vector<float> horizon;         // por azimute em torno da camera: maior inclinacao ja' coberta
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> orderKeys;
+    // malhas de rasterize(), uma por bloco da drawList
+    std::vector<std::vector<float> > meshVertices;
+    std::vector<std::vector<unsigned int> > meshIndices;
+
+    // tesselacao (tessProgram = 0 no modo de malhas)
+    GLuint tessProgram;
+    GLuint heightTexture;               // alturas do mapa em R32F, na unidade 1
+    GLuint patchVao, patchVbo;
+    GLuint primitivesQuery;             // triangulos gerados, lidos um quadro depois
+    bool queryPending, patchesDirty;
+    float pixelsPerSegment;
+    long long tessTriangles;
+    GLint tessMvpLocation, tessPixelScaleLocation, tessDetailLocation;
+    std::vector<GLint> patchFirst;
+    std::vector<GLsizei> patchCount;
 
+    void buildMesh(int lodLevel, int startX, int startY, int blockWidth, int blockHeight,
+                   const float* samples, int originX, int originY, size_t stride,
+                   std::vector<float>& vertices, std::vector<unsigned int>& indices) const;
+    static int blockLod(float distance);
+    void resetStats();
     void generateBlockMesh(Block& block, int lodLevel, int startX, int startY, int blockWidth, int blockHeight);
+    void streamBlocks(const glm::vec3& cameraPosition);
     void calculateBlockCenter();
+    void updateBlockBounds(Block& block) const;
+    float groundHeight(const Block& block, float x, float z, float radius) const;
+    void cullBlocks(const glm::mat4& mvp, const glm::vec3& cameraPosition);
+    void uploadPatches();
+    void renderPatches(const glm::mat4& mvp);
+    void initHeights();
+    void deleteBlockMesh(Block& block);
 };
 
 #endif
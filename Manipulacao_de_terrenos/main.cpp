@@ -3,11 +3,26 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <ctype.h>
 #include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Erosion.h"
+#include "HorizonBake.h"
 #include "Terrain.h"
+#include "../Comum/Fft.h"
+#include "../Comum/FilterPipeline.h"
+#include "../Comum/GLState.h"
+#include "../Comum/Headless.h"
+#include "../Comum/ShaderCache.h"
+#include "../Comum/SoftRasterizer.h"
 
 #define SCREEN_X 800
 #define SCREEN_Y 600
+// Lado do mapa procedural do modo --stream
+#define STREAM_WORLD 65536
 
 const char* vertexShaderSource = R"(
 #version 400 core
@@ -20,81 +35,191 @@ void main() {
     gl_Position = mvp * vec4(aPos, 1.0);
 })";
 
+// Iluminacao lida da textura do HorizonBake: R = ceu visivel (ambiente),
+// G = sol visivel (sombra), BA = x e z da normal
 const char* fragmentShaderSource = R"(
 #version 400 core
 in vec2 TexCoord;
 out vec4 FragColor;
+uniform sampler2D lightMap;
+uniform vec3 sunDirection;
 void main() {
-    FragColor = vec4(TexCoord, 1.0, 1.0);
+    // TexCoord = x / largura: meio texel para cair no centro da amostra x
+    vec4 light = texture(lightMap, TexCoord + 0.5 / vec2(textureSize(lightMap, 0)));
+    vec3 normal = vec3(light.b * 2.0 - 1.0, 0.0, light.a * 2.0 - 1.0);
+    normal.y = sqrt(max(1.0 - dot(normal.xz, normal.xz), 0.0));
+    float sun = max(dot(normal, sunDirection), 0.0) * light.g;
+    FragColor = vec4(vec3(TexCoord, 1.0) * (0.35 * light.r + 0.85 * sun), 1.0);
 })";
 
-GLuint compileShader(const char* src, GLenum type) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "Erro ao compilar shader: " << infoLog << std::endl;
-    }
-    return shader;
-}
-
-GLuint createShaderProgram() {
-    GLuint vertexShader = compileShader(vertexShaderSource, GL_VERTEX_SHADER);
-    GLuint fragmentShader = compileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    return shaderProgram;
+// Textura RGBA8 com a iluminacao pre-calculada (ou uma amostra neutra)
+static GLuint createLightMap(int width, int height, const unsigned char* pixels) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
 }
 
-int main() {
-    if (!glfwInit()) return -1;
-
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(SCREEN_X, SCREEN_Y, "Terreno com LOD", NULL, NULL);
-    if (!window) {
-        glfwTerminate();
-        return -1;
+int main(int argc, char** argv) {
+    Headless app(argc, argv);
+    app.createContext(4, 0, true, SCREEN_X, SCREEN_Y, "Terreno com LOD");
+    if (!app.isOk()) return -1;
+
+    // "--software N" desenha no rasterizador de CPU, sem contexto GL nem
+    // iluminacao (so' o wireframe com as cores das coordenadas de textura)
+    std::unique_ptr<SoftRasterizer> software;
+    GLuint shaderProgram = 0;
+    if (app.isSoftware()) {
+        software.reset(new SoftRasterizer(SCREEN_X, SCREEN_Y));
+    }
+    else {
+        GLState::current().depthTest(true);
+        shaderProgram = ShaderCache::instance().program(vertexShaderSource, fragmentShaderSource);
     }
 
-    glfwMakeContextCurrent(window);
-    glewExperimental = true;
-    if (glewInit() != GLEW_OK) return -1;
-
-    glEnable(GL_DEPTH_TEST);
+    // "--smooth R" suaviza o relevo com um passa-baixa gaussiano de raio R (em
+    // ciclos por mapa) no dominio da frequencia: custo O(N log N) para qualquer R.
+    // "--denoise" tira picos isolados (mediana 3x3) e suaviza de leve (gaussiano).
+    // "--noise fbm|ridged|warped [seed]" troca o arquivo por um mapa procedural 256x256;
+    // "--stream R" usa um mapa procedural de STREAM_WORLD^2 do qual so' existem
+    // os blocos a menos de R da camera, gerados conforme ela anda.
+    // "--erode N" erode o mapa enquanto ele e' mostrado: a cada quadro N gotas
+    // de erosao hidraulica e algumas iteracoes de erosao termica, ate' uma gota
+    // por amostra do mapa, e so' os blocos das regioes alteradas refazem a malha.
+    // "--tess [pixels]" troca as malhas da CPU por patches tesselados na GPU,
+    // com segmentos de aresta de ~pixels na tela (padrao 8)
+    float smoothCutoff = 0.0f, streamRadius = 0.0f, tessPixels = 0.0f;
+    int erodeDroplets = 0;
+    bool denoise = false, procedural = false;
+    NoiseSource::Settings noiseSettings;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--smooth" && i + 1 < argc) smoothCutoff = (float)atof(argv[++i]);
+        else if (arg == "--denoise") denoise = true;
+        else if (arg == "--stream" && i + 1 < argc) streamRadius = (float)atof(argv[++i]);
+        else if (arg == "--erode" && i + 1 < argc) erodeDroplets = atoi(argv[++i]);
+        else if (arg == "--tess") {
+            tessPixels = 8.0f;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) tessPixels = (float)atof(argv[++i]);
+        }
+        else if (arg == "--noise" && i + 1 < argc) {
+            std::string type = argv[++i];
+            noiseSettings.type = type == "ridged" ? NoiseSource::RIDGED : (type == "warped" ? NoiseSource::WARPED : NoiseSource::FBM);
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) noiseSettings.seed = (unsigned int)atoi(argv[++i]);
+            procedural = true;
+        }
+    }
 
-    GLuint shaderProgram = createShaderProgram();
-    Terrain terrain("./images/heightmap_realistic_rgb.bmp", shaderProgram);
+    HeightMap heightmap;
+    if (procedural) {
+        NoiseSource(noiseSettings).generate(heightmap, 256, 256);
+    }
+    else if (streamRadius <= 0.0f && !heightmap.load("./images/heightmap_realistic_rgb.bmp")) {
+        std::cerr << "Erro ao carregar heightmap ./images/heightmap_realistic_rgb.bmp" << std::endl;
+    }
+    if (smoothCutoff > 0.0f && heightmap.getWidth() > 0) {
+        Fft2D fft(heightmap.getWidth(), heightmap.getHeight());
+        fft.filter(heightmap.getData(), FrequencyFilter(FrequencyFilter::GAUSSIAN, false, smoothCutoff));
+    }
+    if (denoise) {
+        FilterPipeline pipeline;
+        pipeline.median(1).gaussian(1.0f);
+        pipeline.run(heightmap.getData(), heightmap.getData(), heightmap.getWidth(), heightmap.getHeight());
+    }
+    std::unique_ptr<Terrain> terrain;
+    glm::vec3 center(128, 0, 128);
+    if (streamRadius > 0.0f) {
+        terrain.reset(new Terrain(NoiseSource(noiseSettings), STREAM_WORLD, STREAM_WORLD, shaderProgram, streamRadius));
+        center = glm::vec3(STREAM_WORLD / 2, 0, STREAM_WORLD / 2);
+    }
+    else {
+        terrain.reset(new Terrain(heightmap, shaderProgram));
+    }
+    if (tessPixels > 0.0f && !software) {
+        if (terrain->enableTessellation(fragmentShaderSource)) terrain->setTessellationDetail(tessPixels);
+        else std::cerr << "Tesselacao indisponivel, usando malhas" << std::endl;
+    }
+    std::unique_ptr<Erosion> erosion;
+    std::vector<Erosion::Region> eroded;
+    if (erodeDroplets > 0 && streamRadius <= 0.0f) erosion.reset(new Erosion(heightmap));
+
+    // Horizontes, ceu visivel e sombra do sol calculados uma vez (e de novo
+    // quando a erosao termina); no render so' uma leitura de textura. O
+    // streaming nao tem o mapa inteiro e fica com luz sem sombra
+    HorizonBake lighting;
+    GLuint lightMap = 0;
+    if (!software) {
+        if (streamRadius > 0.0f) {
+            const unsigned char neutral[4] = { 255, 255, 128, 128 };
+            lightMap = createLightMap(1, 1, neutral);
+        }
+        else {
+            lighting.bake(heightmap);
+            lightMap = createLightMap(lighting.getWidth(), lighting.getHeight(), lighting.getLighting());
+        }
+        terrain->setLightMap(lightMap);
+        glm::vec3 sun;
+        lighting.sunDirection(sun.x, sun.y, sun.z);
+        GLState::current().useProgram(terrain->getProgram());
+        glUniform3fv(ShaderCache::instance().reflection(terrain->getProgram()).uniform("sunDirection"), 1, glm::value_ptr(sun));
+    }
     //glm::vec3 cameraPosition(128, 60, 256);
     // terrain.setup(cameraPosition);
 
-    while (!glfwWindowShouldClose(window)) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    while (app.running()) {
+        if (software) software->clear(0.0f, 0.0f, 0.0f);
+        else glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::vec3 cameraPosition(128, 60, 256);
+        glm::vec3 focus = center;
+        glm::vec3 cameraPosition = center + glm::vec3(0, 60, 128);
+        if (app.isHeadless()) {
+            // trajetoria fixa para medicoes reproduziveis: orbita em torno do centro,
+            // que no modo streaming avanca 64 amostras por segundo
+            float t = (float)app.getTime() * 0.25f;
+            if (streamRadius > 0.0f) focus.x += 64.0f * (float)app.getTime();
+            cameraPosition = focus + glm::vec3(128 * sin(t), 60, 128 * cos(t));
+        }
 
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_X / SCREEN_Y, 1.0f, 1000.0f);
-        glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(128, 0, 128), glm::vec3(0, 1, 0));
+        glm::mat4 view = glm::lookAt(cameraPosition, focus, glm::vec3(0, 1, 0));
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 mvp = projection * view * model;
 
-        terrain.render(mvp, cameraPosition);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (erosion && erosion->getDropletCount() < (long long)heightmap.getWidth() * heightmap.getHeight()) {
+            erosion->hydraulic(erodeDroplets);
+            erosion->thermal(4);
+            erosion->takeDirty(eroded);
+            for (const Erosion::Region& r : eroded) {
+                terrain->updateHeights(heightmap.getData(), heightmap.getWidth(), r.x0, r.y0, r.width, r.height);
+            }
+            if (erosion->getDropletCount() >= (long long)heightmap.getWidth() * heightmap.getHeight() && !software) {
+                lighting.bake(heightmap);
+                GLState::current().bindTexture(0, GL_TEXTURE_2D, lightMap);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lighting.getWidth(), lighting.getHeight(), GL_RGBA,
+                                GL_UNSIGNED_BYTE, lighting.getLighting());
+            }
+        }
+        if (software) {
+            terrain->rasterize(*software, mvp, cameraPosition);
+            software->finish();
+        }
+        else {
+            terrain->render(mvp, cameraPosition);
+        }
+
+        app.endFrame();
     }
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    terrain.reset();
+    if (software) {
+        software->save(app.getImagePath().c_str());
+        return 0;
+    }
+    GLState::current().deleteTexture(lightMap);
     return 0;
 }
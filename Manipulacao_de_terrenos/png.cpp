@@ -0,0 +1,369 @@
+#include "Png.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// Implementacao do inflate baseada no "puff" de Mark Adler: decodificacao
+// canonica de Huffman bit a bit, suficiente para os poucos MB de um heightmap.
+namespace {
+
+struct Huffman {
+    short count[16];
+    short symbol[288];
+};
+
+struct BitReader {
+    const unsigned char* in;
+    size_t len, pos;
+    unsigned int buf;
+    int cnt;
+    bool error;
+
+    int bits(int need) {
+        unsigned int val = buf;
+        while (cnt < need) {
+            if (pos >= len) { error = true; return 0; }
+            val |= (unsigned int)in[pos++] << cnt;
+            cnt += 8;
+        }
+        buf = val >> need;
+        cnt -= need;
+        return (int)(val & ((1u << need) - 1));
+    }
+};
+
+int decodeSymbol(BitReader& s, const Huffman& h) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= s.bits(1);
+        int count = h.count[len];
+        if (code - count < first) return h.symbol[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+        if (s.error) return -1;
+    }
+    return -1;
+}
+
+void buildHuffman(Huffman& h, const short* length, int n) {
+    short offs[16];
+    memset(h.count, 0, sizeof(h.count));
+    for (int sym = 0; sym < n; sym++) h.count[length[sym]]++;
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + h.count[len];
+    for (int sym = 0; sym < n; sym++)
+        if (length[sym] != 0) h.symbol[offs[length[sym]]++] = (short)sym;
+}
+
+const short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const short lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const short distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                             257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                             8193, 12289, 16385, 24577 };
+const short distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                              7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Codigos fixos (bloco tipo 1), montados uma vez mesmo com varias threads
+// decodificando ao mesmo tempo (static local e' inicializado uma so' vez)
+struct FixedCodes {
+    Huffman lencode, distcode;
+
+    FixedCodes() {
+        short lengths[288];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < 288; sym++) lengths[sym] = 8;
+        buildHuffman(lencode, lengths, 288);
+        for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+        buildHuffman(distcode, lengths, 30);
+    }
+};
+
+const FixedCodes& fixedCodes() {
+    static const FixedCodes codes;
+    return codes;
+}
+
+// Saida do inflate: os ultimos WINDOW bytes (alcance maximo das distancias)
+// mais o que o consumidor ainda nao usou. A cada FLUSH_SIZE bytes novos ele
+// recebe o pendente e devolve quantos bytes usou (linhas inteiras); o que
+// ja' saiu da janela e' descartado, entao a memoria nao cresce com a imagem
+const size_t WINDOW = 32768;
+const size_t FLUSH_SIZE = 65536;
+const size_t SINK_ERROR = (size_t)-1;
+
+struct Output {
+    std::vector<unsigned char> data;
+    size_t consumed;
+    const std::function<size_t(const unsigned char* data, size_t size)>* sink;
+
+    bool flush() {
+        size_t used = (*sink)(data.data() + consumed, data.size() - consumed);
+        if (used == SINK_ERROR) return false;
+        consumed += used;
+        if (consumed > 8 * WINDOW) {
+            size_t drop = consumed - WINDOW;
+            data.erase(data.begin(), data.begin() + drop);
+            consumed -= drop;
+        }
+        return true;
+    }
+
+    bool pending() const { return data.size() - consumed >= FLUSH_SIZE; }
+};
+
+bool inflateCodes(BitReader& s, Output& output, const Huffman& lencode, const Huffman& distcode) {
+    std::vector<unsigned char>& out = output.data;
+    for (;;) {
+        if (output.pending() && !output.flush()) return false;
+        int symbol = decodeSymbol(s, lencode);
+        if (symbol < 0 || s.error) return false;
+        if (symbol < 256) {
+            out.push_back((unsigned char)symbol);
+        }
+        else if (symbol == 256) {
+            return true;
+        }
+        else {
+            symbol -= 257;
+            if (symbol >= 29) return false;
+            int len = lengthBase[symbol] + s.bits(lengthExtra[symbol]);
+            symbol = decodeSymbol(s, distcode);
+            if (symbol < 0 || symbol >= 30) return false;
+            size_t dist = distBase[symbol] + s.bits(distExtra[symbol]);
+            if (s.error || dist > out.size()) return false;
+            size_t from = out.size() - dist;
+            for (int i = 0; i < len; i++) out.push_back(out[from + i]);
+        }
+    }
+}
+
+} // namespace
+
+bool Png::inflate(const std::vector<unsigned char>& in, const ByteSink& sink) {
+    // cabecalho zlib: CM = 8 (deflate), sem dicionario pre-definido
+    if (in.size() < 2 || (in[0] & 0x0f) != 8 || (in[1] & 0x20) != 0) return false;
+
+    BitReader s = { in.data(), in.size(), 2, 0, 0, false };
+    Output out;
+    out.consumed = 0;
+    out.sink = &sink;
+    out.data.reserve(8 * WINDOW + FLUSH_SIZE + 65536);
+    int last;
+    do {
+        last = s.bits(1);
+        int type = s.bits(2);
+        if (s.error) return false;
+
+        if (type == 0) {
+            // bloco armazenado: descarta os bits restantes do byte atual
+            s.buf = 0;
+            s.cnt = 0;
+            if (s.pos + 4 > s.len) return false;
+            unsigned int len = s.in[s.pos] | (s.in[s.pos + 1] << 8);
+            unsigned int nlen = s.in[s.pos + 2] | (s.in[s.pos + 3] << 8);
+            s.pos += 4;
+            if (len != (~nlen & 0xffff) || s.pos + len > s.len) return false;
+            out.data.insert(out.data.end(), s.in + s.pos, s.in + s.pos + len);
+            s.pos += len;
+            if (out.pending() && !out.flush()) return false;
+        }
+        else if (type == 1) {
+            const FixedCodes& codes = fixedCodes();
+            if (!inflateCodes(s, out, codes.lencode, codes.distcode)) return false;
+        }
+        else if (type == 2) {
+            static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            short lengths[320];
+            Huffman lencode, distcode;
+
+            int nlen = s.bits(5) + 257;
+            int ndist = s.bits(5) + 1;
+            int ncode = s.bits(4) + 4;
+            if (nlen > 286 || ndist > 30) return false;
+
+            int index = 0;
+            for (; index < ncode; index++) lengths[order[index]] = (short)s.bits(3);
+            for (; index < 19; index++) lengths[order[index]] = 0;
+            buildHuffman(lencode, lengths, 19);
+
+            index = 0;
+            while (index < nlen + ndist) {
+                int symbol = decodeSymbol(s, lencode);
+                if (symbol < 0 || s.error) return false;
+                if (symbol < 16) {
+                    lengths[index++] = (short)symbol;
+                    continue;
+                }
+                short len = 0;
+                int repeat;
+                if (symbol == 16) {
+                    if (index == 0) return false;
+                    len = lengths[index - 1];
+                    repeat = 3 + s.bits(2);
+                }
+                else if (symbol == 17) {
+                    repeat = 3 + s.bits(3);
+                }
+                else {
+                    repeat = 11 + s.bits(7);
+                }
+                if (index + repeat > nlen + ndist) return false;
+                while (repeat--) lengths[index++] = len;
+            }
+
+            buildHuffman(lencode, lengths, nlen);
+            buildHuffman(distcode, lengths + nlen, ndist);
+            if (!inflateCodes(s, out, lencode, distcode)) return false;
+        }
+        else {
+            return false;
+        }
+    } while (!last);
+
+    return out.flush();
+}
+
+static unsigned int readBE32(const unsigned char* p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+bool Png::decode(const char* fileName,
+                 const std::function<void(int width, int height)>& onHeader,
+                 const RowCallback& onRow) {
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+    FILE* fp;
+    fopen_s(&fp, fileName, "rb");
+    if (fp == NULL) {
+        printf("\nErro ao abrir arquivo %s para leitura", fileName);
+        return false;
+    }
+
+    unsigned char sig[8];
+    if (fread(sig, 1, 8, fp) != 8 || memcmp(sig, signature, 8) != 0) {
+        printf("\nError: Arquivo PNG invalido: %s", fileName);
+        fclose(fp);
+        return false;
+    }
+
+    int width = 0, height = 0, bitDepth = 0, colorType = 0, interlace = 0;
+    std::vector<unsigned char> idat;
+    unsigned char head[8];
+    bool ok = false;
+
+    while (fread(head, 1, 8, fp) == 8) {
+        unsigned int len = readBE32(head);
+        if (memcmp(head + 4, "IHDR", 4) == 0) {
+            unsigned char ihdr[13];
+            if (len != 13 || fread(ihdr, 1, 13, fp) != 13) break;
+            width = (int)readBE32(ihdr);
+            height = (int)readBE32(ihdr + 4);
+            bitDepth = ihdr[8];
+            colorType = ihdr[9];
+            interlace = ihdr[12];
+            fseek(fp, 4, SEEK_CUR); // CRC
+        }
+        else if (memcmp(head + 4, "IDAT", 4) == 0) {
+            size_t old = idat.size();
+            idat.resize(old + len);
+            if (fread(idat.data() + old, 1, len, fp) != len) break;
+            fseek(fp, 4, SEEK_CUR);
+        }
+        else if (memcmp(head + 4, "IEND", 4) == 0) {
+            ok = true;
+            break;
+        }
+        else {
+            fseek(fp, (long)len + 4, SEEK_CUR);
+        }
+    }
+    fclose(fp);
+
+    if (!ok || width <= 0 || height <= 0) {
+        printf("\nError: Arquivo PNG incompleto: %s", fileName);
+        return false;
+    }
+
+    int channels;
+    switch (colorType) {
+        case 0: channels = 1; break; // cinza
+        case 2: channels = 3; break; // RGB
+        case 4: channels = 2; break; // cinza + alfa
+        case 6: channels = 4; break; // RGBA
+        default:
+            printf("\nError: Tipo de cor PNG nao suportado: %d", colorType);
+            return false;
+    }
+    if ((bitDepth != 8 && bitDepth != 16) || interlace != 0) {
+        printf("\nError: PNG com %d bits/canal ou entrelacado nao suportado", bitDepth);
+        return false;
+    }
+
+    int bpp = channels * bitDepth / 8;
+    size_t stride = (size_t)width * bpp;
+
+    onHeader(width, height);
+
+    // Desfaz os filtros e entrega o primeiro canal de cada linha conforme o
+    // inflate produz as linhas: so' a linha atual e a anterior ficam
+    // guardadas, nunca a imagem descomprimida inteira
+    std::vector<unsigned char> cur(stride), prev(stride, 0);
+    std::vector<unsigned short> row(width);
+    int y = 0;
+    ByteSink sink = [&](const unsigned char* data, size_t size) -> size_t {
+        size_t used = 0;
+        for (; y < height && size - used >= stride + 1; y++, used += stride + 1) {
+            const unsigned char* line = data + used;
+            int filter = line[0];
+            line++;
+
+            for (size_t i = 0; i < stride; i++) {
+                int a = i >= (size_t)bpp ? cur[i - bpp] : 0;
+                int b = prev[i];
+                int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+                switch (filter) {
+                    case 0: cur[i] = line[i]; break;
+                    case 1: cur[i] = (unsigned char)(line[i] + a); break;
+                    case 2: cur[i] = (unsigned char)(line[i] + b); break;
+                    case 3: cur[i] = (unsigned char)(line[i] + ((a + b) >> 1)); break;
+                    case 4: {
+                        int p = a + b - c;
+                        int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                        int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                        cur[i] = (unsigned char)(line[i] + pred);
+                        break;
+                    }
+                    default:
+                        printf("\nError: Filtro PNG invalido: %d", filter);
+                        return SINK_ERROR;
+                }
+            }
+
+            if (bitDepth == 16) {
+                for (int x = 0; x < width; x++)
+                    row[x] = (unsigned short)((cur[x * bpp] << 8) | cur[x * bpp + 1]);
+            }
+            else {
+                for (int x = 0; x < width; x++)
+                    row[x] = (unsigned short)(cur[x * bpp] * 257);
+            }
+            onRow(y, row.data());
+            cur.swap(prev);
+        }
+        return used;
+    };
+
+    if (!inflate(idat, sink) || y < height) {
+        printf("\nError: Falha ao descomprimir PNG: %s", fileName);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,607 @@
+#include "Collision.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <float.h>
+#include <functional>
+#include <emmintrin.h>
+#include "../../../Comum/Profiler.h"
+#include "../../../Comum/ThreadPool.h"
+
+// Limite de celulas por eixo: com corpos muito pequenos a grade ficaria
+// maior que a memoria util; celulas maiores continuam corretas, so' testam mais pares
+static const int MAX_GRID_CELLS = 2048;
+
+// Abaixo disso o custo de acordar as threads passa o do trabalho
+static const size_t PARALLEL_MIN_BODIES = 4096;
+
+// Limite de impactos por corpo num passo continuo; corpos presos entre
+// outros podem gerar impactos sem fim, e o passo discreto resolve o resto
+static const size_t MAX_IMPACTS_PER_BODY = 8;
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+size_t BodyStore::add(float px, float py, float speedX, float speedY, float half) {
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(speedX);
+    vy.push_back(speedY);
+    halfSize.push_back(half);
+    return x.size() - 1;
+}
+
+void BodyStore::clear() {
+    x.clear();
+    y.clear();
+    vx.clear();
+    vy.clear();
+    halfSize.clear();
+}
+
+void BodyStore::reserve(size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+    vx.reserve(n);
+    vy.reserve(n);
+    halfSize.reserve(n);
+}
+
+CollisionWorld::CollisionWorld()
+    : broadPhase(UNIFORM_GRID), continuous(false), sourceX(NULL), sourceY(NULL), sourceHalf(NULL),
+      sweepOrderValid(false) {
+    setBounds(-1.0f, -1.0f, 1.0f, 1.0f);
+    stats.testedPairs = stats.naivePairs = stats.contacts = stats.impacts = 0;
+    stats.broadMs = stats.narrowMs = stats.responseMs = stats.continuousMs = 0.0;
+}
+
+void CollisionWorld::setBounds(float minX, float minY, float maxX, float maxY) {
+    boundsMin[0] = minX;
+    boundsMin[1] = minY;
+    boundsMax[0] = maxX;
+    boundsMax[1] = maxY;
+}
+
+void CollisionWorld::step(float dt) {
+    if (continuous) advance(dt);
+    else integrate(dt);
+    detect();
+    resolve();
+}
+
+void CollisionWorld::integrate(float dt) {
+    PROFILE_SCOPE("CollisionWorld::integrate");
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+
+    // corpos independentes: faixas de corpos em paralelo
+    ThreadPool::shared().parallelFor(bodies.size(), [&](size_t begin, size_t end) {
+        // laco sem dependencias entre corpos: o compilador vetoriza
+        for (size_t i = begin; i < end; i++) {
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+        }
+        applyBounds(begin, end);
+    }, PARALLEL_MIN_BODIES);
+}
+
+// Verifica colisao com as bordas; o corpo volta para dentro e a velocidade aponta para fora da parede
+void CollisionWorld::applyBounds(size_t begin, size_t end) {
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+    const float* half = bodies.halfSize.data();
+    for (size_t i = begin; i < end; i++) {
+        if (x[i] - half[i] < boundsMin[0]) { x[i] = boundsMin[0] + half[i]; vx[i] = fabsf(vx[i]); }
+        if (x[i] + half[i] > boundsMax[0]) { x[i] = boundsMax[0] - half[i]; vx[i] = -fabsf(vx[i]); }
+        if (y[i] - half[i] < boundsMin[1]) { y[i] = boundsMin[1] + half[i]; vy[i] = fabsf(vy[i]); }
+        if (y[i] + half[i] > boundsMax[1]) { y[i] = boundsMax[1] - half[i]; vy[i] = -fabsf(vy[i]); }
+    }
+}
+
+void CollisionWorld::detect() {
+    PROFILE_SCOPE("CollisionWorld::detect");
+    detectPairs(bodies.x.data(), bodies.y.data(), bodies.halfSize.data());
+}
+
+// Fase larga + estreita sobre as colunas dadas (corpos ou caixas varridas)
+void CollisionWorld::detectPairs(const float* x, const float* y, const float* half) {
+    sourceX = x;
+    sourceY = y;
+    sourceHalf = half;
+    size_t n = bodies.size();
+    contacts.clear();
+    stats.testedPairs = 0;
+    stats.naivePairs = (long long)n * (long long)(n > 0 ? n - 1 : 0) / 2;
+    stats.broadMs = stats.narrowMs = 0.0;
+
+    if (broadPhase == UNIFORM_GRID) detectGrid();
+    else detectSweep();
+
+    // junta as faixas na ordem, para a resposta ser a mesma com qualquer numero de threads
+    for (Band& band : bands) {
+        contacts.insert(contacts.end(), band.contacts.begin(), band.contacts.end());
+        stats.testedPairs += band.tested;
+    }
+    stats.contacts = (long long)contacts.size();
+}
+
+// Counting sort dos corpos pela celula do centro. Com o lado da celula >= 2 *
+// maior meio-lado, dois quadrados que se tocam tem centros em celulas vizinhas.
+void CollisionWorld::buildGrid(int& columns, int& rows) {
+    size_t n = bodies.size();
+    float maxHalf = 0.0f;
+    for (size_t i = 0; i < n; i++) maxHalf = std::max(maxHalf, sourceHalf[i]);
+
+    float width = boundsMax[0] - boundsMin[0], height = boundsMax[1] - boundsMin[1];
+    float cellSize = std::max(2.0f * maxHalf, 1e-6f);
+    cellSize = std::max(cellSize, std::max(width, height) / MAX_GRID_CELLS);
+    columns = std::max(1, (int)ceilf(width / cellSize));
+    rows = std::max(1, (int)ceilf(height / cellSize));
+    float inverse = 1.0f / cellSize;
+
+    sweepOrderValid = false;
+    cellStart.assign((size_t)columns * rows + 1, 0);
+    cellOf.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        int cx = std::min(std::max((int)((sourceX[i] - boundsMin[0]) * inverse), 0), columns - 1);
+        int cy = std::min(std::max((int)((sourceY[i] - boundsMin[1]) * inverse), 0), rows - 1);
+        cellOf[i] = (unsigned int)(cy * columns + cx);
+        cellStart[cellOf[i] + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+
+    // copia as colunas na ordem das celulas; cellStart continua apontando o inicio de cada uma
+    order.resize(n);
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedHalf.resize(n);
+    std::vector<unsigned int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        unsigned int slot = fill[cellOf[i]]++;
+        order[slot] = (unsigned int)i;
+        sortedX[slot] = sourceX[i];
+        sortedY[slot] = sourceY[i];
+        sortedHalf[slot] = sourceHalf[i];
+    }
+}
+
+void CollisionWorld::detectGrid() {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    int columns, rows;
+    buildGrid(columns, rows);
+    stats.broadMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    // Cada par de celulas vizinhas e' visitado uma vez: a propria (so' j > i),
+    // leste, e as tres da linha de cima. Faixas de linhas em paralelo, cada
+    // uma com a propria lista de contatos.
+    const int neighbors[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+    prepareBands((size_t)rows);
+    ThreadPool::shared().parallelFor(bands.size(), [&](size_t firstBand, size_t lastBand) {
+        for (size_t b = firstBand; b < lastBand; b++) {
+            Band& band = bands[b];
+            for (int cy = (int)band.begin; cy < (int)band.end; cy++) {
+                for (int cx = 0; cx < columns; cx++) {
+                    unsigned int cell = (unsigned int)(cy * columns + cx);
+                    unsigned int begin = cellStart[cell], end = cellStart[cell + 1];
+                    if (begin == end) continue;
+
+                    for (unsigned int i = begin; i < end; i++) {
+                        testRange(i, i + 1, end, band);
+                        for (int k = 0; k < 4; k++) {
+                            int nx = cx + neighbors[k][0], ny = cy + neighbors[k][1];
+                            if (nx < 0 || nx >= columns || ny >= rows) continue;
+                            unsigned int other = (unsigned int)(ny * columns + nx);
+                            testRange(i, cellStart[other], cellStart[other + 1], band);
+                        }
+                    }
+                }
+            }
+        }
+    });
+    stats.narrowMs = elapsedMs(start);
+}
+
+// Divide [0, items) em faixas para a fase estreita (~4 por thread; uma so' com poucos corpos)
+void CollisionWorld::prepareBands(size_t items) {
+    size_t count = bodies.size() < PARALLEL_MIN_BODIES ? 1 : (size_t)ThreadPool::shared().getThreadCount() * 4;
+    count = std::min(count, items);
+    bands.resize(count);
+    for (size_t b = 0; b < count; b++) {
+        bands[b].begin = items * b / count;
+        bands[b].end = items * (b + 1) / count;
+        bands[b].contacts.clear();
+        bands[b].tested = 0;
+    }
+}
+
+// Sweep-and-prune no eixo x. A ordem do passo anterior quase nao muda, entao
+// um insertion sort sobre ela custa perto de O(n)
+void CollisionWorld::detectSweep() {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t n = bodies.size();
+    const float* x = sourceX;
+    const float* half = sourceHalf;
+    sortedMinX.resize(n);
+    if (order.size() != n || !sweepOrderValid) {
+        // sem ordem anterior: ordenacao completa
+        order.resize(n);
+        for (size_t i = 0; i < n; i++) order[i] = (unsigned int)i;
+        std::sort(order.begin(), order.end(), [x, half](unsigned int a, unsigned int b) {
+            return x[a] - half[a] < x[b] - half[b];
+        });
+        for (size_t i = 0; i < n; i++) sortedMinX[i] = x[order[i]] - half[order[i]];
+        sweepOrderValid = true;
+    }
+    else {
+        for (size_t i = 0; i < n; i++) sortedMinX[i] = x[order[i]] - half[order[i]];
+        for (size_t i = 1; i < n; i++) {
+            unsigned int body = order[i];
+            float key = sortedMinX[i];
+            size_t j = i;
+            while (j > 0 && sortedMinX[j - 1] > key) {
+                order[j] = order[j - 1];
+                sortedMinX[j] = sortedMinX[j - 1];
+                j--;
+            }
+            order[j] = body;
+            sortedMinX[j] = key;
+        }
+    }
+
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedHalf.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        sortedX[i] = x[order[i]];
+        sortedY[i] = sourceY[order[i]];
+        sortedHalf[i] = half[order[i]];
+    }
+    stats.broadMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    prepareBands(n);
+    ThreadPool::shared().parallelFor(bands.size(), [&](size_t firstBand, size_t lastBand) {
+        for (size_t b = firstBand; b < lastBand; b++) {
+            Band& band = bands[b];
+            for (unsigned int i = (unsigned int)band.begin; i < (unsigned int)band.end; i++) {
+                // candidatos: os que comecam ate' o fim de i no eixo x. Inclui
+                // o empate: o teste fino usa |dx| < hi + hj, calculado de outra
+                // forma, e o arredondamento pode aceitar um par que encosta
+                float maxX = sortedX[i] + sortedHalf[i];
+                unsigned int end = i + 1;
+                while (end < n && sortedMinX[end] <= maxX) end++;
+                testRange(i, i + 1, end, band);
+            }
+        }
+    });
+    stats.narrowMs = elapsedMs(start);
+}
+
+void CollisionWorld::testRange(unsigned int i, unsigned int begin, unsigned int end, Band& band) const {
+    if (begin >= end) return;
+    band.tested += end - begin;
+
+    const float* xs = sortedX.data();
+    const float* ys = sortedY.data();
+    const float* hs = sortedHalf.data();
+    float xi = xs[i], yi = ys[i], hi = hs[i];
+
+    // |dx| < hi + hj e |dy| < hi + hj, 4 corpos por vez; o valor absoluto e'
+    // feito zerando o bit de sinal
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 xi4 = _mm_set1_ps(xi), yi4 = _mm_set1_ps(yi), hi4 = _mm_set1_ps(hi);
+    unsigned int j = begin;
+    for (; j + 4 <= end; j += 4) {
+        __m128 reach = _mm_add_ps(hi4, _mm_loadu_ps(hs + j));
+        __m128 dx = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(xs + j), xi4), absMask);
+        __m128 dy = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(ys + j), yi4), absMask);
+        int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(dx, reach), _mm_cmplt_ps(dy, reach)));
+        while (mask) {
+            int bit = 0;
+            while (!(mask & (1 << bit))) bit++;
+            mask &= mask - 1;
+            addContact(i, j + bit, band.contacts);
+        }
+    }
+    for (; j < end; j++) {
+        float reach = hi + hs[j];
+        if (fabsf(xs[j] - xi) < reach && fabsf(ys[j] - yi) < reach) addContact(i, j, band.contacts);
+    }
+}
+
+// Normal no eixo de menor penetracao, de a para b
+void CollisionWorld::addContact(unsigned int a, unsigned int b, std::vector<Contact>& out) const {
+    float dx = sortedX[b] - sortedX[a], dy = sortedY[b] - sortedY[a];
+    float reach = sortedHalf[a] + sortedHalf[b];
+    float px = reach - fabsf(dx), py = reach - fabsf(dy);
+
+    Contact contact;
+    contact.a = order[a];
+    contact.b = order[b];
+    if (px < py) {
+        contact.nx = dx < 0.0f ? -1.0f : 1.0f;
+        contact.ny = 0.0f;
+        contact.depth = px;
+    }
+    else {
+        contact.nx = 0.0f;
+        contact.ny = dy < 0.0f ? -1.0f : 1.0f;
+        contact.depth = py;
+    }
+    out.push_back(contact);
+}
+
+void CollisionWorld::resolve() {
+    PROFILE_SCOPE("CollisionWorld::resolve");
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+
+    for (const Contact& c : contacts) {
+        // cada um recua metade da penetracao
+        float push = c.depth * 0.5f;
+        x[c.a] -= c.nx * push;
+        y[c.a] -= c.ny * push;
+        x[c.b] += c.nx * push;
+        y[c.b] += c.ny * push;
+
+        // so' troca as velocidades se os dois ainda estao se aproximando
+        float approach = (vx[c.b] - vx[c.a]) * c.nx + (vy[c.b] - vy[c.a]) * c.ny;
+        if (approach >= 0.0f) continue;
+        if (c.nx != 0.0f) std::swap(vx[c.a], vx[c.b]);
+        else std::swap(vy[c.a], vy[c.b]);
+    }
+    stats.responseMs = elapsedMs(start);
+}
+
+bool CollisionWorld::timeOfImpact(float dx, float dy, float vx, float vy, float reach, float maxTime,
+                                  float& time, int& axis) {
+    // Intervalo de tempo em que cada eixo se sobrepoe (slabs); o impacto e' a
+    // entrada mais tardia, desde que antes da primeira saida
+    const float d[2] = { dx, dy }, v[2] = { vx, vy };
+    float entry[2], exit[2];
+    for (int k = 0; k < 2; k++) {
+        if (v[k] == 0.0f) {
+            if (fabsf(d[k]) >= reach) return false;
+            entry[k] = -FLT_MAX;
+            exit[k] = FLT_MAX;
+        }
+        else {
+            float inverse = 1.0f / v[k];
+            float t0 = (-reach - d[k]) * inverse, t1 = (reach - d[k]) * inverse;
+            entry[k] = std::min(t0, t1);
+            exit[k] = std::max(t0, t1);
+        }
+    }
+    float enter = std::max(entry[0], entry[1]);
+    float leave = std::min(exit[0], exit[1]);
+    // enter < 0: ja' se sobrepoem (caso do passo discreto)
+    if (enter < 0.0f || enter > leave || enter >= maxTime) return false;
+    time = enter;
+    axis = entry[0] >= entry[1] ? 0 : 1;
+    return true;
+}
+
+void CollisionWorld::advance(float dt) {
+    PROFILE_SCOPE("CollisionWorld::advance");
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t n = bodies.size();
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* vx = bodies.vx.data();
+    const float* vy = bodies.vy.data();
+    const float* half = bodies.halfSize.data();
+
+    // Caixa varrida no passo como quadrado: centro no meio do caminho, meio-lado
+    // cobrindo o maior deslocamento (a fase larga so' trata quadrados)
+    sweptX.resize(n);
+    sweptY.resize(n);
+    sweptHalf.resize(n);
+    ThreadPool::shared().parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sweptX[i] = x[i] + vx[i] * dt * 0.5f;
+            sweptY[i] = y[i] + vy[i] * dt * 0.5f;
+            sweptHalf[i] = half[i] + std::max(fabsf(vx[i]), fabsf(vy[i])) * dt * 0.5f;
+        }
+    }, PARALLEL_MIN_BODIES);
+    detectPairs(sweptX.data(), sweptY.data(), sweptHalf.data());
+
+    // Estado de movimento na ordem da fase larga: vizinhos ficam perto na memoria
+    motion.resize(n);
+    rank.resize(n);
+    ThreadPool::shared().parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            unsigned int i = order[k];
+            Motion& m = motion[k];
+            m.x = x[i];
+            m.y = y[i];
+            m.vx = vx[i];
+            m.vy = vy[i];
+            m.half = half[i];
+            m.time = 0.0f;
+            m.version = 0;
+            rank[i] = (unsigned int)k;
+        }
+    }, PARALLEL_MIN_BODIES);
+    buildNeighbors();
+
+    // Primeiro impacto de cada corpo, em paralelo; so' os que acontecem no passo ficam
+    impacts.resize(n);
+    ThreadPool::shared().parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!nextImpact((unsigned int)i, 0.0f, dt, impacts[i])) impacts[i].time = FLT_MAX;
+        }
+    }, PARALLEL_MIN_BODIES);
+    impacts.erase(std::remove_if(impacts.begin(), impacts.end(),
+        [](const Impact& impact) { return impact.time == FLT_MAX; }), impacts.end());
+    std::make_heap(impacts.begin(), impacts.end(), std::greater<Impact>());
+
+    // Resolve na ordem do tempo. Cada corpo tem so' o proximo impacto na fila:
+    // se o outro corpo mudou de velocidade desde o calculo, o impacto e'
+    // descartado e o proximo do corpo e' recalculado a partir de agora
+    size_t limit = n * MAX_IMPACTS_PER_BODY;
+    stats.impacts = 0;
+    while (!impacts.empty() && (size_t)stats.impacts < limit) {
+        std::pop_heap(impacts.begin(), impacts.end(), std::greater<Impact>());
+        Impact impact = impacts.back();
+        impacts.pop_back();
+        Motion& a = motion[impact.a];
+        if (a.version != impact.versionA) continue;
+        if (impact.b != WALL && motion[impact.b].version != impact.versionB) {
+            schedule(impact.a, impact.time, dt);
+            continue;
+        }
+
+        moveTo(a, impact.time);
+        float& va = impact.axis == 0 ? a.vx : a.vy;
+        if (impact.b == WALL) {
+            // a parede so' gera impacto com o corpo indo contra ela
+            va = -va;
+        }
+        else {
+            Motion& b = motion[impact.b];
+            moveTo(b, impact.time);
+            float& vb = impact.axis == 0 ? b.vx : b.vy;
+            float gap = impact.axis == 0 ? b.x - a.x : b.y - a.y;
+            if ((vb - va) * gap < 0.0f) std::swap(va, vb);
+            b.version++;
+            schedule(impact.b, impact.time, dt);
+        }
+        a.version++;
+        schedule(impact.a, impact.time, dt);
+        stats.impacts++;
+    }
+    impacts.clear();
+
+    // o resto do passo em linha reta, de volta para as colunas dos corpos
+    float* xs = bodies.x.data();
+    float* ys = bodies.y.data();
+    float* vxs = bodies.vx.data();
+    float* vys = bodies.vy.data();
+    ThreadPool::shared().parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Motion& m = motion[rank[i]];
+            moveTo(m, dt);
+            xs[i] = m.x;
+            ys[i] = m.y;
+            vxs[i] = m.vx;
+            vys[i] = m.vy;
+        }
+        applyBounds(begin, end);
+    }, PARALLEL_MIN_BODIES);
+    stats.continuousMs = elapsedMs(start);
+}
+
+// Lista de vizinhos (pares candidatos) de cada corpo, em formato CSR, nos indices de motion
+void CollisionWorld::buildNeighbors() {
+    size_t n = bodies.size();
+    neighborStart.assign(n + 1, 0);
+    for (const Contact& c : contacts) {
+        neighborStart[rank[c.a] + 1]++;
+        neighborStart[rank[c.b] + 1]++;
+    }
+    for (size_t i = 1; i <= n; i++) neighborStart[i] += neighborStart[i - 1];
+    neighbors.resize(contacts.size() * 2);
+    std::vector<unsigned int> fill(neighborStart.begin(), neighborStart.end() - 1);
+    for (const Contact& c : contacts) {
+        unsigned int a = rank[c.a], b = rank[c.b];
+        neighbors[fill[a]++] = b;
+        neighbors[fill[b]++] = a;
+    }
+}
+
+void CollisionWorld::moveTo(Motion& m, float time) {
+    float elapsed = time - m.time;
+    m.x += m.vx * elapsed;
+    m.y += m.vy * elapsed;
+    m.time = time;
+}
+
+// Impacto entre a e b depois de now, com as posicoes dos dois levadas a now
+bool CollisionWorld::pairImpact(unsigned int a, unsigned int b, float now, float dt, Impact& impact) const {
+    const Motion& ma = motion[a];
+    const Motion& mb = motion[b];
+    float ta = now - ma.time, tb = now - mb.time;
+    float dx = (mb.x + mb.vx * tb) - (ma.x + ma.vx * ta);
+    float dy = (mb.y + mb.vy * tb) - (ma.y + ma.vy * ta);
+    float time;
+    int axis;
+    if (!timeOfImpact(dx, dy, mb.vx - ma.vx, mb.vy - ma.vy, ma.half + mb.half, dt - now, time, axis)) return false;
+    impact.time = now + time;
+    impact.a = a;
+    impact.b = b;
+    impact.versionA = ma.version;
+    impact.versionB = mb.version;
+    impact.axis = axis;
+    return true;
+}
+
+// Primeira parede que o corpo i alcanca depois de now, indo na direcao dela
+bool CollisionWorld::wallImpact(unsigned int i, float now, float dt, Impact& impact) const {
+    const Motion& m = motion[i];
+    float elapsed = now - m.time;
+    const float position[2] = { m.x + m.vx * elapsed, m.y + m.vy * elapsed };
+    const float velocity[2] = { m.vx, m.vy };
+    float best = dt - now;
+    int bestAxis = -1;
+    for (int k = 0; k < 2; k++) {
+        if (velocity[k] == 0.0f) continue;
+        float wall = velocity[k] > 0.0f ? boundsMax[k] - m.half : boundsMin[k] + m.half;
+        // ja' fora e saindo: reflete na hora
+        float time = std::max((wall - position[k]) / velocity[k], 0.0f);
+        if (time < best) {
+            best = time;
+            bestAxis = k;
+        }
+    }
+    if (bestAxis < 0) return false;
+    impact.time = now + best;
+    impact.a = i;
+    impact.b = WALL;
+    impact.versionA = m.version;
+    impact.versionB = 0;
+    impact.axis = bestAxis;
+    return true;
+}
+
+// Impacto mais proximo do corpo i depois de now, com vizinhos ou paredes
+bool CollisionWorld::nextImpact(unsigned int i, float now, float dt, Impact& impact) const {
+    bool found = wallImpact(i, now, dt, impact);
+    Impact candidate;
+    for (unsigned int k = neighborStart[i]; k < neighborStart[i + 1]; k++) {
+        if (pairImpact(i, neighbors[k], now, dt, candidate) && (!found || candidate.time < impact.time)) {
+            impact = candidate;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void CollisionWorld::schedule(unsigned int i, float now, float dt) {
+    Impact impact;
+    if (!nextImpact(i, now, dt, impact)) return;
+    impacts.push_back(impact);
+    std::push_heap(impacts.begin(), impacts.end(), std::greater<Impact>());
+}
+
+void CollisionWorld::detectNaive(std::vector<Contact>& out) const {
+    out.clear();
+    size_t n = bodies.size();
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) {
+            float reach = bodies.halfSize[a] + bodies.halfSize[b];
+            if (fabsf(bodies.x[b] - bodies.x[a]) < reach && fabsf(bodies.y[b] - bodies.y[a]) < reach) {
+                Contact contact = { (unsigned int)a, (unsigned int)b, 0.0f, 0.0f, 0.0f };
+                out.push_back(contact);
+            }
+        }
+    }
+}
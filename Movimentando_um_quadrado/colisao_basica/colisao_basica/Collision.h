@@ -0,0 +1,162 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <stddef.h>
+#include <vector>
+
+// Corpos em estrutura de arrays: cada campo num vetor proprio, para os lacos
+// de integracao e de teste lerem so' o que usam e vetorizarem (SSE, 4 corpos
+// por instrucao). Posicao e' o centro; halfSize e' metade do lado do quadrado.
+struct BodyStore {
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;   // unidades por segundo
+    std::vector<float> halfSize;
+
+    size_t size() const { return x.size(); }
+    size_t add(float px, float py, float speedX, float speedY, float half);
+    void clear();
+    void reserve(size_t n);
+};
+
+// Par em contato; normal (nx, ny) aponta de a para b e depth e' a penetracao
+struct Contact {
+    unsigned int a, b;
+    float nx, ny;
+    float depth;
+};
+
+// Deteccao em duas fases sobre quadrados alinhados aos eixos (AABB):
+//
+// - fase larga: grade uniforme (ordenacao por celula, cada corpo testa a
+//   propria celula e 4 vizinhas) ou sweep-and-prune no eixo x;
+// - fase estreita: teste AABB com SSE contra blocos contiguos de corpos ja'
+//   ordenados, sem gather, em faixas paralelas;
+// - resposta: separa os pares na direcao de menor penetracao e troca as
+//   componentes normais das velocidades (choque elastico, massas iguais).
+//
+// No modo continuo (setContinuous) o teste discreto no fim do passo deixaria
+// corpos rapidos atravessarem outros entre dois passos. Entao a fase larga
+// roda sobre a caixa varrida de cada corpo no passo, cada par candidato tem o
+// tempo de impacto calculado (swept AABB) e os impactos sao resolvidos em
+// ordem de tempo: cada corpo avanca so' ate' o proximo impacto conhecido
+// (avanco conservador), e quando um impacto muda a velocidade de um corpo os
+// impactos dele com os vizinhos sao recalculados. Um passo discreto no fim
+// corrige o que sobrar. Assim o passo pode ser bem maior sem perder contatos.
+//
+// getStats() compara os pares testados com os n(n-1)/2 do teste ingenuo.
+class CollisionWorld {
+public:
+    enum BroadPhase { UNIFORM_GRID, SWEEP_AND_PRUNE };
+
+    struct Stats {
+        long long testedPairs;    // pares que chegaram ao teste AABB
+        long long naivePairs;     // n(n-1)/2
+        long long contacts;
+        long long impacts;        // impactos resolvidos pelo modo continuo no passo
+        double broadMs, narrowMs, responseMs;
+        double continuousMs;      // calculo e resolucao dos tempos de impacto
+    };
+
+    CollisionWorld();
+
+    BodyStore bodies;
+
+    void setBroadPhase(BroadPhase phase) { broadPhase = phase; }
+    BroadPhase getBroadPhase() const { return broadPhase; }
+    // Paredes do mundo; corpos que as tocam sao refletidos
+    void setBounds(float minX, float minY, float maxX, float maxY);
+    void setContinuous(bool enabled) { continuous = enabled; }
+    bool isContinuous() const { return continuous; }
+
+    // integrate + detect + resolve, ou advance + detect + resolve no modo
+    // continuo. Integracao e fase estreita usam ThreadPool::shared()
+    void step(float dt);
+    void integrate(float dt);
+    void detect();
+    void resolve();
+    // Move os corpos por dt resolvendo os impactos no caminho, em ordem de tempo
+    void advance(float dt);
+
+    // Tempo de impacto entre dois quadrados em movimento retilineo: d e' a
+    // posicao de b menos a de a, v a velocidade de b menos a de a, reach a soma
+    // dos meio-lados. Falso se ja' se sobrepoem ou nao se tocam antes de maxTime;
+    // axis = 0 (x) ou 1 (y) e' o eixo do contato.
+    static bool timeOfImpact(float dx, float dy, float vx, float vy, float reach, float maxTime,
+                             float& time, int& axis);
+
+    // Referencia O(n^2) para validar a fase larga (so' para n pequeno)
+    void detectNaive(std::vector<Contact>& out) const;
+
+    const std::vector<Contact>& getContacts() const { return contacts; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    BroadPhase broadPhase;
+    float boundsMin[2], boundsMax[2];
+    bool continuous;
+
+    // Colunas de entrada da fase larga: os proprios corpos, ou as caixas
+    // varridas no modo continuo
+    const float *sourceX, *sourceY, *sourceHalf;
+    std::vector<float> sweptX, sweptY, sweptHalf;
+
+    // Copias ordenadas (por celula ou por x) das colunas usadas no teste
+    std::vector<unsigned int> order;
+    std::vector<float> sortedX, sortedY, sortedHalf;
+    std::vector<float> sortedMinX;
+    bool sweepOrderValid;        // order ainda e' a do sweep anterior (nao a da grade)
+    // Grade: inicio de cada celula em order (counting sort)
+    std::vector<unsigned int> cellStart, cellOf;
+    std::vector<Contact> contacts;
+    Stats stats;
+
+    // Faixa da fase estreita (linhas da grade ou corpos do sweep) processada por uma thread
+    struct Band {
+        size_t begin, end;
+        std::vector<Contact> contacts;
+        long long tested;
+    };
+    std::vector<Band> bands;
+
+    // Impacto agendado (a e b indices em motion); vale enquanto as velocidades de a e b nao mudarem
+    // (versoes iguais as de quando foi calculado). b = WALL para paredes.
+    struct Impact {
+        float time;
+        unsigned int a, b;
+        unsigned int versionA, versionB;
+        int axis;
+        bool operator>(const Impact& other) const { return time > other.time; }
+    };
+    static const unsigned int WALL = 0xFFFFFFFFu;
+    std::vector<Impact> impacts;              // heap pelo menor tempo, no maximo um valido por corpo
+    // Copia do corpo durante advance(), na ordem da fase larga; version conta
+    // as mudancas de velocidade e time e' ate' onde o corpo ja' avancou no passo
+    struct Motion {
+        float x, y, vx, vy, half, time;
+        unsigned int version;
+    };
+    std::vector<Motion> motion;
+    std::vector<unsigned int> rank;           // indice em motion de cada corpo
+    std::vector<unsigned int> neighborStart, neighbors;   // pares candidatos por corpo (CSR)
+
+    void applyBounds(size_t begin, size_t end);
+    void detectPairs(const float* x, const float* y, const float* half);
+
+    void buildGrid(int& columns, int& rows);
+    void detectGrid();
+    void detectSweep();
+    void prepareBands(size_t items);
+    // Testa o corpo ordenado i contra os ordenados [begin, end)
+    void testRange(unsigned int i, unsigned int begin, unsigned int end, Band& band) const;
+    void addContact(unsigned int a, unsigned int b, std::vector<Contact>& out) const;
+
+    void buildNeighbors();
+    static void moveTo(Motion& m, float time);
+    bool pairImpact(unsigned int a, unsigned int b, float now, float dt, Impact& impact) const;
+    bool wallImpact(unsigned int i, float now, float dt, Impact& impact) const;
+    bool nextImpact(unsigned int i, float now, float dt, Impact& impact) const;
+    // Poe na fila o proximo impacto do corpo i
+    void schedule(unsigned int i, float now, float dt);
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "SpriteBatch.h"
+#include <algorithm>
+#include <string.h>
+#include "../../../Comum/GLState.h"
+#include "../../../Comum/Profiler.h"
+#include "../../../Comum/ShaderCache.h"
+
+static const char* spriteVertexSource = R"(
+    #version 420 core
+    layout(location = 0) in vec2 aCenter;
+    layout(location = 1) in vec2 aSize;
+    layout(location = 2) in vec4 aColor;
+
+    out vec2 uv;
+    out vec4 color;
+
+    void main() {
+        // canto do quadrado a partir do indice do vertice: (0,0) (1,0) (0,1) (1,1)
+        vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+        gl_Position = vec4(aCenter + (corner - 0.5) * aSize, 0.0, 1.0);
+        uv = corner;
+        color = aColor;
+    }
+)";
+
+static const char* spriteFragmentSource = R"(
+    #version 420 core
+    in vec2 uv;
+    in vec4 color;
+    out vec4 FragColor;
+    uniform sampler2D sprite;
+
+    void main() {
+        FragColor = texture(sprite, uv) * color;
+    }
+)";
+
+SpriteBatch::SpriteBatch(size_t initialCapacity)
+    : lastBucket(-1), vao(0), buffer(0), defaultProgram(0), whiteTexture(0), textureLocation(-1),
+      capacity(0), persistent(false), mapped(NULL), region(0), drawCalls(0), spriteCount(0)
+{
+    for (int i = 0; i < REGIONS; i++) fences[i] = 0;
+
+    ShaderCache& shaders = ShaderCache::instance();
+    defaultProgram = shaders.program(spriteVertexSource, spriteFragmentSource);
+    textureLocation = shaders.reflection(defaultProgram).uniform("sprite");
+    GLState::current().useProgram(defaultProgram);
+    glUniform1i(textureLocation, 0);
+
+    // textura branca 1x1: sprites sem textura usam so' a cor
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    glGenTextures(1, &whiteTexture);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    persistent = GLEW_ARB_buffer_storage != 0;
+    glGenVertexArrays(1, &vao);
+    createBuffer(std::max(initialCapacity, (size_t)1));
+}
+
+SpriteBatch::~SpriteBatch() {
+    destroyBuffer();
+    GLState& gl = GLState::current();
+    gl.deleteVertexArray(vao);
+    gl.deleteTexture(whiteTexture);
+}
+
+// Cria o buffer de instancias e liga os atributos por instancia no VAO
+void SpriteBatch::createBuffer(size_t newCapacity) {
+    capacity = newCapacity;
+    GLsizeiptr bytes = (GLsizeiptr)(capacity * REGIONS * sizeof(Sprite));
+
+    GLState& gl = GLState::current();
+    gl.bindVertexArray(vao);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistent) {
+        // coerente: o que a CPU escreve fica visivel sem glFlushMappedBufferRange
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+        mapped = (Sprite*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+        if (mapped == NULL) {
+            // driver recusou o mapeamento: recria como buffer comum
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            persistent = false;
+        }
+    }
+    if (!persistent) glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(capacity * sizeof(Sprite)), NULL, GL_STREAM_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite), (void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite), (void*)(2 * sizeof(float)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Sprite), (void*)(4 * sizeof(float)));
+    for (GLuint i = 0; i < 3; i++) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+    gl.bindVertexArray(0);
+}
+
+void SpriteBatch::destroyBuffer() {
+    for (int i = 0; i < REGIONS; i++) {
+        if (fences[i]) {
+            glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = NULL;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+unsigned int SpriteBatch::rgba(float r, float g, float b, float a) {
+    const float c[4] = { r, g, b, a };
+    unsigned int packed = 0;
+    for (int i = 0; i < 4; i++) {
+        float v = std::min(std::max(c[i], 0.0f), 1.0f);
+        packed |= (unsigned int)(v * 255.0f + 0.5f) << (i * 8);
+    }
+    return packed;
+}
+
+void SpriteBatch::begin() {
+    for (Bucket& bucket : buckets) bucket.sprites.clear();
+    lastBucket = -1;
+}
+
+SpriteBatch::Bucket& SpriteBatch::bucketFor(GLuint texture, GLuint program) {
+    if (program == 0) program = defaultProgram;
+    if (lastBucket >= 0 && buckets[lastBucket].texture == texture && buckets[lastBucket].program == program) {
+        return buckets[lastBucket];
+    }
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (buckets[i].texture == texture && buckets[i].program == program) {
+            lastBucket = (int)i;
+            return buckets[i];
+        }
+    }
+    Bucket bucket;
+    bucket.program = program;
+    bucket.texture = texture;
+    buckets.push_back(bucket);
+    lastBucket = (int)buckets.size() - 1;
+    return buckets.back();
+}
+
+void SpriteBatch::draw(float x, float y, float width, float height, unsigned int color, GLuint texture, GLuint program) {
+    Sprite sprite = { x, y, width, height, color };
+    bucketFor(texture, program).sprites.push_back(sprite);
+}
+
+SpriteBatch::Sprite* SpriteBatch::allocate(size_t count, GLuint texture, GLuint program) {
+    std::vector<Sprite>& sprites = bucketFor(texture, program).sprites;
+    size_t start = sprites.size();
+    sprites.resize(start + count);
+    return sprites.data() + start;
+}
+
+void SpriteBatch::end() {
+    PROFILE_SCOPE("SpriteBatch::end");
+    PROFILE_GPU_SCOPE("SpriteBatch::end");
+    drawCalls = 0;
+    spriteCount = 0;
+
+    // baldes nao vazios, por programa e depois por textura
+    std::vector<Bucket*> order;
+    for (Bucket& bucket : buckets) {
+        if (bucket.sprites.empty()) continue;
+        order.push_back(&bucket);
+        spriteCount += bucket.sprites.size();
+    }
+    if (spriteCount == 0) return;
+    std::sort(order.begin(), order.end(), [](const Bucket* a, const Bucket* b) {
+        return a->program != b->program ? a->program < b->program : a->texture < b->texture;
+    });
+
+    if (spriteCount > capacity) {
+        destroyBuffer();
+        createBuffer(std::max(spriteCount, capacity * 2));
+    }
+
+    // Regiao deste quadro: espera a GPU terminar o quadro que a usou por ultimo
+    size_t base = 0;
+    if (persistent) {
+        region = (region + 1) % REGIONS;
+        if (fences[region]) {
+            PROFILE_SCOPE("SpriteBatch::waitFence");
+            while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000ull) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        base = (size_t)region * capacity;
+        Sprite* out = mapped + base;
+        for (Bucket* bucket : order) {
+            memcpy(out, bucket->sprites.data(), bucket->sprites.size() * sizeof(Sprite));
+            out += bucket->sprites.size();
+        }
+    }
+    else {
+        // orphaning: o driver entrega memoria nova em vez de esperar a GPU
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(capacity * sizeof(Sprite)), NULL, GL_STREAM_DRAW);
+        size_t offset = 0;
+        for (Bucket* bucket : order) {
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(offset * sizeof(Sprite)),
+                            (GLsizeiptr)(bucket->sprites.size() * sizeof(Sprite)), bucket->sprites.data());
+            offset += bucket->sprites.size();
+        }
+    }
+    PROFILE_UPLOAD(spriteCount * sizeof(Sprite));
+
+    GLState& gl = GLState::current();
+    gl.bindVertexArray(vao);
+    size_t first = base;
+    for (Bucket* bucket : order) {
+        gl.useProgram(bucket->program);
+        gl.bindTexture(0, GL_TEXTURE_2D, bucket->texture ? bucket->texture : whiteTexture);
+
+        // baseInstance aponta os atributos por instancia para o inicio do balde na regiao
+        GLsizei count = (GLsizei)bucket->sprites.size();
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, count, (GLuint)first);
+        PROFILE_DRAW(2LL * count);
+        first += bucket->sprites.size();
+        drawCalls++;
+    }
+
+    if (persistent) fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,76 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// Desenha retangulos 2D (em coordenadas de tela -1..1) em lote: cada sprite
+// vira uma instancia de 20 bytes (centro, tamanho, cor RGBA8) e um quadro
+// inteiro sai em uma chamada de desenho por combinacao programa/textura.
+//
+// As instancias vao para um buffer mapeado de forma persistente
+// (ARB_buffer_storage) dividido em 3 regioes; cada quadro escreve numa regiao
+// que a GPU ja' terminou de ler (fence), sem glBufferData nem glMap por
+// quadro. Sem a extensao, cai para glBufferData + glBufferSubData.
+//
+// Sprites com programa/textura diferentes vao para baldes separados; end()
+// desenha os baldes ordenados por programa e depois por textura, para trocar
+// cada estado o minimo de vezes. O programa padrao multiplica a cor pela
+// textura (branca se texture == 0). Programas proprios recebem os mesmos
+// atributos: 0 = centro (vec2), 1 = tamanho (vec2), 2 = cor (vec4), e o canto
+// do quadrado vem de gl_VertexID (0..3, triangle strip).
+class SpriteBatch {
+public:
+    struct Sprite {
+        float x, y;             // centro
+        float width, height;
+        unsigned int color;     // RGBA8, R no byte mais baixo
+    };
+
+    // capacity: sprites por quadro antes de o buffer precisar crescer
+    explicit SpriteBatch(size_t capacity = 1 << 16);
+    ~SpriteBatch();
+
+    void begin();
+    void draw(float x, float y, float width, float height, unsigned int color, GLuint texture = 0, GLuint program = 0);
+    // Reserva count sprites no balde de (texture, program) para preencher direto
+    Sprite* allocate(size_t count, GLuint texture = 0, GLuint program = 0);
+    void end();
+
+    static unsigned int rgba(float r, float g, float b, float a = 1.0f);
+
+    int getDrawCalls() const { return drawCalls; }
+    size_t getSpriteCount() const { return spriteCount; }
+    bool isPersistent() const { return persistent; }
+
+private:
+    static const int REGIONS = 3;
+
+    struct Bucket {
+        GLuint program, texture;
+        std::vector<Sprite> sprites;
+    };
+
+    std::vector<Bucket> buckets;
+    int lastBucket;               // atalho: quase sempre o proximo sprite vai para o mesmo balde
+
+    GLuint vao, buffer, defaultProgram, whiteTexture;
+    GLint textureLocation;
+    size_t capacity;
+    bool persistent;
+    Sprite* mapped;               // inicio do buffer persistente
+    GLsync fences[REGIONS];
+    int region;
+
+    int drawCalls;
+    size_t spriteCount;
+
+    Bucket& bucketFor(GLuint texture, GLuint program);
+    void createBuffer(size_t newCapacity);
+    void destroyBuffer();
+
+    SpriteBatch(const SpriteBatch&);
+    SpriteBatch& operator=(const SpriteBatch&);
+};
+
+#endif
@@ -1,194 +1,204 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include <iostream>
 #include <cmath>
-
-// Vertex Shader Source Code
-const char* vertexShaderSource = R"(
-    #version 400 core
-    layout(location = 0) in vec2 aPos;
-    layout(location = 1) in vec3 aColor;
-
-    out vec3 vertexColor;
-    uniform vec2 offset;
-
-    void main() {
-        gl_Position = vec4(aPos + offset, 0.0, 1.0);
-        vertexColor = aColor;
+#include <random>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "../../../Comum/GLState.h"
+#include "../../../Comum/Headless.h"
+#include "../../../Comum/SimulationLoop.h"
+#include "../../../Comum/ThreadPool.h"
+#include "Collision.h"
+#include "SpriteBatch.h"
+
+// Passo fixo da simulao, independente da taxa de quadros
+static const double STEP_SECONDS = 1.0 / 120.0;
+// Com coliso contnua nenhum contato se perde entre passos, ento o passo pode ser maior
+static const double CONTINUOUS_STEP_SECONDS = 1.0 / 30.0;
+
+// Os dois quadrados originais, ou n quadrados aleatrios (semente fixa) ocupando ~10% da tela
+static void createBodies(BodyStore& bodies, int count) {
+    bodies.clear();
+    if (count <= 2) {
+        // Posio inicial e velocidade (por segundo, a 60 quadros por segundo) dos quadrados
+        bodies.add(0.5f, 0.5f, 0.3f, 0.18f, 0.1f);
+        bodies.add(-0.5f, 0.5f, 0.6f, 0.36f, 0.1f);
+        return;
     }
-)";
 
-// Fragment Shader Source Code
-const char* fragmentShaderSource = R"(
-    #version 400 core
-    in vec3 vertexColor;
-    out vec4 FragColor;
-
-    void main() {
-        FragColor = vec4(vertexColor, 1.0);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f), speed(-0.3f, 0.3f);
+    float half = sqrtf(0.1f / count);
+    bodies.reserve(count);
+    for (int i = 0; i < count; i++) {
+        bodies.add(position(random) * (1.0f - half), position(random) * (1.0f - half), speed(random), speed(random), half);
     }
-)";
-
-void checkCompileErrors(GLuint shader, std::string type) {
-    GLint success;
-    GLchar infoLog[1024];
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n"
-                << infoLog << "\n" << std::endl;
-        }
-    }
-    else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n"
-                << infoLog << "\n" << std::endl;
+}
+
+// Gradiente 16x16 com as cores dos cantos do quadrado original
+static GLuint createGradientTexture() {
+    const float corners[4][3] = {
+        { 1.0f, 0.0f, 0.0f },   // Inferior esquerdo (Vermelho)
+        { 0.0f, 1.0f, 0.0f },   // Inferior direito (Verde)
+        { 0.0f, 0.0f, 1.0f },   // Superior esquerdo (Azul)
+        { 0.5f, 0.4f, 1.0f }    // Superior direito (Roxo)
+    };
+    const int size = 16;
+    std::vector<unsigned char> pixels(size * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float u = x / (size - 1.0f), v = y / (size - 1.0f);
+            for (int c = 0; c < 3; c++) {
+                float bottom = corners[0][c] + (corners[1][c] - corners[0][c]) * u;
+                float top = corners[2][c] + (corners[3][c] - corners[2][c]) * u;
+                pixels[(y * size + x) * 4 + c] = (unsigned char)((bottom + (top - bottom) * v) * 255.0f + 0.5f);
+            }
+            pixels[(y * size + x) * 4 + 3] = 255;
         }
     }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
 }
 
-// Estrutura para armazenar o tringulo em movimento
-struct Square {
-    float x, y;        // Posio
-    float speedX, speedY; // Velocidade
-    float size = 0.2f; // Tamanho do tringulo
-};
-
-// Funo para verificar coliso entre dois quadrados
-bool checkCollision(const Square& a, const Square& b) {
-    return (fabs(a.x - b.x) * 2 < (a.size + b.size)) &&
-        (fabs(a.y - b.y) * 2 < (a.size + b.size));
-};
-
-int main() {
-    // Inicializa GLFW
-    if (!glfwInit()) {
-        std::cerr << "Erro ao inicializar GLFW" << std::endl;
-        return -1;
+// Modo benchmark (sem janela nem OpenGL): --bench N [--steps S] [--sap] [--ccd] [--validate]
+static int runBenchmark(int count, int steps, bool sweep, bool continuous, bool validate) {
+    CollisionWorld world;
+    world.setBroadPhase(sweep ? CollisionWorld::SWEEP_AND_PRUNE : CollisionWorld::UNIFORM_GRID);
+    world.setContinuous(continuous);
+    double stepSeconds = continuous ? CONTINUOUS_STEP_SECONDS : STEP_SECONDS;
+    createBodies(world.bodies, count);
+
+    if (validate) {
+        // A fase larga no pode perder nenhum par que o teste ingnuo encontra
+        std::vector<Contact> naive;
+        world.detect();
+        world.detectNaive(naive);
+        bool ok = naive.size() == world.getContacts().size();
+        std::cout << "Validacao: " << world.getContacts().size() << " contatos, ingenuo " << naive.size()
+                  << (ok ? " (ok)" : " (DIFERENTE)") << std::endl;
+        if (!ok) return 1;
     }
 
-    // Configurao da verso do OpenGL
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // Cria uma janela GLFW
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Tringulo em Movimento", NULL, NULL);
-    if (!window) {
-        std::cerr << "Erro ao criar janela GLFW" << std::endl;
-        glfwTerminate();
-        return -1;
+    double broad = 0.0, narrow = 0.0, response = 0.0, swept = 0.0, total = 0.0;
+    long long tested = 0, contacts = 0, impacts = 0;
+    for (int s = 0; s < steps; s++) {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        world.step((float)stepSeconds);
+        total += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        const CollisionWorld::Stats& stats = world.getStats();
+        broad += stats.broadMs;
+        narrow += stats.narrowMs;
+        response += stats.responseMs;
+        swept += stats.continuousMs;
+        tested += stats.testedPairs;
+        contacts += stats.contacts;
+        impacts += stats.impacts;
     }
-    glfwMakeContextCurrent(window);
 
-    // Inicializa GLEW
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Erro ao inicializar GLEW" << std::endl;
-        return -1;
+    const CollisionWorld::Stats& stats = world.getStats();
+    std::cout << "Colisao: " << count << " corpos, " << (sweep ? "sweep-and-prune" : "grade uniforme") << ", " << steps << " passos, "
+              << ThreadPool::shared().getThreadCount() << " threads\n"
+              << "  por passo: " << total * 1000.0 / steps << " ms (larga " << broad / steps << " ms, estreita "
+              << narrow / steps << " ms, resposta " << response / steps << " ms)\n"
+              << "  pares testados " << tested / steps << " de " << stats.naivePairs << " do teste ingenuo ("
+              << 100.0 * tested / steps / (double)stats.naivePairs << "%), contatos " << contacts / steps << std::endl;
+    if (continuous) {
+        std::cout << "  continuo: passo de " << stepSeconds * 1000.0 << " ms, " << swept / steps << " ms e "
+                  << impacts / steps << " impactos por passo, " << total / (steps * stepSeconds)
+                  << " s de CPU por segundo simulado" << std::endl;
     }
+    return 0;
+}
 
-    // Define a rea de renderizao
-    glViewport(0, 0, 800, 600);
-
-    // Dados dos vrtices: Posio (x, y) e Cor (r, g, b)
-    GLfloat vertices[] = {
-        // Posies     // Cores
-        -0.1f, -0.1f,  1.0f, 0.0f, 0.0f,  // Inferior esquerdo (Vermelho)
-         0.1f, -0.1f,  0.0f, 1.0f, 0.0f,  // Inferior direito (Verde)
-        -0.1f,  0.1f,  0.0f, 0.0f, 1.0f,  // Superior (Azul)
-		 0.1f,  0.1f,  0.5f, 0.4f, 1.0f   // Superior direito (Roxo)
-    };
-
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Compilar shaders
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkCompileErrors(vertexShader, "VERTEX");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkCompileErrors(fragmentShader, "FRAGMENT");
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    checkCompileErrors(shaderProgram, "PROGRAM");
+int main(int argc, char** argv) {
+    // "--bodies N" simula N quadrados em vez de dois; "--bench N" mede sem abrir janela;
+    // "--ccd" liga a coliso contnua; "--threads N" limita as threads da simulao
+    int bodyCount = 2, benchCount = 0, steps = 100;
+    bool sweep = false, continuous = false, validate = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bodies" && i + 1 < argc) bodyCount = atoi(argv[++i]);
+        else if (arg == "--bench" && i + 1 < argc) benchCount = atoi(argv[++i]);
+        else if (arg == "--steps" && i + 1 < argc) steps = atoi(argv[++i]);
+        else if (arg == "--sap") sweep = true;
+        else if (arg == "--ccd") continuous = true;
+        else if (arg == "--validate") validate = true;
+        else if (arg == "--threads" && i + 1 < argc) ThreadPool::setSharedThreadCount(atoi(argv[++i]));
+    }
+    if (benchCount > 0) return runBenchmark(benchCount, steps, sweep, continuous, validate);
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Cria a janela GLFW (ou o contexto headless) e inicializa o GLEW
+    Headless app(argc, argv);
+    app.createContext(4, 4, true, 800, 600, "Tringulo em Movimento");
+    if (!app.isOk()) return -1;
 
-    // Posio inicial e velocidade do tringulo
-    Square square = { 0.5f, 0.5f, 0.005f, 0.003f };
-    Square square2 = { -0.5f, 0.5f, 0.010f, 0.006f };
+    // Define a rea de renderizao
+    glViewport(0, 0, 800, 600);
 
-    int offsetLocation = glGetUniformLocation(shaderProgram, "offset");
+    // As cores dos cantos do quadrado original viram uma textura com o gradiente;
+    // cada quadrado  um sprite com essa textura num nico lote
+    GLuint gradientTexture = createGradientTexture();
+    SpriteBatch batch;
+
+    CollisionWorld world;
+    world.setBroadPhase(sweep ? CollisionWorld::SWEEP_AND_PRUNE : CollisionWorld::UNIFORM_GRID);
+    world.setContinuous(continuous);
+    createBodies(world.bodies, bodyCount);
+
+    // A simulao anda em passos fixos e publica centro + meio-lado de cada quadrado
+    SimulationLoop simulation(continuous ? CONTINUOUS_STEP_SECONDS : STEP_SECONDS,
+        [&world](double dt) { world.step((float)dt); },
+        [&world](std::vector<float>& state) {
+            const BodyStore& bodies = world.bodies;
+            state.resize(bodies.size() * 3);
+            for (size_t i = 0; i < bodies.size(); i++) {
+                state[i * 3] = bodies.x[i];
+                state[i * 3 + 1] = bodies.y[i];
+                state[i * 3 + 2] = bodies.halfSize[i];
+            }
+        });
+    // Com janela a simulao roda numa thread prpria; no headless o tempo vem do
+    // nmero do quadro e os passos rodam aqui, para o resultado ser reproduzvel
+    if (!app.isHeadless()) simulation.start();
+    std::vector<float> instances;
 
-    while (!glfwWindowShouldClose(window)) {
+    while (app.running()) {
         glClear(GL_COLOR_BUFFER_BIT);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
-
-        // Atualiza a posio do quadrado
-        square.x += square.speedX;
-        square.y += square.speedY;
-
-        square2.x += square2.speedX;
-        square2.y += square2.speedY;
 
-        // Verifica coliso com as bordas da tela
-        if (fabs(square.x) + square.size > 1.0f) square.speedX *= -1;
-        if (fabs(square.y) + square.size > 1.0f) square.speedY *= -1;
-
-        if (fabs(square2.x) + square2.size > 1.0f) square2.speedX *= -1;
-        if (fabs(square2.y) + square2.size > 1.0f) square2.speedY *= -1;
+        if (app.isHeadless()) simulation.advanceTo(app.getTime());
+
+        // Interpola entre os dois ltimos passos para o movimento no depender da taxa de quadros
+        float alpha;
+        const SimulationLoop::Snapshot& snapshot = simulation.acquire(alpha);
+        SimulationLoop::interpolate(snapshot, alpha, instances);
+
+        // Renderiza os quadrados: uma chamada de desenho para todos
+        size_t count = instances.size() / 3;
+        batch.begin();
+        SpriteBatch::Sprite* sprites = batch.allocate(count, gradientTexture);
+        for (size_t i = 0; i < count; i++) {
+            float size = instances[i * 3 + 2] * 2.0f;
+            SpriteBatch::Sprite sprite = { instances[i * 3], instances[i * 3 + 1], size, size, 0xFFFFFFFFu };
+            sprites[i] = sprite;
+        }
+        batch.end();
 
-        // Verifica coliso entre os quadrados
-        if (checkCollision(square, square2)) {
-            // Inverte a direo dos quadrados em caso de coliso
-            if (fabs(square.x - square2.x) * 2 < (square.size + square2.size)) {
-                square.speedX *= -1;
-                square2.speedX *= -1;
-            }
-            if (fabs(square.y - square2.y) * 2 < (square.size + square2.size)) {
-                square.speedY *= -1;
-                square2.speedY *= -1;
-            };
-        };
-        
-        // Passa o deslocamento para o shader
-        glUniform2f(offsetLocation, square.x, square.y);
-        // Renderiza o quadrado
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-		// Precisa colocar o glUniform2f novamente para o segundo quadrado - sempre juntos
-        glUniform2f(offsetLocation, square2.x, square2.y);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        app.endFrame();
     }
 
-    glfwTerminate();
+    simulation.stop();
+
     return 0;
 }
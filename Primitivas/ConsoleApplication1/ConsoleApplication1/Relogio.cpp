@@ -6,6 +6,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "../../../Comum/Headless.h"
+#include "../../../Comum/ShaderCache.h"
+#include "../../../Comum/SimulationLoop.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -35,48 +38,10 @@ const char* fragmentShaderSource = R"(
     }
 )";
 
-void checkCompileErrors(GLuint shader, std::string type) {
-    GLint success;
-    GLchar infoLog[1024];
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n" << std::endl;
-        }
-    }
-    else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n" << std::endl;
-        }
-    }
-}
-
-int main() {
-    if (!glfwInit()) {
-        std::cerr << "Erro ao inicializar GLFW" << std::endl;
-        return -1;
-    }
-
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Relógio", NULL, NULL);
-    if (!window) {
-        std::cerr << "Erro ao criar janela GLFW" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Erro ao inicializar GLEW" << std::endl;
-        return -1;
-    }
+int main(int argc, char** argv) {
+    Headless app(argc, argv);
+    app.createContext(4, 4, true, 800, 600, "Relógio");
+    if (!app.isOk()) return -1;
 
     glViewport(0, 0, 800, 600);
 
@@ -123,32 +88,30 @@ int main() {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkCompileErrors(vertexShader, "VERTEX");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkCompileErrors(fragmentShader, "FRAGMENT");
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    checkCompileErrors(shaderProgram, "PROGRAM");
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    ShaderCache& shaders = ShaderCache::instance();
+    GLuint shaderProgram = shaders.program(vertexShaderSource, fragmentShaderSource);
+    const ShaderReflection& reflection = shaders.reflection(shaderProgram);
+
+    int transformLoc = reflection.uniform("transform");
+
+    // Ângulos dos ponteiros (horas, minutos, segundos) e velocidades em rad/s;
+    // avançam em passos fixos, não por quadro desenhado
+    float angles[3] = { 0.0f, 0.0f, 0.0f };
+    const float angularSpeeds[3] = { 0.06f, 0.6f, 6.0f };
+    SimulationLoop simulation(1.0 / 120.0,
+        [&angles, &angularSpeeds](double dt) {
+            for (int i = 0; i < 3; i++) angles[i] += angularSpeeds[i] * (float)dt;
+        },
+        [&angles](std::vector<float>& state) { state.assign(angles, angles + 3); });
+    if (!app.isHeadless()) simulation.start();
+    std::vector<float> hands;
+
+    while (app.running()) {
+        if (app.isHeadless()) simulation.advanceTo(app.getTime());
+        float alpha;
+        SimulationLoop::interpolate(simulation.acquire(alpha), alpha, hands);
+        float hourAngle = hands[0], minuteAngle = hands[1], secondAngle = hands[2];
 
-    int transformLoc = glGetUniformLocation(shaderProgram, "transform");
-
-    float hourAngle = 0.0f;
-    float minuteAngle = 0.0f;
-    float secondAngle = 0.0f;
-
-    while (!glfwWindowShouldClose(window)) {
         glClear(GL_COLOR_BUFFER_BIT);
 
         glUseProgram(shaderProgram);
@@ -159,11 +122,6 @@ int main() {
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(identity));
         glDrawArrays(GL_LINE_LOOP, 0, segments);
 
-		// Atualiza o ângulo de rotação dos ponteiros
-		hourAngle += 0.001f;
-        minuteAngle += 0.01f;
-        secondAngle += 0.1f;
-
         // Ponteiro das horas
         glBindVertexArray(VAOs[1]);
         glm::mat4 hourTransform = glm::rotate(identity, hourAngle, glm::vec3(0, 0, 1));
@@ -180,10 +138,10 @@ int main() {
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(secTransform));
         glDrawArrays(GL_LINES, 0, 2);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        app.endFrame();
     }
 
-    glfwTerminate();
+    simulation.stop();
+
     return 0;
 }
@@ -0,0 +1,299 @@
+// Verificacao do decodificador Bmp sobre um pequeno corpus gerado aqui:
+// 1/4/8 bits com paleta, RLE8, RLE4, 24 bits, 32 bits BGRA e BI_BITFIELDS,
+// arquivos de cima para baixo (altura negativa), larguras que exigem
+// alinhamento de linha, uma imagem larga e baixa (faixas de linhas em
+// paralelo), ida e volta por Bmp::save e cabecalhos truncados ou com
+// dimensoes absurdas, que tem que falhar com status e sem travar.
+//
+// Cada caso grava o arquivo, carrega com Bmp e compara getImage() com a
+// imagem esperada no layout de sempre (BGR, de baixo para cima, linhas
+// alinhadas em 4 bytes). Sai com codigo 1 se algum caso falhar.
+//
+// Uso: bmp_decode_check [diretorio temporario]
+//
+// Compilar com ../Comum/{bmp,ThreadPool}.cpp.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../Comum/Bmp.h"
+
+typedef std::vector<unsigned char> Bytes;
+
+static std::string directory = ".";
+static int failures = 0;
+
+static void put16(Bytes& b, unsigned int v) {
+    b.push_back((uchar)v);
+    b.push_back((uchar)(v >> 8));
+}
+
+static void put32(Bytes& b, unsigned int v) {
+    put16(b, v & 0xffff);
+    put16(b, v >> 16);
+}
+
+// Arquivo com HEADER + INFOHEADER de 40 bytes, depois extra (mascaras ou
+// paleta) e os pixels ja' codificados
+static Bytes makeFile(int width, int height, int bits, int compression, const Bytes& extra, const Bytes& pixels) {
+    Bytes b;
+    unsigned int offset = HEADER_SIZE + INFOHEADER_SIZE + (unsigned int)extra.size();
+    put16(b, 19778);
+    put32(b, offset + (unsigned int)pixels.size());
+    put16(b, 0);
+    put16(b, 0);
+    put32(b, offset);
+    put32(b, INFOHEADER_SIZE);
+    put32(b, (unsigned int)width);
+    put32(b, (unsigned int)height);
+    put16(b, 1);
+    put16(b, bits);
+    put32(b, compression);
+    put32(b, (unsigned int)pixels.size());
+    put32(b, 2835);
+    put32(b, 2835);
+    put32(b, 0);
+    put32(b, 0);
+    b.insert(b.end(), extra.begin(), extra.end());
+    b.insert(b.end(), pixels.begin(), pixels.end());
+    return b;
+}
+
+// Cor de referencia de cada pixel (x, y com y = 0 embaixo) e indice de paleta
+static void color(int x, int y, uchar bgr[3]) {
+    bgr[0] = (uchar)(x * 7 + y * 3);
+    bgr[1] = (uchar)(x * 13 + 40);
+    bgr[2] = (uchar)(y * 29 + x);
+}
+
+static int paletteIndex(int x, int y, int colours) {
+    return (x * 3 + y * 5) % colours;
+}
+
+static Bytes makePalette(int colours) {
+    Bytes p;
+    for (int i = 0; i < colours; i++) {
+        p.push_back((uchar)(i * 37));
+        p.push_back((uchar)(i * 91 + 5));
+        p.push_back((uchar)(i * 13 + 200));
+        p.push_back(0);
+    }
+    return p;
+}
+
+// Imagem esperada a partir de uma funcao por pixel
+template <typename F>
+static Bytes expected(int width, int height, F pixel) {
+    int stride = (3 * width + 3) / 4 * 4;
+    Bytes out((size_t)stride * height, 0);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) pixel(x, y, &out[(size_t)y * stride + 3 * x]);
+    return out;
+}
+
+static Bytes expectedDirect(int width, int height) {
+    return expected(width, height, [](int x, int y, uchar* out) { color(x, y, out); });
+}
+
+static Bytes expectedPalette(int width, int height, int colours) {
+    Bytes palette = makePalette(colours);
+    return expected(width, height, [&](int x, int y, uchar* out) {
+        memcpy(out, &palette[4 * paletteIndex(x, y, colours)], 3);
+    });
+}
+
+static std::string fileName(const char* name) {
+    return directory + "/bmpcheck_" + name + ".bmp";
+}
+
+static bool writeFile(const std::string& path, const Bytes& data) {
+    FILE* fp = NULL;
+    fopen_s(&fp, path.c_str(), "wb");
+    if (fp == NULL) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+static void report(const char* name, bool ok, const char* detail) {
+    printf("%-28s %s%s%s\n", name, ok ? "ok" : "FALHOU", detail[0] ? ": " : "", detail);
+    if (!ok) failures++;
+}
+
+static void check(const char* name, const Bytes& file, int width, int height, const Bytes& want) {
+    std::string path = fileName(name);
+    if (!writeFile(path, file)) {
+        report(name, false, "nao foi possivel gravar o arquivo");
+        return;
+    }
+    Bmp bmp(path.c_str());
+    remove(path.c_str());
+    if (bmp.getStatus() != BMP_OK) {
+        report(name, false, Bmp::statusMessage(bmp.getStatus()));
+        return;
+    }
+    if (bmp.getWidth() != width || bmp.getHeight() != height) {
+        report(name, false, "dimensoes erradas");
+        return;
+    }
+    report(name, memcmp(bmp.getImage(), want.data(), want.size()) == 0, "");
+}
+
+static void checkStatus(const char* name, const Bytes& file, BmpStatus want) {
+    std::string path = fileName(name);
+    writeFile(path, file);
+    Bmp bmp(path.c_str());
+    remove(path.c_str());
+    report(name, bmp.getStatus() == want && bmp.getImage() == NULL, Bmp::statusMessage(bmp.getStatus()));
+}
+
+// 24 ou 32 bits sem paleta; linhas gravadas de cima para baixo se topDown
+static Bytes directPixels(int width, int height, int bits, bool topDown, const unsigned int* masks) {
+    int stride = (bits * width + 31) / 32 * 4;
+    Bytes p((size_t)stride * height, 0);
+    for (int row = 0; row < height; row++) {
+        int y = topDown ? height - 1 - row : row;
+        uchar* out = &p[(size_t)row * stride];
+        for (int x = 0; x < width; x++) {
+            uchar bgr[3];
+            color(x, y, bgr);
+            if (bits == 24) {
+                memcpy(out + 3 * x, bgr, 3);
+            }
+            else if (masks == NULL) {
+                memcpy(out + 4 * x, bgr, 3);
+                out[4 * x + 3] = 255;
+            }
+            else {
+                // masks = R, G, B com 8 bits cada
+                unsigned int v = 0;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int shift = 0;
+                    while (((masks[c] >> shift) & 1) == 0) shift++;
+                    v |= (unsigned int)bgr[2 - c] << shift;
+                }
+                for (int k = 0; k < 4; k++) out[4 * x + k] = (uchar)(v >> (8 * k));
+            }
+        }
+    }
+    return p;
+}
+
+static Bytes indexedPixels(int width, int height, int bits, bool topDown) {
+    int stride = (bits * width + 31) / 32 * 4;
+    int perByte = 8 / bits;
+    Bytes p((size_t)stride * height, 0);
+    for (int row = 0; row < height; row++) {
+        int y = topDown ? height - 1 - row : row;
+        for (int x = 0; x < width; x++) {
+            int idx = paletteIndex(x, y, 1 << bits);
+            p[(size_t)row * stride + x / perByte] |= (uchar)(idx << ((perByte - 1 - x % perByte) * bits));
+        }
+    }
+    return p;
+}
+
+// RLE com 12 pixels por linha: 5 repetidos (sequencia codificada) e 7
+// diferentes (sequencia absoluta), fim de linha e fim do bitmap
+static const int RLE_WIDTH = 12;
+
+static int rleIndex(int x, int y) {
+    return x < 5 ? y % 16 : (x * 3 + y) % 16;
+}
+
+static Bytes rlePixels(int height, bool rle8) {
+    Bytes p;
+    for (int y = 0; y < height; y++) {
+        p.push_back(5);
+        p.push_back((uchar)(rle8 ? rleIndex(0, y) : (rleIndex(0, y) << 4 | rleIndex(0, y))));
+        p.push_back(0);
+        p.push_back(7);
+        if (rle8) {
+            for (int x = 5; x < RLE_WIDTH; x++) p.push_back((uchar)rleIndex(x, y));
+            p.push_back(0); // 7 bytes: completa 16 bits
+        }
+        else {
+            for (int x = 5; x < RLE_WIDTH; x += 2) {
+                int hi = rleIndex(x, y), lo = x + 1 < RLE_WIDTH ? rleIndex(x + 1, y) : 0;
+                p.push_back((uchar)(hi << 4 | lo));
+            }
+        }
+        p.push_back(0);
+        p.push_back(0);
+    }
+    p.push_back(0);
+    p.push_back(1);
+    return p;
+}
+
+static void checkRle(const char* name, bool rle8) {
+    const int height = 6;
+    Bytes palette = makePalette(rle8 ? 256 : 16);
+    Bytes want = expected(RLE_WIDTH, height, [&](int x, int y, uchar* out) {
+        memcpy(out, &palette[4 * rleIndex(x, y)], 3);
+    });
+    check(name, makeFile(RLE_WIDTH, height, rle8 ? 8 : 4, rle8 ? BMP_RLE8 : BMP_RLE4, palette, rlePixels(height, rle8)),
+          RLE_WIDTH, height, want);
+}
+
+static void checkIndexed(const char* name, int width, int height, int bits, bool topDown) {
+    check(name, makeFile(width, topDown ? -height : height, bits, BMP_RGB, makePalette(1 << bits),
+                         indexedPixels(width, height, bits, topDown)),
+          width, height, expectedPalette(width, height, 1 << bits));
+}
+
+static void checkDirect(const char* name, int width, int height, int bits, bool topDown) {
+    check(name, makeFile(width, topDown ? -height : height, bits, BMP_RGB, Bytes(),
+                         directPixels(width, height, bits, topDown, NULL)),
+          width, height, expectedDirect(width, height));
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) directory = argv[1];
+    Bmp::setVerbose(false);
+
+    checkIndexed("1 bit", 13, 7, 1, false);
+    checkIndexed("4 bits", 13, 7, 4, false);
+    checkIndexed("8 bits", 13, 7, 8, false);
+    checkIndexed("8 bits topo-base", 13, 7, 8, true);
+    checkRle("RLE8", true);
+    checkRle("RLE4", false);
+    checkDirect("24 bits", 5, 4, 24, false);
+    checkDirect("24 bits topo-base", 5, 4, 24, true);
+    checkDirect("32 bits", 6, 5, 32, false);
+    checkDirect("32 bits topo-base", 6, 5, 32, true);
+    // mascaras fora da ordem BGRA padrao
+    const unsigned int masks[3] = { 0x000000ff, 0x00ff0000, 0x0000ff00 };
+    Bytes maskBytes;
+    for (int c = 0; c < 3; c++) put32(maskBytes, masks[c]);
+    check("32 bits BI_BITFIELDS", makeFile(6, 5, 32, BMP_BITFIELDS, maskBytes, directPixels(6, 5, 32, false, masks)),
+          6, 5, expectedDirect(6, 5));
+    // poucas linhas muito largas: as faixas de linhas nao podem ficar vazias
+    checkDirect("24 bits 10000x10", 10000, 10, 24, false);
+    checkIndexed("8 bits 300x300", 300, 300, 8, false);
+
+    // ida e volta por Bmp::save
+    {
+        Bytes want = expectedDirect(7, 3);
+        std::string path = fileName("save");
+        bool saved = Bmp::save(path.c_str(), 7, 3, want.data()) == BMP_OK;
+        Bmp bmp(path.c_str());
+        remove(path.c_str());
+        report("Bmp::save", saved && bmp.getStatus() == BMP_OK && bmp.getWidth() == 7 && bmp.getHeight() == 3 &&
+                            memcmp(bmp.getImage(), want.data(), want.size()) == 0, "");
+    }
+
+    // erros: status, imagem NULL e nada de leitura fora do arquivo
+    Bytes full = makeFile(5, 4, 24, BMP_RGB, Bytes(), directPixels(5, 4, 24, false, NULL));
+    checkStatus("pixels truncados", Bytes(full.begin(), full.end() - 10), BMP_ERROR_TRUNCATED);
+    checkStatus("cabecalho truncado", Bytes(full.begin(), full.begin() + 20), BMP_ERROR_TRUNCATED);
+    checkStatus("dimensoes enormes", makeFile(0x40000000, 0x40000000, 24, BMP_RGB, Bytes(), Bytes(64, 0)),
+                BMP_ERROR_UNSUPPORTED);
+    checkStatus("altura INT_MIN", makeFile(4, (int)0x80000000, 24, BMP_RGB, Bytes(), Bytes(64, 0)),
+                BMP_ERROR_CORRUPT);
+    checkStatus("16 bits", makeFile(4, 4, 16, BMP_RGB, Bytes(), Bytes(64, 0)), BMP_ERROR_UNSUPPORTED);
+
+    printf("%s\n", failures == 0 ? "Todos os casos passaram" : "Ha' falhas");
+    return failures == 0 ? 0 : 1;
+}
@@ -7,7 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <windows.h>
-#include "Bmp.h"
+#include <string>
+#include "../Comum/Bmp.h"
+#include "../Comum/FilterPipeline.h"
+#include "../Comum/GLState.h"
+#include "../Comum/Headless.h"
+#include "../Comum/Profiler.h"
+#include "../Comum/ShaderCache.h"
+#include "../Comum/SoftRasterizer.h"
 
 #define SCREEN_X 800
 #define SCREEN_Y 600
@@ -15,6 +22,7 @@
 GLuint textureID;
 GLuint vao, vbo, ebo;
 GLuint shaderProgram;
+GLint mvpLoc = -1;
 
 Bmp* img1;
 unsigned char* data;
@@ -42,7 +50,7 @@ void main() {
 void buildTexture()
 {
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLState::current().bindTexture(0, GL_TEXTURE_2D, textureID);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -52,89 +60,74 @@ void buildTexture()
     gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGB, img1->getWidth(), img1->getHeight(), GL_RGB, GL_UNSIGNED_BYTE, data);
 }
 
-GLuint compileShader(const char* src, GLenum type)
-{
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, NULL);
-    glCompileShader(shader);
-    return shader;
-}
-
 void setupShaders()
 {
-    GLuint vertexShader = compileShader(vertexShaderSource, GL_VERTEX_SHADER);
-    GLuint fragmentShader = compileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    ShaderCache& shaders = ShaderCache::instance();
+    shaderProgram = shaders.program(vertexShaderSource, fragmentShaderSource);
+    mvpLoc = shaders.reflection(shaderProgram).uniform("mvp");
 }
 
+static const float cubeVertices[] = {
+    // positions          // texture coords
+    // Face traseira
+    -1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
+     1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f, -1.0f,  1.0f, 1.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f, 1.0f,
+
+    // Face frontal
+    -1.0f, -1.0f,  1.0f,  0.0f, 0.0f,
+     1.0f, -1.0f,  1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
+    -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
+
+    // Face esquerda
+    -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
+    -1.0f,  1.0f, -1.0f,  0.0f, 0.0f,
+    -1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
+    -1.0f, -1.0f,  1.0f,  1.0f, 1.0f,
+
+    // Face direita
+     1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
+     1.0f,  1.0f, -1.0f,  1.0f, 0.0f,
+     1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
+     1.0f, -1.0f,  1.0f,  0.0f, 1.0f,
+
+     // Face inferior
+     -1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
+      1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
+      1.0f, -1.0f,  1.0f,  1.0f, 1.0f,
+     -1.0f, -1.0f,  1.0f,  0.0f, 1.0f,
+
+     // Face superior
+     -1.0f,  1.0f, -1.0f,  0.0f, 0.0f,
+      1.0f,  1.0f, -1.0f,  1.0f, 0.0f,
+      1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
+     -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
+};
+
+static const unsigned int cubeIndices[] = {
+    0, 1, 2, 2, 3, 0,   // Face traseira
+    4, 5, 6, 6, 7, 4,   // Face frontal
+    8, 9, 10, 10, 11, 8, // Face esquerda
+    12, 13, 14, 14, 15, 12, // Face direita
+    16, 17, 18, 18, 19, 16, // Face inferior
+    20, 21, 22, 22, 23, 20  // Face superior
+};
+
 void setupBuffers()
 {
-    float vertices[] = {
-        // positions          // texture coords
-        // Face traseira
-        -1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,  1.0f, 1.0f,
-        -1.0f,  1.0f, -1.0f,  0.0f, 1.0f,
-
-        // Face frontal
-        -1.0f, -1.0f,  1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
-        -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
-
-        // Face esquerda
-        -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f,  1.0f, -1.0f,  0.0f, 0.0f,
-        -1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
-        -1.0f, -1.0f,  1.0f,  1.0f, 1.0f,
-
-        // Face direita
-         1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
-         1.0f,  1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,  0.0f, 1.0f,
-
-         // Face inferior
-         -1.0f, -1.0f, -1.0f,  0.0f, 0.0f,
-          1.0f, -1.0f, -1.0f,  1.0f, 0.0f,
-          1.0f, -1.0f,  1.0f,  1.0f, 1.0f,
-         -1.0f, -1.0f,  1.0f,  0.0f, 1.0f,
-
-         // Face superior
-         -1.0f,  1.0f, -1.0f,  0.0f, 0.0f,
-          1.0f,  1.0f, -1.0f,  1.0f, 0.0f,
-          1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
-         -1.0f,  1.0f,  1.0f,  0.0f, 1.0f,
-    };
-
-    GLuint indices[] = {
-        0, 1, 2, 2, 3, 0,   // Face traseira
-        4, 5, 6, 6, 7, 4,   // Face frontal
-        8, 9, 10, 10, 11, 8, // Face esquerda
-        12, 13, 14, 14, 15, 12, // Face direita
-        16, 17, 18, 18, 19, 16, // Face inferior
-        20, 21, 22, 22, 23, 20  // Face superior
-    };
-
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
 
-    glBindVertexArray(vao);
+    GLState::current().bindVertexArray(vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -142,13 +135,11 @@ void setupBuffers()
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    GLState::current().bindVertexArray(0);
 }
 
-void display(GLFWwindow* window)
+glm::mat4 cubeMvp(double time)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
     // Projeção com perspectiva corrigida
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_X / SCREEN_Y, 0.1f, 100.0f);
 
@@ -156,43 +147,87 @@ void display(GLFWwindow* window)
     glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -5));
 
     // Rotação do cubo
-    glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)time, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    return projection * view * model;
+}
+
+void display(Headless& app)
+{
+    PROFILE_SCOPE("display");
+    PROFILE_GPU_SCOPE("display");
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glm::mat4 mvp = projection * view * model;
+    glm::mat4 mvp = cubeMvp(app.getTime());
 
-    glUseProgram(shaderProgram);
-    GLuint mvpLoc = glGetUniformLocation(shaderProgram, "mvp");
+    GLState& gl = GLState::current();
+    gl.useProgram(shaderProgram);
     glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
 
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glBindVertexArray(vao);
+    gl.bindTexture(0, GL_TEXTURE_2D, textureID);
+    gl.bindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    PROFILE_DRAW(12);
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    app.endFrame();
 }
 
-int main()
+// Mesmo quadro no SoftRasterizer (--software): a textura so' com o filtro
+// bilinear, sem os mipmaps do gluBuild2DMipmaps
+void displaySoftware(Headless& app, SoftRasterizer& raster, const SoftRasterizer::Texture& texture)
 {
-    if (!glfwInit()) return -1;
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+    PROFILE_SCOPE("displaySoftware");
+    raster.clear(0.0f, 0.0f, 0.0f);
+    SoftRasterizer::Material material = { SoftRasterizer::TEXTURE, 3, &texture, false };
+    raster.draw(cubeVertices, 24, 5, cubeIndices, 36, cubeMvp(app.getTime()), material);
+    raster.finish();
 
-    GLFWwindow* window = glfwCreateWindow(SCREEN_X, SCREEN_Y, "Texture Demo", NULL, NULL);
-    if (!window) { glfwTerminate(); return -1; }
+    app.endFrame();
+}
 
-    glfwMakeContextCurrent(window);
-    glewExperimental = true;
-    if (glewInit() != GLEW_OK) return -1;
+int main(int argc, char** argv)
+{
+    Headless app(argc, argv);
+    app.createContext(4, 0, false, SCREEN_X, SCREEN_Y, "Texture Demo");
+    if (!app.isOk()) return -1;
 
-    glEnable(GL_DEPTH_TEST);
-    glViewport(0, 0, 800, 600);
+    if (!app.isSoftware())
+    {
+        GLState::current().depthTest(true);
+        glViewport(0, 0, 800, 600);
+    }
 
     img1 = new Bmp("./images/normal_1.bmp");
     img1->convertBGRtoRGB();
     data = img1->getImage();
 
+    // "--prefilter" tira o ruido da imagem (mediana 3x3) e recupera as bordas
+    // (unsharp mask) antes de gerar os mipmaps, numa passada so' por ladrilho
+    for (int i = 1; i < argc; i++)
+    {
+        if (data && std::string(argv[i]) == "--prefilter")
+        {
+            FilterPipeline pipeline;
+            pipeline.median(1).unsharp(1.0f, 0.6f);
+            pipeline.runImage(data, data, img1->getWidth(), img1->getHeight());
+        }
+    }
+
+    if (app.isSoftware())
+    {
+        SoftRasterizer raster(SCREEN_X, SCREEN_Y);
+        if (data)
+        {
+            // linhas do Bmp alinhadas em 4 bytes, como o GL_UNPACK_ALIGNMENT padrao
+            SoftRasterizer::Texture texture = { data, img1->getWidth(), img1->getHeight(), (3 * img1->getWidth() + 3) / 4 * 4, true };
+            while (app.running()){
+                displaySoftware(app, raster, texture);
+            }
+        }
+        raster.save(app.getImagePath().c_str());
+        return 0;
+    }
+
     if (data)
     {
         buildTexture();
@@ -200,11 +235,9 @@ int main()
         setupBuffers();
     }
 
-    while (!glfwWindowShouldClose(window)){
-        display(window);
+    while (app.running()){
+        display(app);
     }
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
     return 0;
 }